@@ -22,6 +22,12 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// sub-allocated host visible memory stays mapped
+		if (allocation.isValid())
+		{
+			mapped = allocation.mapped ? (uint8_t*)allocation.mapped + offset : nullptr;
+			return mapped ? VK_SUCCESS : VK_ERROR_MEMORY_MAP_FAILED;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +40,8 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocation.isValid())
+				vkUnmapMemory(device, memory);
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +55,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -93,8 +100,11 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
+		mappedRange.offset = allocation.offset + offset;
 		mappedRange.size = size;
+		// the whole size would reach to the end of the block
+		if (allocation.isValid() && size == VK_WHOLE_SIZE)
+			mappedRange.size = allocation.size - offset;
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -113,8 +123,11 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
+		mappedRange.offset = allocation.offset + offset;
 		mappedRange.size = size;
+		// the whole size would reach to the end of the block
+		if (allocation.isValid() && size == VK_WHOLE_SIZE)
+			mappedRange.size = allocation.size - offset;
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -128,6 +141,12 @@ namespace vks
 			vkDestroyBuffer(device, buffer, nullptr);
 			buffer = VK_NULL_HANDLE;
 		}
+		if (allocation.isValid())
+		{
+			allocation.allocator->free(allocation);
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
 		if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
@@ -64,6 +64,10 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		if (memoryAllocator)
+		{
+			delete memoryAllocator;
+		}
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -282,7 +286,7 @@ namespace vks
 			enableBindingPartiallyBound = true;
 		}
 
-		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = enabledDescriptorIndexingFeatures;
 		if (enableBindingPartiallyBound) {
 			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
 			descriptorIndexingFeatures.pNext = nullptr;
@@ -327,6 +331,8 @@ namespace vks
 		}
 
 		this->enabledFeatures = enabledFeatures;
+		// what the device was created with, callers check these before relying on a feature
+		if (!enableBindingPartiallyBound) enabledDescriptorIndexingFeatures = {};
 
 		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
 		if (result != VK_SUCCESS) 
@@ -337,6 +343,8 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		memoryAllocator = new DeviceMemoryAllocator(logicalDevice, memoryProperties, properties.limits);
+
 		return result;
 	}
 
@@ -399,6 +407,76 @@ namespace vks
 		return VK_SUCCESS;
 	}
 
+	/**
+	* Create a buffer on the device whose memory is sub-allocated from a block of the memory allocator
+	*
+	* @param usageFlags Usage flag bit mask for the buffer (i.e. index, vertex, uniform buffer)
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param size Size of the buffer in bytes
+	* @param buffer Pointer to the buffer handle acquired by the function
+	* @param allocation Pointer to the memory range acquired by the function, to be released with freeMemory
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, requires host visible memory)
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*/
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::MemoryAllocation *allocation, void *data)
+	{
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
+		const uint32_t memoryType = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR : 0;
+		VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryType, DeviceMemoryAllocator::kResource_Linear, allocation, allocateFlags));
+
+		if (data != nullptr)
+		{
+			assert(allocation->mapped);
+			memcpy(allocation->mapped, data, size);
+			if ((memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+			{
+				VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+				mappedRange.memory = allocation->memory;
+				mappedRange.offset = allocation->offset;
+				mappedRange.size = allocation->size;
+				vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
+			}
+		}
+		return vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Allocate and bind the memory of an image from a block of the memory allocator, large images get a dedicated allocation
+	*
+	* @param image Image without memory bound to it
+	* @param memoryPropertyFlags Memory properties for the image memory (usually device local)
+	* @param allocation Pointer to the memory range acquired by the function, to be released with freeMemory
+	* @param linearTiling True if the image was created with VK_IMAGE_TILING_LINEAR, it shares blocks with buffers then
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound to the image
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, bool linearTiling)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		const uint32_t memoryType = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		const DeviceMemoryAllocator::ResourceKind kind = linearTiling ? DeviceMemoryAllocator::kResource_Linear : DeviceMemoryAllocator::kResource_Optimal;
+		VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryType, kind, allocation));
+		return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Return a range acquired by createBuffer or allocateImageMemory, the resource bound to it has to be destroyed already
+	*/
+	void VulkanDevice::freeMemory(vks::MemoryAllocation &allocation)
+	{
+		if (allocation.isValid())
+		{
+			allocation.allocator->free(allocation);
+		}
+	}
+
 	/**
 	* Create a buffer on the device
 	*
@@ -407,32 +485,36 @@ namespace vks
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param sharingQueueFamilies Queue families accessing the buffer concurrently (optional, with less than two distinct families the buffer is exclusive)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, const std::vector<uint32_t> &sharingQueueFamilies)
 	{
 		buffer->device = logicalDevice;
 
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		std::vector<uint32_t> queueFamilies = sharingQueueFamilies;
+		std::sort(queueFamilies.begin(), queueFamilies.end());
+		queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+		if (queueFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = (uint32_t)queueFamilies.size();
+			bufferCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+		}
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
 		// Create the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
 		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		const uint32_t memoryType = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set the memory is allocated on its own with the appropriate flag
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR : 0;
+		VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryType, DeviceMemoryAllocator::kResource_Linear, &buffer->allocation, allocateFlags));
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -564,7 +646,10 @@ namespace vks
 		VkFence fence;
 		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
 		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		}
 		// Wait for the fence to signal that command buffer has finished executing
 		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 		vkDestroyFence(logicalDevice, fence, nullptr);
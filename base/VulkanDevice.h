@@ -11,11 +11,13 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanDeviceMemory.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <mutex>
 
 namespace vks
 {
@@ -31,6 +33,8 @@ struct VulkanDevice
 	VkPhysicalDeviceFeatures features;
 	/** @brief Features that have been enabled for use on the physical device */
 	VkPhysicalDeviceFeatures enabledFeatures;
+	/** @brief Descriptor indexing features to enable with the extension, partially bound bindings are always enabled */
+	VkPhysicalDeviceDescriptorIndexingFeatures enabledDescriptorIndexingFeatures{};
 	/** @brief Memory types and heaps of the physical device */
 	VkPhysicalDeviceMemoryProperties memoryProperties;
 	/** @brief Queue family properties of the physical device */
@@ -39,6 +43,10 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Sub-allocates the memory of vks::Buffer, textures and model buffers, created with the logical device */
+	DeviceMemoryAllocator *memoryAllocator = nullptr;
+	/** @brief Guards host access to the queues, which must be externally synchronized when several threads submit */
+	std::mutex queueMutex;
 	/** @brief Contains queue family indices */
 	bool enableDebugMarkers = false;
 	bool enableBindingPartiallyBound = false;
@@ -59,7 +67,10 @@ struct VulkanDevice
 	uint32_t        getQueueFamilyIndex(VkQueueFlags queueFlags) const;
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::MemoryAllocation *allocation, void *data = nullptr);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, const std::vector<uint32_t> &sharingQueueFamilies = {});
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, bool linearTiling = false);
+	void            freeMemory(vks::MemoryAllocation &allocation);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
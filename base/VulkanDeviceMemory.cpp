@@ -0,0 +1,271 @@
+/*
+* Vulkan device memory sub-allocator
+*
+* Places buffers and images in large blocks of device memory instead of one allocation per resource
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDeviceMemory.h"
+#include <algorithm>
+#include <iostream>
+
+namespace vks
+{
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static VkResult allocateMemory(VkDevice device, uint32_t memoryType, VkDeviceSize size, VkMemoryAllocateFlags allocateFlags, bool map, VkDeviceMemory* memory, void** mapped)
+	{
+		VkMemoryAllocateInfo memAlloc{};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryType;
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (allocateFlags != 0) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = allocateFlags;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS) return result;
+
+		*mapped = nullptr;
+		if (map) {
+			result = vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (result != VK_SUCCESS) {
+				vkFreeMemory(device, *memory, nullptr);
+				*memory = VK_NULL_HANDLE;
+			}
+		}
+		return result;
+	}
+
+	DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize)
+	{
+		device_ = device;
+		memoryProperties_ = memoryProperties;
+		nonCoherentAtomSize_ = std::max<VkDeviceSize>(1, limits.nonCoherentAtomSize);
+		blockSize_ = blockSize;
+	}
+
+	DeviceMemoryAllocator::~DeviceMemoryAllocator()
+	{
+		destroy();
+	}
+
+	void DeviceMemoryAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint32_t leaked = 0;
+		for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+			for (auto& blocks : blocks_[type]) {
+				for (Block* block : blocks) {
+					leaked += block->allocationCount;
+					destroyBlock(block);
+				}
+				blocks.clear();
+			}
+			leaked += dedicatedCount_[type];
+			dedicatedCount_[type] = 0;
+			dedicatedBytes_[type] = 0;
+		}
+		if (leaked) std::cerr << "DeviceMemoryAllocator: " << leaked << " allocations were not freed\n";
+	}
+
+	bool DeviceMemoryAllocator::isHostVisible(uint32_t memoryType) const
+	{
+		return (memoryProperties_.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	VkDeviceSize DeviceMemoryAllocator::getBlockSize(uint32_t memoryType) const
+	{
+		// small heaps (e.g. the 256 MB host visible window of VRAM) get proportionally smaller blocks
+		const VkDeviceSize heapSize = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[memoryType].heapIndex].size;
+		return std::min(blockSize_, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+	}
+
+	DeviceMemoryAllocator::Block* DeviceMemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size)
+	{
+		Block* block = new Block();
+		void* mapped = nullptr;
+		if (allocateMemory(device_, memoryType, size, 0, isHostVisible(memoryType), &block->memory, &mapped) != VK_SUCCESS) {
+			delete block;
+			return nullptr;
+		}
+		block->size = size;
+		block->mapped = (uint8_t*)mapped;
+		block->freeRanges.push_back({ 0, size });
+		return block;
+	}
+
+	void DeviceMemoryAllocator::destroyBlock(Block* block)
+	{
+		// freeing mapped memory unmaps it implicitly
+		vkFreeMemory(device_, block->memory, nullptr);
+		delete block;
+	}
+
+	VkResult DeviceMemoryAllocator::allocate(const VkMemoryRequirements& memReqs, uint32_t memoryType, ResourceKind kind, MemoryAllocation* allocation, VkMemoryAllocateFlags allocateFlags)
+	{
+		*allocation = MemoryAllocation();
+		allocation->memoryType = memoryType;
+		allocation->allocator = this;
+
+		// flushed ranges of host visible memory have to start and end at atom boundaries
+		const bool hostVisible = isHostVisible(memoryType);
+		VkDeviceSize alignment = std::max<VkDeviceSize>(1, memReqs.alignment);
+		VkDeviceSize size = std::max<VkDeviceSize>(1, memReqs.size);
+		if (hostVisible) {
+			alignment = std::max(alignment, nonCoherentAtomSize_);
+			size = alignUp(size, nonCoherentAtomSize_);
+		}
+		allocation->size = size;
+
+		const VkDeviceSize blockSize = getBlockSize(memoryType);
+		if (allocateFlags == 0 && size < blockSize / 2) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::vector<Block*>& blocks = blocks_[memoryType][kind];
+
+			// best fit over all blocks fills the holes freed resources left before a new block is started
+			Block* bestBlock = nullptr;
+			size_t bestRange = 0;
+			VkDeviceSize bestWaste = ~(VkDeviceSize)0;
+			for (Block* block : blocks) {
+				for (size_t i = 0; i < block->freeRanges.size(); ++i) {
+					const Range& range = block->freeRanges[i];
+					const VkDeviceSize offset = alignUp(range.offset, alignment);
+					if (offset + size > range.offset + range.size) continue;
+					const VkDeviceSize waste = range.size - size;
+					if (waste < bestWaste) {
+						bestBlock = block;
+						bestRange = i;
+						bestWaste = waste;
+					}
+				}
+			}
+			if (!bestBlock) {
+				bestBlock = createBlock(memoryType, blockSize);
+				if (bestBlock) blocks.push_back(bestBlock);
+			}
+			if (bestBlock) {
+				// the padding in front of the aligned offset and the rest behind it stay free
+				std::vector<Range>& freeRanges = bestBlock->freeRanges;
+				const Range range = freeRanges[bestRange];
+				const VkDeviceSize offset = alignUp(range.offset, alignment);
+				const VkDeviceSize end = offset + size;
+				auto it = freeRanges.erase(freeRanges.begin() + bestRange);
+				if (end < range.offset + range.size) it = freeRanges.insert(it, { end, range.offset + range.size - end });
+				if (offset > range.offset) freeRanges.insert(it, { range.offset, offset - range.offset });
+
+				bestBlock->usedBytes += size;
+				++bestBlock->allocationCount;
+				allocation->memory = bestBlock->memory;
+				allocation->offset = offset;
+				allocation->mapped = bestBlock->mapped ? bestBlock->mapped + offset : nullptr;
+				allocation->block = bestBlock;
+				return VK_SUCCESS;
+			}
+			// no room for another block, the resource may still fit on its own
+		}
+
+		VkResult result = allocateMemory(device_, memoryType, size, allocateFlags, hostVisible, &allocation->memory, &allocation->mapped);
+		if (result != VK_SUCCESS) {
+			*allocation = MemoryAllocation();
+			return result;
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		++dedicatedCount_[memoryType];
+		dedicatedBytes_[memoryType] += size;
+		return VK_SUCCESS;
+	}
+
+	void DeviceMemoryAllocator::free(MemoryAllocation& allocation)
+	{
+		if (!allocation.isValid()) return;
+
+		if (allocation.isDedicated()) {
+			vkFreeMemory(device_, allocation.memory, nullptr);
+			std::lock_guard<std::mutex> lock(mutex_);
+			--dedicatedCount_[allocation.memoryType];
+			dedicatedBytes_[allocation.memoryType] -= allocation.size;
+		}
+		else {
+			std::lock_guard<std::mutex> lock(mutex_);
+			Block* block = (Block*)allocation.block;
+			block->usedBytes -= allocation.size;
+			--block->allocationCount;
+
+			const Range range = { allocation.offset, allocation.size };
+			std::vector<Range>& freeRanges = block->freeRanges;
+			auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), range.offset, [](const Range& r, VkDeviceSize offset) {
+				return r.offset < offset;
+			});
+			it = freeRanges.insert(it, range);
+			// merge with the following range first, the iterator stays valid
+			auto next = it + 1;
+			if (next != freeRanges.end() && it->offset + it->size == next->offset) {
+				it->size += next->size;
+				freeRanges.erase(next);
+			}
+			if (it != freeRanges.begin()) {
+				auto prev = it - 1;
+				if (prev->offset + prev->size == it->offset) {
+					prev->size += it->size;
+					freeRanges.erase(it);
+				}
+			}
+		}
+		allocation = MemoryAllocation();
+	}
+
+	uint32_t DeviceMemoryAllocator::releaseEmptyBlocks()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint32_t released = 0;
+		for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+			for (auto& blocks : blocks_[type]) {
+				auto end = std::remove_if(blocks.begin(), blocks.end(), [this, &released](Block* block) {
+					if (block->allocationCount) return false;
+					destroyBlock(block);
+					++released;
+					return true;
+				});
+				blocks.erase(end, blocks.end());
+			}
+		}
+		return released;
+	}
+
+	DeviceMemoryAllocator::Stats DeviceMemoryAllocator::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		Stats stats;
+		VkDeviceSize freeBytes = 0, unfragmentedBytes = 0;
+		for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+			for (auto& blocks : blocks_[type]) {
+				for (const Block* block : blocks) {
+					++stats.blockCount;
+					stats.blockBytes += block->size;
+					stats.allocationCount += block->allocationCount;
+					stats.usedBytes += block->usedBytes;
+					VkDeviceSize largest = 0;
+					for (const Range& range : block->freeRanges) {
+						freeBytes += range.size;
+						largest = std::max(largest, range.size);
+					}
+					unfragmentedBytes += largest;
+					stats.largestFreeRange = std::max(stats.largestFreeRange, largest);
+				}
+			}
+			stats.dedicatedCount += dedicatedCount_[type];
+			stats.dedicatedBytes += dedicatedBytes_[type];
+		}
+		stats.allocationCount += stats.dedicatedCount;
+		stats.usedBytes += stats.dedicatedBytes;
+		if (freeBytes) stats.fragmentation = 1.0f - (float)((double)unfragmentedBytes / (double)freeBytes);
+		return stats;
+	}
+}
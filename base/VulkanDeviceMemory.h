@@ -0,0 +1,112 @@
+/*
+* Vulkan device memory sub-allocator
+*
+* Places buffers and images in large blocks of device memory instead of one allocation per resource
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class DeviceMemoryAllocator;
+
+	/**
+	* @brief A range of device memory handed out by a DeviceMemoryAllocator
+	* @note Resources bind at memory + offset, the range has to be returned with DeviceMemoryAllocator::free
+	*/
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Host address of offset, host visible memory stays mapped for the lifetime of its block */
+		void* mapped = nullptr;
+		uint32_t memoryType = 0;
+		DeviceMemoryAllocator* allocator = nullptr;
+		/** @brief Block the range was taken from, null for a dedicated allocation */
+		void* block = nullptr;
+
+		bool isValid() const { return memory != VK_NULL_HANDLE; }
+		bool isDedicated() const { return isValid() && block == nullptr; }
+	};
+
+	/**
+	* @brief Sub-allocates buffers and images from large blocks of one memory type
+	* @note Linear resources (buffers, linear images) and optimal images are kept in separate blocks, so bufferImageGranularity never applies.
+	* Resources of at least half a block get a dedicated allocation. Freed ranges merge with their neighbours, empty blocks are kept
+	* until releaseEmptyBlocks, which the application calls once a scene has been unloaded
+	*/
+	class DeviceMemoryAllocator
+	{
+	public:
+		enum ResourceKind
+		{
+			kResource_Linear,
+			kResource_Optimal,
+			kResource_Count
+		};
+		struct Stats
+		{
+			uint32_t blockCount = 0;
+			VkDeviceSize blockBytes = 0;
+			uint32_t allocationCount = 0;//ranges in blocks and dedicated allocations
+			VkDeviceSize usedBytes = 0;//of blocks and dedicated allocations
+			uint32_t dedicatedCount = 0;
+			VkDeviceSize dedicatedBytes = 0;
+			VkDeviceSize largestFreeRange = 0;
+			/** @brief Share of the free bytes of blocks outside the largest free range of their block, 0 while every block has one free range */
+			float fragmentation = 0.0f;
+		};
+	private:
+		struct Range
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			VkDeviceSize usedBytes = 0;
+			uint32_t allocationCount = 0;
+			uint8_t* mapped = nullptr;
+			std::vector<Range> freeRanges;//sorted by offset, neighbours are merged
+		};
+		VkDevice device_ = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties_;
+		VkDeviceSize nonCoherentAtomSize_ = 1;
+		VkDeviceSize blockSize_ = 0;
+		std::vector<Block*> blocks_[VK_MAX_MEMORY_TYPES][kResource_Count];
+		uint32_t dedicatedCount_[VK_MAX_MEMORY_TYPES] = {};
+		VkDeviceSize dedicatedBytes_[VK_MAX_MEMORY_TYPES] = {};
+		mutable std::mutex mutex_;//textures and buffers of a scene are created on its loader thread
+	public:
+		DeviceMemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize = 64 * 1024 * 1024);
+		~DeviceMemoryAllocator();
+		void destroy();
+
+		/**
+		* Allocate a range that satisfies memReqs from a block of memoryType, or a dedicated allocation for large resources
+		*
+		* @param allocateFlags Non-zero flags (e.g. device address) always get a dedicated allocation that is allocated with them
+		*/
+		VkResult allocate(const VkMemoryRequirements& memReqs, uint32_t memoryType, ResourceKind kind, MemoryAllocation* allocation, VkMemoryAllocateFlags allocateFlags = 0);
+		void free(MemoryAllocation& allocation);
+		/** @brief Returns the memory of blocks without allocations to the driver, returns the number of blocks released */
+		uint32_t releaseEmptyBlocks();
+
+		Stats getStats() const;
+		VkDeviceSize getBlockSize(uint32_t memoryType) const;
+	private:
+		bool isHostVisible(uint32_t memoryType) const;
+		Block* createBlock(uint32_t memoryType, VkDeviceSize size);
+		void destroyBlock(Block* block);
+	};
+}
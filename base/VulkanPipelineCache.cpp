@@ -0,0 +1,161 @@
+/*
+* Persistent pipeline cache
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	namespace pipelinecache
+	{
+		// The driver only checks its own header, so the file carries the driver version
+		// and a checksum of the data as well
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint32_t reserved;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+		static_assert(sizeof(FileHeader) == 56, "FileHeader must not contain padding");
+
+		static const uint32_t fileMagic = 0x43504B56;// "VKPC"
+		static const uint32_t fileVersion = 1;
+
+		static uint64_t hashData(const char* data, size_t size)
+		{
+			// FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; ++i) {
+				hash ^= (uint8_t)data[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		static FileHeader makeHeader(const VkPhysicalDeviceProperties& properties)
+		{
+			FileHeader header = {};
+			header.magic = fileMagic;
+			header.version = fileVersion;
+			header.vendorID = properties.vendorID;
+			header.deviceID = properties.deviceID;
+			header.driverVersion = properties.driverVersion;
+			memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+			return header;
+		}
+
+		static bool isDataCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+		{
+			VkPipelineCacheHeaderVersionOne vkHeader;
+			if (data.size() < sizeof(vkHeader)) return false;
+			memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+			return vkHeader.headerSize >= sizeof(vkHeader) && vkHeader.headerSize <= data.size()
+				&& vkHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+				&& vkHeader.vendorID == properties.vendorID
+				&& vkHeader.deviceID == properties.deviceID
+				&& memcmp(vkHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+		}
+
+		std::vector<char> loadFromFile(const std::string& filename, const VkPhysicalDeviceProperties& properties)
+		{
+			std::vector<char> data;
+			FILE* file = fopen(filename.c_str(), "rb");
+			if (!file) return data;
+
+			FileHeader header = {};
+			FileHeader expected = makeHeader(properties);
+			bool valid = fread(&header, sizeof(header), 1, file) == 1
+				&& header.magic == expected.magic
+				&& header.version == expected.version
+				&& header.vendorID == expected.vendorID
+				&& header.deviceID == expected.deviceID
+				&& header.driverVersion == expected.driverVersion
+				&& memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+			if (valid) {
+				fseek(file, 0, SEEK_END);
+				long fileSize = ftell(file);
+				valid = fileSize >= 0 && (uint64_t)fileSize == sizeof(header) + header.dataSize;
+			}
+			if (valid) {
+				data.resize((size_t)header.dataSize);
+				fseek(file, sizeof(header), SEEK_SET);
+				valid = fread(data.data(), 1, data.size(), file) == data.size()
+					&& hashData(data.data(), data.size()) == header.dataHash
+					&& isDataCompatible(data, properties);
+			}
+			fclose(file);
+
+			if (!valid) {
+				std::cout << "Pipeline cache \"" << filename << "\" is outdated or damaged, starting with an empty cache\n";
+				data.clear();
+			}
+			return data;
+		}
+
+		size_t getDataSize(VkDevice device, VkPipelineCache pipelineCache)
+		{
+			size_t size = 0;
+			if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS) return 0;
+			return size;
+		}
+
+		bool saveToFile(const std::string& filename, const VkPhysicalDeviceProperties& properties, VkDevice device, VkPipelineCache pipelineCache)
+		{
+			size_t size = getDataSize(device, pipelineCache);
+			if (size == 0) return false;
+			std::vector<char> data(size);
+			// VK_INCOMPLETE if the cache grew since the size query, the truncated data is still valid
+			VkResult result = vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+			if (result != VK_SUCCESS && result != VK_INCOMPLETE) return false;
+			data.resize(size);
+
+			FileHeader header = makeHeader(properties);
+			header.dataSize = data.size();
+			header.dataHash = hashData(data.data(), data.size());
+
+			const std::string tmpFilename = filename + ".tmp";
+			FILE* file = fopen(tmpFilename.c_str(), "wb");
+			if (!file) return false;
+			bool written = fwrite(&header, sizeof(header), 1, file) == 1
+				&& fwrite(data.data(), 1, data.size(), file) == data.size()
+				&& fflush(file) == 0;
+			// make sure the data reached the disk before the rename makes it visible
+#if defined(_WIN32)
+			written = written && _commit(_fileno(file)) == 0;
+#else
+			written = written && fsync(fileno(file)) == 0;
+#endif
+			written = (fclose(file) == 0) && written;
+			if (!written) {
+				remove(tmpFilename.c_str());
+				return false;
+			}
+
+#if defined(_WIN32)
+			bool renamed = MoveFileExA(tmpFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			bool renamed = rename(tmpFilename.c_str(), filename.c_str()) == 0;
+#endif
+			if (!renamed) remove(tmpFilename.c_str());
+			return renamed;
+		}
+	}
+}
@@ -0,0 +1,26 @@
+/*
+* Persistent pipeline cache
+*
+* Stores the data of a VkPipelineCache on disk so pipelines do not have to be recompiled on every launch
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	namespace pipelinecache
+	{
+		/** @brief Reads cache data written by saveToFile, returns an empty vector if the file is missing, damaged or was written by another device or driver */
+		std::vector<char> loadFromFile(const std::string& filename, const VkPhysicalDeviceProperties& properties);
+		/** @brief Writes the current data of the cache to a temporary file and renames it over filename, so an interrupted write never leaves a damaged cache behind */
+		bool saveToFile(const std::string& filename, const VkPhysicalDeviceProperties& properties, VkDevice device, VkPipelineCache pipelineCache);
+		/** @brief Size of the data the cache would currently serialize */
+		size_t getDataSize(VkDevice device, VkPipelineCache pipelineCache);
+	}
+}
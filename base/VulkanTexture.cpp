@@ -8,6 +8,7 @@
 
 #include <VulkanTexture.h>
 #include "stb_image.h"
+#include <thread>
 
 namespace vks
 {
@@ -31,6 +32,11 @@ namespace vks
 		vkSafeDestroyImageView(device->logicalDevice, sRGBView, nullptr);
 		vkSafeDestroyImage(device->logicalDevice, image, nullptr);
 		vkSafeDestroySampler(device->logicalDevice, sampler, nullptr);
+		if (allocation.isValid())
+		{
+			device->freeMemory(allocation);
+			deviceMemory = VK_NULL_HANDLE;
+		}
 		vkSafeFreeMemory(device->logicalDevice, deviceMemory, nullptr);
 	}
 
@@ -68,6 +74,7 @@ namespace vks
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
+	* @param (Optional) commandPool Pool the copy command buffer is allocated from, the device's pool if null (threads other than the one owning it pass their own)
 	*
 	*/
 	bool Texture2D::loadFromFile(std::string filename, 
@@ -77,11 +84,12 @@ namespace vks
 		VkImageUsageFlags imageUsageFlags,
 		VkImageLayout imageLayout,
 		bool forceLinear,
-		SamplerOption	samplerOpt)
+		SamplerOption	samplerOpt,
+		VkCommandPool commandPool)
 	{
 		std::string extension = vks::tools::getFileNameExtension(filename);
-		if (extension == "ktx" || extension == "ktx2") return loadFromKtxFile(filename, format, device, copyQueue, imageUsageFlags, imageLayout, forceLinear, samplerOpt);
-		else if (extension == "png") return loadFromPngFile(filename, format, device, copyQueue, imageUsageFlags, imageLayout, forceLinear, samplerOpt);
+		if (extension == "ktx" || extension == "ktx2") return loadFromKtxFile(filename, format, device, copyQueue, imageUsageFlags, imageLayout, forceLinear, samplerOpt, commandPool);
+		else if (extension == "png") return loadFromPngFile(filename, format, device, copyQueue, imageUsageFlags, imageLayout, forceLinear, samplerOpt, commandPool);
 		else return false;
 	}
 
@@ -92,8 +100,10 @@ namespace vks
 		VkImageUsageFlags imageUsageFlags, 
 		VkImageLayout imageLayout, 
 		bool forceLinear, 
-		SamplerOption	samplerOpt)
+		SamplerOption	samplerOpt,
+		VkCommandPool commandPool)
 	{
+		if (commandPool == VK_NULL_HANDLE) commandPool = device->commandPool;
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -128,7 +138,7 @@ namespace vks
 		VkMemoryRequirements memReqs;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
 
 		if (useStaging)
 		{
@@ -201,13 +211,8 @@ namespace vks
 			}
 			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+			VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+			deviceMemory = allocation.memory;
 
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -243,7 +248,7 @@ namespace vks
 				imageLayout,
 				subresourceRange);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			device->flushCommandBuffer(copyCmd, copyQueue, commandPool);
 
 			// Clean up staging resources
 			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
@@ -321,7 +326,7 @@ namespace vks
 			// Setup image memory barrier
 			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			device->flushCommandBuffer(copyCmd, copyQueue, commandPool);
 		}
 
 		ktxTexture_Destroy(ktxTexture);
@@ -413,7 +418,8 @@ namespace vks
 		VkImageUsageFlags  imageUsageFlags,
 		VkImageLayout      imageLayout,
 		bool               forceLinear,
-		SamplerOption	   samplerOpt)
+		SamplerOption	   samplerOpt,
+		VkCommandPool      commandPool)
 	{
 		std::vector<char> buffer;
 		VkDeviceSize bufferSize;
@@ -421,7 +427,7 @@ namespace vks
 		if (!loadImageFromPng(filename, buffer, bufferSize, format, texWidth, texHeight))
 			return false;
 
-		fromBuffer(buffer.data(), bufferSize, format, texWidth, texHeight, device, copyQueue, imageUsageFlags, imageLayout, false, samplerOpt);
+		fromBuffer(buffer.data(), bufferSize, format, texWidth, texHeight, device, copyQueue, imageUsageFlags, imageLayout, false, samplerOpt, commandPool);
 		return true;
 	}
 	/**
@@ -437,6 +443,7 @@ namespace vks
 	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) commandPool Pool the copy command buffer is allocated from, the device's pool if null (threads other than the one owning it pass their own)
 	*/
 /*
 		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
@@ -455,21 +462,17 @@ namespace vks
 		vks::VulkanDevice *device, VkQueue copyQueue, 
 		VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, 
 		bool mutableFormat, 
-		SamplerOption samplerOpt)
+		SamplerOption samplerOpt,
+		VkCommandPool commandPool)
 	{
 		assert(buffer);
-
-		this->format = format;
-		this->device = device;
-		width = texWidth;
-		height = texHeight;
-		mipLevels = 1;
+		if (commandPool == VK_NULL_HANDLE) commandPool = device->commandPool;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
 
 		// Create a host-visible staging buffer that contains the raw image data
 		VkBuffer stagingBuffer;
@@ -499,6 +502,48 @@ namespace vks
 		memcpy(data, buffer, bufferSize);
 		vkUnmapMemory(device->logicalDevice, stagingMemory);
 
+		fromStagingBuffer(stagingBuffer, 0, format, texWidth, texHeight, device, copyCmd, imageUsageFlags, imageLayout, mutableFormat, samplerOpt);
+
+		device->flushCommandBuffer(copyCmd, copyQueue, commandPool);
+
+		// Clean up staging resources
+		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	}
+
+	/**
+	* Create a 2D texture from pixels that already sit in a staging buffer, nothing is submitted
+	*
+	* @param stagingBuffer Buffer containing the texture data, must stay alive until copyCmd has been executed
+	* @param stagingOffset Offset of the texture data in stagingBuffer, must be a multiple of 4 and of the texel size
+	* @param format Vulkan format of the image data stored in the buffer
+	* @param texWidth Width of the texture to create
+	* @param texHeight Height of the texture to create
+	* @param device Vulkan device to create the texture on
+	* @param copyCmd Command buffer in recording state, receives the copy and layout transitions
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) mipmapSource Creates a full mip chain, either blitted on the GPU (copyCmd must be on a graphics queue) or read from the staging buffer
+	* @param (Optional) stagedMipLevels Number of levels in the staging buffer for kMipmap_Staged, 0 is the full chain (KTX2 files may end it early)
+	* @param (Optional) createSampler False leaves sampler empty for a sampler shared between textures
+	*/
+	void Texture2D::fromStagingBuffer(VkBuffer stagingBuffer, VkDeviceSize stagingOffset,
+		VkFormat format, uint32_t texWidth, uint32_t texHeight,
+		vks::VulkanDevice *device, VkCommandBuffer copyCmd,
+		VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout,
+		bool mutableFormat,
+		SamplerOption samplerOpt,
+		MipmapSource mipmapSource,
+		uint32_t stagedMipLevels,
+		bool createSampler)
+	{
+		this->format = format;
+		this->device = device;
+		width = texWidth;
+		height = texHeight;
+		mipLevels = (mipmapSource == kMipmap_None) ? 1 : getMipLevelCount(width, height);
+		if (mipmapSource == kMipmap_Staged && stagedMipLevels) mipLevels = std::min(mipLevels, stagedMipLevels);
+
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.mipLevel = 0;
@@ -507,7 +552,7 @@ namespace vks
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = 0;
+		bufferCopyRegion.bufferOffset = stagingOffset;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -526,16 +571,16 @@ namespace vks
 		{
 			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		}
+		// Mip levels are blitted from their predecessor
+		if (mipmapSource == kMipmap_Blit && mipLevels > 1)
+		{
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
 		imageCreateInfo.flags = mutableFormat ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -553,53 +598,110 @@ namespace vks
 			subresourceRange);
 
 		// Copy mip levels from staging buffer
+		std::vector<VkBufferImageCopy> bufferCopyRegions(1, bufferCopyRegion);
+		if (mipmapSource == kMipmap_Staged)
+		{
+			std::vector<VkDeviceSize> levelOffsets;
+			getMipChainLayout(format, width, height, mipLevels, levelOffsets);
+			bufferCopyRegions.resize(mipLevels, bufferCopyRegion);
+			for (uint32_t level = 0; level < mipLevels; level++)
+			{
+				bufferCopyRegions[level].imageSubresource.mipLevel = level;
+				bufferCopyRegions[level].imageExtent.width = std::max(1u, width >> level);
+				bufferCopyRegions[level].imageExtent.height = std::max(1u, height >> level);
+				bufferCopyRegions[level].bufferOffset = stagingOffset + levelOffsets[level];
+			}
+		}
 		vkCmdCopyBufferToImage(
 			copyCmd,
 			stagingBuffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferCopyRegion
+			static_cast<uint32_t>(bufferCopyRegions.size()),
+			bufferCopyRegions.data()
 		);
 
-		// Change texture image layout to shader read after all mip levels have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			imageLayout,
-			subresourceRange);
-
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		if (mipmapSource == kMipmap_Blit && mipLevels > 1)
+		{
+			// Each level is downsampled from the previous one, which is turned into a transfer source first
+			VkImageSubresourceRange levelRange = subresourceRange;
+			levelRange.levelCount = 1;
+			for (uint32_t level = 1; level < mipLevels; level++)
+			{
+				levelRange.baseMipLevel = level - 1;
+				vks::tools::setImageLayout(
+					copyCmd,
+					image,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					levelRange,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+				VkImageBlit imageBlit{};
+				imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+				imageBlit.srcOffsets[1] = { int32_t(std::max(1u, width >> (level - 1))), int32_t(std::max(1u, height >> (level - 1))), 1 };
+				imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				imageBlit.dstOffsets[1] = { int32_t(std::max(1u, width >> level)), int32_t(std::max(1u, height >> level)), 1 };
+				vkCmdBlitImage(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			}
 
-		// Clean up staging resources
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			// All levels but the last one are transfer sources now
+			levelRange.baseMipLevel = 0;
+			levelRange.levelCount = mipLevels - 1;
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				imageLayout,
+				levelRange);
+			levelRange.baseMipLevel = mipLevels - 1;
+			levelRange.levelCount = 1;
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				imageLayout,
+				levelRange);
+		}
+		else
+		{
+			// Change texture image layout to shader read after all mip levels have been copied
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				imageLayout,
+				subresourceRange);
+		}
 
 		// Create sampler
-		VkSamplerCreateInfo samplerCreateInfo = {};
-		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerCreateInfo.magFilter = samplerOpt.magFilter;
-		samplerCreateInfo.minFilter = samplerOpt.minFilter;
-		samplerCreateInfo.mipmapMode = samplerOpt.mipmapMode;
-		samplerCreateInfo.addressModeU = samplerOpt.addressModeU;
-		samplerCreateInfo.addressModeV = samplerOpt.addressModeV;
-		samplerCreateInfo.addressModeW = samplerOpt.addressModeW;
-		samplerCreateInfo.compareEnable = samplerOpt.compareEnable;
-		samplerCreateInfo.compareOp = samplerOpt.compareOp;
-		if (samplerOpt.anisotropyEnable) {
-			samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
-			samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
-		}
-		else {
-			samplerCreateInfo.maxAnisotropy = 1.0f;
-			samplerCreateInfo.anisotropyEnable = false;
+		if (createSampler)
+		{
+			VkSamplerCreateInfo samplerCreateInfo = {};
+			samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			samplerCreateInfo.magFilter = samplerOpt.magFilter;
+			samplerCreateInfo.minFilter = samplerOpt.minFilter;
+			samplerCreateInfo.mipmapMode = samplerOpt.mipmapMode;
+			samplerCreateInfo.addressModeU = samplerOpt.addressModeU;
+			samplerCreateInfo.addressModeV = samplerOpt.addressModeV;
+			samplerCreateInfo.addressModeW = samplerOpt.addressModeW;
+			samplerCreateInfo.compareEnable = samplerOpt.compareEnable;
+			samplerCreateInfo.compareOp = samplerOpt.compareOp;
+			if (samplerOpt.anisotropyEnable) {
+				samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+				samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+			}
+			else {
+				samplerCreateInfo.maxAnisotropy = 1.0f;
+				samplerCreateInfo.anisotropyEnable = false;
+			}
+			samplerCreateInfo.mipLodBias = 0.0f;
+			samplerCreateInfo.minLod = 0.0f;
+			samplerCreateInfo.maxLod = (float)mipLevels;
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
 		}
-		samplerCreateInfo.mipLodBias = 0.0f;
-		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = 0.0f;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = {};
@@ -608,7 +710,7 @@ namespace vks
 		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewCreateInfo.format = format;
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
@@ -624,6 +726,143 @@ namespace vks
 		updateDescriptor();
 	}
 
+	uint32_t Texture2D::getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+	}
+
+	/** @brief Linear blits need both blit bits and linear filtering for optimal tiling */
+	bool Texture2D::isLinearBlitSupported(vks::VulkanDevice* device, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & required) == required;
+	}
+
+	/**
+	* Offsets of every mip level in a tightly packed chain, each level starts 16 byte aligned
+	*
+	* @return Size of the whole chain in bytes
+	*/
+	VkDeviceSize Texture2D::getMipChainLayout(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize, std::vector<VkDeviceSize>& levelOffsets)
+	{
+		levelOffsets.resize(mipLevels);
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			levelOffsets[level] = size;
+			VkDeviceSize levelSize = VkDeviceSize(std::max(1u, width >> level)) * std::max(1u, height >> level) * texelSize;
+			size += (levelSize + 15) & ~VkDeviceSize(15);
+		}
+		return size;
+	}
+
+	/**
+	* Mip chain layout of an RGBA8 or a 4x4 block compressed format, a level holds whole blocks
+	*
+	* @return Size of the whole chain in bytes
+	*/
+	VkDeviceSize Texture2D::getMipChainLayout(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<VkDeviceSize>& levelOffsets)
+	{
+		const uint32_t blockSize = vks::tools::formatBlockSize(format);
+		if (!blockSize) return getMipChainLayout(width, height, mipLevels, 4, levelOffsets);
+
+		levelOffsets.resize(mipLevels);
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			levelOffsets[level] = size;
+			const uint32_t blocksX = (std::max(1u, width >> level) + 3) / 4, blocksY = (std::max(1u, height >> level) + 3) / 4;
+			size += (VkDeviceSize(blocksX) * blocksY * blockSize + 15) & ~VkDeviceSize(15);
+		}
+		return size;
+	}
+
+	// sRGB encoded bytes to linear values, and the linear values half way between two bytes to encode them back
+	struct SrgbTables
+	{
+		float toLinear[256];
+		float thresholds[255];
+		SrgbTables()
+		{
+			auto decode = [](float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); };
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				toLinear[i] = decode(i / 255.0f);
+			}
+			for (uint32_t i = 0; i < 255; i++)
+			{
+				thresholds[i] = decode((i + 0.5f) / 255.0f);
+			}
+		}
+		// rounds in encoded space, as the thresholds are
+		uint8_t toSrgb(float linear) const
+		{
+			return uint8_t(std::upper_bound(thresholds, thresholds + 255, linear) - thresholds);
+		}
+	};
+
+	/**
+	* CPU fallback for formats without linear blit support, 2x2 box filter over RGBA8 texels
+	*
+	* @param chain Host memory holding the base level at levelOffsets[0], should not be mapped device memory as every level is read back
+	* @param levelOffsets Level offsets from getMipChainLayout with a texel size of 4
+	* @param srgb RGB is sRGB encoded, it is averaged in linear space and encoded again, alpha is linear
+	*/
+	void Texture2D::buildMipChainRGBA8(uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<VkDeviceSize>& levelOffsets, bool srgb)
+	{
+		static const SrgbTables srgbTables;
+		const uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			const uint32_t srcWidth = std::max(1u, width >> (level - 1)), srcHeight = std::max(1u, height >> (level - 1));
+			const uint32_t dstWidth = std::max(1u, width >> level), dstHeight = std::max(1u, height >> level);
+			const uint8_t* src = chain + levelOffsets[level - 1];
+			uint8_t* dst = chain + levelOffsets[level];
+
+			auto downsampleRows = [=](uint32_t rowBegin, uint32_t rowEnd) {
+				for (uint32_t y = rowBegin; y < rowEnd; y++)
+				{
+					const uint8_t* row0 = src + size_t(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+					const uint8_t* row1 = src + size_t(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+					uint8_t* out = dst + size_t(y) * dstWidth * 4;
+					for (uint32_t x = 0; x < dstWidth; x++)
+					{
+						const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4, x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+						const uint32_t linearBegin = srgb ? 3 : 0;
+						for (uint32_t c = 0; c < linearBegin; c++)
+						{
+							const float* toLinear = srgbTables.toLinear;
+							out[x * 4 + c] = srgbTables.toSrgb(0.25f * (toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]]));
+						}
+						for (uint32_t c = linearBegin; c < 4; c++)
+						{
+							out[x * 4 + c] = uint8_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+						}
+					}
+				}
+			};
+
+			// Small levels are not worth a thread
+			if (threadCount == 1 || size_t(dstWidth) * dstHeight < 64 * 1024)
+			{
+				downsampleRows(0, dstHeight);
+				continue;
+			}
+			std::vector<std::thread> threads;
+			const uint32_t rowsPerThread = (dstHeight + threadCount - 1) / threadCount;
+			for (uint32_t rowBegin = 0; rowBegin < dstHeight; rowBegin += rowsPerThread)
+			{
+				threads.emplace_back(downsampleRows, rowBegin, std::min(rowBegin + rowsPerThread, dstHeight));
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+	}
+
 	/**
 	* Load a 2D texture array including all mip levels
 	*
@@ -727,13 +966,8 @@ namespace vks
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+		deviceMemory = allocation.memory;
 
 		// Use a separate command buffer for texture loading
 		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -818,10 +1052,12 @@ namespace vks
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) commandPool Pool the copy command buffer is allocated from, the device's pool if null (threads other than the one owning it pass their own)
 	*
 	*/
-	bool TextureCubeMap::loadFromFile(std::string filename, VkFormat /*format*/, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	bool TextureCubeMap::loadFromFile(std::string filename, VkFormat /*format*/, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, VkCommandPool commandPool)
 	{
+		if (commandPool == VK_NULL_HANDLE) commandPool = device->commandPool;
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		if (result != KTX_SUCCESS) return false;
@@ -923,16 +1159,11 @@ namespace vks
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+		deviceMemory = allocation.memory;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
 
 		// Image barrier for optimal image (target)
 		// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -967,7 +1198,7 @@ namespace vks
 			imageLayout,
 			subresourceRange);
 
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->flushCommandBuffer(copyCmd, copyQueue, commandPool);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
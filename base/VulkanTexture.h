@@ -35,6 +35,7 @@ class Texture
 	VkImage               image = VK_NULL_HANDLE;
 	VkImageLayout         imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	VkDeviceMemory        deviceMemory = VK_NULL_HANDLE;
+	MemoryAllocation      allocation;//deviceMemory is owned by the texture if invalid
 	VkFormat			  format = VK_FORMAT_UNDEFINED, sRGBFormat = VK_FORMAT_UNDEFINED;
 	VkImageView           view = VK_NULL_HANDLE, sRGBView = VK_NULL_HANDLE;
 	uint32_t              width = 0, height = 0;
@@ -68,6 +69,17 @@ public:
 		VkCompareOp             compareOp = VK_COMPARE_OP_NEVER;
 		VkBool32                anisotropyEnable = FALSE;
 	};
+	// How fromStagingBuffer fills the mip chain
+	enum MipmapSource {
+		kMipmap_None,		// base level only
+		kMipmap_Blit,		// staging holds the base level, the others are blitted on the GPU
+		kMipmap_Staged,		// staging holds the whole chain laid out by getMipChainLayout
+	};
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+	static bool isLinearBlitSupported(vks::VulkanDevice* device, VkFormat format);
+	static VkDeviceSize getMipChainLayout(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize, std::vector<VkDeviceSize>& levelOffsets);
+	static VkDeviceSize getMipChainLayout(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<VkDeviceSize>& levelOffsets);
+	static void buildMipChainRGBA8(uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<VkDeviceSize>& levelOffsets, bool srgb = false);
 	bool loadFromFile(
 		std::string        filename,
 		VkFormat           format,
@@ -76,7 +88,8 @@ public:
 		VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		bool               forceLinear = false,
-		SamplerOption	   samplerOpt = SamplerOption());
+		SamplerOption	   samplerOpt = SamplerOption(),
+		VkCommandPool      commandPool = VK_NULL_HANDLE);
 	void fromBuffer(
 		void* buffer,
 		VkDeviceSize       bufferSize,
@@ -88,7 +101,23 @@ public:
 		VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		bool			   mutableFormat = false,
-		SamplerOption	   samplerOpt = SamplerOption());
+		SamplerOption	   samplerOpt = SamplerOption(),
+		VkCommandPool      commandPool = VK_NULL_HANDLE);
+	void fromStagingBuffer(
+		VkBuffer           stagingBuffer,
+		VkDeviceSize       stagingOffset,
+		VkFormat           format,
+		uint32_t           texWidth,
+		uint32_t           texHeight,
+		vks::VulkanDevice* device,
+		VkCommandBuffer    copyCmd,
+		VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+		VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		bool			   mutableFormat = false,
+		SamplerOption	   samplerOpt = SamplerOption(),
+		MipmapSource	   mipmapSource = kMipmap_None,
+		uint32_t		   stagedMipLevels = 0,
+		bool			   createSampler = true);
 private:
 	bool loadFromKtxFile(
 		std::string        filename,
@@ -98,7 +127,8 @@ private:
 		VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		bool               forceLinear = false,
-		SamplerOption	   samplerOpt = SamplerOption());
+		SamplerOption	   samplerOpt = SamplerOption(),
+		VkCommandPool      commandPool = VK_NULL_HANDLE);
 	bool loadFromPngFile(
 		std::string        filename,
 		VkFormat           format,
@@ -107,7 +137,8 @@ private:
 		VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout      imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		bool               forceLinear = false,
-		SamplerOption	   samplerOpt = SamplerOption());
+		SamplerOption	   samplerOpt = SamplerOption(),
+		VkCommandPool      commandPool = VK_NULL_HANDLE);
 };
 
 class Texture2DArray : public Texture
@@ -131,6 +162,7 @@ class TextureCubeMap : public Texture
 	    vks::VulkanDevice *device,
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    VkCommandPool      commandPool     = VK_NULL_HANDLE);
 };
 }        // namespace vks
@@ -105,6 +105,8 @@ namespace vks
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
 		VkFormat formatConvertToSRGB(VkFormat format);
+		// Returns the size in bytes of a 4x4 texel block of a block compressed format, 0 for formats that are not 4x4 block compressed
+		uint32_t formatBlockSize(VkFormat format);
 
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
 		void setImageLayout(
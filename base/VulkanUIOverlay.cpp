@@ -310,11 +310,38 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
+	/** Use one set of vertex and index buffers per frame in flight, the GPU may still read those of the previous frames */
+	void UIOverlay::setFrameCount(uint32_t frameCount)
+	{
+		for (size_t i = frameCount; i < drawBuffers.size(); i++) {
+			drawBuffers[i].vertexBuffer.destroy();
+			drawBuffers[i].indexBuffer.destroy();
+		}
+		drawBuffers.resize(std::max(frameCount, 1u));
+		frameIndex = 0;
+	}
+
 	/** Update vertex and index buffer containing the imGui elements when required */
 	bool UIOverlay::update()
+	{
+		if (drawBuffers.size() > 1) {
+			// Buffers of frames in flight can't be written here, each frame uploads the new draw data in draw()
+			for (auto& buffers : drawBuffers) {
+				buffers.outdated = true;
+			}
+			return false;
+		}
+		return updateBuffers(drawBuffers[0]);
+	}
+
+	bool UIOverlay::updateBuffers(DrawBuffers& buffers)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		bool updateCmdBuffers = false;
+		vks::Buffer& vertexBuffer = buffers.vertexBuffer;
+		vks::Buffer& indexBuffer = buffers.indexBuffer;
+		int32_t& vertexCount = buffers.vertexCount;
+		int32_t& indexCount = buffers.indexCount;
 
 		if (!imDrawData) { return false; };
 
@@ -363,6 +390,7 @@ namespace vks
 		// Flush to make writes visible to GPU
 		vertexBuffer.flush();
 		indexBuffer.flush();
+		buffers.outdated = false;
 
 		return updateCmdBuffers;
 	}
@@ -377,6 +405,14 @@ namespace vks
 			return;
 		}
 
+		DrawBuffers& buffers = drawBuffers[frameIndex];
+		if (buffers.outdated) {
+			updateBuffers(buffers);
+		}
+		if (buffers.vertexBuffer.buffer == VK_NULL_HANDLE || buffers.indexBuffer.buffer == VK_NULL_HANDLE) {
+			return;
+		}
+
 		ImGuiIO& io = ImGui::GetIO();
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -387,8 +423,8 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, buffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -417,8 +453,10 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (auto& buffers : drawBuffers) {
+			buffers.vertexBuffer.destroy();
+			buffers.indexBuffer.destroy();
+		}
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
@@ -39,10 +39,17 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples{ VK_SAMPLE_COUNT_1_BIT };
 		uint32_t subpass{ 0 };
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount{ 0 };
-		int32_t indexCount{ 0 };
+		struct DrawBuffers {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			int32_t vertexCount{ 0 };
+			int32_t indexCount{ 0 };
+			// Draw data changed since these buffers were last written
+			bool outdated{ true };
+		};
+		// One set per frame in flight, draw() uses drawBuffers[frameIndex]
+		std::vector<DrawBuffers> drawBuffers{ 1 };
+		uint32_t frameIndex{ 0 };
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -73,7 +80,9 @@ namespace vks
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
 		void prepareResources();
 
+		void setFrameCount(uint32_t frameCount);
 		bool update();
+		bool updateBuffers(DrawBuffers& buffers);
 		void draw(const VkCommandBuffer commandBuffer);
 		void resize(uint32_t width, uint32_t height);
 
@@ -19,6 +19,11 @@
 
 #include "VulkanglTFModel.h"
 
+// images are decoded on several threads, each has to see the failure reason of its own loads
+#ifndef STBI_THREAD_LOCAL
+#error "stb_image keeps no thread local failure reason with this compiler"
+#endif
+
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
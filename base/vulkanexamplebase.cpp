@@ -197,9 +197,57 @@ std::string VulkanExampleBase::getShadersPath() const
 
 void VulkanExampleBase::createPipelineCache()
 {
+	std::vector<char> cacheData;
+	if (settings.persistentPipelineCache) {
+		if (pipelineCacheFile.empty()) {
+			pipelineCacheFile = name + ".pipelinecache";
+		}
+		cacheData = vks::pipelinecache::loadFromFile(pipelineCacheFile, vulkanDevice->properties);
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	if (result != VK_SUCCESS && !cacheData.empty()) {
+		// The driver may still reject data that passed our checks
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
+
+	pipelineCacheSavedSize = settings.persistentPipelineCache ? vks::pipelinecache::getDataSize(device, pipelineCache) : 0;
+	pipelineCacheSaveTimestamp = std::chrono::high_resolution_clock::now();
+}
+
+void VulkanExampleBase::savePipelineCache()
+{
+	if (!settings.persistentPipelineCache || pipelineCache == VK_NULL_HANDLE) {
+		return;
+	}
+	size_t size = vks::pipelinecache::getDataSize(device, pipelineCache);
+	if (size == pipelineCacheSavedSize) {
+		return;
+	}
+	if (vks::pipelinecache::saveToFile(pipelineCacheFile, vulkanDevice->properties, device, pipelineCache)) {
+		pipelineCacheSavedSize = size;
+	}
+	else {
+		std::cerr << "Could not save pipeline cache to \"" << pipelineCacheFile << "\"\n";
+	}
+}
+
+void VulkanExampleBase::updatePipelineCacheFile()
+{
+	// Pipelines created after startup (e.g. new shader permutations) survive a crash this way
+	auto tNow = std::chrono::high_resolution_clock::now();
+	if (std::chrono::duration<float>(tNow - pipelineCacheSaveTimestamp).count() < settings.pipelineCacheSaveInterval) {
+		return;
+	}
+	pipelineCacheSaveTimestamp = tNow;
+	savePipelineCache();
 }
 
 void VulkanExampleBase::prepare()
@@ -673,6 +721,7 @@ void VulkanExampleBase::renderLoop()
 #endif
 	// Flush device to make sure all resources can be freed
 	if (device != VK_NULL_HANDLE) {
+		std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
 		vkDeviceWaitIdle(device);
 	}
 }
@@ -780,6 +829,71 @@ void VulkanExampleBase::submitFrame()
 		VK_CHECK_RESULT(result);
 	}
 	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	updatePipelineCacheFile();
+}
+
+bool VulkanExampleBase::prepareFrameInFlight()
+{
+	if (frameResources.empty()) {
+		createFrameResources();
+	}
+	FrameResources& frame = frameResources[currentFrame];
+	// Wait until the GPU is done with this frame slot, its resources can be written after that
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+	VkResult result = swapChain.acquireNextImage(frame.presentComplete, currentBuffer);
+	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), the image is still acquired and gets recreated in submitFrameInFlight()
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		windowResize();
+		return false;
+	}
+	else if (result != VK_SUBOPTIMAL_KHR) {
+		VK_CHECK_RESULT(result);
+	}
+	// Only reset once the frame is certain to be submitted, a skipped frame would otherwise never signal it
+	VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+	ui.frameIndex = currentFrame;
+	return true;
+}
+
+void VulkanExampleBase::submitFrameInFlight()
+{
+	FrameResources& frame = frameResources[currentFrame];
+	VkSubmitInfo frameSubmitInfo = vks::initializers::submitInfo();
+	frameSubmitInfo.pWaitDstStageMask = &submitPipelineStages;
+	frameSubmitInfo.waitSemaphoreCount = 1;
+	frameSubmitInfo.pWaitSemaphores = &frame.presentComplete;
+	frameSubmitInfo.signalSemaphoreCount = 1;
+	frameSubmitInfo.pSignalSemaphores = &renderCompleteSemaphores[currentBuffer];
+	frameSubmitInfo.commandBufferCount = 1;
+	frameSubmitInfo.pCommandBuffers = &frame.commandBuffer;
+	VkResult result;
+	{
+		// other threads may be uploading through the same queue
+		std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &frameSubmitInfo, frame.fence));
+		result = swapChain.queuePresent(queue, currentBuffer, renderCompleteSemaphores[currentBuffer]);
+	}
+	currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frameResources.size());
+
+	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
+	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
+		windowResize();
+	}
+	else {
+		VK_CHECK_RESULT(result);
+	}
+	updatePipelineCacheFile();
+}
+
+void VulkanExampleBase::waitFramesInFlight()
+{
+	std::vector<VkFence> fences;
+	for (auto& frame : frameResources) {
+		fences.push_back(frame.fence);
+	}
+	if (!fences.empty()) {
+		VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase()
@@ -800,6 +914,9 @@ VulkanExampleBase::VulkanExampleBase()
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set the number of frames in flight (1-3) for samples that support it");
+	commandLineParser.add("pipelinecache", { "-pc", "--pipelinecache" }, 1, "Set file name the pipeline cache is loaded from and saved to");
+	commandLineParser.add("nopipelinecache", { "-npc", "--nopipelinecache" }, 0, "Do not load or save the pipeline cache");
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	commandLineParser.add("resourcepath", { "-rp", "--resourcepath" }, 1, "Set path for dir where assets and shaders folder is present");
 #endif
@@ -856,6 +973,16 @@ VulkanExampleBase::VulkanExampleBase()
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("framesinflight")) {
+		int32_t framesInFlight = commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight);
+		settings.framesInFlight = static_cast<uint32_t>(std::min(std::max(framesInFlight, 1), (int32_t)maxFramesInFlight));
+	}
+	if (commandLineParser.isSet("pipelinecache")) {
+		pipelineCacheFile = commandLineParser.getValueAsString("pipelinecache", "");
+	}
+	if (commandLineParser.isSet("nopipelinecache")) {
+		settings.persistentPipelineCache = false;
+	}
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	if(commandLineParser.isSet("resourcepath")) {
 		vks::tools::resourcePath = commandLineParser.getValueAsString("resourcepath", "");
@@ -913,6 +1040,7 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 	destroyCommandBuffers();
+	destroyFrameResources();
 	if (renderPass != VK_NULL_HANDLE)
 	{
 		vkDestroyRenderPass(device, renderPass, nullptr);
@@ -930,6 +1058,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.memory, nullptr);
 
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
@@ -1075,6 +1204,13 @@ bool VulkanExampleBase::initVulkan()
 		descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
 		descriptorIndexingProperties.pNext = nullptr;
 		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+		VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &descriptorIndexingFeatures;
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		descriptorIndexingFeatures.pNext = nullptr;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
 	}
 #endif
 
@@ -1089,7 +1225,8 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	result = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	vulkanDevice->enabledDescriptorIndexingFeatures = enabledDescriptorIndexingFeatures;
+	result = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, requestedQueueTypes);
 	if (result != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(result), result);
 		return false;
@@ -3050,6 +3187,50 @@ void VulkanExampleBase::createSynchronizationPrimitives()
 	}
 }
 
+void VulkanExampleBase::createFrameResources()
+{
+	frameResources.resize(settings.framesInFlight);
+	currentFrame = 0;
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+	// Signaled, the first wait on every slot returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	for (auto& frame : frameResources) {
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.commandBuffer));
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+	}
+	createRenderCompleteSemaphores();
+	// The overlay keeps its vertex and index buffers per frame slot
+	ui.setFrameCount(settings.framesInFlight);
+}
+
+void VulkanExampleBase::createRenderCompleteSemaphores()
+{
+	for (auto& semaphore : renderCompleteSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	renderCompleteSemaphores.resize(swapChain.images.size());
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	for (auto& semaphore : renderCompleteSemaphores) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+}
+
+void VulkanExampleBase::destroyFrameResources()
+{
+	for (auto& frame : frameResources) {
+		vkFreeCommandBuffers(device, cmdPool, 1, &frame.commandBuffer);
+		vkDestroyFence(device, frame.fence, nullptr);
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+	}
+	frameResources.clear();
+	for (auto& semaphore : renderCompleteSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	renderCompleteSemaphores.clear();
+}
+
 void VulkanExampleBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -3209,7 +3390,10 @@ void VulkanExampleBase::windowResize()
 	resized = true;
 
 	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(device);
+	{
+		std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+		vkDeviceWaitIdle(device);
+	}
 
 	// Recreate swap chain
 	width = destWidth;
@@ -3243,8 +3427,14 @@ void VulkanExampleBase::windowResize()
 		vkDestroyFence(device, fence, nullptr);
 	}
 	createSynchronizationPrimitives();
+	if (!frameResources.empty()) {
+		createRenderCompleteSemaphores();
+	}
 
-	vkDeviceWaitIdle(device);
+	{
+		std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+		vkDeviceWaitIdle(device);
+	}
 
 	if ((width > 0.0f) && (height > 0.0f)) {
 		camera.updateAspectRatio((float)width / (float)height);
@@ -68,6 +68,7 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanPipelineCache.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -84,8 +85,13 @@ private:
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	void savePipelineCache();
+	void updatePipelineCacheFile();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void createFrameResources();
+	void createRenderCompleteSemaphores();
+	void destroyFrameResources();
 	void createSurface();
 	void createSwapChain();
 	void createCommandBuffers();
@@ -109,15 +115,21 @@ protected:
 	// Stores the features available on the selected physical device (for e.g. checking if a feature is available)
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties;
+	// Descriptor indexing features available on the selected physical device
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
 	// Stores all available memory (type) properties for the physical device
 	VkPhysicalDeviceMemoryProperties deviceMemoryProperties{};
 	/** @brief Set of physical device features to be enabled for this example (must be set in the derived constructor) */
 	VkPhysicalDeviceFeatures enabledFeatures{};
+	/** @brief Descriptor indexing features to be enabled besides partially bound bindings (set in getEnabledFeatures) */
+	VkPhysicalDeviceDescriptorIndexingFeatures enabledDescriptorIndexingFeatures{};
 	/** @brief Set of device extensions to be enabled for this example (must be set in the derived constructor) */
 	std::vector<const char*> enabledDeviceExtensions;
 	std::vector<const char*> enabledInstanceExtensions;
 	/** @brief Optional pNext structure for passing extension structures to device creation */
 	void* deviceCreatepNextChain = nullptr;
+	/** @brief Queue families requested at device creation, a transfer family of its own is only created if VK_QUEUE_TRANSFER_BIT is set (must be set in the derived constructor) */
+	VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
 	/** @brief Logical device, application's view of the physical device (GPU) */
 	VkDevice device{ VK_NULL_HANDLE };
 	// Handle to the device graphics queue that command buffers are submitted to
@@ -144,6 +156,11 @@ protected:
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+	// File the pipeline cache is loaded from and saved to, defaults to <name>.pipelinecache in the working directory
+	std::string pipelineCacheFile;
+	// Cache size at the last save, the periodic save is skipped while no new pipelines were added
+	size_t pipelineCacheSavedSize = 0;
+	std::chrono::time_point<std::chrono::high_resolution_clock> pipelineCacheSaveTimestamp;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 	// Synchronization semaphores
@@ -154,6 +171,20 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Per-frame objects of samples that render through prepareFrameInFlight/submitFrameInFlight, created on first use */
+	struct FrameResources {
+		// Re-recorded every frame
+		VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+		// Signaled once the GPU has finished the frame, guards everything the CPU writes for this frame slot
+		VkFence fence{ VK_NULL_HANDLE };
+		// Swap chain image acquisition
+		VkSemaphore presentComplete{ VK_NULL_HANDLE };
+	};
+	std::vector<FrameResources> frameResources;
+	// Command buffer execution, one per swap chain image as the presentation engine may still wait on it
+	std::vector<VkSemaphore> renderCompleteSemaphores;
+	// Frame slot that is being recorded, per-frame resources of the sample are indexed with it
+	uint32_t currentFrame = 0;
 	bool requiresStencil{ false };
 public:
 	bool prepared = false;
@@ -183,7 +214,14 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Number of frames the CPU may record ahead of the GPU (1 to maxFramesInFlight), only used by samples rendering through prepareFrameInFlight/submitFrameInFlight */
+		uint32_t framesInFlight = 2;
+		/** @brief Keep the pipeline cache on disk so pipelines compiled in earlier runs are reused */
+		bool persistentPipelineCache = true;
+		/** @brief Interval in seconds between saves of the pipeline cache while running, it is always saved on shutdown */
+		float pipelineCacheSaveInterval = 30.0f;
 	} settings;
+	static constexpr uint32_t maxFramesInFlight = 3;
 
 	/** @brief State of gamepad input (only used on Android) */
 	struct {
@@ -409,6 +447,13 @@ public:
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
 
+	/** @brief Waits until the GPU has finished the current frame slot and acquires the next swap chain image, returns false if the frame has to be skipped */
+	bool prepareFrameInFlight();
+	/** @brief Submits the command buffer of the current frame slot, presents it and advances to the next slot without waiting for the GPU */
+	void submitFrameInFlight();
+	/** @brief Waits until all submitted frames in flight have finished, e.g. before destroying resources they may still use */
+	void waitFramesInFlight();
+
 	/** @brief (Virtual) Called when the UI overlay is updating, can be used to add custom elements to the overlay */
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay);
 
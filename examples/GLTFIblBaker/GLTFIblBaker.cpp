@@ -0,0 +1,66 @@
+/*
+ * Image based lighting baker of the glTF sample viewer
+ *
+ * Prefilters equirectangular HDR panoramas to the Lambertian, GGX and Charlie cubemaps and the BRDF LUTs the viewer's
+ * environments consist of. GLTFSampleViewer bakes a panorama given as its environment the same way, files baked here
+ * into its IBL cache directory (iblcache in its working directory by default) are found again. The files are named by a
+ * hash of the panorama and the settings, and -s and -n change that hash: the viewer bakes with the default settings, so it
+ * only finds bakes made without them. Here the cubemaps are filtered on the CPU, the viewer filters them on its device.
+ *
+ * usage: GLTFIblBaker [-o dir] [-j threads] [-f] [-s size] [-n samples] panorama.hdr...
+ */
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#include "IblBaker.h"
+#include "Enviroment.h"
+
+int main(int argc, char* argv[])
+{
+	CommandLineParser commandLineParser;
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("output", { "-o", "--output" }, 1, "Set directory the baked files are written to (default iblcache)");
+	commandLineParser.add("threads", { "-j", "--threads" }, 1, "Number of filtering threads (default one per hardware core)");
+	commandLineParser.add("force", { "-f", "--force" }, 0, "Bake panoramas again that were baked already");
+	commandLineParser.add("size", { "-s", "--size" }, 1, "Size of the GGX and Charlie cubemaps (default 256)");
+	commandLineParser.add("samples", { "-n", "--samples" }, 1, "Samples per texel of the GGX and Charlie cubemaps (default 256)");
+	commandLineParser.parse(argc, argv);
+
+	// every argument that is neither an option nor an option value is a panorama
+	std::vector<std::string> panoramaFilenames;
+	for (int i = 1; i < argc; ++i) {
+		if (argv[i][0] == '-') {
+			for (auto& option : commandLineParser.options) {
+				const auto& commands = option.second.commands;
+				if (option.second.hasValue && std::find(commands.begin(), commands.end(), argv[i]) != commands.end()) ++i;
+			}
+			continue;
+		}
+		panoramaFilenames.push_back(argv[i]);
+	}
+	if (commandLineParser.isSet("help") || panoramaFilenames.empty()) {
+		std::cout << "usage: GLTFIblBaker [options] panorama.hdr...\n";
+		commandLineParser.printHelp();
+		std::cout << "\n";
+		return panoramaFilenames.empty() ? 1 : 0;
+	}
+	const std::string cacheDir = commandLineParser.getValueAsString("output", "iblcache");
+	IblBaker::Settings settings;
+	settings.specularSize = (uint32_t)std::max(4, commandLineParser.getValueAsInt("size", (int)settings.specularSize));
+	settings.specularSamples = (uint32_t)std::max(1, commandLineParser.getValueAsInt("samples", (int)settings.specularSamples));
+	IblBaker baker(settings, (uint32_t)commandLineParser.getValueAsInt("threads", 0));
+	const bool force = commandLineParser.isSet("force");
+
+	bool result = true;
+	for (const std::string& filename : panoramaFilenames) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		EnviromentImagesPath paths;
+		if (!baker.bake(filename, cacheDir, force, paths)) {
+			result = false;
+			continue;
+		}
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << filename << ": " << paths.ggxEnvPath << " (" << (uint32_t)tDiff << " ms)\n";
+	}
+	return result ? 0 : 1;
+}
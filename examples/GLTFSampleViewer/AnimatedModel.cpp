@@ -1,11 +1,17 @@
 #include "AnimatedModel.h"
 #include "Camera.h"
+#include "SkinningPalette.h"
+#include "DrawSortKey.h"
+#include "KtxTranscoder.h"
+#include "threadpool.hpp"
 
-AnimatedModel::AnimatedModel(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue)
+AnimatedModel::AnimatedModel(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue, uint32_t frameCount)
 {
 	vulkanDevice_ = vulkanDevice;
 	descriptorPool_ = descriptorPool;
 	queue_ = queue;
+	uploadCommandPool_ = vulkanDevice->commandPool;
+	frameCount_ = std::max(1u, frameCount);
 
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding(1, vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, SKELETON_BINDING));
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI_Params = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBinding.data(), setLayoutBinding.size());
@@ -25,11 +31,6 @@ AnimatedModel::AnimatedModel(vks::VulkanDevice* vulkanDevice, VkDescriptorPool d
 }
 AnimatedModel::~AnimatedModel()
 {
-	for (auto node : nodes_) {
-		delete node;
-	}
-	nodes_.clear();
-
 	destroy();
 }
 void AnimatedModel::destroy()
@@ -39,10 +40,15 @@ void AnimatedModel::destroy()
 }
 void AnimatedModel::reset()
 {
+	// the copies of an unfinished load still write into the buffers and images
+	if (uploader_ && uploadValue_) uploader_->wait(uploadValue_);
+	uploadValue_ = 0;
+
 	for (auto& mtl : materials_) {
 		mtl.dispose();
 	}
 	materials_.clear();
+	materialTable_.dispose();
 
 	for (auto& skin : skins_) {
 		//vkSafeFreeDescriptorSets(device, descriptorPool_, 1, skin.descriptorSet);
@@ -51,86 +57,421 @@ void AnimatedModel::reset()
 	skins_.clear();
 	dummySkin_.destroy();
 
-	for (Image& image : images_) {
-		image.destroy();
-	}
+	// the images and samplers belong to the texture cache
 	images_.clear();
+	imageRefs_.clear();
 
-	vertices.destroy(vulkanDevice_->logicalDevice);
-	indices.destroy(vulkanDevice_->logicalDevice);
+	vertices.destroy(vulkanDevice_);
+	attributes.destroy(vulkanDevice_);
+	skinAttributes.destroy(vulkanDevice_);
+	skinnedVertexCount_ = 0;
+	indices.destroy(vulkanDevice_);
+	indices16.destroy(vulkanDevice_);
+	meshOptimizationStats_ = MeshOptimizationStats();
 
 	{
 		images_.clear();
 		materials_.clear();
 		nodes_.clear(); nodeByIndex_.clear();
+		transforms_.clear();
 		skins_.clear();
 		animations_.clear();
+		keyframeSamplers_.clear();
 		animationIndex_ = 0;
 	}
 }
 
-void VertexBuffer::destroy(VkDevice device)
+void VertexBuffer::destroy(vks::VulkanDevice* device)
+{
+	vkSafeDestroyBuffer(device->logicalDevice, this->buffer);
+	device->freeMemory(this->allocation);
+}
+void IndexBuffer::destroy(vks::VulkanDevice* device)
+{
+	vkSafeDestroyBuffer(device->logicalDevice, this->buffer);
+	device->freeMemory(this->allocation);
+}
+
+// Staging of the textures of one load: each one gets a span of the upload ring, or they all share one staging buffer
+// and one command buffer, which is submitted and waited for once
+class TextureStaging
+{
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	UploadManager* uploader_ = nullptr;
+	VkQueue queue_ = VK_NULL_HANDLE;
+	VkCommandPool commandPool_ = VK_NULL_HANDLE;
+	vks::Buffer staging_;
+	VkCommandBuffer copyCmd_ = VK_NULL_HANDLE;
+public:
+	TextureStaging(vks::VulkanDevice* vulkanDevice, UploadManager* uploader, VkQueue queue, VkCommandPool commandPool, VkDeviceSize stagingSize)
+	{
+		vulkanDevice_ = vulkanDevice;
+		uploader_ = uploader;
+		queue_ = queue;
+		commandPool_ = commandPool;
+		if (uploader_) return;
+
+		VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+			&staging_, stagingSize));
+		VK_CHECK_RESULT(staging_.map());
+		copyCmd_ = vulkanDevice_->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool_, true);
+	}
+	// offset into the shared staging buffer, the ring places the texture itself
+	UploadManager::Span stage(VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (uploader_) return uploader_->stage(size);
+
+		UploadManager::Span span;
+		span.buffer = staging_.buffer;
+		span.offset = offset;
+		span.mapped = (unsigned char*)staging_.mapped + offset;
+		return span;
+	}
+	// after stage, the ring may have submitted the previous command buffer to make room
+	VkCommandBuffer getCommandBuffer()
+	{
+		return uploader_ ? uploader_->getGraphicsCommandBuffer() : copyCmd_;
+	}
+	// returns the upload value of the textures, 0 once they are resident
+	uint64_t submit()
+	{
+		if (uploader_) return uploader_->submit();
+
+		vulkanDevice_->flushCommandBuffer(copyCmd_, queue_, commandPool_, true);
+		staging_.unmap();
+		staging_.destroy();
+		return 0;
+	}
+};
+
+// the KTX2 image of KHR_texture_basisu, -1 without the extension
+static int getBasisuSource(const tinygltf::Texture& gltfTexture)
+{
+	auto it = gltfTexture.extensions.find("KHR_texture_basisu");
+	if (it == gltfTexture.extensions.end() || !it->second.Has("source")) return -1;
+	const tinygltf::Value& source = it->second.Get("source");
+	return source.IsNumber() ? (int)source.GetNumberAsInt() : -1;
+}
+// Transcoding is as slow as image decoding, the images are spread over a thread pool like in GltfImageDecoder
+static void transcodeKtxImages(const KtxTranscoder& transcoder, const tinygltf::Model& input, const std::vector<int>& imageIndices, std::vector<KtxTranscoder::Image>& images)
+{
+	if (imageIndices.empty()) return;
+
+	std::vector<char> results(input.images.size(), true);
+	auto func_transcode = [&](int imageIndex) {
+		const tinygltf::Image& glTFImage = input.images[imageIndex];
+		results[imageIndex] = transcoder.transcode(glTFImage.image.data(), glTFImage.image.size(), images[imageIndex]);
+	};
+	// libktx initializes the Basis transcoder on first use without a lock
+	func_transcode(imageIndices[0]);
+	if (imageIndices.size() > 1) {
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(std::min<uint32_t>(std::max(1u, std::thread::hardware_concurrency()), (uint32_t)imageIndices.size() - 1));
+		for (size_t i = 1; i < imageIndices.size(); ++i) {
+			threadPool.threads[i % threadPool.threads.size()]->addJob([&func_transcode, &imageIndices, i] { func_transcode(imageIndices[i]); });
+		}
+		threadPool.wait();
+	}
+	for (int imageIndex : imageIndices) {
+		if (!results[imageIndex]) std::cerr << "transcode KTX2 image[" << imageIndex << "] \"" << input.images[imageIndex].name << "\" failed\n";
+	}
+}
+
+// An image of the textures that refer to it, or of the model cache
+struct AnimatedModel::PendingImage {
+	const tinygltf::Image* image = nullptr;
+	const KtxTranscoder::Image* ktxImage = nullptr;//null for a decoded RGBA8 image
+	bool mipmaps = false;//of any texture sampling it
+	bool srgb = false;//base color or emissive, its mip levels are filtered in linear space
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t width = 0, height = 0, mipLevels = 1;
+	uint64_t contentHash = 0;
+	uint64_t key = 0;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	TextureCache::ImagePtr shared;//found in the texture cache, not staged
+};
+struct AnimatedModel::PendingTexture {
+	int imageSlot = -1;
+	vks::Texture2D::SamplerOption samplerOpt;
+	bool mipmaps = true;
+};
+
+TextureCache* AnimatedModel::getTextureCache()
+{
+	if (!textureCache_) textureCache_ = std::make_shared<TextureCache>(vulkanDevice_);
+	return textureCache_.get();
+}
+bool AnimatedModel::findSharedImage(PendingImage& pending)
 {
-	vkSafeDestroyBuffer(device, this->buffer);
-	vkSafeFreeMemory(device, this->memory);
+	uint64_t uploadValue = 0;
+	TextureCache::ImagePtr shared = getTextureCache()->findImage(pending.key, uploadValue);
+	// an image still in flight on the upload ring can't be waited for without one
+	if (!shared || (uploadValue && !uploader_)) return false;
+	pending.shared = shared;
+	uploadValue_ = std::max(uploadValue_, uploadValue);
+	return true;
 }
-void IndexBuffer::destroy(VkDevice device)
+void AnimatedModel::bindTextures(const std::vector<PendingImage>& pendings, const std::vector<PendingTexture>& textures)
 {
-	vkSafeDestroyBuffer(device, this->buffer);
-	vkSafeFreeMemory(device, this->memory);
+	imageRefs_.resize(pendings.size());
+	for (size_t i = 0; i < pendings.size(); ++i) {
+		imageRefs_[i] = pendings[i].shared;
+	}
+	images_.resize(textures.size());
+	for (size_t i = 0; i < textures.size(); ++i) {
+		const PendingTexture& texture = textures[i];
+		if (texture.imageSlot < 0 || !imageRefs_[texture.imageSlot]) continue;
+		images_[i] = TextureCache::makeTexture(*imageRefs_[texture.imageSlot], getTextureCache()->getSampler(texture.samplerOpt, texture.mipmaps));
+	}
 }
 
-void AnimatedModel::loadTextures(tinygltf::Model& input)
+void AnimatedModel::loadTextures(tinygltf::Model& input, ModelCacheWriter* cache)
 {
-	images_.resize(input.textures.size());
+	// Mip levels are blitted on the GPU, or downsampled on the CPU and staged when the format can't be linearly blitted.
+	// Cooking always builds them on the CPU, so the cache stores the whole chain
+	const vks::Texture2D::MipmapSource mipmapSource = (!cache && vks::Texture2D::isLinearBlitSupported(vulkanDevice_, VK_FORMAT_R8G8B8A8_UNORM))
+		? vks::Texture2D::kMipmap_Blit : vks::Texture2D::kMipmap_Staged;
+
+	// KHR_texture_basisu images are preferred over the fallback source. KTX2 images, of the extension or cooked by
+	// TextureCooker in place of the source, were left encoded by GltfImageDecoder
+	const KtxTranscoder transcoder(vulkanDevice_);
+	std::vector<int> textureSources(input.textures.size(), -1);
+	std::vector<int> ktxImageIndices;
+	std::vector<char> isKtxImage(input.images.size(), false);
+	auto func_isKtx2 = [&input](int imageIndex) {
+		if (imageIndex < 0 || imageIndex >= (int)input.images.size()) return false;
+		const tinygltf::Image& glTFImage = input.images[imageIndex];
+		return glTFImage.as_is && KtxTranscoder::isKtx2(glTFImage.image.data(), glTFImage.image.size());
+	};
+	for (size_t i = 0; i < input.textures.size(); i++) {
+		const int basisuSource = getBasisuSource(input.textures[i]);
+		textureSources[i] = func_isKtx2(basisuSource) ? basisuSource : input.textures[i].source;
+		if (func_isKtx2(textureSources[i])) {
+			if (!isKtxImage[textureSources[i]]) ktxImageIndices.push_back(textureSources[i]);
+			isKtxImage[textureSources[i]] = true;
+		}
+	}
+	std::vector<KtxTranscoder::Image> ktxImages(input.images.size());
+	transcodeKtxImages(transcoder, input, ktxImageIndices, ktxImages);
+
+	// Textures that sample the same image share one upload of it, with mipmaps if any of them filters with them
+	std::vector<PendingImage> pendings;
+	std::vector<PendingTexture> textures(input.textures.size());
+	std::vector<int> slotByImage(input.images.size(), -1);
+	// the images are uploaded as UNORM and the shaders decode these, but mip levels must average linear colors
+	std::vector<char> isSrgbTexture(input.textures.size(), false);
+	for (const tinygltf::Material& material : input.materials) {
+		for (int textureIndex : { material.pbrMetallicRoughness.baseColorTexture.index, material.emissiveTexture.index }) {
+			if (textureIndex >= 0 && textureIndex < (int)input.textures.size()) isSrgbTexture[textureIndex] = true;
+		}
+	}
 	for (size_t i = 0; i < input.textures.size(); i++) {
 		tinygltf::Texture& gltfTexture = input.textures[i];
-		int imageIndex = gltfTexture.source;
-		if (imageIndex >= input.images.size()) 
+		int imageIndex = textureSources[i];
+		if (imageIndex < 0 || imageIndex >= input.images.size()) 
 			continue;
 
-		tinygltf::Image& glTFImage = input.images[imageIndex];
-		// Get the image data from the glTF loader
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		// We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
-		if (glTFImage.component == 3) {
-			bufferSize = glTFImage.width * glTFImage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &glTFImage.image[0];
-			for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i) {
-				memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
-		}
-		else {
-			buffer = &glTFImage.image[0];
-			bufferSize = glTFImage.image.size();
-		}
+		// Image data was decoded to RGBA8 or transcoded, skip images that failed
+		const tinygltf::Image& glTFImage = input.images[imageIndex];
+		const KtxTranscoder::Image* ktxImage = isKtxImage[imageIndex] ? &ktxImages[imageIndex] : nullptr;
+		if (ktxImage && !ktxImage->isValid())
+			continue;
+		if (!ktxImage && (glTFImage.as_is || glTFImage.image.empty() || glTFImage.width <= 0 || glTFImage.height <= 0 || glTFImage.component != 4))
+			continue;
 
-		// Load texture from image buffer
-		vks::Texture2D::SamplerOption samplerOpt;
+		PendingTexture& texture = textures[i];//no sampler or no min filter leaves filtering to the viewer
 		int samplerIndex = gltfTexture.sampler;
-		if (samplerIndex < input.samplers.size()) {
+		if (samplerIndex >= 0 && samplerIndex < input.samplers.size()) {
 			tinygltf::Sampler& gltfSampler = input.samplers[samplerIndex];
-			OglToVulkan::convertSamplerWrap(gltfSampler.wrapS, samplerOpt.addressModeU);
-			OglToVulkan::convertSamplerWrap(gltfSampler.wrapT, samplerOpt.addressModeV);
-			OglToVulkan::convertSamplerWrap(gltfSampler.wrapR, samplerOpt.addressModeW);
-			OglToVulkan::convertSamplerFilter(gltfSampler.magFilter, samplerOpt.magFilter, samplerOpt.mipmapMode);
-			OglToVulkan::convertSamplerFilter(gltfSampler.minFilter, samplerOpt.minFilter, samplerOpt.mipmapMode);
+			OglToVulkan::convertSamplerWrap(gltfSampler.wrapS, texture.samplerOpt.addressModeU);
+			OglToVulkan::convertSamplerWrap(gltfSampler.wrapT, texture.samplerOpt.addressModeV);
+			OglToVulkan::convertSamplerWrap(gltfSampler.wrapR, texture.samplerOpt.addressModeW);
+			OglToVulkan::convertSamplerFilter(gltfSampler.magFilter, texture.samplerOpt.magFilter, texture.samplerOpt.mipmapMode);
+			OglToVulkan::convertSamplerFilter(gltfSampler.minFilter, texture.samplerOpt.minFilter, texture.samplerOpt.mipmapMode);
+			texture.mipmaps = gltfSampler.minFilter < 0 || OglToVulkan::isMipmapFilter(gltfSampler.minFilter);
 		}
 
-		images_[i].fromBuffer(buffer, bufferSize, VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height,
-			vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-			true, samplerOpt
-		);
+		if (slotByImage[imageIndex] < 0) {
+			slotByImage[imageIndex] = (int)pendings.size();
+			PendingImage pending;
+			pending.image = &glTFImage;
+			pending.ktxImage = ktxImage;
+			pendings.push_back(pending);
+		}
+		texture.imageSlot = slotByImage[imageIndex];
+		pendings[texture.imageSlot].mipmaps |= texture.mipmaps;
+		pendings[texture.imageSlot].srgb |= isSrgbTexture[i] != 0;
+	}
+
+	// the cache is looked up by the staged bytes of each image, a model being cooked needs them all
+	VkDeviceSize stagingSize = 0;
+	std::vector<VkDeviceSize> levelOffsets;
+	for (PendingImage& pending : pendings) {
+		// 16 byte aligned, satisfies the texel size and copy offset alignment of RGBA8 and of the block formats
+		if (pending.ktxImage) {
+			const KtxTranscoder::Image& ktxImage = *pending.ktxImage;
+			pending.format = ktxImage.format;
+			pending.width = ktxImage.width;
+			pending.height = ktxImage.height;
+			pending.mipLevels = pending.mipmaps ? ktxImage.getMipLevels() : 1;
+			// the levels of the file are staged as they are, blocks can't be blitted
+			pending.size = pending.mipmaps ? ktxImage.data.size() : vks::Texture2D::getMipChainLayout(ktxImage.format, ktxImage.width, ktxImage.height, 1, levelOffsets);
+			pending.contentHash = ModelCache::hashBytes(ModelCache::kHashSeed, pending.image->image.data(), pending.image->image.size());
+		}
+		else {
+			pending.width = pending.image->width;
+			pending.height = pending.image->height;
+			pending.mipLevels = pending.mipmaps ? vks::Texture2D::getMipLevelCount(pending.width, pending.height) : 1;
+			if (pending.mipmaps && mipmapSource == vks::Texture2D::kMipmap_Staged) {
+				pending.size = vks::Texture2D::getMipChainLayout(pending.width, pending.height, pending.mipLevels, 4, levelOffsets);
+			}
+			else {
+				pending.size = ((VkDeviceSize)pending.width * pending.height * 4 + 15) & ~VkDeviceSize(15);
+			}
+			pending.contentHash = ModelCache::hashBytes(ModelCache::kHashSeed, pending.image->image.data(), (size_t)pending.width * pending.height * 4);
+			// the staged mip levels of the same bytes differ with it
+			if (pending.srgb) pending.contentHash = ModelCache::hashBytes(pending.contentHash, &pending.srgb, sizeof(pending.srgb));
+		}
+		// keyed even when cooking, the upload is added to the cache under it
+		pending.key = TextureCache::makeImageKey(pending.contentHash, pending.format, pending.width, pending.height, pending.mipLevels);
+		if (!cache && findSharedImage(pending)) continue;
+		pending.offset = stagingSize;
+		stagingSize += pending.size;
+	}
+	if (cache) {
+		cache->write((uint64_t)textures.size());
+		cache->write((uint64_t)pendings.size());
+	}
+
+	if (stagingSize) {
+		TextureStaging staging(vulkanDevice_, uploader_.get(), queue_, uploadCommandPool_, stagingSize);
+		std::vector<unsigned char> mipChain;
+		std::vector<vks::Texture2D> uploads(pendings.size());
+		for (size_t i = 0; i < pendings.size(); ++i) {
+			const PendingImage& pending = pendings[i];
+			if (pending.shared) continue;
+
+			const UploadManager::Span span = staging.stage(pending.offset, pending.size);
+			vks::Texture2D::MipmapSource imageMipmapSource = vks::Texture2D::kMipmap_None;
+			if (pending.ktxImage) {
+				if (pending.mipLevels > 1) imageMipmapSource = vks::Texture2D::kMipmap_Staged;
+				memcpy(span.mapped, pending.ktxImage->data.data(), (size_t)pending.size);
+			}
+			else {
+				const VkDeviceSize baseSize = (VkDeviceSize)pending.width * pending.height * 4;
+				const bool stagedMipmaps = pending.mipmaps && mipmapSource == vks::Texture2D::kMipmap_Staged;
+				if (pending.mipmaps) imageMipmapSource = mipmapSource;
+				if (stagedMipmaps) {
+					//downsampling reads back every level, so the chain is built in host memory first
+					mipChain.resize(vks::Texture2D::getMipChainLayout(pending.width, pending.height, pending.mipLevels, 4, levelOffsets));
+					memcpy(mipChain.data(), &pending.image->image[0], (size_t)baseSize);
+					vks::Texture2D::buildMipChainRGBA8(mipChain.data(), pending.width, pending.height, pending.mipLevels, levelOffsets, pending.srgb);
+					memcpy(span.mapped, mipChain.data(), mipChain.size());
+				}
+				else {
+					memcpy(span.mapped, &pending.image->image[0], (size_t)baseSize);
+					memset((unsigned char*)span.mapped + baseSize, 0, (size_t)(pending.size - baseSize));
+				}
+			}
+			if (cache) {
+				cache->write(pending.width);
+				cache->write(pending.height);
+				cache->write((uint32_t)pending.format);
+				cache->write(pending.mipLevels);
+				cache->write(pending.contentHash);
+				cache->writeBlob((unsigned char*)span.mapped, vks::Texture2D::getMipChainLayout(pending.format, pending.width, pending.height, pending.mipLevels, levelOffsets));
+			}
+
+			uploads[i].fromStagingBuffer(span.buffer, span.offset, pending.format, pending.width, pending.height,
+				vulkanDevice_, staging.getCommandBuffer(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
+				true, vks::Texture2D::SamplerOption(), imageMipmapSource, pending.mipLevels, false
+			);
+		}
+		const uint64_t uploadValue = staging.submit();
+		uploadValue_ = std::max(uploadValue_, uploadValue);
+		for (size_t i = 0; i < pendings.size(); ++i) {
+			if (!pendings[i].shared) pendings[i].shared = getTextureCache()->addImage(pendings[i].key, uploads[i], uploadValue);
+		}
+	}
+	if (cache) {
+		for (const PendingTexture& texture : textures) {
+			cache->write((int32_t)texture.imageSlot);
+			cache->write(texture.samplerOpt);
+			cache->write((uint8_t)texture.mipmaps);
+		}
+	}
+	bindTextures(pendings, textures);
+}
+bool AnimatedModel::loadTextures(ModelCacheReader& cache)
+{
+	uint64_t textureCount = 0, imageCount = 0;
+	cache.read(textureCount);
+	cache.read(imageCount);
+	if (!cache.isGood() || imageCount > textureCount || textureCount > (1u << 20)) return false;
+
+	// transcoded images were cooked for the block formats of the device that cooked them
+	const KtxTranscoder transcoder(vulkanDevice_);
+	std::vector<PendingImage> pendings((size_t)imageCount);
+	std::vector<ModelCacheBlob> pixels((size_t)imageCount);
+	std::vector<VkDeviceSize> levelOffsets;
+	VkDeviceSize stagingSize = 0;
+	for (size_t i = 0; i < pendings.size(); ++i) {
+		PendingImage& pending = pendings[i];
+		uint32_t format = 0;
+		cache.read(pending.width);
+		cache.read(pending.height);
+		cache.read(format);
+		cache.read(pending.mipLevels);
+		cache.read(pending.contentHash);
+		cache.readBlob(pixels[i]);
+		pending.format = (VkFormat)format;
+		if (!cache.isGood() || pending.width == 0 || pending.height == 0) return false;
+		if (!transcoder.isFormatSupported(pending.format)) return false;
+		if (pending.mipLevels == 0 || pending.mipLevels > vks::Texture2D::getMipLevelCount(pending.width, pending.height)) return false;
+
+		// the cooked chain is laid out exactly as fromStagingBuffer expects it
+		pending.size = vks::Texture2D::getMipChainLayout(pending.format, pending.width, pending.height, pending.mipLevels, levelOffsets);
+		if (pixels[i].size != pending.size) return false;
+		pending.key = TextureCache::makeImageKey(pending.contentHash, pending.format, pending.width, pending.height, pending.mipLevels);
+		if (findSharedImage(pending)) continue;
+		pending.offset = stagingSize;
+		stagingSize += pending.size;
+	}
+	std::vector<PendingTexture> textures((size_t)textureCount);
+	for (PendingTexture& texture : textures) {
+		int32_t imageSlot = -1;
+		uint8_t mipmaps = 0;
+		cache.read(imageSlot);
+		cache.read(texture.samplerOpt);
+		cache.read(mipmaps);
+		if (!cache.isGood() || imageSlot < -1 || imageSlot >= (int32_t)imageCount) return false;
+		texture.imageSlot = imageSlot;
+		texture.mipmaps = mipmaps != 0;
+	}
 
-		if (deleteBuffer) delete[] buffer;
+	if (stagingSize) {
+		TextureStaging staging(vulkanDevice_, uploader_.get(), queue_, uploadCommandPool_, stagingSize);
+		std::vector<vks::Texture2D> uploads(pendings.size());
+		for (size_t i = 0; i < pendings.size(); ++i) {
+			const PendingImage& pending = pendings[i];
+			if (pending.shared) continue;
+
+			const UploadManager::Span span = staging.stage(pending.offset, pending.size);
+			memcpy(span.mapped, pixels[i].data, (size_t)pending.size);
+			uploads[i].fromStagingBuffer(span.buffer, span.offset, pending.format, pending.width, pending.height,
+				vulkanDevice_, staging.getCommandBuffer(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
+				true, vks::Texture2D::SamplerOption(), pending.mipLevels > 1 ? vks::Texture2D::kMipmap_Staged : vks::Texture2D::kMipmap_None, pending.mipLevels, false
+			);
+		}
+		const uint64_t uploadValue = staging.submit();
+		uploadValue_ = std::max(uploadValue_, uploadValue);
+		for (size_t i = 0; i < pendings.size(); ++i) {
+			if (!pendings[i].shared) pendings[i].shared = getTextureCache()->addImage(pendings[i].key, uploads[i], uploadValue);
+		}
 	}
+	bindTextures(pendings, textures);
+	return true;
 }
 void AnimatedModel::loadMaterials(tinygltf::Model& input, MaterialFactory& mtlFac)
 {
@@ -210,32 +551,36 @@ static void generateTangents(std::vector<AnimatedModel::Vertex>& vertex, uint32_
 	}
 }
 
-void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, const tinygltf::Model& input, AnimatedModelNode* parent,
+void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, const tinygltf::Model& input, int parent,
 	std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, bool flipY)
 {
-	AnimatedModelNode* node = new AnimatedModelNode{};
-	node->parent = parent;
-	node->bbox.reset();
-
-	node->position = glm::vec3(0);
-	node->rotation = glm::quat();
-	node->scale = glm::vec3(1,1,1);
-	node->matrix = glm::mat4(1.0);
-	if (inputNode.translation.size() == 3) node->position = glm::make_vec3(inputNode.translation.data());
-	if (inputNode.rotation.size() == 4) node->rotation = glm::make_quat(inputNode.rotation.data());
-	if (inputNode.scale.size() == 3) node->scale = glm::make_vec3(inputNode.scale.data());
-	if (inputNode.matrix.size() == 16) node->matrix = glm::make_mat4x4(inputNode.matrix.data());
-	node->localMatrix = Transform(node->position, node->rotation, node->scale).getMatrix() * node->matrix;
-	node->bindMatrix = node->localMatrix;
-
-	node->skinIndex = inputNode.skin;
+	glm::vec3 position = glm::vec3(0);
+	glm::quat rotation = glm::quat();
+	glm::vec3 scale = glm::vec3(1,1,1);
+	glm::mat4 matrix = glm::mat4(1.0);
+	if (inputNode.translation.size() == 3) position = glm::make_vec3(inputNode.translation.data());
+	if (inputNode.rotation.size() == 4) rotation = glm::make_quat(inputNode.rotation.data());
+	if (inputNode.scale.size() == 3) scale = glm::make_vec3(inputNode.scale.data());
+	if (inputNode.matrix.size() == 16) matrix = glm::make_mat4x4(inputNode.matrix.data());
+
+	// parent is added before its children, keeps nodes_ in depth-first order
+	int flatIndex = transforms_.addNode(parent, position, rotation, scale, matrix);
+	nodes_.emplace_back();
+	nodes_[flatIndex].nodeIndex = nodeIndex;
+	nodes_[flatIndex].skinIndex = inputNode.skin;
+	if (nodeIndex >= nodeByIndex_.size()) nodeByIndex_.resize(nodeIndex + 1, -1);
+	nodeByIndex_[nodeIndex] = flatIndex;
 
 	// Load node's children
 	if (inputNode.children.size() > 0) {
 		for (size_t i = 0; i < inputNode.children.size(); i++) {
-			loadNode(input.nodes[inputNode.children[i]], inputNode.children[i], input, node, indexBuffer, vertexBuffer, flipY);
+			loadNode(input.nodes[inputNode.children[i]], inputNode.children[i], input, flatIndex, indexBuffer, vertexBuffer, flipY);
 		}
 	}
+	transforms_.endSubtree(flatIndex);
+
+	// children may have reallocated nodes_
+	AnimatedModelNode* node = &nodes_[flatIndex];
 
 	// If the node contains mesh data, we load vertices and indices from the buffers
 	// In glTF this is done via accessors and buffer views
@@ -249,6 +594,7 @@ void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, con
 			uint32_t indexCount = 0;
 			const float* normalsBuffer = nullptr;
 			const float* tangentsBuffer = nullptr;
+			bool hasSkin = false;
 			std::vector<double> vertexMin, vertexMax;
 			// Vertices
 			{
@@ -314,7 +660,7 @@ void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, con
 				}
 
 				// Append data to model's vertex buffer
-				bool hasSkin = (jointIndicesBuffer && jointWeightsBuffer);
+				hasSkin = (jointIndicesBuffer && jointWeightsBuffer);
 				for (size_t v = 0; v < vertexCount; v++) {
 					Vertex vert{};
 					vert.pos = glm::vec4(glm::make_vec3(&positionBuffer[v * 3]), 1.0f);
@@ -376,15 +722,24 @@ void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, con
 			primitive.firstIndex = firstIndex;
 			primitive.indexCount = indexCount;
 			primitive.materialIndex = glTFPrimitive.material;
-			node->mesh.primitives.push_back(primitive);
+			primitive.vertexStart = vertexStart;
+			primitive.vertexCount = static_cast<uint32_t>(vertexBuffer.size()) - vertexStart;
+			primitive.skinned = hasSkin && node->skinIndex >= 0;
 
 			if (!normalsBuffer) generateNormals(vertexBuffer, vertexStart, vertexBuffer.size(), indexBuffer, firstIndex, indexBuffer.size());
 			if (!tangentsBuffer) generateTangents(vertexBuffer, vertexStart, vertexBuffer.size(), indexBuffer, firstIndex, indexBuffer.size());
+			// after normal and tangent generation, welding must not merge vertices that differ in those
+			if (meshOptimization_) optimizePrimitive(primitive, vertexBuffer, indexBuffer);
 
 			auto& bbox = node->bbox;
 			if (vertexMin.size() >= 3 && vertexMax.size() >= 3)
 			{
 				BoundingBox nodeBBox(toVec3(vertexMin), toVec3(vertexMax));
+				if (flipY) {
+					float minY = nodeBBox.min.y;
+					nodeBBox.min.y = -nodeBBox.max.y;
+					nodeBBox.max.y = -minY;
+				}
 				bbox.merge(nodeBBox);
 				primitive.bbox.merge(nodeBBox);
 			}
@@ -395,21 +750,26 @@ void AnimatedModel::loadNode(const tinygltf::Node& inputNode, int nodeIndex, con
 					primitive.bbox.merge(vertexBuffer[i].pos);
 				}
 			}
+			// push after bbox is computed, culling relies on primitive.bbox
+			node->mesh.primitives.push_back(primitive);
 		}
 	}
 
-	if (parent) parent->children.push_back(node);
-	else nodes_.push_back(node);
-
 	if (node->bbox) {
 		glm::vec3 center = node->bbox.center();
 		float radius = glm::distance(node->bbox.max, center);
 		node->bbox = BoundingBox(center - vec3(radius), center + vec3(radius));
 	}
 
-	node->nodeIndex = nodeIndex;
-	if (nodeIndex >= nodeByIndex_.size()) nodeByIndex_.resize(nodeIndex + 1);
-	nodeByIndex_[nodeIndex] = node;
+	// children are already loaded, accumulate their static subtree info
+	node->subtreePrimitiveCount = 0;
+	for (auto& primitive : node->mesh.primitives)
+		node->subtreePrimitiveCount += (primitive.indexCount > 0) ? 1 : 0;
+	node->subtreeSkinned = (node->skinIndex >= 0 && node->mesh.primitives.size() > 0);
+	for (int child = flatIndex + 1; child < transforms_.getSubtreeEnd(flatIndex); child = transforms_.getSubtreeEnd(child)) {
+		node->subtreePrimitiveCount += nodes_[child].subtreePrimitiveCount;
+		node->subtreeSkinned = node->subtreeSkinned || nodes_[child].subtreeSkinned;
+	}
 }
 void AnimatedModel::loadAnimations(tinygltf::Model& input)
 {
@@ -419,13 +779,16 @@ void AnimatedModel::loadAnimations(tinygltf::Model& input)
 		ani.load(input, iAnimation);
 		animations_.push_back(ani);
 	}
+	keyframeSamplers_.resize(animations_.size());
+	for (size_t i = 0; i < animations_.size(); ++i) {
+		keyframeSamplers_[i].build(animations_[i]);
+	}
 }
 void AnimatedModel::loadSkins(tinygltf::Model& input)
 {
 	skins_.resize(input.skins.size());
 	for (size_t i = 0; i < input.skins.size(); i++)
 	{
-		std::vector<AnimatedModelNode*> skinNodes;
 		tinygltf::Skin glTFSkin = input.skins[i];
 
 		auto& skinI = skins_[i];
@@ -433,9 +796,6 @@ void AnimatedModel::loadSkins(tinygltf::Model& input)
 		skinI.rootNodeIndex = glTFSkin.skeleton;
 		skinI.jointNodeIndexs = glTFSkin.joints;
 
-		for (int j : skinI.jointNodeIndexs)
-			skinNodes.push_back(nodeByIndex_[j]);
-
 		// Get the inverse bind matrices from the buffer associated to this skin
 		if (glTFSkin.inverseBindMatrices > -1)
 		{
@@ -444,34 +804,57 @@ void AnimatedModel::loadSkins(tinygltf::Model& input)
 			const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 			skinI.inverseBindMatrices.resize(accessor.count);
 			memcpy(skinI.inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+		}
+		// glTF defaults missing inverse bind matrices to identity
+		skinI.inverseBindMatrices.resize(skinI.jointNodeIndexs.size(), glm::mat4(1.0f));
+		if (skinI.inverseBindMatrices.empty()) skinI.inverseBindMatrices.push_back(glm::mat4(1.0f));
+	}
+	createSkins();
+}
+void AnimatedModel::createSkins()
+{
+	for (auto& skinI : skins_)
+	{
+		skinI.jointFlatIndexs.assign(skinI.jointNodeIndexs.size(), -1);
+		for (size_t j = 0; j < skinI.jointNodeIndexs.size(); ++j) {
+			int nodeIndex = skinI.jointNodeIndexs[j];
+			if (nodeIndex >= 0 && nodeIndex < nodeByIndex_.size()) skinI.jointFlatIndexs[j] = nodeByIndex_[nodeIndex];
+		}
 
-			// Store inverse bind matrices for this skin in a shader storage buffer object
-			// To keep this sample simple, we create a host visible shader storage buffer
+		// Store inverse bind matrices for this skin in a shader storage buffer object per frame in flight
+		// The buffers stay mapped, updateJoints writes the joint palette into them directly
+		skinI.ssbos.resize(frameCount_);
+		for (auto& ssbo : skinI.ssbos) {
 			VK_CHECK_RESULT(vulkanDevice_->createBuffer(
 				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&skinI.ssbo, sizeof(glm::mat4) * skinI.inverseBindMatrices.size(), skinI.inverseBindMatrices.data())
+				&ssbo, sizeof(glm::mat4) * skinI.inverseBindMatrices.size(), skinI.inverseBindMatrices.data())
 			);
-			VK_CHECK_RESULT(skinI.ssbo.map());
+			VK_CHECK_RESULT(ssbo.map());
 		}
+		skinI.dirtyFrames = ~0u;
 
-		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, &skeletonDSLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice_->logicalDevice, &allocInfo, &skinI.descriptorSet));
+		std::vector<VkDescriptorSetLayout> layouts(frameCount_, skeletonDSLayout);
+		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, layouts.data(), frameCount_);
+		skinI.descriptorSets.resize(frameCount_);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice_->logicalDevice, &allocInfo, skinI.descriptorSets.data()));
 	}
-	if (skins_.empty())
+	// static primitives of a skinned model bind it as well
 	{
 		auto& skinI = dummySkin_;
 
 		skinI.inverseBindMatrices.clear();
 		skinI.inverseBindMatrices.push_back(glm::mat4(1.0f));
 
+		// never written after creation, so one buffer serves every frame in flight
+		skinI.ssbos.resize(1);
 		VK_CHECK_RESULT(vulkanDevice_->createBuffer(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&skinI.ssbo, sizeof(glm::mat4) * skinI.inverseBindMatrices.size(), skinI.inverseBindMatrices.data())
+			&skinI.ssbos[0], sizeof(glm::mat4) * skinI.inverseBindMatrices.size(), skinI.inverseBindMatrices.data())
 		);
-		VK_CHECK_RESULT(skinI.ssbo.map());
 
 		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, &skeletonDSLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice_->logicalDevice, &allocInfo, &skinI.descriptorSet));
+		skinI.descriptorSets.resize(1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice_->logicalDevice, &allocInfo, skinI.descriptorSets.data()));
 	}
 }
 
@@ -508,46 +891,71 @@ void AnimatedModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelin
 }
 #endif
 
-struct CompareDrawableDepth
+static void sortDrawableQueue(const std::vector<Drawable>& queue, uint64_t (*makeKey)(const Drawable&), std::vector<uint64_t>& keys, std::vector<uint32_t>& order)
 {
-	bool operator()(const Drawable& l, const Drawable& r) const {
-		return l.depth_ > r.depth_;
-	}
-};
+	keys.resize(queue.size());
+	for (size_t i = 0; i < queue.size(); ++i)
+		keys[i] = makeKey(queue[i]);
+	DrawSortKey::sort(keys, order);
+}
+void DrawableQueueGroup::sortOpaqueQueueByState()
+{
+	sortDrawableQueue(opaqueQueue_, DrawSortKey::makeOpaque, sortKeys_, opaqueOrder_);
+}
 void DrawableQueueGroup::sortTransmissionQueueByDepth()
 {
-	std::stable_sort(transmissionQueue_.begin(), transmissionQueue_.end(), CompareDrawableDepth());
+	sortDrawableQueue(transmissionQueue_, DrawSortKey::makeBlended, sortKeys_, transmissionOrder_);
 }
 void DrawableQueueGroup::sortTransparentQueueByDepth()
 {
-	std::stable_sort(transparentQueue_.begin(), transparentQueue_.end(), CompareDrawableDepth());
+	sortDrawableQueue(transparentQueue_, DrawSortKey::makeBlended, sortKeys_, transparentOrder_);
 }
-void Drawable::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+void Drawable::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool bindDescriptorSets)
 {
 	if (!isValid()) return;
 	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstant_), &pushConstant_);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MATERIAL_SET, descriptorSets_.size(), descriptorSets_.data(), 0, nullptr);
-	vkCmdDrawIndexed(commandBuffer, indexCount_, 1, firstIndex_, 0, 0);
+	if (bindDescriptorSets) vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MATERIAL_SET, descriptorSets_.size(), descriptorSets_.data(), 0, nullptr);
+	vkCmdDrawIndexed(commandBuffer, indexCount_, 1, firstIndex_, vertexOffset_, 0);
 }
 
-void AnimatedModel::getDrawableQueueGroupByNode(DrawableQueueGroup& drwQueGrp, Camera1& camera, AnimatedModelNode* node)
+static bool isBBoxInFrustum(const vks::Frustum& frustum, const BoundingBox& worldBBox)
 {
-	if (node->mesh.primitives.size() > 0) {
-		glm::mat4 modelMatrix = node->getWorldMatrix();
+	glm::vec3 center = worldBBox.center();
+	float radius = glm::length(worldBBox.size()) * 0.5f;
+	return frustum.checkSphere(center, radius);
+}
+void AnimatedModel::getDrawableQueueGroupByNode(DrawableQueueGroup& drwQueGrp, Camera1& camera, int nodeId)
+{
+	const AnimatedModelNode& node = nodes_[nodeId];
+	if (node.mesh.primitives.size() > 0) {
+		const glm::mat4& modelMatrix = transforms_.getWorldMatrix(nodeId);
+		glm::mat4 mvp = camera.getViewProjectionMatrix() * modelMatrix;
 
-		for (Primitive& primitive : node->mesh.primitives) {
+		for (const Primitive& primitive : node.mesh.primitives) {
 			if (primitive.indexCount > 0) {
+				// primitive-level
+				if (frustumCulling_ && node.skinIndex < 0 && primitive.bbox && !isBBoxInFrustum(frustum_, primitive.bbox.transform(modelMatrix))) {
+					cullingStats_.culled++;
+					continue;
+				}
+				cullingStats_.visible++;
+
 				const Material& mtl = materials_[primitive.materialIndex];
 				
 				Drawable drawable;
 				drawable.firstIndex_ = primitive.firstIndex;
 				drawable.indexCount_ = primitive.indexCount;
+				drawable.vertexOffset_ = (primitive.indexType == VK_INDEX_TYPE_UINT16) ? (int32_t)primitive.vertexStart : 0;
+				drawable.indexType_ = primitive.indexType;
+				drawable.skinned_ = primitive.skinned && node.skinIndex < (int)skins_.size();
+				drawable.variant_ = mtl.getVariant();
 				
-				drawable.descriptorSets_[0] = mtl.descriptorSet;
-				drawable.descriptorSets_[1] = (node->skinIndex < skins_.size()) ? skins_[node->skinIndex].descriptorSet : dummySkin_.descriptorSet;
+				// bindless draws share one material set and pass the material index instead
+				drawable.descriptorSets_[0] = materialTable_.isValid() ? materialTable_.descriptorSet : mtl.descriptorSet;
+				drawable.descriptorSets_[1] = drawable.skinned_ ? skins_[node.skinIndex].descriptorSets[frameIndex_] : dummySkin_.descriptorSets[0];
 				drawable.pushConstant_.u_ModelMatrix = modelMatrix;
+				drawable.pushConstant_.u_MaterialIndex = primitive.materialIndex;
 
-				glm::mat4 mvp = camera.getViewProjectionMatrix() * modelMatrix;
 				glm::vec4 pos = mvp * glm::vec4(primitive.bbox.center(), 1.0f);
 				drawable.depth_ = pos[2];
 
@@ -568,160 +976,214 @@ void AnimatedModel::getDrawableQueueGroupByNode(DrawableQueueGroup& drwQueGrp, C
 			}
 		}
 	}
-	for (auto& child : node->children) {
-		getDrawableQueueGroupByNode(drwQueGrp, camera, child);
-	}
 }
 void AnimatedModel::getDrawableQueueGroup(DrawableQueueGroup& drwQueGrp, Camera1& camera)
 {
-	for (auto& node : nodes_) {
-		getDrawableQueueGroupByNode(drwQueGrp, camera, node);
+	cullingStats_ = CullingStats();
+
+	if (frustumCulling_) {
+		frustum_.update(camera.getViewProjectionMatrix());
+		updateSubtreeWorldBBox();
 	}
-}
 
-glm::mat4 AnimatedModelNode::getWorldMatrix() const
+	const int nodeCount = (int)nodes_.size();
+	for (int i = 0; i < nodeCount; ) {
+		// node-level: skip the whole subtree when its world bounds are outside the frustum
+		const AnimatedModelNode& node = nodes_[i];
+		if (frustumCulling_ && node.subtreeWorldBBox && !isBBoxInFrustum(frustum_, node.subtreeWorldBBox)) {
+			cullingStats_.culled += node.subtreePrimitiveCount;
+			i = transforms_.getSubtreeEnd(i);
+			continue;
+		}
+		getDrawableQueueGroupByNode(drwQueGrp, camera, i);
+		++i;
+	}
+}
+void AnimatedModel::updateSubtreeWorldBBox()
 {
-	glm::mat4 nodeMatrix = this->localMatrix;
-	AnimatedModelNode* currentParent = this->parent;
-	while (currentParent) {
-		nodeMatrix = currentParent->localMatrix * nodeMatrix;
-		currentParent = currentParent->parent;
+	// skinned meshes are deformed by joints, their static bounds are not reliable.
+	// an invalid bbox means "never cull"
+	const int nodeCount = (int)nodes_.size();
+	for (int i = 0; i < nodeCount; ++i) {
+		auto& node = nodes_[i];
+		if (node.subtreeSkinned) node.subtreeWorldBBox.reset();
+		else node.subtreeWorldBBox = node.bbox.transform(transforms_.getWorldMatrix(i));
+	}
+	// children follow their parent, so a reverse pass folds every subtree into its root
+	for (int i = nodeCount - 1; i >= 0; --i) {
+		int parent = transforms_.getParent(i);
+		if (parent >= 0 && !nodes_[parent].subtreeSkinned)
+			nodes_[parent].subtreeWorldBBox.merge(nodes_[i].subtreeWorldBBox);
 	}
-	return nodeMatrix;
 }
-BoundingBox AnimatedModelNode::getWorldBBox() const
+bool AnimatedModel::hasTransmission() const
 {
-	BoundingBox worldBBox = bbox.transform(getWorldMatrix());
-	for (auto child : children)
-		worldBBox.merge(child->getWorldBBox());
-	return worldBBox;
+	for (auto& node : nodes_) {
+		for (auto& primitive : node.mesh.primitives) {
+			if (primitive.indexCount > 0 && materials_[primitive.materialIndex].params.isFeatureEnabled(MTL_TEX_TRANSMISSION_BINDING))
+				return true;
+		}
+	}
+	return false;
 }
+std::vector<std::pair<MaterialVariant, bool>> AnimatedModel::getMaterialVariants() const
+{
+	std::vector<std::pair<MaterialVariant, bool>> variants;
+	for (auto& node : nodes_) {
+		for (auto& primitive : node.mesh.primitives) {
+			if (primitive.indexCount == 0) continue;
+			const bool skinned = primitive.skinned && node.skinIndex < (int)skins_.size();
+			variants.push_back(std::make_pair(materials_[primitive.materialIndex].getVariant(), skinned));
+		}
+	}
+	std::sort(variants.begin(), variants.end());
+	variants.erase(std::unique(variants.begin(), variants.end()), variants.end());
+	return variants;
+}
+
 BoundingBox AnimatedModel::getWorldBBox() const
 {
 	BoundingBox worldBBox;
-	for (auto node : nodes_) {
-		worldBBox.merge(node->getWorldBBox());
+	for (int i = 0; i < (int)nodes_.size(); ++i) {
+		worldBBox.merge(nodes_[i].bbox.transform(transforms_.getWorldMatrix(i)));
 	}
 	return worldBBox;
 }
 
-std::vector<VkVertexInputAttributeDescription> AnimatedModel::getVertexAttributesDesc() const
+std::vector<VkVertexInputBindingDescription> AnimatedModel::getVertexBindingsDesc(VertexLayout vertexLayout, bool skinned)
 {
-	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-		vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, pos)),				// Location 0: Position
-		vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, normal)),			// Location 1: Normal
-		vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(AnimatedModel::Vertex, color)),				// Location 2: Color
-		vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, uv)),				// Location 3: Texture coordinates
-		vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, uv1)),				// Location 4: Texture coordinates
-		vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedModel::Vertex, tangent)),		// Location 5: Tangent
-		vks::initializers::vertexInputAttributeDescription(0, 6, VK_FORMAT_R8G8B8A8_UINT, offsetof(AnimatedModel::Vertex, blendIndex)),		// Location 6: Blend Index
-		vks::initializers::vertexInputAttributeDescription(0, 7, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedModel::Vertex, blendWeight)),  // Location 7: Blend Weight
+	if (vertexLayout == kVertexLayout_Full) {
+		return { vks::initializers::vertexInputBindingDescription(0, sizeof(AnimatedModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX) };
+	}
+	return {
+		vks::initializers::vertexInputBindingDescription(kVertexStream_Position, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX),
+		vks::initializers::vertexInputBindingDescription(kVertexStream_Attribute, sizeof(AnimatedModel::CompactVertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		// the shader never reads the skin attributes of static primitives, every vertex fetches the same bytes
+		vks::initializers::vertexInputBindingDescription(kVertexStream_Skin, skinned ? sizeof(AnimatedModel::SkinVertex) : 0, VK_VERTEX_INPUT_RATE_VERTEX),
 	};
-	return vertexInputAttributes;
 }
-
-#define Eplison 1e-5
-static float clamp(float minv, float maxv, float v) { return std::max(minv, std::min(minv, v)); }
-static bool selectFrameByTime(const std::vector<float>& times, float curTime, int& frameIndex, float& fParam)
+std::vector<VkVertexInputAttributeDescription> AnimatedModel::getVertexAttributesDesc(VertexLayout vertexLayout)
 {
-	if (times.empty()) return false;
-
-	if (curTime <= times[0]) {
-		frameIndex = 0;
-		fParam = 0;
-		return true;
+	if (vertexLayout == kVertexLayout_Full) {
+		return {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, pos)),				// Location 0: Position
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AnimatedModel::Vertex, normal)),			// Location 1: Normal
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(AnimatedModel::Vertex, color)),				// Location 2: Color
+			vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32G32_SFLOAT, offsetof(AnimatedModel::Vertex, uv)),				// Location 3: Texture coordinates
+			vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32G32_SFLOAT, offsetof(AnimatedModel::Vertex, uv1)),				// Location 4: Texture coordinates
+			vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedModel::Vertex, tangent)),		// Location 5: Tangent
+			vks::initializers::vertexInputAttributeDescription(0, 6, VK_FORMAT_R8G8B8A8_UINT, offsetof(AnimatedModel::Vertex, blendIndex)),		// Location 6: Blend Index
+			vks::initializers::vertexInputAttributeDescription(0, 7, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(AnimatedModel::Vertex, blendWeight)),  // Location 7: Blend Weight
+		};
 	}
-	for (int idx = 1; idx < times.size(); ++idx) {
-		if (curTime < times[idx] && times[idx] - times[idx - 1] > Eplison) {
-			frameIndex = idx - 1;
-			fParam = (curTime - times[idx - 1]) / (times[idx] - times[idx - 1]);
-			return true;
-		}
+	return {
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Position, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),										// Location 0: Position
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Attribute, 1, VK_FORMAT_R16G16_SNORM, offsetof(AnimatedModel::CompactVertex, normal)),		// Location 1: Octahedral normal
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Attribute, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(AnimatedModel::CompactVertex, color)),		// Location 2: Color
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Attribute, 3, VK_FORMAT_R16G16_SFLOAT, offsetof(AnimatedModel::CompactVertex, uv)),		// Location 3: Texture coordinates
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Attribute, 4, VK_FORMAT_R16G16_SFLOAT, offsetof(AnimatedModel::CompactVertex, uv1)),		// Location 4: Texture coordinates
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Attribute, 5, VK_FORMAT_R16G16_SNORM, offsetof(AnimatedModel::CompactVertex, tangent)),	// Location 5: Octahedral tangent
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Skin, 6, VK_FORMAT_R8G8B8A8_UINT, offsetof(AnimatedModel::SkinVertex, blendIndex)),		// Location 6: Blend Index
+		vks::initializers::vertexInputAttributeDescription(kVertexStream_Skin, 7, VK_FORMAT_R16G16B16A16_UNORM, offsetof(AnimatedModel::SkinVertex, blendWeight)),	// Location 7: Blend Weight
+	};
+}
+std::vector<VkVertexInputBindingDescription> AnimatedModel::getPositionBindingsDesc(VertexLayout vertexLayout)
+{
+	const uint32_t stride = (vertexLayout == kVertexLayout_Full) ? sizeof(AnimatedModel::Vertex) : sizeof(glm::vec3);
+	return { vks::initializers::vertexInputBindingDescription(0, stride, VK_VERTEX_INPUT_RATE_VERTEX) };
+}
+std::vector<VkVertexInputAttributeDescription> AnimatedModel::getPositionAttributesDesc(VertexLayout vertexLayout)
+{
+	return { vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0) };// Location 0: Position
+}
+void AnimatedModel::bindVertexBuffers(VkCommandBuffer commandBuffer, bool skinned) const
+{
+	if (vertexLayout_ == kVertexLayout_Full) {
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 	}
-	frameIndex = times.size();
-	fParam = 0;
-	return true;
+	else {
+		// static pipelines read binding kVertexStream_Skin with a zero stride, any buffer of at least one SkinVertex will do
+		const VkBuffer skinBuffer = (skinned && skinAttributes.buffer) ? skinAttributes.buffer : vertices.buffer;
+		const VkBuffer buffers[kVertexStream_Count] = { vertices.buffer, attributes.buffer, skinBuffer };
+		const VkDeviceSize offsets[kVertexStream_Count] = { 0, 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, kVertexStream_Count, buffers, offsets);
+	}
+}
+void AnimatedModel::bindPositionBuffer(VkCommandBuffer commandBuffer) const
+{
+	VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+}
+void AnimatedModel::bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+	if (indexType == VK_INDEX_TYPE_UINT16) vkCmdBindIndexBuffer(commandBuffer, indices16.buffer, 0, VK_INDEX_TYPE_UINT16);
+	else vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 }
-void AnimatedModel::updateJoints(AnimatedModelNode* node)
+
+#define Eplison 1e-5
+void AnimatedModel::updateJoints()
 {
-	if (node->skinIndex > -1)
+	for (int nodeId = 0; nodeId < (int)nodes_.size(); ++nodeId)
 	{
-		glm::mat4 inverseTransform = glm::inverse(node->getWorldMatrix());
-		
-		Skin& skin = skins_[node->skinIndex];
-		std::vector<glm::mat4> jointMatrices(skin.jointNodeIndexs.size(), glm::mat4(1.0));
-		for (int i = 0; i < skin.jointNodeIndexs.size(); i++) {
-			int nodeIndex = skin.jointNodeIndexs[i];
-			if (nodeIndex > nodeByIndex_.size()) continue;
-
-			jointMatrices[i] = inverseTransform * nodeByIndex_[nodeIndex]->getWorldMatrix() * skin.inverseBindMatrices[i];
-		}
+		const AnimatedModelNode& node = nodes_[nodeId];
+		if (node.skinIndex < 0 || node.skinIndex >= skins_.size()) continue;
+
+		Skin& skin = skins_[node.skinIndex];
+		uint32_t jointCount = (uint32_t)std::min(skin.jointFlatIndexs.size(), skin.inverseBindMatrices.size());
+		vks::Buffer& ssbo = skin.ssbos[frameIndex_];
+		if (!ssbo.mapped || jointCount == 0) continue;
+
+		// a moved joint invalidates the palette of every frame in flight,
+		// each frame then only rebuilds its own copy
+		if (SkinningPalette::isChanged(nodeId, transforms_, skin.jointFlatIndexs.data(), jointCount))
+			skin.dirtyFrames = ~0u;
+		if (!(skin.dirtyFrames & (1u << frameIndex_)))
+			continue;
 
-		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		glm::mat4 inverseTransform = glm::inverse(transforms_.getWorldMatrix(nodeId));
+		SkinningPalette::build(inverseTransform, transforms_, skin.jointFlatIndexs.data(), skin.inverseBindMatrices.data(), jointCount, (glm::mat4*)ssbo.mapped);
 	}
-
-	for (auto& child : node->children) 
-	{
-		updateJoints(child);
+	for (auto& skin : skins_) {
+		skin.dirtyFrames &= ~(1u << frameIndex_);
 	}
 }
 void AnimatedModel::setAnimationTime(float currentTime)
+{
+	applyAnimation(currentTime);
+
+	// only animated nodes and their subtrees are recomputed, palettes of the
+	// other frames in flight may still be stale so this runs even without animation
+	transforms_.update();
+	updateJoints();
+}
+void AnimatedModel::applyAnimation(float currentTime)
 {
 	if (animationIndex_ >= animations_.size()) return;
 	auto& animation = animations_[animationIndex_];
 	if (animation.getDuration() <= Eplison) return;
 
 	currentTime = fmod(currentTime, animation.getDuration());
-	for (int i = 0; i < animation.getTrackCount(); ++i)
-	{
-		const AnimationTrack& track = animation.getTrackByIndex(i);
-		if (track.nodeIndex >= nodeByIndex_.size()) continue;
-		AnimatedModelNode* trackNode = nodeByIndex_[track.nodeIndex];
-
-		for (int i = 0; i < track.samplers.size(); ++i) 
-		{
-			const AnimationSampler& sample = track.samplers[i];
-			if (!sample) continue;
-
-			int frameIndex = 0;
-			float fParam = 0;
-			if (!selectFrameByTime(sample.times, currentTime, frameIndex, fParam))
-				continue;
-
-			switch ((EAnimationTargetPath)i)
-			{
-			case kATPath_Translation: {
-				if (frameIndex < sample.translation.size())
-					trackNode->position = (glm::mix(sample.translation[frameIndex], sample.translation[frameIndex + 1], fParam));
-				else
-					trackNode->position = (sample.translation.back());
-			}break;
-			case kATPath_Rotation: {
-				if (frameIndex < sample.rotation.size())
-					trackNode->rotation = (glm::slerp(sample.rotation[frameIndex], sample.rotation[frameIndex + 1], fParam));
-				else
-					trackNode->rotation = (sample.rotation.back());
-			}break;
-			case kATPath_Scale: {
-				if (frameIndex < sample.scale.size())
-					trackNode->scale = (glm::mix(sample.scale[frameIndex], sample.scale[frameIndex + 1], fParam));
-				else
-					trackNode->scale = (sample.scale.back());
-			}break;
-			case kATPath_Weight:
-			default:
-				break;
-			}
-		}
+	KeyframeSampler& sampler = keyframeSamplers_[animationIndex_];
+	sampler.evaluate(currentTime);
 
-		Transform transform(trackNode->position, trackNode->rotation, trackNode->scale);
-		trackNode->localMatrix = transform.getMatrix() * trackNode->matrix;
+	auto func_getNode = [&](int nodeIndex)->int {
+		return (nodeIndex >= 0 && nodeIndex < nodeByIndex_.size()) ? nodeByIndex_[nodeIndex] : -1;
+	};
+	const auto& translations = sampler.getTranslations();
+	for (size_t c = 0; c < translations.size(); ++c) {
+		int node = func_getNode(translations.targetNodes[c]);
+		if (node >= 0) transforms_.setTranslation(node, translations.results[c]);
 	}
-
-	for (auto& node : nodes_)
-	{
-		updateJoints(node);
+	const auto& rotations = sampler.getRotations();
+	for (size_t c = 0; c < rotations.size(); ++c) {
+		int node = func_getNode(rotations.targetNodes[c]);
+		if (node >= 0) transforms_.setRotation(node, rotations.results[c]);
+	}
+	const auto& scales = sampler.getScales();
+	for (size_t c = 0; c < scales.size(); ++c) {
+		int node = func_getNode(scales.targetNodes[c]);
+		if (node >= 0) transforms_.setScale(node, scales.results[c]);
 	}
 }
 
@@ -741,105 +1203,468 @@ std::vector<std::string> AnimatedModel::getAnimationNames() const
 	return vec;
 }
 
-bool AnimatedModel::load(tinygltf::Model& glTFInput, MaterialFactory& mtlFac, bool flipY)
+bool AnimatedModel::load(tinygltf::Model& glTFInput, MaterialFactory& mtlFac, bool flipY, ModelCacheWriter* cache)
 {
 	reset();
 
 	this->loadMaterials(glTFInput, mtlFac);
-	this->loadTextures(glTFInput);
+	this->loadTextures(glTFInput, cache);
+	if (mtlFac.isBindless()) mtlFac.createMaterialTable(materialTable_, materials_, images_);
 	std::vector<uint32_t> indexBuffer;
 	std::vector<AnimatedModel::Vertex> vertexBuffer;
 	const tinygltf::Scene& scene = glTFInput.scenes[0];
 	for (size_t i = 0; i < scene.nodes.size(); i++) {
 		const tinygltf::Node& node = glTFInput.nodes[scene.nodes[i]];
-		this->loadNode(node, scene.nodes[i], glTFInput, nullptr, indexBuffer, vertexBuffer,flipY);
+		this->loadNode(node, scene.nodes[i], glTFInput, -1, indexBuffer, vertexBuffer,flipY);
 	}
+	transforms_.update();
 	this->loadAnimations(glTFInput);
 	this->loadSkins(glTFInput);
+	uint32_t frameIndex = frameIndex_;
+	for (frameIndex_ = 0; frameIndex_ < frameCount_; ++frameIndex_)
+		this->updateJoints();
+	frameIndex_ = frameIndex;
+
+	if (vertexLayout_ == kVertexLayout_Compact)
+		moveSkinnedVerticesFirst(vertexBuffer, indexBuffer);
+	std::vector<uint16_t> indexBuffer16;
+	if (meshOptimization_) {
+		splitIndexBuffer(indexBuffer, indexBuffer16);
+
+		const auto& stats = meshOptimizationStats_;
+		std::cout << "Mesh optimization: " << stats.primitives << " primitives, " << stats.primitives16 << " with 16-bit indices, "
+			<< stats.verticesBefore << " -> " << stats.verticesAfter << " vertices, "
+			<< "ACMR " << stats.before.getACMR() << " -> " << stats.after.getACMR() << ", "
+			<< "ATVR " << stats.before.getATVR() << " -> " << stats.after.getATVR() << std::endl;
+	}
 
+	GeometryBlobs geometry;
+	std::vector<glm::vec3> positions;
+	std::vector<CompactVertex> compactVertices;
+	std::vector<SkinVertex> skinVertices;
+	if (vertexLayout_ == kVertexLayout_Full) {
+		geometry.streams[kVertexStream_Position] = { vertexBuffer.data(), vertexBuffer.size() * sizeof(Vertex) };
+	}
+	else {
+		packCompactVertexStreams(vertexBuffer, positions, compactVertices, skinVertices);
+		geometry.streams[kVertexStream_Position] = { positions.data(), positions.size() * sizeof(glm::vec3) };
+		geometry.streams[kVertexStream_Attribute] = { compactVertices.data(), compactVertices.size() * sizeof(CompactVertex) };
+		geometry.streams[kVertexStream_Skin] = { skinVertices.data(), skinVertices.size() * sizeof(SkinVertex) };
+	}
+	geometry.indices = { indexBuffer.data(), indexBuffer.size() * sizeof(uint32_t) };
+	geometry.indices16 = { indexBuffer16.data(), indexBuffer16.size() * sizeof(uint16_t) };
+	if (cache) saveToCache(*cache, geometry);
+	uploadVertexStreams(geometry);
+	return true;
+}
+
+void AnimatedModel::saveToCache(ModelCacheWriter& cache, const GeometryBlobs& geometry) const
+{
+	// textures were written by loadTextures already
+	cache.write((uint64_t)materials_.size());
+	for (const Material& mtl : materials_) {
+		cache.writeString(mtl.name);
+		cache.write(mtl.mtl_flags);
+		cache.write(mtl.params);
+		cache.write(mtl.textureIndexs);
+		cache.write((uint8_t)mtl.doubleSided);
+	}
+
+	cache.write((uint64_t)nodes_.size());
+	for (int i = 0; i < (int)nodes_.size(); ++i) {
+		const AnimatedModelNode& node = nodes_[i];
+		cache.write(transforms_.getParent(i));
+		cache.write(transforms_.getSubtreeEnd(i));
+		cache.write(transforms_.getTranslation(i));
+		cache.write(transforms_.getRotation(i));
+		cache.write(transforms_.getScale(i));
+		cache.write(transforms_.getBaseMatrix(i));
+		cache.write(node.nodeIndex);
+		cache.write(node.skinIndex);
+		cache.write(node.bbox);
+		cache.write(node.subtreePrimitiveCount);
+		cache.write((uint8_t)node.subtreeSkinned);
+		cache.writeVector(node.mesh.primitives);
+	}
+
+	cache.write((uint64_t)animations_.size());
+	for (const Animation& animation : animations_)
+		animation.save(cache);
+
+	cache.write((uint64_t)skins_.size());
+	for (const Skin& skin : skins_) {
+		cache.writeString(skin.name);
+		cache.write(skin.rootNodeIndex);
+		cache.writeVector(skin.inverseBindMatrices);
+		cache.writeVector(skin.jointNodeIndexs);
+	}
+
+	cache.write(skinnedVertexCount_);
+	cache.write(meshOptimizationStats_);
+	for (const ModelCacheBlob& stream : geometry.streams)
+		cache.writeBlob(stream.data, stream.size);
+	cache.writeBlob(geometry.indices.data, geometry.indices.size);
+	cache.writeBlob(geometry.indices16.data, geometry.indices16.size);
+}
+bool AnimatedModel::load(ModelCacheReader& cache, MaterialFactory& mtlFac)
+{
+	reset();
+
+	if (!loadTextures(cache)) return false;
+
+	uint64_t count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		Material mtl;
+		uint8_t doubleSided = 0;
+		cache.readString(mtl.name);
+		cache.read(mtl.mtl_flags);
+		cache.read(mtl.params);
+		cache.read(mtl.textureIndexs);
+		cache.read(doubleSided);
+		if (!cache.isGood()) return false;
+		mtl.doubleSided = doubleSided != 0;
+		materials_.push_back(mtlFac.createMaterial(mtl));
+	}
+	if (!cache.isGood()) return false;
+	if (mtlFac.isBindless()) mtlFac.createMaterialTable(materialTable_, materials_, images_);
+
+	// nodes were saved in depth-first order, a subtree ends once the node at its end is reached
+	count = 0;
+	cache.read(count);
+	std::vector<int> openSubtrees, subtreeEnds;
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		int parent = -1, subtreeEnd = 0;
+		glm::vec3 translation, scale;
+		glm::quat rotation;
+		glm::mat4 matrix;
+		cache.read(parent);
+		cache.read(subtreeEnd);
+		cache.read(translation);
+		cache.read(rotation);
+		cache.read(scale);
+		cache.read(matrix);
+		if (parent >= (int)i || subtreeEnd <= (int)i || subtreeEnd > (int)count) return false;
+
+		while (!openSubtrees.empty() && subtreeEnds[openSubtrees.back()] == (int)i) {
+			transforms_.endSubtree(openSubtrees.back());
+			openSubtrees.pop_back();
+		}
+		int flatIndex = transforms_.addNode(parent, translation, rotation, scale, matrix);
+		nodes_.emplace_back();
+		AnimatedModelNode& node = nodes_[flatIndex];
+		uint8_t subtreeSkinned = 0;
+		cache.read(node.nodeIndex);
+		cache.read(node.skinIndex);
+		cache.read(node.bbox);
+		cache.read(node.subtreePrimitiveCount);
+		cache.read(subtreeSkinned);
+		cache.readVector(node.mesh.primitives);
+		node.subtreeSkinned = subtreeSkinned != 0;
+		if (node.nodeIndex < 0 || node.nodeIndex >= (1 << 24)) return false;
+		if (node.nodeIndex >= nodeByIndex_.size()) nodeByIndex_.resize(node.nodeIndex + 1, -1);
+		nodeByIndex_[node.nodeIndex] = flatIndex;
+
+		subtreeEnds.push_back(subtreeEnd);
+		openSubtrees.push_back(flatIndex);
+	}
+	while (!openSubtrees.empty()) {
+		transforms_.endSubtree(openSubtrees.back());
+		openSubtrees.pop_back();
+	}
+	transforms_.update();
+
+	count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		animations_.emplace_back();
+		animations_.back().load(cache);
+	}
+	keyframeSamplers_.resize(animations_.size());
+	for (size_t i = 0; i < animations_.size(); ++i) {
+		keyframeSamplers_[i].build(animations_[i]);
+	}
+
+	count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		skins_.emplace_back();
+		Skin& skin = skins_.back();
+		cache.readString(skin.name);
+		cache.read(skin.rootNodeIndex);
+		cache.readVector(skin.inverseBindMatrices);
+		cache.readVector(skin.jointNodeIndexs);
+		if (skin.inverseBindMatrices.size() < std::max<size_t>(skin.jointNodeIndexs.size(), 1)) return false;
+	}
+
+	GeometryBlobs geometry;
+	cache.read(skinnedVertexCount_);
+	cache.read(meshOptimizationStats_);
+	for (ModelCacheBlob& stream : geometry.streams)
+		cache.readBlob(stream);
+	cache.readBlob(geometry.indices);
+	cache.readBlob(geometry.indices16);
+	if (!cache.isGood()) return false;
+
+	// the ranges of a damaged file would be drawn out of bounds, it is cooked again instead
+	const uint64_t vertexCount = geometry.streams[kVertexStream_Position].size / (vertexLayout_ == kVertexLayout_Compact ? sizeof(glm::vec3) : sizeof(Vertex));
+	const uint64_t indexCount = geometry.indices.size / sizeof(uint32_t), indexCount16 = geometry.indices16.size / sizeof(uint16_t);
+	for (const AnimatedModelNode& node : nodes_) {
+		if (node.skinIndex >= (int)skins_.size()) return false;
+		for (const Primitive& primitive : node.mesh.primitives) {
+			if (primitive.indexType != VK_INDEX_TYPE_UINT32 && primitive.indexType != VK_INDEX_TYPE_UINT16) return false;
+			const uint64_t indexEnd = (uint64_t)primitive.firstIndex + primitive.indexCount;
+			if (indexEnd > (primitive.indexType == VK_INDEX_TYPE_UINT16 ? indexCount16 : indexCount)) return false;
+			if ((uint64_t)primitive.vertexStart + primitive.vertexCount > vertexCount) return false;
+			if (primitive.materialIndex < 0 || primitive.materialIndex >= (int32_t)materials_.size()) return false;
+		}
+	}
+
+	createSkins();
+	uint32_t frameIndex = frameIndex_;
+	for (frameIndex_ = 0; frameIndex_ < frameCount_; ++frameIndex_)
+		this->updateJoints();
+	frameIndex_ = frameIndex;
+
+	uploadVertexStreams(geometry);
+	return true;
+}
+
+void AnimatedModel::optimizePrimitive(Primitive& primitive, std::vector<AnimatedModel::Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+	// the primitive's vertices are the last ones appended, so the vertex buffer can shrink from the back
+	if (primitive.indexCount < 3 || primitive.indexCount % 3 != 0) return;
+	if (primitive.vertexStart + primitive.vertexCount != vertexBuffer.size()) return;
+	uint32_t* indices = &indexBuffer[primitive.firstIndex];
+	const size_t indexCount = primitive.indexCount;
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (indices[i] < primitive.vertexStart || indices[i] >= primitive.vertexStart + primitive.vertexCount) return;
+	}
+	for (size_t i = 0; i < indexCount; ++i)
+		indices[i] -= primitive.vertexStart;
+
+	Vertex* vertices = &vertexBuffer[primitive.vertexStart];
+	size_t vertexCount = primitive.vertexCount;
+	auto& stats = meshOptimizationStats_;
+	stats.primitives++;
+	stats.verticesBefore += (uint32_t)vertexCount;
+	stats.before += MeshOptimizer::analyzeVertexCache(indices, indexCount, vertexCount);
+
+	// the padding of copied vertices is undefined, only their attributes are compared
+	static const std::vector<MeshOptimizer::VertexAttribute> weldAttributes = {
+		{ offsetof(Vertex, pos), sizeof(Vertex::pos) },
+		{ offsetof(Vertex, normal), sizeof(Vertex::normal) },
+		{ offsetof(Vertex, color), sizeof(Vertex::color) },
+		{ offsetof(Vertex, uv), sizeof(Vertex::uv) },
+		{ offsetof(Vertex, uv1), sizeof(Vertex::uv1) },
+		{ offsetof(Vertex, tangent), sizeof(Vertex::tangent) },
+		{ offsetof(Vertex, tangent_w), sizeof(Vertex::tangent_w) },
+		{ offsetof(Vertex, blendIndex), sizeof(Vertex::blendIndex) },
+		{ offsetof(Vertex, blendWeight), sizeof(Vertex::blendWeight) },
+	};
+	vertexCount = MeshOptimizer::weldVertices(indices, indexCount, vertices, vertexCount, sizeof(Vertex), weldAttributes);
+	MeshOptimizer::optimizeVertexCache(indices, indexCount, vertexCount);
+	MeshOptimizer::optimizeOverdraw(indices, indexCount, vertices, vertexCount, sizeof(Vertex));
+	vertexCount = MeshOptimizer::optimizeVertexFetch(indices, indexCount, vertices, vertexCount, sizeof(Vertex));
+
+	stats.verticesAfter += (uint32_t)vertexCount;
+	stats.after += MeshOptimizer::analyzeVertexCache(indices, indexCount, vertexCount);
+
+	for (size_t i = 0; i < indexCount; ++i)
+		indices[i] += primitive.vertexStart;
+	primitive.vertexCount = (uint32_t)vertexCount;
+	vertexBuffer.resize(primitive.vertexStart + vertexCount);
+}
+
+void AnimatedModel::splitIndexBuffer(std::vector<uint32_t>& indexBuffer, std::vector<uint16_t>& indexBuffer16)
+{
+	// primitives small enough index relative to their first vertex with 16 bits, drawn with it as vertex offset
+	std::vector<uint32_t> indexBuffer32;
+	indexBuffer32.reserve(indexBuffer.size());
+	indexBuffer16.reserve(indexBuffer.size());
+	for (auto& node : nodes_) {
+		for (auto& primitive : node.mesh.primitives) {
+			const uint32_t* indices = &indexBuffer[primitive.firstIndex];
+			bool fits16 = primitive.indexCount > 0 && primitive.vertexCount <= 65536;
+			for (uint32_t i = 0; fits16 && i < primitive.indexCount; ++i)
+				fits16 = indices[i] >= primitive.vertexStart && indices[i] - primitive.vertexStart < primitive.vertexCount;
+			if (fits16) {
+				primitive.indexType = VK_INDEX_TYPE_UINT16;
+				primitive.firstIndex = static_cast<uint32_t>(indexBuffer16.size());
+				for (uint32_t i = 0; i < primitive.indexCount; ++i)
+					indexBuffer16.push_back(static_cast<uint16_t>(indices[i] - primitive.vertexStart));
+				meshOptimizationStats_.primitives16++;
+			}
+			else {
+				primitive.indexType = VK_INDEX_TYPE_UINT32;
+				primitive.firstIndex = static_cast<uint32_t>(indexBuffer32.size());
+				indexBuffer32.insert(indexBuffer32.end(), indices, indices + primitive.indexCount);
+			}
+		}
+	}
+	indexBuffer.swap(indexBuffer32);
+}
+
+void AnimatedModel::moveSkinnedVerticesFirst(std::vector<AnimatedModel::Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+	// every primitive owns a contiguous vertex range that only its own indices refer to,
+	// so moving whole ranges keeps them contiguous and the skin stream ends after the last skinned one
+	std::vector<uint32_t> remap(vertexBuffer.size(), 0);
+	std::vector<AnimatedModel::Vertex> sorted;
+	sorted.reserve(vertexBuffer.size());
+	for (int skinned = 1; skinned >= 0; --skinned) {
+		for (auto& node : nodes_) {
+			for (auto& primitive : node.mesh.primitives) {
+				if (primitive.skinned != (skinned != 0)) continue;
+				uint32_t vertexStart = static_cast<uint32_t>(sorted.size());
+				for (uint32_t v = primitive.vertexStart; v < primitive.vertexStart + primitive.vertexCount; ++v) {
+					remap[v] = static_cast<uint32_t>(sorted.size());
+					sorted.push_back(vertexBuffer[v]);
+				}
+				primitive.vertexStart = vertexStart;
+			}
+		}
+		if (skinned) skinnedVertexCount_ = static_cast<uint32_t>(sorted.size());
+	}
+	for (auto& index : indexBuffer)
+		index = remap[index];
+	vertexBuffer.swap(sorted);
+}
+
+static glm::vec2 octEncode(glm::vec3 n)
+{
+	float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (!(sum > 0.0f)) return glm::vec2(0.0f);//degenerate normals decode to +z
+
+	n /= sum;
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
+static glm::uint32 packTangent(const glm::vec3& tangent, float tangent_w)
+{
+	// y is remapped to [0,1] and never quantizes to zero, its sign is left for the bitangent sign
+	glm::vec2 e = octEncode(tangent);
+	e.y = std::max(e.y * 0.5f + 0.5f, 1.0f / 32767.0f) * (tangent_w < 0.0f ? -1.0f : 1.0f);
+	return glm::packSnorm2x16(e);
+}
+void AnimatedModel::packCompactVertexStreams(const std::vector<AnimatedModel::Vertex>& vertexBuffer, 
+	std::vector<glm::vec3>& positions, std::vector<CompactVertex>& compactVertices, std::vector<SkinVertex>& skinVertices) const
+{
+	positions.resize(vertexBuffer.size());
+	compactVertices.resize(vertexBuffer.size());
+	skinVertices.resize(skinnedVertexCount_);
+	for (size_t v = 0; v < vertexBuffer.size(); ++v) {
+		const Vertex& vert = vertexBuffer[v];
+		positions[v] = vert.pos;
+
+		CompactVertex& compact = compactVertices[v];
+		compact.normal = glm::packSnorm2x16(octEncode(vert.normal));
+		compact.tangent = packTangent(vert.tangent, vert.tangent_w);
+		compact.uv = glm::packHalf2x16(vert.uv);
+		compact.uv1 = glm::packHalf2x16(vert.uv1);
+		compact.color = vert.color;
+		if (v < skinnedVertexCount_) {
+			skinVertices[v].blendIndex = vert.blendIndex;
+			skinVertices[v].blendWeight[0] = glm::packUnorm2x16(glm::vec2(vert.blendWeight.x, vert.blendWeight.y));
+			skinVertices[v].blendWeight[1] = glm::packUnorm2x16(glm::vec2(vert.blendWeight.z, vert.blendWeight.w));
+		}
+	}
+}
+void AnimatedModel::uploadVertexStreams(const GeometryBlobs& geometry)
+{
 	// Create and upload vertex and index buffer
-	// We will be using one single vertex buffer and one single index buffer for the whole glTF scene
+	// We will be using one single buffer per vertex stream and one single index buffer for the whole glTF scene
 	// Primitives (of the glTF model) will then index into these using index offsets
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(AnimatedModel::Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	this->indices.count = static_cast<uint32_t>(indexBuffer.size());
-
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
-
-	// Create host visible staging buffers (source)
-	VK_CHECK_RESULT(vulkanDevice_->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(vulkanDevice_->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
-
-	// Create device local buffers (target)
-	VK_CHECK_RESULT(vulkanDevice_->createBuffer(
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&this->vertices.buffer,
-		&this->vertices.memory));
-	VK_CHECK_RESULT(vulkanDevice_->createBuffer(
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
-		&this->indices.buffer,
-		&this->indices.memory));
+	struct StreamUpload {
+		const void* data;
+		VkDeviceSize size;
+		VkBufferUsageFlags usage;
+		VkBuffer* buffer;
+		vks::MemoryAllocation* allocation;
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+	};
+	std::vector<StreamUpload> uploads;
+	const ModelCacheBlob* streams = geometry.streams;
+	uploads.push_back({ streams[kVertexStream_Position].data, streams[kVertexStream_Position].size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertices.buffer, &vertices.allocation });
+	if (vertexLayout_ == kVertexLayout_Compact) {
+		uploads.push_back({ streams[kVertexStream_Attribute].data, streams[kVertexStream_Attribute].size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &attributes.buffer, &attributes.allocation });
+		uploads.push_back({ streams[kVertexStream_Skin].data, streams[kVertexStream_Skin].size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &skinAttributes.buffer, &skinAttributes.allocation });
+	}
+	uploads.push_back({ geometry.indices.data, geometry.indices.size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices.buffer, &indices.allocation });
+	uploads.push_back({ geometry.indices16.data, geometry.indices16.size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices16.buffer, &indices16.allocation });
+	this->indices.count = static_cast<uint32_t>(geometry.indices.size / sizeof(uint32_t));
+	this->indices16.count = static_cast<uint32_t>(geometry.indices16.size / sizeof(uint16_t));
+
+	if (uploader_) {
+		// copied through the upload ring, the buffers are read by the vertex input stage once the batch completes
+		for (auto& upload : uploads) {
+			if (upload.size == 0) continue;
+			VK_CHECK_RESULT(vulkanDevice_->createBuffer(
+				upload.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				upload.size,
+				upload.buffer,
+				upload.allocation));
+			const VkAccessFlags dstAccess = (upload.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) ? VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			uploader_->uploadBuffer(*upload.buffer, 0, upload.data, upload.size, dstAccess, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		}
+		uploadValue_ = uploader_->submit();
+		return;
+	}
+
+	// Create host visible staging buffers (source) and device local buffers (target)
+	for (auto& upload : uploads) {
+		if (upload.size == 0) continue;//a model without skinned primitives has no skin stream, one without 16-bit primitives no 16-bit indices
+		VK_CHECK_RESULT(vulkanDevice_->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			upload.size,
+			&upload.stagingBuffer,
+			&upload.stagingMemory,
+			const_cast<void*>(upload.data)));
+		VK_CHECK_RESULT(vulkanDevice_->createBuffer(
+			upload.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			upload.size,
+			upload.buffer,
+			upload.allocation));
+	}
 
 	// Copy data from staging buffers (host) do device local buffer (gpu)
-	VkCommandBuffer copyCmd = vulkanDevice_->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	VkBufferCopy copyRegion = {};
-
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(
-		copyCmd,
-		vertexStaging.buffer,
-		this->vertices.buffer,
-		1,
-		&copyRegion);
-
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(
-		copyCmd,
-		indexStaging.buffer,
-		this->indices.buffer,
-		1,
-		&copyRegion);
-
-	vulkanDevice_->flushCommandBuffer(copyCmd, queue_, true);
+	VkCommandBuffer copyCmd = vulkanDevice_->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, uploadCommandPool_, true);
+	for (auto& upload : uploads) {
+		if (upload.size == 0) continue;
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = upload.size;
+		vkCmdCopyBuffer(copyCmd, upload.stagingBuffer, *upload.buffer, 1, &copyRegion);
+	}
+	vulkanDevice_->flushCommandBuffer(copyCmd, queue_, uploadCommandPool_, true);
 
 	// Free staging resources
 	auto device = vulkanDevice_->logicalDevice;
-	vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-	vkFreeMemory(device, indexStaging.memory, nullptr);
-	return true;
+	for (auto& upload : uploads) {
+		if (upload.size == 0) continue;
+		vkDestroyBuffer(device, upload.stagingBuffer, nullptr);
+		vkFreeMemory(device, upload.stagingMemory, nullptr);
+	}
 }
 
 void AnimatedModel::uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams)
 {
-	for (auto& mtl : materials_) {
-		mtl.uploadDescriptorSet2Gpu(images_, writeParams);
+	if (materialTable_.isValid()) {
+		materialTable_.uploadDescriptorSet2Gpu(writeParams);
+	}
+	else {
+		for (auto& mtl : materials_)
+			mtl.uploadDescriptorSet2Gpu(images_, writeParams);
 	}
 	for (auto& skin : skins_) {
-		writeParams.push_back(vks::initializers::writeDescriptorSet(skin.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &skin.ssbo.descriptor));
+		for (size_t i = 0; i < skin.descriptorSets.size(); ++i)
+			writeParams.push_back(vks::initializers::writeDescriptorSet(skin.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &skin.ssbos[i].descriptor));
 	}
-	if (skins_.empty()) {
-		writeParams.push_back(vks::initializers::writeDescriptorSet(dummySkin_.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &dummySkin_.ssbo.descriptor));
+	{
+		writeParams.push_back(vks::initializers::writeDescriptorSet(dummySkin_.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &dummySkin_.ssbos[0].descriptor));
 	}
 }
\ No newline at end of file
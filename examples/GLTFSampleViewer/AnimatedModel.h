@@ -1,9 +1,16 @@
 #pragma once
 #include "gltfShaderStruct.h"
 #include "Transform.h"
+#include "TransformHierarchy.h"
 #include "BoundingBox.h"
 #include "Material.h"
 #include "Animation.h"
+#include "KeyframeSampler.h"
+#include "MeshOptimizer.h"
+#include "ModelCache.h"
+#include "UploadManager.h"
+#include "TextureCache.h"
+#include "frustum.hpp"
 
 enum DrawableType 
 {
@@ -12,6 +19,18 @@ enum DrawableType
 	kDrawble_Transparent,
 	kDrawble_Max
 };
+enum VertexLayout
+{
+	kVertexLayout_Full,//one interleaved stream of AnimatedModel::Vertex
+	kVertexLayout_Compact,//quantized position, attribute and skin streams, see AnimatedModel::CompactVertex
+};
+enum VertexStream
+{
+	kVertexStream_Position,
+	kVertexStream_Attribute,
+	kVertexStream_Skin,
+	kVertexStream_Count
+};
 struct Drawable
 {
 	DrawableType type_ = kDrawble_Opaque;
@@ -20,20 +39,32 @@ struct Drawable
 	PushConsts pushConstant_;
 	uint32_t firstIndex_ = 0;
 	uint32_t indexCount_ = 0;
+	int32_t vertexOffset_ = 0;//16-bit indices are relative to their primitive's first vertex
+	VkIndexType indexType_ = VK_INDEX_TYPE_UINT32;
+	bool skinned_ = false;//drawn with the USE_SKELETON pipeline and the skin stream
+	MaterialVariant variant_;//selects the pipeline when the viewer specializes them per material
 	std::array<VkDescriptorSet, 2> descriptorSets_;
 
 	bool isValid() const { return indexCount_; }
 	operator bool() const { return isValid(); }
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	// bindDescriptorSets may be false when descriptorSets_ are bound already, e.g. the bindless material set
+	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool bindDescriptorSets = true);
 };
 struct DrawableQueueGroup
 {
 	std::vector<Drawable> opaqueQueue_;
 	std::vector<Drawable> transmissionQueue_;
 	std::vector<Drawable> transparentQueue_;
+	// draw order of each queue, filled by the sorts below, see DrawSortKey
+	std::vector<uint32_t> opaqueOrder_;
+	std::vector<uint32_t> transmissionOrder_;
+	std::vector<uint32_t> transparentOrder_;
+	std::vector<uint64_t> sortKeys_;//scratch
 
 	void sortTransmissionQueueByDepth();
 	void sortTransparentQueueByDepth();
+	// by state for fewer binds and longer indirect draws, then front to back
+	void sortOpaqueQueueByState();
 };
 
 struct Primitive 
@@ -41,6 +72,10 @@ struct Primitive
 	uint32_t firstIndex;
 	uint32_t indexCount;
 	int32_t materialIndex;
+	uint32_t vertexStart = 0;
+	uint32_t vertexCount = 0;
+	bool skinned = false;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;//firstIndex points into the index buffer of this type
 	BoundingBox bbox;
 };
 struct Mesh 
@@ -51,24 +86,13 @@ struct Mesh
 struct AnimatedModelNode
 {
 	int nodeIndex = -1;
-	AnimatedModelNode* parent = nullptr;
-	std::vector<AnimatedModelNode*> children;
 	Mesh mesh;
 	int skinIndex = -1;
 
-	glm::vec3 position, scale;
-	glm::quat rotation;
-	glm::mat4 localMatrix, bindMatrix, matrix;
 	BoundingBox bbox;
-
-public:
-	~AnimatedModelNode() {
-		for (auto& child : children) {
-			delete child;
-		}
-	}
-	glm::mat4 getWorldMatrix() const;
-	BoundingBox getWorldBBox() const;
+	BoundingBox subtreeWorldBBox;//bbox of this node and all its children in world space, refreshed before culling
+	uint32_t subtreePrimitiveCount = 0;
+	bool subtreeSkinned = false;
 };
 
 struct Skin
@@ -77,30 +101,32 @@ struct Skin
 	int						rootNodeIndex = -1;
 	std::vector<glm::mat4>	inverseBindMatrices;
 	std::vector<int>		jointNodeIndexs;
-	vks::Buffer				ssbo;
-	VkDescriptorSet			descriptorSet = VK_NULL_HANDLE;
+	std::vector<int>		jointFlatIndexs;//index into AnimatedModel::nodes_, -1 if the joint was not loaded
+	uint32_t				dirtyFrames = ~0u;//bit per frame in flight whose palette is stale
+	std::vector<vks::Buffer>	ssbos;//one per frame in flight
+	std::vector<VkDescriptorSet>	descriptorSets;
 
-	void destroy() { ssbo.destroy(); }
+	void destroy() { for (auto& ssbo : ssbos) ssbo.destroy(); ssbos.clear(); descriptorSets.clear(); }
 
-	bool isValid() const { return descriptorSet != VK_NULL_HANDLE; }
+	bool isValid() const { return !descriptorSets.empty(); }
 	operator bool() const { return isValid(); }
 };
 
 struct VertexBuffer
 {
 	VkBuffer buffer = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	vks::MemoryAllocation allocation;//a range of a device local block
 
-	void destroy(VkDevice device);
+	void destroy(vks::VulkanDevice* device);
 };
 
 struct IndexBuffer
 {
 	int count = 0;
 	VkBuffer buffer = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	vks::MemoryAllocation allocation;//a range of a device local block
 
-	void destroy(VkDevice device);
+	void destroy(vks::VulkanDevice* device);
 };
 
 class Camera1;
@@ -111,6 +137,10 @@ public:
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
 	VkQueue queue_ = VK_NULL_HANDLE;
+	VkCommandPool uploadCommandPool_ = VK_NULL_HANDLE;//command pools are not thread safe, a loader thread brings its own
+	UploadManagerPtr uploader_;//without one, uploads are submitted and waited for right away
+	uint64_t uploadValue_ = 0;//completes the uploads of the last load
+	TextureCachePtr textureCache_;//a private one unless shared by setTextureCache
 
 	VkDescriptorSetLayout skeletonDSLayout = VK_NULL_HANDLE;
 
@@ -126,33 +156,115 @@ public:
 		uchar4 blendIndex;
 		glm::vec4 blendWeight;
 	};
-	VertexBuffer vertices;
+	// kVertexLayout_Compact: float position in its own stream for depth-only passes,
+	// the attribute stream below and a skin stream that only covers the vertices of skinned primitives
+	struct CompactVertex
+	{
+		glm::uint32 normal;//octahedral, snorm16x2
+		glm::uint32 tangent;//octahedral, snorm16x2, the sign of y is the bitangent sign
+		glm::uint32 uv;//half2
+		glm::uint32 uv1;//half2
+		glm::uint32 color;
+	};
+	struct SkinVertex
+	{
+		uchar4 blendIndex;
+		glm::uint32 blendWeight[2];//unorm16x4
+	};
+	VertexLayout vertexLayout_ = kVertexLayout_Full;
+	VertexBuffer vertices;//the interleaved vertices, or the position stream of the compact layout
+	VertexBuffer attributes, skinAttributes;//compact layout only
+	uint32_t skinnedVertexCount_ = 0;//skinned primitives come first in the compact layout
 	IndexBuffer indices;
+	IndexBuffer indices16;//primitives of at most 65536 vertices, only with mesh optimization
+
+	struct MeshOptimizationStats
+	{
+		VertexCacheStats before, after;
+		uint32_t verticesBefore = 0, verticesAfter = 0;
+		uint32_t primitives = 0, primitives16 = 0;
+	};
+	bool meshOptimization_ = false;
+	MeshOptimizationStats meshOptimizationStats_;
 
 	using Image = vks::Texture2D;
 
-	std::vector<Image> images_;
+	std::vector<Image> images_;//one per glTF texture, the images and samplers are shared through textureCache_
+	std::vector<TextureCache::ImagePtr> imageRefs_;
 	std::vector<Material> materials_;
-	std::vector<AnimatedModelNode*> nodes_, nodeByIndex_;
+	MaterialTable materialTable_;//bindless mode only
+	// nodes_ and transforms_ share the same depth-first order, nodeByIndex_ maps glTF node index to it
+	std::vector<AnimatedModelNode> nodes_;
+	std::vector<int> nodeByIndex_;
+	TransformHierarchy transforms_;
 	std::vector<Skin> skins_;
 	Skin dummySkin_;
 	std::vector<Animation> animations_;
+	std::vector<KeyframeSampler> keyframeSamplers_;//one per animation
 	int animationIndex_ = 0;
+	uint32_t frameCount_ = 1;
+	uint32_t frameIndex_ = 0;//frame in flight the skin palettes and drawables refer to
 
+	struct CullingStats
+	{
+		uint32_t visible = 0;
+		uint32_t culled = 0;
+	};
+	bool frustumCulling_ = true;
+	CullingStats cullingStats_;
+	vks::Frustum frustum_;
 public:
-	AnimatedModel(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue);
+	AnimatedModel(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue, uint32_t frameCount = 1);
 	~AnimatedModel();
 	void reset();
 	void destroy();
-	bool load(tinygltf::Model& gltfMdl, MaterialFactory& mtlFac, bool flipY = false);
+	// cooks the model into cache as well when one is given
+	bool load(tinygltf::Model& gltfMdl, MaterialFactory& mtlFac, bool flipY = false, ModelCacheWriter* cache = nullptr);
+	// a model cooked by load(), geometry and pre-mipped textures are copied from the mapping straight to staging memory
+	bool load(ModelCacheReader& cache, MaterialFactory& mtlFac);
+	void setUploadCommandPool(VkCommandPool commandPool) { uploadCommandPool_ = commandPool; }
+	// buffers and textures are staged through it and a load returns before they are resident, see getUploadValue
+	void setUploadManager(const UploadManagerPtr& uploader) { uploader_ = uploader; }
+	uint64_t getUploadValue() const { return uploadValue_; }
+	// images and samplers are shared with other models loaded through the same cache, takes effect with the next load
+	void setTextureCache(const TextureCachePtr& textureCache) { textureCache_ = textureCache; }
+	// takes effect with the next load
+	void setVertexLayout(VertexLayout vertexLayout) { vertexLayout_ = vertexLayout; }
+	VertexLayout getVertexLayout() const { return vertexLayout_; }
+	// welds and reorders every primitive for vertex cache, overdraw and fetch, takes effect with the next load
+	void setMeshOptimization(bool enable) { meshOptimization_ = enable; }
+	const MeshOptimizationStats& getMeshOptimizationStats() const { return meshOptimizationStats_; }
 	
 	// glTF loading functions
-	void loadTextures(tinygltf::Model& input);
+	void loadTextures(tinygltf::Model& input, ModelCacheWriter* cache = nullptr);
 	void loadMaterials(tinygltf::Model& input, MaterialFactory& mtlFac);
-	void loadNode(const tinygltf::Node& inputNode, int nodeIndex, const tinygltf::Model& input, AnimatedModelNode* parent, 
+	void loadNode(const tinygltf::Node& inputNode, int nodeIndex, const tinygltf::Model& input, int parent, 
 		std::vector<uint32_t>& indexBuffer, std::vector<AnimatedModel::Vertex>& vertexBuffer, bool flipY);
 	void loadAnimations(tinygltf::Model& input);
 	void loadSkins(tinygltf::Model& input);
+private:
+	// final GPU layout of the geometry, points into the packed vertices or into a mapped model cache
+	struct GeometryBlobs
+	{
+		ModelCacheBlob streams[kVertexStream_Count];
+		ModelCacheBlob indices, indices16;
+	};
+	struct PendingImage;
+	struct PendingTexture;
+	TextureCache* getTextureCache();
+	// a hit is waited for with the uploads of this load
+	bool findSharedImage(PendingImage& pending);
+	void bindTextures(const std::vector<PendingImage>& pendings, const std::vector<PendingTexture>& textures);
+	bool loadTextures(ModelCacheReader& cache);
+	void saveToCache(ModelCacheWriter& cache, const GeometryBlobs& geometry) const;
+	void createSkins();
+	void optimizePrimitive(Primitive& primitive, std::vector<AnimatedModel::Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
+	void moveSkinnedVerticesFirst(std::vector<AnimatedModel::Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
+	void splitIndexBuffer(std::vector<uint32_t>& indexBuffer, std::vector<uint16_t>& indexBuffer16);
+	void packCompactVertexStreams(const std::vector<AnimatedModel::Vertex>& vertexBuffer, 
+		std::vector<glm::vec3>& positions, std::vector<CompactVertex>& compactVertices, std::vector<SkinVertex>& skinVertices) const;
+	void uploadVertexStreams(const GeometryBlobs& geometry);
+public:
 
 	void uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams);
 public:
@@ -160,14 +272,29 @@ public:
 	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, AnimatedModelNode* node);
 	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 #endif
-	void getDrawableQueueGroupByNode(DrawableQueueGroup& drwQueGrp, Camera1& camera, AnimatedModelNode* node);
+	void getDrawableQueueGroupByNode(DrawableQueueGroup& drwQueGrp, Camera1& camera, int node);
 	void getDrawableQueueGroup(DrawableQueueGroup& drwQueGrp, Camera1& camera);
+	const CullingStats& getCullingStats() const { return cullingStats_; }
+	bool hasTransmission() const;
+	// every material variant a primitive is drawn with and whether that primitive is skinned, sorted and unique
+	std::vector<std::pair<MaterialVariant, bool>> getMaterialVariants() const;
 
-	std::vector<VkVertexInputAttributeDescription> getVertexAttributesDesc() const;
+	// static primitives read no skin stream, their pipeline fetches binding kVertexStream_Skin with a zero stride
+	static std::vector<VkVertexInputBindingDescription> getVertexBindingsDesc(VertexLayout vertexLayout, bool skinned);
+	static std::vector<VkVertexInputAttributeDescription> getVertexAttributesDesc(VertexLayout vertexLayout);
+	// location 0 only, for depth-only passes
+	static std::vector<VkVertexInputBindingDescription> getPositionBindingsDesc(VertexLayout vertexLayout);
+	static std::vector<VkVertexInputAttributeDescription> getPositionAttributesDesc(VertexLayout vertexLayout);
+	void bindVertexBuffers(VkCommandBuffer commandBuffer, bool skinned) const;
+	void bindPositionBuffer(VkCommandBuffer commandBuffer) const;
+	void bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
 	BoundingBox getWorldBBox() const;
-
+private:
+	void updateSubtreeWorldBBox();
+	void applyAnimation(float currentTime);
 public:
-	void updateJoints(AnimatedModelNode* node);
+	void setFrameIndex(uint32_t frameIndex) { frameIndex_ = frameIndex; }
+	void updateJoints();
 	void setAnimationTime(float currentTime);
 	void setAnimationIndex(int animationIndex);
 	int getAnimationIndex() const { return animationIndex_; }
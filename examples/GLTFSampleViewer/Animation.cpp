@@ -1,4 +1,5 @@
 #include "Animation.h"
+#include "ModelCache.h"
 
 void Animation::reset() 
 {
@@ -92,3 +93,42 @@ bool Animation::load(tinygltf::Model& input, tinygltf::Animation& iAnimation)
 	}
 	return true;
 }
+
+void Animation::save(ModelCacheWriter& cache) const
+{
+	cache.writeString(name_);
+	cache.write(duration_);
+	cache.write((uint64_t)tracks_.size());
+	for (const AnimationTrack& track : tracks_) {
+		cache.write(track.nodeIndex);
+		for (const AnimationSampler& sampler : track.samplers) {
+			cache.writeVector(sampler.times);
+			cache.writeVector(sampler.translation);
+			cache.writeVector(sampler.scale);
+			cache.writeVector(sampler.rotation);
+			cache.writeVector(sampler.weights);
+		}
+	}
+}
+bool Animation::load(ModelCacheReader& cache)
+{
+	reset();
+
+	cache.readString(name_);
+	cache.read(duration_);
+	uint64_t trackCount = 0;
+	cache.read(trackCount);
+	for (uint64_t i = 0; i < trackCount && cache.isGood(); ++i) {
+		tracks_.emplace_back();
+		AnimationTrack& track = tracks_.back();
+		cache.read(track.nodeIndex);
+		for (AnimationSampler& sampler : track.samplers) {
+			cache.readVector(sampler.times);
+			cache.readVector(sampler.translation);
+			cache.readVector(sampler.scale);
+			cache.readVector(sampler.rotation);
+			cache.readVector(sampler.weights);
+		}
+	}
+	return cache.isGood();
+}
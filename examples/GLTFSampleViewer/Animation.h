@@ -43,6 +43,8 @@ struct AnimationTrack
 	int nodeIndex = -1;
 	std::array<AnimationSampler, kATPath_Max> samplers;
 };
+class ModelCacheWriter;
+class ModelCacheReader;
 class Animation 
 {
 public:
@@ -51,6 +53,8 @@ public:
 
 	void reset();
 	bool load(tinygltf::Model& gltfMdl, tinygltf::Animation& gltfAni);
+	void save(ModelCacheWriter& cache) const;
+	bool load(ModelCacheReader& cache);
 	
 	float getDuration() const { return duration_; }
 	const std::string& getName() const { return name_; }
@@ -0,0 +1,304 @@
+#include "BlockCompressor.h"
+
+// Principal axis of the texel colors in the first channelCount channels, by power iteration on their covariance
+template<int channelCount> static void getPrincipalAxis(const uint8_t* texels, float mean[4], float axis[4])
+{
+	for (int c = 0; c < channelCount; ++c) mean[c] = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < channelCount; ++c) mean[c] += texels[i * 4 + c];
+	}
+	for (int c = 0; c < channelCount; ++c) mean[c] /= 16.0f;
+
+	float covariance[channelCount][channelCount] = {};
+	for (int i = 0; i < 16; ++i) {
+		float d[channelCount];
+		for (int c = 0; c < channelCount; ++c) d[c] = texels[i * 4 + c] - mean[c];
+		for (int r = 0; r < channelCount; ++r) {
+			for (int c = 0; c < channelCount; ++c) covariance[r][c] += d[r] * d[c];
+		}
+	}
+
+	for (int c = 0; c < channelCount; ++c) axis[c] = 1.0f;
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float next[channelCount] = {};
+		for (int r = 0; r < channelCount; ++r) {
+			for (int c = 0; c < channelCount; ++c) next[r] += covariance[r][c] * axis[c];
+		}
+		float length = 0.0f;
+		for (int c = 0; c < channelCount; ++c) length += next[c] * next[c];
+		// a flat block has no axis, any direction reaches its only color
+		if (length < 1e-12f) break;
+		length = 1.0f / sqrtf(length);
+		for (int c = 0; c < channelCount; ++c) axis[c] = next[c] * length;
+	}
+}
+template<int channelCount> static int getDistance(const uint8_t* texel, const int* color)
+{
+	int distance = 0;
+	for (int c = 0; c < channelCount; ++c) distance += (texel[c] - color[c]) * (texel[c] - color[c]);
+	return distance;
+}
+static int clampByte(float value)
+{
+	return std::max(0, std::min(255, (int)(value + 0.5f)));
+}
+
+/**
+ * BC1
+ */
+static uint16_t packRGB565(const int* color)
+{
+	const int r = (color[0] * 31 + 127) / 255, g = (color[1] * 63 + 127) / 255, b = (color[2] * 31 + 127) / 255;
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+static void unpackRGB565(uint16_t packed, int* color)
+{
+	const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+void BlockCompressor::encodeBC1(const uint8_t* texels, uint8_t* block)
+{
+	float mean[4], axis[4];
+	getPrincipalAxis<3>(texels, mean, axis);
+	float minProj = FLT_MAX, maxProj = -FLT_MAX;
+	for (int i = 0; i < 16; ++i) {
+		float proj = 0.0f;
+		for (int c = 0; c < 3; ++c) proj += (texels[i * 4 + c] - mean[c]) * axis[c];
+		minProj = std::min(minProj, proj);
+		maxProj = std::max(maxProj, proj);
+	}
+	// inset by 1/16 of the range, the extremes are rarely worth an endpoint of their own
+	const float inset = (maxProj - minProj) / 16.0f;
+	int endpoints[2][3];
+	for (int c = 0; c < 3; ++c) {
+		endpoints[0][c] = clampByte(mean[c] + axis[c] * (maxProj - inset));
+		endpoints[1][c] = clampByte(mean[c] + axis[c] * (minProj + inset));
+	}
+	uint16_t packed0 = packRGB565(endpoints[0]), packed1 = packRGB565(endpoints[1]);
+	// color0 > color1 selects the opaque 4 color mode
+	if (packed0 < packed1) std::swap(packed0, packed1);
+
+	uint32_t indices = 0;
+	if (packed0 != packed1) {
+		int palette[4][3];
+		unpackRGB565(packed0, palette[0]);
+		unpackRGB565(packed1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; ++i) {
+			uint32_t best = 0;
+			int bestDistance = INT_MAX;
+			for (uint32_t p = 0; p < 4; ++p) {
+				const int distance = getDistance<3>(texels + i * 4, palette[p]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+	block[0] = (uint8_t)packed0;
+	block[1] = (uint8_t)(packed0 >> 8);
+	block[2] = (uint8_t)packed1;
+	block[3] = (uint8_t)(packed1 >> 8);
+	for (int i = 0; i < 4; ++i) block[4 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+/**
+ * BC4
+ */
+void BlockCompressor::encodeBC4(const uint8_t* texels, uint8_t* block)
+{
+	int red0 = 0, red1 = 255;
+	for (int i = 0; i < 16; ++i) {
+		red0 = std::max(red0, (int)texels[i * 4]);
+		red1 = std::min(red1, (int)texels[i * 4]);
+	}
+	uint64_t indices = 0;
+	// red0 > red1 selects the 8 value mode, equal endpoints leave every index at red0
+	if (red0 != red1) {
+		int palette[8] = { red0, red1 };
+		for (int p = 2; p < 8; ++p) palette[p] = ((8 - p) * red0 + (p - 1) * red1 + 3) / 7;
+		for (int i = 0; i < 16; ++i) {
+			uint64_t best = 0;
+			int bestDistance = INT_MAX;
+			for (uint64_t p = 0; p < 8; ++p) {
+				const int distance = std::abs(texels[i * 4] - palette[p]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (i * 3);
+		}
+	}
+	block[0] = (uint8_t)red0;
+	block[1] = (uint8_t)red1;
+	for (int i = 0; i < 6; ++i) block[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+/**
+ * BC7
+ */
+static const int sBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Mode6Block
+{
+	int endpoints[2][4];//7 bit
+	int pbits[2];
+	uint8_t indices[16];
+	int error = INT_MAX;
+};
+// 7 bit endpoint and the p-bit that together come closest to the color
+static void quantizeBC7Endpoint(const float* color, int* endpoint, int& pbit)
+{
+	float bestError = FLT_MAX;
+	for (int p = 0; p < 2; ++p) {
+		int quantized[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c) {
+			quantized[c] = std::max(0, std::min(127, (int)((color[c] - p) * 0.5f + 0.5f)));
+			const float d = (float)((quantized[c] << 1) | p) - color[c];
+			error += d * d;
+		}
+		if (error < bestError) {
+			bestError = error;
+			pbit = p;
+			for (int c = 0; c < 4; ++c) endpoint[c] = quantized[c];
+		}
+	}
+}
+static void findBC7Indices(const uint8_t* texels, BC7Mode6Block& result)
+{
+	int palette[16][4];
+	for (int c = 0; c < 4; ++c) {
+		const int e0 = (result.endpoints[0][c] << 1) | result.pbits[0], e1 = (result.endpoints[1][c] << 1) | result.pbits[1];
+		for (int p = 0; p < 16; ++p) palette[p][c] = ((64 - sBC7Weights4[p]) * e0 + sBC7Weights4[p] * e1 + 32) >> 6;
+	}
+	result.error = 0;
+	for (int i = 0; i < 16; ++i) {
+		int bestDistance = INT_MAX;
+		for (int p = 0; p < 16; ++p) {
+			const int distance = getDistance<4>(texels + i * 4, palette[p]);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				result.indices[i] = (uint8_t)p;
+			}
+		}
+		result.error += bestDistance;
+	}
+}
+static void fitBC7Endpoints(const uint8_t* texels, const float* color0, const float* color1, BC7Mode6Block& result)
+{
+	quantizeBC7Endpoint(color0, result.endpoints[0], result.pbits[0]);
+	quantizeBC7Endpoint(color1, result.endpoints[1], result.pbits[1]);
+	findBC7Indices(texels, result);
+}
+void BlockCompressor::encodeBC7(const uint8_t* texels, uint8_t* block)
+{
+	float mean[4], axis[4];
+	getPrincipalAxis<4>(texels, mean, axis);
+	float minProj = FLT_MAX, maxProj = -FLT_MAX;
+	for (int i = 0; i < 16; ++i) {
+		float proj = 0.0f;
+		for (int c = 0; c < 4; ++c) proj += (texels[i * 4 + c] - mean[c]) * axis[c];
+		minProj = std::min(minProj, proj);
+		maxProj = std::max(maxProj, proj);
+	}
+	float color0[4], color1[4];
+	for (int c = 0; c < 4; ++c) {
+		color0[c] = std::max(0.0f, std::min(255.0f, mean[c] + axis[c] * minProj));
+		color1[c] = std::max(0.0f, std::min(255.0f, mean[c] + axis[c] * maxProj));
+	}
+	BC7Mode6Block best;
+	fitBC7Endpoints(texels, color0, color1, best);
+
+	// least squares endpoints for the chosen weights, kept while they lower the error
+	for (int iteration = 0; iteration < 2 && best.error > 0; ++iteration) {
+		float a = 0.0f, b = 0.0f, c = 0.0f, d0[4] = {}, d1[4] = {};
+		for (int i = 0; i < 16; ++i) {
+			const float w = sBC7Weights4[best.indices[i]] / 64.0f;
+			a += (1.0f - w) * (1.0f - w);
+			b += (1.0f - w) * w;
+			c += w * w;
+			for (int ch = 0; ch < 4; ++ch) {
+				d0[ch] += (1.0f - w) * texels[i * 4 + ch];
+				d1[ch] += w * texels[i * 4 + ch];
+			}
+		}
+		const float det = a * c - b * b;
+		if (fabsf(det) < 1e-6f) break;
+		for (int ch = 0; ch < 4; ++ch) {
+			color0[ch] = std::max(0.0f, std::min(255.0f, (c * d0[ch] - b * d1[ch]) / det));
+			color1[ch] = std::max(0.0f, std::min(255.0f, (a * d1[ch] - b * d0[ch]) / det));
+		}
+		BC7Mode6Block refined;
+		fitBC7Endpoints(texels, color0, color1, refined);
+		if (refined.error >= best.error) break;
+		best = refined;
+	}
+
+	// the anchor index is stored without its top bit
+	if (best.indices[0] & 8) {
+		for (int c = 0; c < 4; ++c) std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+		std::swap(best.pbits[0], best.pbits[1]);
+		for (int i = 0; i < 16; ++i) best.indices[i] = (uint8_t)(15 - best.indices[i]);
+	}
+
+	memset(block, 0, 16);
+	uint32_t bitPos = 0;
+	auto func_writeBits = [&](uint32_t value, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i, ++bitPos) {
+			if ((value >> i) & 1) block[bitPos >> 3] |= (uint8_t)(1 << (bitPos & 7));
+		}
+	};
+	func_writeBits(1 << 6, 7);//mode 6
+	for (int c = 0; c < 4; ++c) {
+		func_writeBits(best.endpoints[0][c], 7);
+		func_writeBits(best.endpoints[1][c], 7);
+	}
+	func_writeBits(best.pbits[0], 1);
+	func_writeBits(best.pbits[1], 1);
+	for (int i = 0; i < 16; ++i) func_writeBits(best.indices[i], i == 0 ? 3 : 4);
+}
+
+bool BlockCompressor::isSupported(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK: case VK_FORMAT_BC7_SRGB_BLOCK:
+		return true;
+	default: return false;
+	}
+}
+void BlockCompressor::compressRows(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount, uint8_t* dst)
+{
+	void (*func_encode)(const uint8_t*, uint8_t*) = nullptr;
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC1_RGB_SRGB_BLOCK: func_encode = encodeBC1; break;
+	case VK_FORMAT_BC4_UNORM_BLOCK: func_encode = encodeBC4; break;
+	case VK_FORMAT_BC7_UNORM_BLOCK: case VK_FORMAT_BC7_SRGB_BLOCK: func_encode = encodeBC7; break;
+	default: assert(false); return;
+	}
+	const uint32_t blockSize = vks::tools::formatBlockSize(format);
+	const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	uint8_t texels[16 * 4];
+	for (uint32_t by = firstRow; by < std::min(blocksY, firstRow + rowCount); ++by) {
+		for (uint32_t bx = 0; bx < blocksX; ++bx) {
+			for (uint32_t y = 0; y < 4; ++y) {
+				const uint32_t srcY = std::min(by * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x) {
+					const uint32_t srcX = std::min(bx * 4 + x, width - 1);
+					memcpy(texels + (y * 4 + x) * 4, rgba + ((size_t)srcY * width + srcX) * 4, 4);
+				}
+			}
+			func_encode(texels, dst + ((size_t)by * blocksX + bx) * blockSize);
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "gltfShaderStruct.h"
+
+// CPU encoders of the 4x4 block formats TextureCooker writes, texels are RGBA8 and a block reads 16 of them row by row.
+// Blocks are independent, compressRows encodes a band of block rows so one image can be spread over threads
+class BlockCompressor
+{
+public:
+	// opaque, endpoints on the principal axis of the block colors
+	static void encodeBC1(const uint8_t* texels, uint8_t* block);
+	// red channel only
+	static void encodeBC4(const uint8_t* texels, uint8_t* block);
+	// mode 6 only: one subset with RGBA endpoints, refined by a least squares fit to the chosen indices
+	static void encodeBC7(const uint8_t* texels, uint8_t* block);
+
+	static bool isSupported(VkFormat format);
+	// Encodes block rows [firstRow, firstRow + rowCount) of an image to dst, the start of the compressed image.
+	// Partial blocks at the right and bottom edge repeat the edge texels
+	static void compressRows(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t rowCount, uint8_t* dst);
+};
@@ -63,7 +63,7 @@ public:
 		}
 
 		// Define the 8 corners of the bounding box
-		std::vector<glm::vec3> corners = {
+		std::array<glm::vec3, 8> corners = { {
 			{min.x, min.y, min.z},
 			{max.x, min.y, min.z},
 			{min.x, max.y, min.z},
@@ -72,7 +72,7 @@ public:
 			{max.x, min.y, max.z},
 			{min.x, max.y, max.z},
 			{max.x, max.y, max.z}
-		};
+		} };
 
 		// Transform all corners and compute the new bounding box
 		BoundingBox transformedBBox;
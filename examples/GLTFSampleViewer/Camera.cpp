@@ -185,23 +185,24 @@ void Camera1::load(float aspect, glm::vec3 min, glm::vec3 max, tinygltf::Model&
 	cameraIndex_ = (cameraList_.size() > 1) ? 1 : 0;
 	
 }
-bool Camera1::createHardware(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout)
+bool Camera1::createHardware(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, const UniformRingPtr& uniformRing)
 {
 	vulkanDevice_ = vulkanDevice;
 	descriptorPool_ = descriptorPool;
+	uniformRing_ = uniformRing;
 
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
 	
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(params)));
-
-	uploadParams2Gpu();
-	return true;
+	// the frame slices are written by uploadParams2Gpu, every frame before drawing
+	updateParams();
+	return uniformRing_->allocateBlock(uniformBlock_, sizeof(params));
 }
 void Camera1::destroy()
 {
 	//vkSafeFreeDescriptorSets(vulkanDevice_->logicalDevice, descriptorPool_, 1, descriptorSet);
-	uniformBuffer.destroy();
+	if (uniformRing_) uniformRing_->freeBlock(uniformBlock_);
+	uniformRing_ = nullptr;
 }
 
 void Camera1::zoomBy(float value)
@@ -217,7 +218,7 @@ void Camera1::pan(float x, float y)
 	cameraList_[cameraIndex_].pan(x, y);
 }
 
-void Camera1::uploadParams2Gpu()
+void Camera1::updateParams()
 {
 	const auto& cam = cameraList_[cameraIndex_];
 	params.u_ProjectionMatrix = cam.matrices.perspective;
@@ -238,21 +239,24 @@ void Camera1::uploadParams2Gpu()
 	assert(std::abs(ndc_far.z - 1) < 1e-3);
 	assert(std::abs(camera_->getNearClip()) < std::abs(camera_->getFarClip()));
 #endif
-
-	VK_CHECK_RESULT(uniformBuffer.map());
-	memcpy(uniformBuffer.mapped, &params, sizeof(params));
-	uniformBuffer.unmap();
+}
+void Camera1::uploadParams2Gpu(uint32_t frameIndex)
+{
+	updateParams();
+	uniformRing_->upload(uniformBlock_, frameIndex, &params);
 }
 void Camera1::uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeDescriptorSet)
 {
-	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, CAMERA_BINDING, &uniformBuffer.descriptor));
+	uniformDescriptor_ = uniformRing_->getDescriptor(uniformBlock_);
+	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, CAMERA_BINDING, &uniformDescriptor_));
 }
 
 void Camera1::setCurrentIndex(int currentIndex)
 {
+	//uniform buffers pick the new camera up with the next frame
 	if (cameraIndex_ != currentIndex) {
 		cameraIndex_ = currentIndex;
-		uploadParams2Gpu();
+		updateParams();
 	}
 }
 std::vector<std::string> Camera1::getCameraNames() const
@@ -271,13 +275,14 @@ mat4 Camera1::getViewProjectionMatrix() const
 /**
  * CameraFactory
  */
-CameraFactory::CameraFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool)
+CameraFactory::CameraFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, const UniformRingPtr& uniformRing)
 {
 	vulkanDevice_ = vulkanDevice;
 	device_ = vulkanDevice->logicalDevice;
 	descriptorPool_ = descriptorPool;
+	uniformRing_ = uniformRing;
 
-	std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Camera(1, vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, CAMERA_BINDING));
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Camera(1, vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, CAMERA_BINDING));
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI_Params = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBinding_Camera.data(), setLayoutBinding_Camera.size());
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device_, &descriptorSetLayoutCI_Params, nullptr, &descriptorSetLayout));
 }
@@ -294,6 +299,6 @@ CameraPtr CameraFactory::creatCamera(float aspect, glm::vec3 min, glm::vec3 max,
 {
 	CameraPtr camera = std::make_shared<Camera1>();
 	camera->load(aspect, min, max, gltfMdl);
-	camera->createHardware(vulkanDevice_, descriptorPool_, descriptorSetLayout);
+	camera->createHardware(vulkanDevice_, descriptorPool_, descriptorSetLayout, uniformRing_);
 	return camera;
 }
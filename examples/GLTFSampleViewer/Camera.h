@@ -1,6 +1,7 @@
 #pragma once
 #include "camera.hpp"
 #include "GltfShaderStruct.h"
+#include "UniformRing.h"
 
 class CameraEx : public Camera
 {
@@ -42,16 +43,19 @@ class Camera1
 
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
+	UniformRingPtr uniformRing_;
+	UniformRing::Block uniformBlock_;
+	VkDescriptorBufferInfo uniformDescriptor_{};//referenced by the pending descriptor write
 public:
-	VkDescriptorSet descriptorSet;
-	vks::Buffer uniformBuffer;
+	// bound with the dynamic offset of the frame in flight, see UniformRing
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 	float Exposure = 1.0f;
 
 public:
 	Camera1();
 	~Camera1();
 	void load(float aspect, glm::vec3 min, glm::vec3 max, tinygltf::Model& gltfMdl);
-	bool createHardware(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout);
+	bool createHardware(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, const UniformRingPtr& uniformRing);
 	void destroy();
 
 	void setCurrentIndex(int currentIndex);
@@ -63,7 +67,8 @@ public:
 	void orbit(float x, float y);
 	void pan(float x, float y);
 
-	void uploadParams2Gpu();
+	void updateParams();
+	void uploadParams2Gpu(uint32_t frameIndex);
 	void uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams);
 };
 using CameraPtr = std::shared_ptr<Camera1>;
@@ -73,13 +78,14 @@ class CameraFactory
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDevice device_ = VK_NULL_HANDLE;
 	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
+	UniformRingPtr uniformRing_;
 
 	std::vector<CameraPtr> trackedCameras_;
 public:
 	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 
 public:
-	CameraFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool);
+	CameraFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, const UniformRingPtr& uniformRing);
 	~CameraFactory() { destroy(); }
 	void destroy();
 
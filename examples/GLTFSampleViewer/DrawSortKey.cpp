@@ -0,0 +1,73 @@
+#include "DrawSortKey.h"
+#include "AnimatedModel.h"
+#include <cstring>
+
+static uint64_t getStateBits(const Drawable& drawable)
+{
+	const uint64_t material = (uint64_t)std::max(0, drawable.pushConstant_.u_MaterialIndex) & ((1u << DrawSortKey::kMaterialBits) - 1);
+	const uint64_t indexType = drawable.indexType_ == VK_INDEX_TYPE_UINT16 ? 1 : 0;
+	const uint64_t skinned = drawable.skinned_ ? 1 : 0;
+	// the variant picks the pipeline of specialized materials, drawables of one variant stay together
+	const MaterialVariant& variant = drawable.variant_;
+	const uint64_t features = ((uint32_t)variant.features & MATERIAL_FEATURE_BITS) >> MATERIAL_TEXTURE_COUNT;
+	const uint64_t variantBits = (features << 3) | ((uint64_t)(variant.alphaMode & 3) << 1) | (variant.doubleSided ? 1 : 0);
+	return (skinned << (DrawSortKey::kVariantBits + DrawSortKey::kMaterialBits + 1))
+		| (variantBits << (DrawSortKey::kMaterialBits + 1))
+		| (indexType << DrawSortKey::kMaterialBits) | material;
+}
+uint64_t DrawSortKey::makeOpaque(const Drawable& drawable)
+{
+	// state first for fewer binds, nearer first within a state for early-z rejection
+	return (getStateBits(drawable) << kDepthBits) | quantizeDepth(drawable.depth_);
+}
+uint64_t DrawSortKey::makeBlended(const Drawable& drawable)
+{
+	// blending needs far to near, state only orders drawables at the same depth
+	const uint64_t farFirst = ~quantizeDepth(drawable.depth_) & ((1u << kDepthBits) - 1);
+	return (farFirst << (kVariantBits + kMaterialBits + 2)) | getStateBits(drawable);
+}
+uint32_t DrawSortKey::quantizeDepth(float depth)
+{
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	// negative floats order reversed, flipping all their bits and only the sign of the others makes them compare as unsigned
+	bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+	return bits >> (32 - kDepthBits);
+}
+
+void DrawSortKey::sort(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order)
+{
+	const uint32_t count = (uint32_t)keys.size();
+	order.resize(count);
+	for (uint32_t i = 0; i < count; ++i) order[i] = i;
+	if (count < 2) return;
+
+	// all eight byte histograms in one pass, bytes that are equal in every key are skipped
+	uint32_t histograms[8][256] = {};
+	for (uint64_t key : keys) {
+		for (int pass = 0; pass < 8; ++pass)
+			++histograms[pass][(key >> (pass * 8)) & 0xFF];
+	}
+
+	std::vector<uint32_t> scratch(count);
+	uint32_t* src = order.data();
+	uint32_t* dst = scratch.data();
+	for (int pass = 0; pass < 8; ++pass) {
+		uint32_t* histogram = histograms[pass];
+		const uint32_t firstByte = (keys[0] >> (pass * 8)) & 0xFF;
+		if (histogram[firstByte] == count) continue;
+
+		uint32_t offset = 0;
+		for (int digit = 0; digit < 256; ++digit) {
+			uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t index = src[i];
+			dst[histogram[(keys[index] >> (pass * 8)) & 0xFF]++] = index;
+		}
+		std::swap(src, dst);
+	}
+	if (src != order.data()) memcpy(order.data(), src, count * sizeof(uint32_t));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+struct Drawable;
+
+// Packed 64-bit draw order, most significant field first:
+//  opaque:  skinned | material variant | index type | material | front-to-back depth
+//  blended: back-to-front depth | skinned | material variant | index type | material
+// Queues are ordered by a stable LSD radix sort over (key, index) pairs, the drawables themselves are not moved
+class DrawSortKey
+{
+public:
+	static const int kDepthBits = 24;
+	static const int kMaterialBits = 20;
+	static const int kVariantBits = 12;//MATERIAL_FEATURE_BITS, alpha mode and double sided
+
+	static uint64_t makeOpaque(const Drawable& drawable);
+	static uint64_t makeBlended(const Drawable& drawable);
+	// order preserving mapping of a float to its top kDepthBits
+	static uint32_t quantizeDepth(float depth);
+
+	// order receives the indices of keys, ascending by key, equal keys keep their order
+	static void sort(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order);
+};
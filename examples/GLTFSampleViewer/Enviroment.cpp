@@ -1,15 +1,24 @@
 #include "Enviroment.h"
 #include "AnimatedModel.h"
 
-Enviroment::Enviroment(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue)
+void EnviromentImages::destroy()
+{
+	imageLambertEnv.destroy();
+	imageGGXEnv.destroy();
+	imageCharlieEnv.destroy();
+	imageGGXLut = nullptr;
+	imageCharlieLut = nullptr;
+	imageSheenELut = nullptr;
+}
+
+Enviroment::Enviroment(vks::VulkanDevice* vulkanDevice, const UniformRingPtr& uniformRing)
 {
 	vulkanDevice_ = vulkanDevice;
 	device_ = vulkanDevice_->logicalDevice;
-	descriptorPool_ = descriptorPool;
-	queue_ = queue;
+	uniformRing_ = uniformRing;
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Env;
-		setLayoutBinding_Env.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, ENVIROMENT_BINDING));
+		setLayoutBinding_Env.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, ENVIROMENT_BINDING));
 		for (int binding = ENVIROMENT_TEXTURE_FIRST_BINDING; binding <= ENVIROMENT_TEXTURE_LAST_BINDING; binding++) {
 			setLayoutBinding_Env.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, binding));
 		}
@@ -30,10 +39,7 @@ Enviroment::Enviroment(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descrip
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device_, &descriptorSetLayoutCI_Tex, nullptr, &descriptorSetLayout));
 	}
 
-	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet));
-
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(params)));
+	SAFE_ASSERT(uniformRing_->allocateBlock(uniformBlock_, sizeof(params)));
 }
 Enviroment::~Enviroment()
 {
@@ -42,45 +48,20 @@ Enviroment::~Enviroment()
 
 void Enviroment::destroy()
 {
-	//vkSafeFreeDescriptorSets(device_, descriptorPool_, 1, descriptorSet);
+	// the images and their sets belong to EnviromentCache
+	images_ = nullptr;
 	vkSafeDestroyDescriptorSetLayout(device_, descriptorSetLayout);
-	uniformBuffer.destroy();
+	if (uniformRing_) uniformRing_->freeBlock(uniformBlock_);
+	uniformRing_ = nullptr;
 
-	reset();
-}
-void Enviroment::reset()
-{
 	vkSafeDestroySampler(device_, transmissionTexture_.sampler);
 	vkSafeDestroyImageView(device_, transmissionTexture_.imageView);
-
-	imageGGXLut.destroy();
-	imageCharlieLut.destroy();
-	imageSheenELut.destroy();
-	imageLambertEnv.destroy();
-	imageGGXEnv.destroy();
-	imageCharlieEnv.destroy();
 }
 
-void Enviroment::load(EnviromentImagesPath imgs, const vks::FramebufferAttachment* transmissionFb)
+void Enviroment::setTransmissionFramebuffer(const vks::FramebufferAttachment* transmissionFb)
 {
-	reset();
-
-	vks::Texture2D::SamplerOption lutOpt;
-	lutOpt.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	lutOpt.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	lutOpt.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	lutOpt.anisotropyEnable = true;
-	vks::Texture2D::SamplerOption envOpt;
-	lutOpt.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	lutOpt.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	lutOpt.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	lutOpt.anisotropyEnable = true;
-	SAFE_ASSERT(imageGGXEnv.loadFromFile(imgs.ggxEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_));
-	SAFE_ASSERT(imageGGXLut.loadFromFile(imgs.ggxLutPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, lutOpt));
-	SAFE_ASSERT(imageLambertEnv.loadFromFile(imgs.lambertEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_));
-	SAFE_ASSERT(imageCharlieEnv.loadFromFile(imgs.charlieEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_));
-	SAFE_ASSERT(imageCharlieLut.loadFromFile(imgs.charlieLutPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, lutOpt));
-	SAFE_ASSERT(imageSheenELut.loadFromFile(imgs.sheenLutPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, lutOpt));
+	vkSafeDestroySampler(device_, transmissionTexture_.sampler);
+	vkSafeDestroyImageView(device_, transmissionTexture_.imageView);
 
 	if (transmissionFb)
 	{
@@ -123,34 +104,32 @@ void Enviroment::load(EnviromentImagesPath imgs, const vks::FramebufferAttachmen
 
 		transmissionTexture_.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	}
-
-	uploadParams2Gpu();
 }
 
-void Enviroment::uploadParams2Gpu()
+void Enviroment::uploadParams2Gpu(uint32_t frameIndex)
 {
 	params.u_EnvIntensity = envIntensity;
 	params.u_EnvRotation = glm::rotate(glm::mat4(1), glm::radians(environmentRotation * 1.0f), vec3(0,1,0));
-	params.u_MipCount = imageGGXEnv.mipLevels;
+	params.u_MipCount = images_ ? images_->imageGGXEnv.mipLevels : 1;
 	params.u_EnvBlurNormalized = environmentBlur ? 0.6 : 0;
 
-	VK_CHECK_RESULT(uniformBuffer.map());
-	memcpy(uniformBuffer.mapped, &params, sizeof(params));
-	uniformBuffer.unmap();
+	uniformRing_->upload(uniformBlock_, frameIndex, &params);
 }
-void Enviroment::uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeDescriptorSet)
+void Enviroment::uploadDescriptorSet2Gpu(EnviromentImages& images, std::vector<VkWriteDescriptorSet>& writeDescriptorSet)
 {
-	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ENVIROMENT_BINDING, &uniformBuffer.descriptor));
-	
+	const VkDescriptorSet descriptorSet = images.descriptorSet;
+	uniformDescriptor_ = uniformRing_->getDescriptor(uniformBlock_);
+	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ENVIROMENT_BINDING, &uniformDescriptor_));
+
 	auto func_pushDescriptorSet = [&](int binding, VkDescriptorImageInfo* imageInfo) {
 		writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, binding, imageInfo));
 	};
-	func_pushDescriptorSet(ENV_TEX_GGX_ENV_BIDING, &imageGGXEnv.descriptor);
-	func_pushDescriptorSet(ENV_TEX_GGX_LUT_BIDING, &imageGGXLut.descriptor);
-	func_pushDescriptorSet(ENV_TEX_LAMBERT_ENV_BIDING, &imageLambertEnv.descriptor);
-	func_pushDescriptorSet(ENV_TEX_CHARLIE_ENV_BIDING, &imageCharlieEnv.descriptor);
-	func_pushDescriptorSet(ENV_TEX_CHARLIE_LUT_BIDING, &imageCharlieLut.descriptor);
-	func_pushDescriptorSet(ENV_TEX_SHEEN_ELUT_BIDING, &imageSheenELut.descriptor);
+	func_pushDescriptorSet(ENV_TEX_GGX_ENV_BIDING, &images.imageGGXEnv.descriptor);
+	func_pushDescriptorSet(ENV_TEX_GGX_LUT_BIDING, &images.imageGGXLut->descriptor);
+	func_pushDescriptorSet(ENV_TEX_LAMBERT_ENV_BIDING, &images.imageLambertEnv.descriptor);
+	func_pushDescriptorSet(ENV_TEX_CHARLIE_ENV_BIDING, &images.imageCharlieEnv.descriptor);
+	func_pushDescriptorSet(ENV_TEX_CHARLIE_LUT_BIDING, &images.imageCharlieLut->descriptor);
+	func_pushDescriptorSet(ENV_TEX_SHEEN_ELUT_BIDING, &images.imageSheenELut->descriptor);
 	if (transmissionTexture_.sampler) func_pushDescriptorSet(ENV_TEX_TRANSMISSION_FRAMEBUFFER_BIDING, &transmissionTexture_);
 }
 
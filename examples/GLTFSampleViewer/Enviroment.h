@@ -1,6 +1,7 @@
 #pragma once
 #include "GltfShaderStruct.h"
 #include "VulkanFrameBuffer.hpp"
+#include "UniformRing.h"
 
 class AnimatedModel;
 struct EnviromentImagesPath 
@@ -12,12 +13,29 @@ struct EnviromentImagesPath
 	std::string charlieLutPath;
 	std::string sheenLutPath;
 };
+// The textures of one environment with a descriptor set of their own, kept resident by EnviromentCache
+struct EnviromentImages
+{
+	std::string name;
+	std::shared_ptr<vks::Texture2D> imageGGXLut, imageCharlieLut, imageSheenELut;//shared by the environments of a directory
+	vks::TextureCubeMap imageLambertEnv, imageGGXEnv, imageCharlieEnv;
+	VkDeviceSize size = 0;//of the cubemaps, what the cache budget counts
+	// bound with the dynamic offset of the frame in flight, see UniformRing. Rewritten only when no frame is in flight
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	~EnviromentImages() { destroy(); }
+	void destroy();
+};
+using EnviromentImagesPtr = std::shared_ptr<EnviromentImages>;
+
+// What the environments have in common: the set layout, the uniform block and the transmission framebuffer
 class Enviroment
 {
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDevice device_ = VK_NULL_HANDLE;
-	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
-	VkQueue queue_ = VK_NULL_HANDLE;
+	UniformRingPtr uniformRing_;
+	UniformRing::Block uniformBlock_;
+	VkDescriptorBufferInfo uniformDescriptor_{};//referenced by the pending descriptor write
 
 	EnviromentUniforms params{};
 public:
@@ -26,20 +44,21 @@ public:
 	bool environmentBlur = true;
 
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
-	vks::Buffer uniformBuffer;
-
-	vks::Texture2D imageGGXLut, imageCharlieLut, imageSheenELut;
-	vks::TextureCubeMap imageLambertEnv, imageGGXEnv, imageCharlieEnv;
 	VkDescriptorImageInfo transmissionTexture_ = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+private:
+	EnviromentImagesPtr images_;//drawn with
 public:
-	Enviroment(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkQueue queue);
+	Enviroment(vks::VulkanDevice* vulkanDevice, const UniformRingPtr& uniformRing);
 	~Enviroment();
-	void reset();
-	void load(EnviromentImagesPath imagePaths, const vks::FramebufferAttachment* transmissionFb = nullptr);
+	void setTransmissionFramebuffer(const vks::FramebufferAttachment* transmissionFb);
 	void destroy();
 
-	void uploadParams2Gpu();
-	void uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams);
+	// takes effect with the next frame recorded, the images have to stay alive until no frame in flight samples them
+	void setImages(const EnviromentImagesPtr& images) { images_ = images; }
+	const EnviromentImagesPtr& getImages() const { return images_; }
+	VkDescriptorSet getDescriptorSet() const { return images_ ? images_->descriptorSet : VK_NULL_HANDLE; }
+
+	void uploadParams2Gpu(uint32_t frameIndex);
+	void uploadDescriptorSet2Gpu(EnviromentImages& images, std::vector<VkWriteDescriptorSet>& writeParams);
 };
 using EnviromentPtr = std::shared_ptr<Enviroment>;
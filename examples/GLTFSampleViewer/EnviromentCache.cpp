@@ -0,0 +1,329 @@
+#include "EnviromentCache.h"
+
+EnviromentCache::EnviromentCache(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t frameCount, const EnviromentPtr& enviroment, const PathResolver& resolver, VkDeviceSize budget, uint32_t maxEntries)
+{
+	vulkanDevice_ = vulkanDevice;
+	device_ = vulkanDevice_->logicalDevice;
+	queue_ = queue;
+	frameCount_ = std::max(1u, frameCount);
+	enviroment_ = enviroment;
+	resolver_ = resolver;
+	budget_ = budget;
+	maxEntries_ = std::max(2u, maxEntries);
+	{
+		// the resident sets and the released ones the frames in flight may still sample, every one adopted meanwhile
+		// may have pushed out one resident before. At most two are adopted per frame, see beginFrame and load
+		const uint32_t maxSetCount = maxEntries_ + 2 * frameCount_ + 2;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxSetCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSetCount * ENVIROMENT_TEXTURE_COUNT),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
+		descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device_, &descriptorPoolInfo, nullptr, &descriptorPool_));
+	}
+	commandPool_ = vulkanDevice_->createCommandPool(vulkanDevice_->queueFamilyIndices.graphics);
+
+	worker_ = std::thread(&EnviromentCache::run, this);
+}
+EnviromentCache::~EnviromentCache()
+{
+	destroy();
+}
+void EnviromentCache::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	wakeup_.notify_one();
+	// an environment being loaded is finished first
+	if (worker_.joinable()) worker_.join();
+
+	if (enviroment_) enviroment_->setImages(nullptr);
+	enviroment_ = nullptr;
+	for (Entry& entry : entries_) releaseImages(entry.images);
+	entries_.clear();
+	for (Retired& it : retired_) releaseImages(it.images);
+	retired_.clear();
+	finished_.clear();
+	requestResult_ = nullptr;
+	residentBytes_ = 0;
+
+	if (commandPool_) {
+		vkDestroyCommandPool(device_, commandPool_, nullptr);
+		commandPool_ = VK_NULL_HANDLE;
+	}
+	if (descriptorPool_) {
+		vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
+		descriptorPool_ = VK_NULL_HANDLE;
+	}
+}
+
+bool EnviromentCache::select(const std::string& name)
+{
+	auto iter = std::find_if(entries_.begin(), entries_.end(), [&](const Entry& entry) { return entry.images->name == name; });
+	if (iter != entries_.end()) {
+		// a background selection still running is outdated, it is adopted like a prefetch once finished
+		requested_.clear();
+		hasRequestResult_ = false;
+		requestResult_ = nullptr;
+		++stats_.hits;
+		if (iter->prefetched) ++stats_.prefetchHits;
+		makeCurrent(iter);
+		return true;
+	}
+
+	requested_ = name;
+	hasRequestResult_ = false;
+	requestResult_ = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(), [&](const Job& job) { return job.name == name; }), jobs_.end());
+		Job job;
+		job.name = name;
+		jobs_.push_front(job);
+	}
+	wakeup_.notify_one();
+	return false;
+}
+bool EnviromentCache::pollRequest(EnviromentImagesPtr& images)
+{
+	if (!hasRequestResult_) return false;
+	images = requestResult_;
+	requestResult_ = nullptr;
+	hasRequestResult_ = false;
+	return true;
+}
+bool EnviromentCache::load(const std::string& name)
+{
+	if (select(name)) return true;
+	{
+		// the worker finishes the environment it is loading first, then this one
+		std::unique_lock<std::mutex> lock(mutex_);
+		finishedCond_.wait(lock, [&] {
+			return std::any_of(finished_.begin(), finished_.end(), [&](const Finished& finished) { return finished.job.name == name; });
+		});
+	}
+	adoptFinished(&name);
+	EnviromentImagesPtr images;
+	return pollRequest(images) && images;
+}
+void EnviromentCache::prefetch(const std::vector<std::string>& names)
+{
+	// nothing but the current environment fits
+	if (budget_ == 0) return;
+	prefetchNames_ = names;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(), [](const Job& job) { return job.prefetch; }), jobs_.end());
+		for (const std::string& name : names) {
+			if (known_.count(name)) continue;
+			Job job;
+			job.name = name;
+			job.prefetch = true;
+			jobs_.push_back(job);
+		}
+	}
+	wakeup_.notify_one();
+}
+
+void EnviromentCache::beginFrame()
+{
+	for (auto it = retired_.begin(); it != retired_.end();) {
+		if (--it->framesLeft == 0) {
+			releaseImages(it->images);
+			it = retired_.erase(it);
+		}
+		else ++it;
+	}
+	// one per frame, so no more sets are retired than the pool has room for
+	adoptFinished(nullptr);
+}
+void EnviromentCache::updateDescriptorSets()
+{
+	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
+	for (Entry& entry : entries_) enviroment_->uploadDescriptorSet2Gpu(*entry.images, writeDescriptorSet);
+	if (!writeDescriptorSet.empty()) vkUpdateDescriptorSets(device_, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+}
+
+bool EnviromentCache::adoptFinished(const std::string* name)
+{
+	Finished finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (finished_.empty()) return false;
+		// the selection goes before prefetches
+		const std::string& wanted = name ? *name : requested_;
+		auto iter = std::find_if(finished_.begin(), finished_.end(), [&](const Finished& it) { return it.job.name == wanted; });
+		if (iter == finished_.end()) {
+			if (name) return false;
+			iter = finished_.begin();
+		}
+		finished = *iter;
+		finished_.erase(iter);
+	}
+	adopt(finished);
+	return true;
+}
+void EnviromentCache::adopt(const Finished& finished)
+{
+	const bool requested = finished.job.name == requested_;
+	if (requested) requested_.clear();
+	if (!finished.images) {
+		std::cerr << "Environment \"" << finished.job.name << "\" could not be loaded\n";
+		if (requested) {
+			requestResult_ = nullptr;
+			hasRequestResult_ = true;
+		}
+		return;
+	}
+
+	// a prefetch goes behind the current environment, a selection in front of it
+	Entry entry;
+	entry.images = finished.images;
+	entry.prefetched = !requested;
+	auto iter = entries_.insert(requested || entries_.empty() ? entries_.begin() : std::next(entries_.begin()), entry);
+	residentBytes_ += entry.images->size;
+
+	// a selection pushes out prefetches too if it has to, a prefetch that does not fit otherwise is dropped
+	evict(entry.images, true);
+	if (requested && isOverBudget()) evict(entry.images, false);
+	if (!requested && isOverBudget()) {
+		entries_.erase(iter);
+		residentBytes_ -= entry.images->size;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			known_.erase(entry.images->name);
+		}
+		// never bound
+		EnviromentImagesPtr images = entry.images;
+		releaseImages(images);
+		return;
+	}
+
+	EnviromentImages& images = *entry.images;
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, &enviroment_->descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device_, &allocInfo, &images.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
+	enviroment_->uploadDescriptorSet2Gpu(images, writeDescriptorSet);
+	vkUpdateDescriptorSets(device_, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+
+	if (requested) {
+		++stats_.loads;
+		makeCurrent(iter);
+		requestResult_ = entry.images;
+		hasRequestResult_ = true;
+	}
+	else ++stats_.prefetches;
+}
+void EnviromentCache::makeCurrent(std::list<Entry>::iterator iter)
+{
+	iter->prefetched = false;
+	entries_.splice(entries_.begin(), entries_, iter);
+	enviroment_->setImages(entries_.front().images);
+	// the environment selected before may have been kept over the budget
+	if (isOverBudget()) evict(entries_.front().images, true);
+}
+void EnviromentCache::evict(const EnviromentImagesPtr& keep, bool keepPrefetches)
+{
+	// least recently selected first
+	auto iter = entries_.end();
+	while (isOverBudget() && iter != entries_.begin()) {
+		--iter;
+		const EnviromentImagesPtr& images = iter->images;
+		if (images == keep || images == enviroment_->getImages()) continue;
+		if (keepPrefetches && std::find(prefetchNames_.begin(), prefetchNames_.end(), images->name) != prefetchNames_.end()) continue;
+		residentBytes_ -= images->size;
+		++stats_.evictions;
+		retire(images);
+		iter = entries_.erase(iter);
+	}
+}
+void EnviromentCache::retire(const EnviromentImagesPtr& images)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		known_.erase(images->name);
+	}
+	// the frames in flight may still sample it
+	Retired retired;
+	retired.images = images;
+	retired.framesLeft = frameCount_;
+	retired_.push_back(retired);
+}
+void EnviromentCache::releaseImages(EnviromentImagesPtr& images)
+{
+	if (!images) return;
+	vkSafeFreeDescriptorSets(device_, descriptorPool_, 1, images->descriptorSet);
+	images->destroy();
+	images = nullptr;
+}
+
+std::shared_ptr<vks::Texture2D> EnviromentCache::loadLut(const std::string& path, const vks::Texture2D::SamplerOption& samplerOpt)
+{
+	// the environments of a directory, or baked with the same settings, share their LUTs
+	std::shared_ptr<vks::Texture2D> lut = luts_[path].lock();
+	if (lut) return lut;
+	vks::Texture2D texture;
+	if (!texture.loadFromFile(path, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, samplerOpt, commandPool_)) return nullptr;
+	lut = std::shared_ptr<vks::Texture2D>(new vks::Texture2D(texture), [](vks::Texture2D* lut) {
+		lut->destroy();
+		delete lut;
+	});
+	luts_[path] = lut;
+	return lut;
+}
+EnviromentImagesPtr EnviromentCache::loadImages(const std::string& name)
+{
+	EnviromentImagesPath imgs;
+	if (!resolver_(name, imgs)) return nullptr;
+
+	vks::Texture2D::SamplerOption lutOpt;
+	lutOpt.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	lutOpt.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	lutOpt.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+	lutOpt.anisotropyEnable = true;
+
+	EnviromentImagesPtr images = std::make_shared<EnviromentImages>();
+	images->name = name;
+	// each copy is submitted and waited for on its own, so the environment is resident once this returns
+	bool result = images->imageGGXEnv.loadFromFile(imgs.ggxEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool_)
+		&& images->imageLambertEnv.loadFromFile(imgs.lambertEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool_)
+		&& images->imageCharlieEnv.loadFromFile(imgs.charlieEnvPath, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice_, queue_, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool_);
+	if (result) {
+		images->imageGGXLut = loadLut(imgs.ggxLutPath, lutOpt);
+		images->imageCharlieLut = loadLut(imgs.charlieLutPath, lutOpt);
+		images->imageSheenELut = loadLut(imgs.sheenLutPath, lutOpt);
+		result = images->imageGGXLut && images->imageCharlieLut && images->imageSheenELut;
+	}
+	if (!result) {
+		images->destroy();
+		return nullptr;
+	}
+	images->size = images->imageGGXEnv.allocation.size + images->imageLambertEnv.allocation.size + images->imageCharlieEnv.allocation.size;
+	return images;
+}
+void EnviromentCache::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		wakeup_.wait(lock, [this] { return quit_ || !jobs_.empty(); });
+		if (quit_) break;
+
+		Job job = jobs_.front();
+		jobs_.pop_front();
+		if (known_.count(job.name)) continue;
+		lock.unlock();
+		EnviromentImagesPtr images = loadImages(job.name);
+		lock.lock();
+
+		if (images) known_.insert(job.name);
+		Finished finished;
+		finished.job = job;
+		finished.images = images;
+		finished_.push_back(finished);
+		finishedCond_.notify_all();
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "Enviroment.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+
+// Keeps the recently used environments resident, each with a descriptor set of its own, so switching back to one only
+// changes the set Enviroment binds. Environments are loaded on a worker thread with a command pool of its own, the render
+// thread keeps drawing the current one and adopts a finished one at a frame boundary. Besides the environment selected,
+// the worker prefetches the ones likely to be selected next. The cubemaps of the resident environments stay within a
+// budget, the least recently used go first and the current one never. A released environment lives on until no frame
+// in flight samples it. All but the worker's loading runs on the render thread
+class EnviromentCache
+{
+public:
+	// called on the worker only, so resolving may take a while, e.g. bake a panorama
+	using PathResolver = std::function<bool(const std::string& name, EnviromentImagesPath& paths)>;
+	struct Stats
+	{
+		uint32_t hits = 0;//selections of a resident environment
+		uint32_t prefetchHits = 0;//of those, the first selections of a prefetched one
+		uint32_t loads = 0;//selections that had to wait for the worker
+		uint32_t prefetches = 0;//adopted without being selected
+		uint32_t evictions = 0;
+	};
+private:
+	struct Job
+	{
+		std::string name;
+		bool prefetch = false;
+	};
+	struct Finished
+	{
+		Job job;
+		EnviromentImagesPtr images;//null if loading failed
+	};
+	struct Entry
+	{
+		EnviromentImagesPtr images;
+		bool prefetched = false;//not selected since
+	};
+	struct Retired
+	{
+		EnviromentImagesPtr images;
+		uint32_t framesLeft = 0;
+	};
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	VkDevice device_ = VK_NULL_HANDLE;
+	VkQueue queue_ = VK_NULL_HANDLE;
+	uint32_t frameCount_ = 1;
+	EnviromentPtr enviroment_;//its uniform block and transmission framebuffer are written into every set
+	PathResolver resolver_;
+	VkDeviceSize budget_ = 0;
+	uint32_t maxEntries_ = 2;
+	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;//a set per entry, freed with it
+
+	std::list<Entry> entries_;//most recently selected first
+	VkDeviceSize residentBytes_ = 0;
+	std::vector<Retired> retired_;
+	std::vector<std::string> prefetchNames_;//evicted only to make room for a selection
+	std::string requested_;//selected, not resident yet
+	bool hasRequestResult_ = false;
+	EnviromentImagesPtr requestResult_;
+	Stats stats_;
+
+	VkCommandPool commandPool_ = VK_NULL_HANDLE;//used by the worker only
+	std::unordered_map<std::string, std::weak_ptr<vks::Texture2D>> luts_;//by path, used by the worker only
+
+	std::thread worker_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_, finishedCond_;
+	bool quit_ = false;
+	std::deque<Job> jobs_;//the selection first, prefetches behind it
+	std::vector<Finished> finished_;
+	std::unordered_set<std::string> known_;//resident or finished, the worker skips them
+public:
+	// budget in bytes of cubemaps, maxEntries bounds the descriptor sets and is at least 2
+	EnviromentCache(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t frameCount, const EnviromentPtr& enviroment, const PathResolver& resolver, VkDeviceSize budget, uint32_t maxEntries = 8);
+	~EnviromentCache();
+	// joins the worker and destroys every environment, no frame may be in flight
+	void destroy();
+
+	// A resident environment is bound from the next frame on and true is returned. Any other is loaded in the background,
+	// the current one stays bound until pollRequest hands the new one out
+	bool select(const std::string& name);
+	// Returns true once per finished background selection, images is null if loading failed
+	bool pollRequest(EnviromentImagesPtr& images);
+	// Selects on the calling thread's behalf and waits for the worker, for when there is nothing to draw yet
+	bool load(const std::string& name);
+	// Replaces the prefetches still waiting, resident environments are skipped
+	void prefetch(const std::vector<std::string>& names);
+	bool isLoading() const { return !requested_.empty(); }
+
+	// after the frame's fence was waited for: releases environments no frame samples anymore and adopts a finished one
+	void beginFrame();
+	// rewrites the sets of all resident environments after the transmission framebuffer changed, no frame may be in flight
+	void updateDescriptorSets();
+
+	uint32_t getResidentCount() const { return (uint32_t)entries_.size(); }
+	VkDeviceSize getResidentBytes() const { return residentBytes_; }
+	VkDeviceSize getBudget() const { return budget_; }
+	const Stats& getStats() const { return stats_; }
+private:
+	EnviromentImagesPtr loadImages(const std::string& name);
+	std::shared_ptr<vks::Texture2D> loadLut(const std::string& path, const vks::Texture2D::SamplerOption& samplerOpt);
+	bool adoptFinished(const std::string* name);
+	void adopt(const Finished& finished);
+	void makeCurrent(std::list<Entry>::iterator iter);
+	void evict(const EnviromentImagesPtr& keep, bool keepPrefetches);
+	bool isOverBudget() const { return residentBytes_ > budget_ || entries_.size() > maxEntries_; }
+	void retire(const EnviromentImagesPtr& images);
+	void releaseImages(EnviromentImagesPtr& images);
+	void run();
+};
+using EnviromentCachePtr = std::shared_ptr<EnviromentCache>;
@@ -0,0 +1,80 @@
+#include "GltfImageDecoder.h"
+#include "KtxTranscoder.h"
+#include "threadpool.hpp"
+#include "stb_image.h"
+
+bool GltfImageDecoder::deferImageDecode(tinygltf::Image* image, const int imageIndex, std::string* err, std::string* warn,
+	int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData)
+{
+	if (!bytes || size <= 0) {
+		if (err) (*err) += "Empty image data for image[" + std::to_string(imageIndex) + "]\n";
+		return false;
+	}
+	// keep encoded, width/height are only known after decoding
+	image->as_is = true;
+	image->image.assign(bytes, bytes + size);
+	return true;
+}
+// stb_image keeps the failure reason per thread, so it is this image's as long as it is taken before the next load
+static bool decodeImage(tinygltf::Image& image, std::string& error)
+{
+	int w = 0, h = 0, comp = 0;
+	const int reqComp = 4;
+	unsigned char* data = stbi_load_from_memory(image.image.data(), (int)image.image.size(), &w, &h, &comp, reqComp);
+	if (!data) {
+		const char* reason = stbi_failure_reason();
+		error = reason ? reason : "unknown";
+		return false;
+	}
+
+	image.width = w;
+	image.height = h;
+	image.component = reqComp;
+	image.bits = 8;
+	image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+	image.image.assign(data, data + (size_t)w * h * reqComp);
+	image.as_is = false;
+	stbi_image_free(data);
+	return true;
+}
+bool GltfImageDecoder::decodeDeferredImages(tinygltf::Model& gltfMdl, uint32_t threadCount)
+{
+	std::vector<int> pendings;
+	for (int i = 0; i < (int)gltfMdl.images.size(); ++i) {
+		const tinygltf::Image& image = gltfMdl.images[i];
+		if (image.as_is && !image.image.empty() && !KtxTranscoder::isKtx2(image.image.data(), image.image.size()))
+			pendings.push_back(i);
+	}
+	if (pendings.empty()) return true;
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min<uint32_t>(threadCount, pendings.size());
+
+	// biggest images first, each goes to the least loaded thread
+	std::sort(pendings.begin(), pendings.end(), [&](int l, int r) {
+		return gltfMdl.images[l].image.size() > gltfMdl.images[r].image.size();
+	});
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threadCount);
+	std::vector<size_t> threadLoads(threadCount, 0);
+	std::vector<char> results(gltfMdl.images.size(), true);
+	std::vector<std::string> errors(gltfMdl.images.size());
+	for (int imageIndex : pendings) {
+		size_t thread = std::min_element(threadLoads.begin(), threadLoads.end()) - threadLoads.begin();
+		threadLoads[thread] += gltfMdl.images[imageIndex].image.size();
+		threadPool.threads[thread]->addJob([&gltfMdl, &results, &errors, imageIndex] {
+			results[imageIndex] = decodeImage(gltfMdl.images[imageIndex], errors[imageIndex]);
+		});
+	}
+	threadPool.wait();
+
+	bool result = true;
+	for (int imageIndex : pendings) {
+		if (!results[imageIndex]) {
+			std::cerr << "decode image[" << imageIndex << "] \"" << gltfMdl.images[imageIndex].name << "\" failed: " << errors[imageIndex] << std::endl;
+			gltfMdl.images[imageIndex].image.clear();
+			result = false;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "gltfShaderStruct.h"
+
+// Image decoding is moved out of the tinygltf parse:
+// deferImageDecode is installed with TinyGLTF::SetImageLoader and only keeps the encoded bytes (Image::as_is),
+// decodeDeferredImages then decodes all of them to RGBA8 on a thread pool.
+// KTX2 images (KHR_texture_basisu) stay encoded, AnimatedModel transcodes them for the device
+class GltfImageDecoder
+{
+public:
+	static bool deferImageDecode(tinygltf::Image* image, const int imageIndex, std::string* err, std::string* warn,
+		int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData);
+
+	// threadCount 0 uses one thread per hardware core
+	static bool decodeDeferredImages(tinygltf::Model& gltfMdl, uint32_t threadCount = 0);
+};
@@ -106,6 +106,19 @@ public:
 		}
 	}
 
+	// true if the min filter samples between mip levels
+	static bool isMipmapFilter(int glFilter) {
+		switch (glFilter) {
+		case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST:
+		case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST:
+		case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR:
+		case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR:
+			return true;
+		default:
+			return false;
+		}
+	}
+
 	static bool convertSamplerWrap(int glWrap, VkSamplerAddressMode& vulkanWrap) {
 		switch (glWrap) {
 		case TINYGLTF_TEXTURE_WRAP_REPEAT: // Ӧ GL_REPEAT
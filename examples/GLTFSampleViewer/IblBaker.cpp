@@ -0,0 +1,930 @@
+#include "IblBaker.h"
+#include "Enviroment.h"
+#include "ModelCache.h"
+#include "stb_image.h"
+#include <ktx.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IBL_BAKER_SSE
+#include <emmintrin.h>
+#endif
+
+// rows filtered by one job
+static const uint32_t sBandRows = 8;
+// panorama samples per axis and texel of the source cubemap
+static const uint32_t sSourceSubsamples = 4;
+static const float sPi = 3.14159265358979f;
+
+struct IblBaker::Panorama
+{
+	uint32_t width = 0, height = 0;
+	std::vector<glm::vec4> texels;
+};
+struct IblBaker::Surface
+{
+	uint32_t size = 0;
+	uint32_t faceCount = 0;
+	std::vector<glm::vec4> texels;
+	void create(uint32_t size, uint32_t faceCount)
+	{
+		this->size = size;
+		this->faceCount = faceCount;
+		texels.assign((size_t)size * size * faceCount, glm::vec4(0.0f));
+	}
+	glm::vec4* getFace(uint32_t face) { return texels.data() + (size_t)face * size * size; }
+	const glm::vec4* getFace(uint32_t face) const { return texels.data() + (size_t)face * size * size; }
+};
+// a direction in the frame of the normal of the filtered texel, the source level it reads and its weight
+struct IblBaker::FilterSample
+{
+	glm::vec3 direction;
+	float lod;
+	float weight;
+};
+
+IblBaker::IblBaker(const Settings& settings, uint32_t threadCount)
+{
+	settings_ = settings;
+	threadCount_ = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadPool_.setThreadCount(threadCount_);
+}
+IblBaker::~IblBaker()
+{
+	destroy();
+}
+void IblBaker::destroy()
+{
+	computeFilter_ = nullptr;
+}
+
+bool IblBaker::isPanorama(const std::string& filename)
+{
+	std::string extension = vks::tools::getFileNameExtension(filename);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == "hdr" || extension == "exr";
+}
+static std::string makeName(uint64_t hash)
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return name;
+}
+void IblBaker::getBakedPaths(const std::string& cacheDir, uint64_t panoramaHash, const Settings& settings, EnviromentImagesPath& paths)
+{
+	const uint32_t envKey[5] = { kBakerVersion, settings.specularSize, settings.lambertianSize, settings.specularSamples, settings.lambertianSamples };
+	const uint32_t lutKey[3] = { kBakerVersion, settings.lutSize, settings.lutSamples };
+	const std::string envName = cacheDir + "/" + makeName(ModelCache::hashBytes(panoramaHash, envKey, sizeof(envKey)));
+	const std::string lutName = cacheDir + "/" + makeName(ModelCache::hashBytes(ModelCache::kHashSeed, lutKey, sizeof(lutKey)));
+	paths.lambertEnvPath = envName + "_diffuse.ktx2";
+	paths.ggxEnvPath = envName + "_specular.ktx2";
+	paths.charlieEnvPath = envName + "_sheen.ktx2";
+	// the LUTs only depend on the settings, all panoramas share them
+	paths.ggxLutPath = lutName + "_lut_ggx.ktx2";
+	paths.charlieLutPath = lutName + "_lut_charlie.ktx2";
+	paths.sheenLutPath = lutName + "_lut_sheen_E.ktx2";
+}
+
+static bool readFile(const std::string& filename, std::vector<unsigned char>& bytes)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+	bool result = fseek(file, 0, SEEK_END) == 0;
+	const long size = result ? ftell(file) : -1;
+	result = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (result) {
+		bytes.resize((size_t)size);
+		result = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	}
+	fclose(file);
+	return result;
+}
+static bool fileExists(const std::string& filename)
+{
+	struct stat st;
+	return stat(filename.c_str(), &st) == 0;
+}
+static uint32_t getLevelCount(uint32_t size)
+{
+	uint32_t count = 1;
+	while (size >> count) ++count;
+	return count;
+}
+
+// Cubemap directions, faces +X -X +Y -Y +Z -Z with s and t in [-1, 1] as Vulkan samples them
+static glm::vec3 getFaceDirection(uint32_t face, float s, float t)
+{
+	switch (face) {
+	case 0: return glm::vec3(1.0f, -t, -s);
+	case 1: return glm::vec3(-1.0f, -t, s);
+	case 2: return glm::vec3(s, 1.0f, t);
+	case 3: return glm::vec3(s, -1.0f, -t);
+	case 4: return glm::vec3(s, -t, 1.0f);
+	default: return glm::vec3(-s, -t, -1.0f);
+	}
+}
+static glm::vec3 getTexelDirection(uint32_t face, float x, float y, uint32_t size)
+{
+	return glm::normalize(getFaceDirection(face, 2.0f * x / size - 1.0f, 2.0f * y / size - 1.0f));
+}
+// bilinear within a face, clamped at its edges
+static glm::vec4 sampleSurface(const IblBaker::Surface& surface, const glm::vec3& dir)
+{
+	const glm::vec3 a = glm::abs(dir);
+	uint32_t face;
+	float ma, sc, tc;
+	if (a.x >= a.y && a.x >= a.z) {
+		face = dir.x > 0.0f ? 0 : 1;
+		ma = a.x; sc = dir.x > 0.0f ? -dir.z : dir.z; tc = -dir.y;
+	}
+	else if (a.y >= a.z) {
+		face = dir.y > 0.0f ? 2 : 3;
+		ma = a.y; sc = dir.x; tc = dir.y > 0.0f ? dir.z : -dir.z;
+	}
+	else {
+		face = dir.z > 0.0f ? 4 : 5;
+		ma = a.z; sc = dir.z > 0.0f ? dir.x : -dir.x; tc = -dir.y;
+	}
+	const float size = (float)surface.size;
+	const float x = glm::clamp(0.5f * (sc / ma + 1.0f) * size - 0.5f, 0.0f, size - 1.0f);
+	const float y = glm::clamp(0.5f * (tc / ma + 1.0f) * size - 0.5f, 0.0f, size - 1.0f);
+	const uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+	const uint32_t x1 = std::min(x0 + 1, surface.size - 1), y1 = std::min(y0 + 1, surface.size - 1);
+	const glm::vec4* texels = surface.getFace(face);
+	const glm::vec4 top = glm::mix(texels[y0 * surface.size + x0], texels[y0 * surface.size + x1], x - x0);
+	const glm::vec4 bottom = glm::mix(texels[y1 * surface.size + x0], texels[y1 * surface.size + x1], x - x0);
+	return glm::mix(top, bottom, y - y0);
+}
+static glm::vec4 sampleCubeMap(const std::vector<IblBaker::Surface>& cubeMap, const glm::vec3& dir, float lod)
+{
+	lod = glm::clamp(lod, 0.0f, (float)(cubeMap.size() - 1));
+	const uint32_t level0 = (uint32_t)lod;
+	const uint32_t level1 = std::min(level0 + 1, (uint32_t)cubeMap.size() - 1);
+	const glm::vec4 color = sampleSurface(cubeMap[level0], dir);
+	if (level1 == level0 || lod == (float)level0) return color;
+	return glm::mix(color, sampleSurface(cubeMap[level1], dir), lod - level0);
+}
+// bilinear, wrapping around horizontally
+static glm::vec4 samplePanorama(const IblBaker::Panorama& panorama, const glm::vec3& dir)
+{
+	const float u = 0.5f + std::atan2(dir.z, dir.x) / (2.0f * sPi);
+	const float v = std::acos(glm::clamp(dir.y, -1.0f, 1.0f)) / sPi;
+	const float x = u * panorama.width - 0.5f;
+	const float y = glm::clamp(v * panorama.height - 0.5f, 0.0f, (float)(panorama.height - 1));
+	const float xFloor = std::floor(x);
+	const uint32_t x0 = ((int)xFloor % (int)panorama.width + panorama.width) % panorama.width;
+	const uint32_t x1 = (x0 + 1) % panorama.width;
+	const uint32_t y0 = (uint32_t)y, y1 = std::min(y0 + 1, panorama.height - 1);
+	const glm::vec4* texels = panorama.texels.data();
+	const glm::vec4 top = glm::mix(texels[y0 * panorama.width + x0], texels[y0 * panorama.width + x1], x - xFloor);
+	const glm::vec4 bottom = glm::mix(texels[y1 * panorama.width + x0], texels[y1 * panorama.width + x1], x - xFloor);
+	return glm::mix(top, bottom, y - y0);
+}
+
+// Sampling, after Karis, Real Shading in Unreal Engine 4, and the Khronos glTF IBL Sampler
+static glm::vec2 hammersley(uint32_t i, uint32_t count)
+{
+	uint32_t bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return glm::vec2((float)i / count, bits * 2.3283064365386963e-10f);
+}
+static glm::vec3 sphericalDirection(float cosTheta, float phi)
+{
+	const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+static float D_GGX(float NdotH, float alpha)
+{
+	const float alphaSq = alpha * alpha;
+	const float f = NdotH * NdotH * (alphaSq - 1.0f) + 1.0f;
+	return alphaSq / (sPi * f * f);
+}
+static float V_GGX(float NdotL, float NdotV, float alpha)
+{
+	const float alphaSq = alpha * alpha;
+	const float GGXV = NdotL * std::sqrt(NdotV * NdotV * (1.0f - alphaSq) + alphaSq);
+	const float GGXL = NdotV * std::sqrt(NdotL * NdotL * (1.0f - alphaSq) + alphaSq);
+	return GGXV + GGXL > 0.0f ? 0.5f / (GGXV + GGXL) : 0.0f;
+}
+// the sheen terms of gltf_fragment.glsl, Estevez and Kulla
+static float D_Charlie(float sheenRoughness, float NdotH)
+{
+	sheenRoughness = std::max(sheenRoughness, 0.000001f);
+	const float invR = 1.0f / (sheenRoughness * sheenRoughness);
+	const float sin2h = 1.0f - NdotH * NdotH;
+	return (2.0f + invR) * std::pow(sin2h, invR * 0.5f) / (2.0f * sPi);
+}
+static float lambdaSheenNumericHelper(float x, float alphaG)
+{
+	const float oneMinusAlphaSq = (1.0f - alphaG) * (1.0f - alphaG);
+	const float a = glm::mix(21.5473f, 25.3245f, oneMinusAlphaSq);
+	const float b = glm::mix(3.82987f, 3.32435f, oneMinusAlphaSq);
+	const float c = glm::mix(0.19823f, 0.16801f, oneMinusAlphaSq);
+	const float d = glm::mix(-1.97760f, -1.27393f, oneMinusAlphaSq);
+	const float e = glm::mix(-4.32054f, -4.85967f, oneMinusAlphaSq);
+	return a / (1.0f + b * std::pow(x, c)) + d * x + e;
+}
+static float lambdaSheen(float cosTheta, float alphaG)
+{
+	if (std::abs(cosTheta) < 0.5f) return std::exp(lambdaSheenNumericHelper(cosTheta, alphaG));
+	return std::exp(2.0f * lambdaSheenNumericHelper(0.5f, alphaG) - lambdaSheenNumericHelper(1.0f - cosTheta, alphaG));
+}
+static float V_Sheen(float NdotL, float NdotV, float sheenRoughness)
+{
+	sheenRoughness = std::max(sheenRoughness, 0.000001f);
+	const float alphaG = sheenRoughness * sheenRoughness;
+	return glm::clamp(1.0f / ((1.0f + lambdaSheen(NdotV, alphaG) + lambdaSheen(NdotL, alphaG)) * (4.0f * NdotV * NdotL)), 0.0f, 1.0f);
+}
+// the visibility the prefiltered Charlie LUT is integrated with, Ashikhmin and Premoze
+static float V_Ashikhmin(float NdotL, float NdotV)
+{
+	return glm::clamp(1.0f / (4.0f * (NdotL + NdotV - NdotL * NdotV)), 0.0f, 1.0f);
+}
+
+enum Distribution
+{
+	kDistribution_Lambertian,
+	kDistribution_GGX,
+	kDistribution_Charlie,
+};
+// The directions around the normal a texel averages, with the normal along z and the view along the normal.
+// Each sample reads the source level whose texels cover the solid angle it stands for, so few samples don't alias
+static std::vector<IblBaker::FilterSample> createFilterSamples(Distribution distribution, float roughness, uint32_t count, uint32_t sourceSize)
+{
+	const float texelSolidAngle = 4.0f * sPi / (6.0f * sourceSize * sourceSize);
+	std::vector<IblBaker::FilterSample> samples;
+	samples.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		const glm::vec2 xi = hammersley(i, count);
+		const float phi = 2.0f * sPi * xi.x;
+		glm::vec3 direction;
+		float pdf;
+		float weight = 1.0f;
+		if (distribution == kDistribution_Lambertian) {
+			// cosine weighted, the mean of the samples is the irradiance over pi
+			direction = sphericalDirection(std::sqrt(1.0f - xi.y), phi);
+			pdf = direction.z / sPi;
+		}
+		else if (distribution == kDistribution_GGX) {
+			// the view reflected about H, the pdf of L is D * NdotH / (4 * VdotH) with V = N
+			const float alpha = roughness * roughness;
+			const glm::vec3 H = sphericalDirection(std::sqrt((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y)), phi);
+			direction = glm::vec3(2.0f * H.z * H.x, 2.0f * H.z * H.y, 2.0f * H.z * H.z - 1.0f);
+			pdf = D_GGX(H.z, alpha) / 4.0f;
+			weight = direction.z;
+		}
+		else {
+			// Charlie half vectors lie near the horizon, reflecting the view about them almost always ends below it.
+			// L is sampled uniformly and weighted by the distribution instead
+			direction = sphericalDirection(xi.y, phi);
+			pdf = 1.0f / (2.0f * sPi);
+			weight = D_Charlie(roughness, std::sqrt(0.5f + 0.5f * direction.z)) * direction.z;
+		}
+		if (direction.z <= 0.0f || weight <= 0.0f) continue;
+
+		IblBaker::FilterSample sample;
+		sample.direction = direction;
+		sample.weight = weight;
+		// biased one level coarser than the solid angle asks for, as the Khronos IBL Sampler does, smooths the few samples
+		sample.lod = pdf > 0.0f ? std::max(0.0f, 0.5f * std::log2(1.0f / (count * pdf * texelSolidAngle)) + 1.0f) : 0.0f;
+		samples.push_back(sample);
+	}
+	return samples;
+}
+
+// the level of the source cubemap a sample table without samples copies
+static const IblBaker::Surface& findSourceLevel(const std::vector<IblBaker::Surface>& source, uint32_t size)
+{
+	return *std::find_if(source.begin(), source.end(), [&](const IblBaker::Surface& s) { return s.size == size; });
+}
+
+#if defined(IBL_BAKER_SSE)
+// A sample table in structure of arrays for four samples at a time, with the source levels each sample blends resolved
+struct PackedSamples
+{
+	std::vector<float> x, y, z, weight;
+	std::vector<float> size0, size1, levelFactor;
+	std::vector<uint32_t> level0, level1;
+	uint32_t count = 0;//padded to a multiple of 4 with samples of weight 0
+	float totalWeight = 0.0f;
+
+	PackedSamples(const std::vector<IblBaker::FilterSample>& samples, const std::vector<IblBaker::Surface>& source)
+	{
+		count = ((uint32_t)samples.size() + 3) & ~3u;
+		x.assign(count, 0.0f); y.assign(count, 0.0f); z.assign(count, 1.0f); weight.assign(count, 0.0f);
+		size0.assign(count, (float)source[0].size); size1.assign(count, (float)source[0].size); levelFactor.assign(count, 0.0f);
+		level0.assign(count, 0); level1.assign(count, 0);
+		for (size_t i = 0; i < samples.size(); ++i) {
+			const IblBaker::FilterSample& sample = samples[i];
+			x[i] = sample.direction.x; y[i] = sample.direction.y; z[i] = sample.direction.z;
+			weight[i] = sample.weight;
+			totalWeight += sample.weight;
+			// as sampleCubeMap picks them
+			const float lod = glm::clamp(sample.lod, 0.0f, (float)(source.size() - 1));
+			level0[i] = (uint32_t)lod;
+			level1[i] = std::min(level0[i] + 1, (uint32_t)source.size() - 1);
+			levelFactor[i] = level1[i] == level0[i] ? 0.0f : lod - level0[i];
+			size0[i] = (float)source[level0[i]].size;
+			size1[i] = (float)source[level1[i]].size;
+		}
+	}
+};
+static inline __m128 selectPs(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+static inline __m128 mixPs(__m128 a, __m128 b, float t)
+{
+	const __m128 factor = _mm_set1_ps(t);
+	return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.0f), factor)), _mm_mul_ps(b, factor));
+}
+// face coordinates of four lanes in [0, 1] to the texel and bilinear factor of levels of the given sizes, clamped at the edges
+static inline void getTexelCoords(__m128 u, __m128 size, int32_t* texel, float* factor)
+{
+	const __m128 coord = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(u, size), _mm_set1_ps(0.5f)), _mm_setzero_ps()), _mm_sub_ps(size, _mm_set1_ps(1.0f)));
+	const __m128i coordTexel = _mm_cvttps_epi32(coord);
+	_mm_store_si128((__m128i*)texel, coordTexel);
+	_mm_store_ps(factor, _mm_sub_ps(coord, _mm_cvtepi32_ps(coordTexel)));
+}
+static inline __m128 sampleFace(const IblBaker::Surface& surface, uint32_t face, uint32_t x0, uint32_t y0, float fx, float fy)
+{
+	const uint32_t size = surface.size;
+	const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+	const float* texels = &surface.getFace(face)->x;
+	const __m128 top = mixPs(_mm_loadu_ps(texels + 4 * (y0 * size + x0)), _mm_loadu_ps(texels + 4 * (y0 * size + x1)), fx);
+	const __m128 bottom = mixPs(_mm_loadu_ps(texels + 4 * (y1 * size + x0)), _mm_loadu_ps(texels + 4 * (y1 * size + x1)), fx);
+	return mixPs(top, bottom, fy);
+}
+// The sample loop of filterCubeMap for four samples at a time: their directions, cube faces and texel coordinates in both
+// levels are computed in SIMD lanes, then each lane blends its RGBA texels as one vector
+static glm::vec4 filterTexel(const std::vector<IblBaker::Surface>& source, const PackedSamples& samples, const glm::vec3& N, const glm::vec3& T, const glm::vec3& B)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), signBit = _mm_set1_ps(-0.0f);
+	const __m128 Tx = _mm_set1_ps(T.x), Ty = _mm_set1_ps(T.y), Tz = _mm_set1_ps(T.z);
+	const __m128 Bx = _mm_set1_ps(B.x), By = _mm_set1_ps(B.y), Bz = _mm_set1_ps(B.z);
+	const __m128 Nx = _mm_set1_ps(N.x), Ny = _mm_set1_ps(N.y), Nz = _mm_set1_ps(N.z);
+	alignas(16) int32_t faces[4], x0[4], y0[4], x1[4], y1[4];
+	alignas(16) float fx0[4], fy0[4], fx1[4], fy1[4];
+	__m128 color = zero;
+	for (uint32_t i = 0; i < samples.count; i += 4) {
+		const __m128 dx = _mm_loadu_ps(&samples.x[i]), dy = _mm_loadu_ps(&samples.y[i]), dz = _mm_loadu_ps(&samples.z[i]);
+		const __m128 Lx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Tx, dx), _mm_mul_ps(Bx, dy)), _mm_mul_ps(Nx, dz));
+		const __m128 Ly = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Ty, dx), _mm_mul_ps(By, dy)), _mm_mul_ps(Ny, dz));
+		const __m128 Lz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Tz, dx), _mm_mul_ps(Bz, dy)), _mm_mul_ps(Nz, dz));
+
+		// the face and its coordinates as sampleSurface finds them
+		const __m128 ax = _mm_andnot_ps(signBit, Lx), ay = _mm_andnot_ps(signBit, Ly), az = _mm_andnot_ps(signBit, Lz);
+		const __m128 xMajor = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+		const __m128 yMajor = _mm_andnot_ps(xMajor, _mm_cmpge_ps(ay, az));
+		const __m128 xPositive = _mm_cmpgt_ps(Lx, zero), yPositive = _mm_cmpgt_ps(Ly, zero), zPositive = _mm_cmpgt_ps(Lz, zero);
+		const __m128 face = selectPs(xMajor, selectPs(xPositive, zero, one),
+			selectPs(yMajor, selectPs(yPositive, _mm_set1_ps(2.0f), _mm_set1_ps(3.0f)), selectPs(zPositive, _mm_set1_ps(4.0f), _mm_set1_ps(5.0f))));
+		const __m128 negLx = _mm_xor_ps(Lx, signBit), negLy = _mm_xor_ps(Ly, signBit), negLz = _mm_xor_ps(Lz, signBit);
+		const __m128 sc = selectPs(xMajor, selectPs(xPositive, negLz, Lz), selectPs(yMajor, Lx, selectPs(zPositive, Lx, negLx)));
+		const __m128 tc = selectPs(yMajor, selectPs(yPositive, Lz, negLz), negLy);
+		const __m128 ma = selectPs(xMajor, ax, selectPs(yMajor, ay, az));
+		const __m128 u = _mm_mul_ps(half, _mm_add_ps(_mm_div_ps(sc, ma), one));
+		const __m128 v = _mm_mul_ps(half, _mm_add_ps(_mm_div_ps(tc, ma), one));
+		_mm_store_si128((__m128i*)faces, _mm_cvttps_epi32(face));
+		const __m128 size0 = _mm_loadu_ps(&samples.size0[i]), size1 = _mm_loadu_ps(&samples.size1[i]);
+		getTexelCoords(u, size0, x0, fx0);
+		getTexelCoords(v, size0, y0, fy0);
+		getTexelCoords(u, size1, x1, fx1);
+		getTexelCoords(v, size1, y1, fy1);
+
+		const uint32_t laneCount = std::min(4u, samples.count - i);
+		for (uint32_t lane = 0; lane < laneCount; ++lane) {
+			const uint32_t s = i + lane;
+			if (samples.weight[s] <= 0.0f) continue;
+			__m128 sampleColor = sampleFace(source[samples.level0[s]], faces[lane], x0[lane], y0[lane], fx0[lane], fy0[lane]);
+			if (samples.levelFactor[s] > 0.0f) {
+				sampleColor = mixPs(sampleColor, sampleFace(source[samples.level1[s]], faces[lane], x1[lane], y1[lane], fx1[lane], fy1[lane]), samples.levelFactor[s]);
+			}
+			color = _mm_add_ps(color, _mm_mul_ps(sampleColor, _mm_set1_ps(samples.weight[s])));
+		}
+	}
+	glm::vec4 result;
+	_mm_storeu_ps(&result.x, color);
+	return result;
+}
+#endif
+
+void IblBaker::forEachBand(const std::vector<uint32_t>& heights, const std::function<void(size_t, uint32_t, uint32_t)>& job)
+{
+	size_t band = 0;
+	for (size_t item = 0; item < heights.size(); ++item) {
+		for (uint32_t row = 0; row < heights[item]; row += sBandRows, ++band) {
+			const uint32_t rowCount = std::min(sBandRows, heights[item] - row);
+			threadPool_.threads[band % threadPool_.threads.size()]->addJob([&job, item, row, rowCount] { job(item, row, rowCount); });
+		}
+	}
+	threadPool_.wait();
+}
+void IblBaker::createSourceCubeMap(const Panorama& panorama, std::vector<Surface>& source)
+{
+	const uint32_t size = settings_.specularSize;
+	source.resize(getLevelCount(size));
+	for (uint32_t level = 0; level < source.size(); ++level) {
+		source[level].create(std::max(1u, size >> level), 6);
+	}
+
+	// level 0 averages a few panorama samples per texel, the panorama is usually finer
+	forEachBand(std::vector<uint32_t>(6, size), [&](size_t face, uint32_t firstRow, uint32_t rowCount) {
+		glm::vec4* texels = source[0].getFace((uint32_t)face);
+		for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+			for (uint32_t x = 0; x < size; ++x) {
+				glm::vec4 color(0.0f);
+				for (uint32_t j = 0; j < sSourceSubsamples; ++j) {
+					for (uint32_t i = 0; i < sSourceSubsamples; ++i) {
+						const float subX = x + (i + 0.5f) / sSourceSubsamples, subY = y + (j + 0.5f) / sSourceSubsamples;
+						color += samplePanorama(panorama, getTexelDirection((uint32_t)face, subX, subY, size));
+					}
+				}
+				texels[y * size + x] = color / (float)(sSourceSubsamples * sSourceSubsamples);
+			}
+		}
+	});
+	// the other levels are box filtered, each from the one before
+	for (uint32_t level = 1; level < source.size(); ++level) {
+		const Surface& src = source[level - 1];
+		Surface& dst = source[level];
+		forEachBand(std::vector<uint32_t>(6, dst.size), [&](size_t face, uint32_t firstRow, uint32_t rowCount) {
+			const glm::vec4* srcTexels = src.getFace((uint32_t)face);
+			glm::vec4* dstTexels = dst.getFace((uint32_t)face);
+			for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+				const uint32_t y0 = std::min(2 * y, src.size - 1), y1 = std::min(2 * y + 1, src.size - 1);
+				for (uint32_t x = 0; x < dst.size; ++x) {
+					const uint32_t x0 = std::min(2 * x, src.size - 1), x1 = std::min(2 * x + 1, src.size - 1);
+					dstTexels[y * dst.size + x] = 0.25f * (srcTexels[y0 * src.size + x0] + srcTexels[y0 * src.size + x1]
+						+ srcTexels[y1 * src.size + x0] + srcTexels[y1 * src.size + x1]);
+				}
+			}
+		});
+	}
+}
+void IblBaker::filterCubeMap(const std::vector<Surface>& source, const std::vector<std::vector<FilterSample>>& sampleTables, std::vector<Surface>& target)
+{
+	// one item per face of every level
+	std::vector<uint32_t> heights;
+	for (const Surface& level : target) {
+		heights.insert(heights.end(), 6, level.size);
+	}
+#if defined(IBL_BAKER_SSE)
+	std::vector<PackedSamples> packedTables;
+	for (const std::vector<FilterSample>& samples : sampleTables) {
+		packedTables.emplace_back(samples, source);
+	}
+#endif
+	forEachBand(heights, [&](size_t item, uint32_t firstRow, uint32_t rowCount) {
+		const uint32_t level = (uint32_t)(item / 6), face = (uint32_t)(item % 6);
+		const std::vector<FilterSample>& samples = sampleTables[level];
+		Surface& surface = target[level];
+		glm::vec4* texels = surface.getFace(face);
+		if (samples.empty()) {
+			const Surface& copy = findSourceLevel(source, surface.size);
+			memcpy(texels + firstRow * surface.size, copy.getFace(face) + firstRow * surface.size, (size_t)rowCount * surface.size * sizeof(glm::vec4));
+			return;
+		}
+#if defined(IBL_BAKER_SSE)
+		const PackedSamples& packed = packedTables[level];
+		const float totalWeight = packed.totalWeight;
+#else
+		float totalWeight = 0.0f;
+		for (const FilterSample& sample : samples) {
+			totalWeight += sample.weight;
+		}
+#endif
+		for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+			for (uint32_t x = 0; x < surface.size; ++x) {
+				const glm::vec3 N = getTexelDirection(face, x + 0.5f, y + 0.5f, surface.size);
+				const glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				const glm::vec3 T = glm::normalize(glm::cross(up, N));
+				const glm::vec3 B = glm::cross(N, T);
+#if defined(IBL_BAKER_SSE)
+				const glm::vec4 color = filterTexel(source, packed, N, T, B);
+#else
+				glm::vec4 color(0.0f);
+				for (const FilterSample& sample : samples) {
+					const glm::vec3 L = T * sample.direction.x + B * sample.direction.y + N * sample.direction.z;
+					color += sampleCubeMap(source, L, sample.lod) * sample.weight;
+				}
+#endif
+				// a Charlie level of roughness 0 samples only grazing directions, the sheen LUT is 0 there
+				texels[y * surface.size + x] = totalWeight > 0.0f ? color / totalWeight : glm::vec4(0.0f);
+			}
+		}
+	});
+}
+// The compute prefilter of enableCompute, ibl_filter.comp runs the sample loop of filterCubeMap for every texel of a level.
+// The source levels go to a storage buffer once per bake, the filtered levels are read back into the surfaces
+struct IblBaker::ComputeFilter
+{
+	struct PushConstants
+	{
+		uint32_t sourceSize;
+		uint32_t sourceLevels;
+		uint32_t targetSize;
+		uint32_t targetOffset;//in texels
+		uint32_t firstSample;
+		uint32_t sampleCount;
+		float totalWeight;
+	};
+	// FilterSample as std430 lays it out
+	struct GpuSample
+	{
+		glm::vec4 direction;
+		float lod;
+		float weight;
+		float padding[2];
+	};
+	static_assert(sizeof(GpuSample) == 32, "");
+	// the levels the shader keeps offsets of
+	static const uint32_t kMaxLevels = 16;
+
+	vks::VulkanDevice* vulkanDevice = nullptr;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	// of the bake in progress
+	vks::Buffer sourceBuffer;
+	uint32_t sourceSize = 0, sourceLevels = 0;
+
+	~ComputeFilter()
+	{
+		destroy();
+	}
+	bool create(vks::VulkanDevice* vulkanDevice, VkQueue queue, const std::string& shaderFilename)
+	{
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		// shaders are assets there, the bakes come with the apk
+		return false;
+#else
+		this->vulkanDevice = vulkanDevice;
+		this->queue = queue;
+		VkDevice device = vulkanDevice->logicalDevice;
+		// the queue is the graphics queue the viewer renders with
+		const uint32_t queueFamily = vulkanDevice->queueFamilyIndices.graphics;
+		if ((vulkanDevice->queueFamilyProperties[queueFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) return false;
+		if (!vks::tools::fileExists(shaderFilename)) return false;
+		VkShaderModule shaderModule = vks::tools::loadShader(shaderFilename.c_str(), device);
+		if (shaderModule == VK_NULL_HANDLE) return false;
+
+		commandPool = vulkanDevice->createCommandPool(queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(bindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		std::vector<VkDescriptorPoolSize> poolSizes = { vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3) };
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = {};
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		const VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline);
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+		return result == VK_SUCCESS;
+#endif
+	}
+	void destroy()
+	{
+		if (!vulkanDevice) return;
+		VkDevice device = vulkanDevice->logicalDevice;
+		releaseSource();
+		vkSafeDestroyPipeline(device, pipeline);
+		vkSafeDestroyPipelineLayout(device, pipelineLayout);
+		if (descriptorPool) {
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+			descriptorSet = VK_NULL_HANDLE;
+		}
+		vkSafeDestroyDescriptorSetLayout(device, descriptorSetLayout);
+		if (commandPool) {
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			commandPool = VK_NULL_HANDLE;
+		}
+		vulkanDevice = nullptr;
+	}
+
+	// the source levels one after the other, false if the shader or the device can't hold them
+	bool uploadSource(const std::vector<Surface>& source)
+	{
+		releaseSource();
+		if (source.size() > kMaxLevels) return false;
+		VkDeviceSize size = 0;
+		for (const Surface& level : source) {
+			size += level.texels.size() * sizeof(glm::vec4);
+		}
+		if (size > vulkanDevice->properties.limits.maxStorageBufferRange) return false;
+
+		vks::Buffer staging;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, size));
+		VK_CHECK_RESULT(staging.map());
+		VkDeviceSize offset = 0;
+		for (const Surface& level : source) {
+			memcpy((uint8_t*)staging.mapped + offset, level.texels.data(), level.texels.size() * sizeof(glm::vec4));
+			offset += level.texels.size() * sizeof(glm::vec4);
+		}
+		staging.unmap();
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &sourceBuffer, size));
+		VkCommandBuffer cmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
+		VkBufferCopy copyRegion = { 0, 0, size };
+		vkCmdCopyBuffer(cmd, staging.buffer, sourceBuffer.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(cmd, queue, commandPool, true);
+		staging.destroy();
+		sourceSize = source[0].size;
+		sourceLevels = (uint32_t)source.size();
+		return true;
+	}
+	void releaseSource()
+	{
+		sourceBuffer.destroy();
+		sourceBuffer = vks::Buffer();
+		sourceSize = sourceLevels = 0;
+	}
+
+	// filterCubeMap of the uploaded source, a dispatch per level
+	bool filter(const std::vector<Surface>& source, const std::vector<std::vector<FilterSample>>& sampleTables, std::vector<Surface>& target)
+	{
+		std::vector<GpuSample> samples;
+		std::vector<PushConstants> levels;
+		VkDeviceSize targetSize = 0;
+		for (uint32_t level = 0; level < target.size(); ++level) {
+			Surface& surface = target[level];
+			if (sampleTables[level].empty()) {
+				surface.texels = findSourceLevel(source, surface.size).texels;
+				continue;
+			}
+			PushConstants pushConstants = {};
+			pushConstants.sourceSize = sourceSize;
+			pushConstants.sourceLevels = sourceLevels;
+			pushConstants.targetSize = surface.size;
+			pushConstants.targetOffset = (uint32_t)(targetSize / sizeof(glm::vec4));
+			pushConstants.firstSample = (uint32_t)samples.size();
+			pushConstants.sampleCount = (uint32_t)sampleTables[level].size();
+			for (const FilterSample& sample : sampleTables[level]) {
+				GpuSample gpuSample = {};
+				gpuSample.direction = glm::vec4(sample.direction, 0.0f);
+				gpuSample.lod = sample.lod;
+				gpuSample.weight = sample.weight;
+				samples.push_back(gpuSample);
+				pushConstants.totalWeight += sample.weight;
+			}
+			levels.push_back(pushConstants);
+			targetSize += surface.texels.size() * sizeof(glm::vec4);
+		}
+		if (levels.empty()) return true;
+		if (targetSize > vulkanDevice->properties.limits.maxStorageBufferRange) return false;
+
+		vks::Buffer sampleBuffer, targetBuffer, readbackBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&sampleBuffer, samples.size() * sizeof(GpuSample), samples.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &targetBuffer, targetSize));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readbackBuffer, targetSize));
+		std::vector<VkWriteDescriptorSet> writes = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &sampleBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &targetBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(vulkanDevice->logicalDevice, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+		VkCommandBuffer cmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		for (const PushConstants& pushConstants : levels) {
+			vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			const uint32_t groupCount = (pushConstants.targetSize + 7) / 8;
+			vkCmdDispatch(cmd, groupCount, groupCount, 6);
+		}
+		VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = targetBuffer.buffer;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		VkBufferCopy copyRegion = { 0, 0, targetSize };
+		vkCmdCopyBuffer(cmd, targetBuffer.buffer, readbackBuffer.buffer, 1, &copyRegion);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.buffer = readbackBuffer.buffer;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		vulkanDevice->flushCommandBuffer(cmd, queue, commandPool, true);
+
+		VK_CHECK_RESULT(readbackBuffer.map());
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0; level < target.size(); ++level) {
+			if (sampleTables[level].empty()) continue;
+			Surface& surface = target[level];
+			memcpy(surface.texels.data(), (const uint8_t*)readbackBuffer.mapped + offset, surface.texels.size() * sizeof(glm::vec4));
+			offset += surface.texels.size() * sizeof(glm::vec4);
+		}
+		readbackBuffer.unmap();
+		sampleBuffer.destroy();
+		targetBuffer.destroy();
+		readbackBuffer.destroy();
+		return true;
+	}
+};
+
+bool IblBaker::enableCompute(vks::VulkanDevice* vulkanDevice, VkQueue queue, const std::string& shaderFilename)
+{
+	computeFilter_ = std::make_shared<ComputeFilter>();
+	if (!computeFilter_->create(vulkanDevice, queue, shaderFilename)) {
+		std::cout << "\"" << shaderFilename << "\" can't run on this device, prefiltering on the CPU\n";
+		computeFilter_ = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void IblBaker::createLuts(Surface& ggxLut, Surface& charlieLut, Surface& sheenLut)
+{
+	// NdotV along x, roughness along y
+	const uint32_t size = settings_.lutSize, count = settings_.lutSamples;
+	ggxLut.create(size, 1);
+	charlieLut.create(size, 1);
+	sheenLut.create(size, 1);
+	forEachBand({ size }, [&](size_t, uint32_t firstRow, uint32_t rowCount) {
+		for (uint32_t y = firstRow; y < firstRow + rowCount; ++y) {
+			const float roughness = (y + 0.5f) / size;
+			const float alpha = roughness * roughness;
+			for (uint32_t x = 0; x < size; ++x) {
+				const float NdotV = (x + 0.5f) / size;
+				const glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+				// scale and bias of F0 for the split sum, importance sampled
+				float A = 0.0f, B = 0.0f;
+				for (uint32_t i = 0; i < count; ++i) {
+					const glm::vec2 xi = hammersley(i, count);
+					const glm::vec3 H = sphericalDirection(std::sqrt((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y)), 2.0f * sPi * xi.x);
+					const float VdotH = glm::dot(V, H);
+					const glm::vec3 L = 2.0f * VdotH * H - V;
+					if (L.z <= 0.0f || VdotH <= 0.0f) continue;
+					const float weight = V_GGX(L.z, NdotV, alpha) * VdotH * L.z / H.z;
+					const float Fc = std::pow(1.0f - VdotH, 5.0f);
+					A += (1.0f - Fc) * weight;
+					B += Fc * weight;
+				}
+				// directional albedo of the sheen lobe, uniformly sampled as the lobe is mostly grazing
+				float charlie = 0.0f, sheen = 0.0f;
+				for (uint32_t i = 0; i < count; ++i) {
+					const glm::vec2 xi = hammersley(i, count);
+					const glm::vec3 L = sphericalDirection(xi.y, 2.0f * sPi * xi.x);
+					if (L.z <= 0.0f) continue;
+					const float D = D_Charlie(roughness, glm::normalize(V + L).z);
+					charlie += D * V_Ashikhmin(L.z, NdotV) * L.z;
+					sheen += D * V_Sheen(L.z, NdotV, roughness) * L.z;
+				}
+				// the shaders read .rg, .b and .r
+				const size_t texel = (size_t)y * size + x;
+				ggxLut.texels[texel] = glm::vec4(4.0f * A / count, 4.0f * B / count, 0.0f, 1.0f);
+				charlieLut.texels[texel] = glm::vec4(glm::vec3(2.0f * sPi * charlie / count), 1.0f);
+				sheenLut.texels[texel] = glm::vec4(glm::vec3(2.0f * sPi * sheen / count), 1.0f);
+			}
+		}
+	});
+}
+
+// RGBA16F, a cubemap when the levels have 6 faces
+static bool writeKtx2(const std::string& filename, const std::vector<IblBaker::Surface>& levels)
+{
+	ktxTextureCreateInfo createInfo = {};
+	createInfo.vkFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	createInfo.baseWidth = levels[0].size;
+	createInfo.baseHeight = levels[0].size;
+	createInfo.baseDepth = 1;
+	createInfo.numDimensions = 2;
+	createInfo.numLevels = (uint32_t)levels.size();
+	createInfo.numLayers = 1;
+	createInfo.numFaces = levels[0].faceCount;
+	createInfo.isArray = KTX_FALSE;
+	createInfo.generateMipmaps = KTX_FALSE;
+	ktxTexture2* texture = nullptr;
+	if (ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) return false;
+
+	bool result = true;
+	std::vector<uint32_t> halfs;
+	for (uint32_t level = 0; level < createInfo.numLevels && result; ++level) {
+		const IblBaker::Surface& surface = levels[level];
+		const size_t texelCount = (size_t)surface.size * surface.size;
+		halfs.resize(texelCount * 2);
+		for (uint32_t face = 0; face < surface.faceCount && result; ++face) {
+			const glm::vec4* texels = surface.getFace(face);
+			for (size_t i = 0; i < texelCount; ++i) {
+				// the sun of a panorama may not fit
+				const glm::vec4 texel = glm::min(texels[i], glm::vec4(65504.0f));
+				halfs[2 * i] = glm::packHalf2x16(glm::vec2(texel.r, texel.g));
+				halfs[2 * i + 1] = glm::packHalf2x16(glm::vec2(texel.b, texel.a));
+			}
+			result = ktxTexture_SetImageFromMemory(ktxTexture(texture), level, 0, face,
+				(const ktx_uint8_t*)halfs.data(), halfs.size() * sizeof(uint32_t)) == KTX_SUCCESS;
+		}
+	}
+	const std::string tmpFilename = filename + ".tmp";
+	result = result && ktxTexture_WriteToNamedFile(ktxTexture(texture), tmpFilename.c_str()) == KTX_SUCCESS;
+	ktxTexture_Destroy(ktxTexture(texture));
+	if (!result) {
+		remove(tmpFilename.c_str());
+		std::cerr << "write \"" << filename << "\" failed\n";
+		return false;
+	}
+	return ModelCache::replaceFile(tmpFilename, filename);
+}
+
+bool IblBaker::bake(const std::string& panoramaFilename, const std::string& cacheDir, bool force, EnviromentImagesPath& paths)
+{
+	std::vector<unsigned char> bytes;
+	if (!readFile(panoramaFilename, bytes)) {
+		std::cerr << "read panorama \"" << panoramaFilename << "\" failed\n";
+		return false;
+	}
+	getBakedPaths(cacheDir, ModelCache::hashBytes(ModelCache::kHashSeed, bytes.data(), bytes.size()), settings_, paths);
+	const bool envBaked = !force && fileExists(paths.lambertEnvPath) && fileExists(paths.ggxEnvPath) && fileExists(paths.charlieEnvPath);
+	const bool lutsBaked = !force && fileExists(paths.ggxLutPath) && fileExists(paths.charlieLutPath) && fileExists(paths.sheenLutPath);
+	if (envBaked && lutsBaked) return true;
+	if (!ModelCache::createDirectory(cacheDir)) {
+		std::cerr << "Could not create directory \"" << cacheDir << "\"\n";
+		return false;
+	}
+
+	bool result = true;
+	if (!envBaked) {
+		Panorama panorama;
+		{
+			if (!stbi_is_hdr_from_memory(bytes.data(), (int)bytes.size())) {
+				std::cerr << "panorama \"" << panoramaFilename << "\" is not a Radiance HDR image, OpenEXR is not supported\n";
+				return false;
+			}
+			int width = 0, height = 0, components = 0;
+			float* pixels = stbi_loadf_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &components, 4);
+			if (!pixels) {
+				std::cerr << "decode panorama \"" << panoramaFilename << "\" failed: " << stbi_failure_reason() << "\n";
+				return false;
+			}
+			panorama.width = width;
+			panorama.height = height;
+			panorama.texels.assign((const glm::vec4*)pixels, (const glm::vec4*)pixels + (size_t)width * height);
+			stbi_image_free(pixels);
+			std::vector<unsigned char>().swap(bytes);
+		}
+		std::vector<Surface> source;
+		createSourceCubeMap(panorama, source);
+		std::vector<glm::vec4>().swap(panorama.texels);
+
+		// the specular maps stop at 4x4, the shaders spread the roughness over their levels
+		const uint32_t specularLevels = std::max(1u, getLevelCount(settings_.specularSize) - 2);
+		std::vector<Surface> lambertian(1), ggx(specularLevels), charlie(specularLevels);
+		lambertian[0].create(settings_.lambertianSize, 6);
+		std::vector<std::vector<FilterSample>> lambertianSamples(1), ggxSamples(specularLevels), charlieSamples(specularLevels);
+		lambertianSamples[0] = createFilterSamples(kDistribution_Lambertian, 1.0f, settings_.lambertianSamples, settings_.specularSize);
+		for (uint32_t level = 0; level < specularLevels; ++level) {
+			const float roughness = specularLevels > 1 ? (float)level / (specularLevels - 1) : 1.0f;
+			ggx[level].create(std::max(1u, settings_.specularSize >> level), 6);
+			charlie[level].create(std::max(1u, settings_.specularSize >> level), 6);
+			// a mirror reflects the source itself
+			if (level > 0) ggxSamples[level] = createFilterSamples(kDistribution_GGX, roughness, settings_.specularSamples, settings_.specularSize);
+			charlieSamples[level] = createFilterSamples(kDistribution_Charlie, roughness, settings_.specularSamples, settings_.specularSize);
+		}
+		const bool filtered = computeFilter_ && computeFilter_->uploadSource(source) && computeFilter_->filter(source, lambertianSamples, lambertian)
+			&& computeFilter_->filter(source, ggxSamples, ggx) && computeFilter_->filter(source, charlieSamples, charlie);
+		if (computeFilter_) computeFilter_->releaseSource();
+		if (!filtered) {
+			filterCubeMap(source, lambertianSamples, lambertian);
+			filterCubeMap(source, ggxSamples, ggx);
+			filterCubeMap(source, charlieSamples, charlie);
+		}
+		result = writeKtx2(paths.lambertEnvPath, lambertian) && result;
+		result = writeKtx2(paths.ggxEnvPath, ggx) && result;
+		result = writeKtx2(paths.charlieEnvPath, charlie) && result;
+	}
+	if (!lutsBaked) {
+		std::vector<Surface> ggxLut(1), charlieLut(1), sheenLut(1);
+		createLuts(ggxLut[0], charlieLut[0], sheenLut[0]);
+		result = writeKtx2(paths.ggxLutPath, ggxLut) && result;
+		result = writeKtx2(paths.charlieLutPath, charlieLut) && result;
+		result = writeKtx2(paths.sheenLutPath, sheenLut) && result;
+	}
+	return result;
+}
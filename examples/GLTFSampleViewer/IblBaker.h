@@ -0,0 +1,64 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include "threadpool.hpp"
+
+struct EnviromentImagesPath;
+// Bakes the image based lighting of an equirectangular HDR panorama, what the viewer's environments were baked with offline:
+// the Lambertian irradiance cubemap, the GGX and Charlie prefiltered cubemaps with one roughness per mip level, and the
+// GGX, Charlie and sheen albedo LUTs. Cubemaps and LUTs are RGBA16F KTX2 files Enviroment::load reads as they are.
+// Prefiltering importance samples the distributions and reads the mip level of the source cubemap matching each
+// sample's solid angle, so a few hundred samples are enough. With enableCompute the cubemaps are prefiltered by a compute
+// shader, otherwise faces and levels are filtered in bands of rows across a thread pool, four samples at a time with SSE.
+// Baked files are named by a hash of the panorama and the settings, a panorama is baked once per cache directory
+class IblBaker
+{
+public:
+	struct Settings
+	{
+		uint32_t specularSize = 256;//GGX and Charlie level 0, the levels go down to 4x4
+		uint32_t lambertianSize = 64;
+		uint32_t lutSize = 256;
+		uint32_t specularSamples = 256;
+		uint32_t lambertianSamples = 1024;
+		uint32_t lutSamples = 512;
+	};
+	// bump whenever the filtering changes, files of older versions are not found any more
+	static const uint32_t kBakerVersion = 1;
+
+	struct Panorama;
+	struct Surface;//square faces of one size, one after the other
+	struct FilterSample;
+	struct ComputeFilter;
+private:
+	Settings settings_;
+	vks::ThreadPool threadPool_;
+	uint32_t threadCount_ = 1;
+	std::shared_ptr<ComputeFilter> computeFilter_;
+public:
+	// threadCount 0 uses one thread per hardware core
+	IblBaker(const Settings& settings, uint32_t threadCount = 0);
+	~IblBaker();
+	// releases the device objects of enableCompute
+	void destroy();
+
+	// Prefilters the cubemaps of later bakes with the compute shader on the device, on the thread calling bake. The queue is
+	// shared through VulkanDevice::queueMutex. Returns false if the shader or the device can't, the thread pool filters then
+	bool enableCompute(vks::VulkanDevice* vulkanDevice, VkQueue queue, const std::string& shaderFilename);
+
+	// Fills paths with the baked files of the panorama, baking them unless an earlier bake is found in cacheDir or force is set
+	bool bake(const std::string& panoramaFilename, const std::string& cacheDir, bool force, EnviromentImagesPath& paths);
+
+	// .hdr and .exr files, only .hdr can be baked as there is no OpenEXR decoder in the tree
+	static bool isPanorama(const std::string& filename);
+	// the files a bake of panoramaHash with the settings is written to
+	static void getBakedPaths(const std::string& cacheDir, uint64_t panoramaHash, const Settings& settings, EnviromentImagesPath& paths);
+private:
+	// the levels of the source cubemap down to 1x1
+	void createSourceCubeMap(const Panorama& panorama, std::vector<Surface>& source);
+	// a level with an empty sample table is a copy of the source level of its size
+	void filterCubeMap(const std::vector<Surface>& source, const std::vector<std::vector<FilterSample>>& sampleTables, std::vector<Surface>& target);
+	void createLuts(Surface& ggxLut, Surface& charlieLut, Surface& sheenLut);
+	// runs job(item, firstRow, rowCount) for bands of rows of items of the given heights
+	void forEachBand(const std::vector<uint32_t>& heights, const std::function<void(size_t, uint32_t, uint32_t)>& job);
+};
+using IblBakerPtr = std::shared_ptr<IblBaker>;
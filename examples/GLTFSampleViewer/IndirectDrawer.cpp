@@ -0,0 +1,124 @@
+#include "IndirectDrawer.h"
+
+IndirectDrawer::IndirectDrawer(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, uint32_t frameCount)
+{
+	vulkanDevice_ = vulkanDevice;
+	descriptorPool_ = descriptorPool;
+	maxDrawIndirectCount_ = std::max(1u, vulkanDevice_->properties.limits.maxDrawIndirectCount);
+
+	VkDevice device = vulkanDevice_->logicalDevice;
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Draw;
+		setLayoutBinding_Draw.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, DRAW_DATA_BINDING));
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBinding_Draw.data(), setLayoutBinding_Draw.size());
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+	}
+
+	frameCount = std::max(1u, frameCount);
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+	std::vector<VkDescriptorSet> descriptorSets(frameCount);
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, layouts.data(), frameCount);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()));
+
+	frames_.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; ++i) {
+		frames_[i].descriptorSet = descriptorSets[i];
+		createFrameBuffers(frames_[i], 256);
+	}
+}
+IndirectDrawer::~IndirectDrawer()
+{
+	destroy();
+}
+void IndirectDrawer::destroy()
+{
+	for (auto& frame : frames_) {
+		frame.drawData.destroy();
+		frame.commands.destroy();
+	}
+	frames_.clear();
+	vkSafeDestroyDescriptorSetLayout(vulkanDevice_->logicalDevice, descriptorSetLayout);
+}
+
+bool IndirectDrawer::isSupported(const VkPhysicalDeviceFeatures& features)
+{
+	return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+bool IndirectDrawer::isSameBatch(const Drawable& a, const Drawable& b)
+{
+	return a.skinned_ == b.skinned_
+		&& a.indexType_ == b.indexType_
+		&& a.descriptorSets_ == b.descriptorSets_;
+}
+
+void IndirectDrawer::createFrameBuffers(FrameResources& frame, uint32_t capacity)
+{
+	frame.drawData.destroy();
+	frame.commands.destroy();
+	frame.capacity = capacity;
+
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.drawData, capacity * sizeof(DrawData)));
+	VK_CHECK_RESULT(frame.drawData.map());
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.commands, capacity * sizeof(VkDrawIndexedIndirectCommand)));
+	VK_CHECK_RESULT(frame.commands.map());
+
+	frame.drawData.setupDescriptor();
+	VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DRAW_DATA_BINDING, &frame.drawData.descriptor);
+	vkUpdateDescriptorSets(vulkanDevice_->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+void IndirectDrawer::beginFrame(uint32_t frameIndex, uint32_t maxDrawCount)
+{
+	frameIndex_ = frameIndex % frames_.size();
+	drawCount_ = 0;
+	stats_ = Stats();
+
+	// the frame's fence has been waited on, its buffers and descriptor set are free to replace
+	FrameResources& frame = frames_[frameIndex_];
+	if (maxDrawCount > frame.capacity) {
+		uint32_t capacity = frame.capacity;
+		while (capacity < maxDrawCount) capacity *= 2;
+		createFrameBuffers(frame, capacity);
+	}
+}
+void IndirectDrawer::bindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, DRAW_SET, 1, &frames_[frameIndex_].descriptorSet, 0, nullptr);
+}
+void IndirectDrawer::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<Drawable>& queue, const uint32_t* order, uint32_t count)
+{
+	FrameResources& frame = frames_[frameIndex_];
+	count = std::min(count, frame.capacity - drawCount_);//beginFrame was given too small a bound
+	if (count == 0) return;
+
+	const uint32_t firstSlot = drawCount_;
+	DrawData* drawData = (DrawData*)frame.drawData.mapped + firstSlot;
+	VkDrawIndexedIndirectCommand* commands = (VkDrawIndexedIndirectCommand*)frame.commands.mapped + firstSlot;
+	uint32_t commandCount = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		const Drawable& drawable = queue[order[i]];
+		if (!drawable.isValid()) continue;
+
+		const uint32_t slot = firstSlot + commandCount;
+		drawData[commandCount].u_ModelMatrix = drawable.pushConstant_.u_ModelMatrix;
+		drawData[commandCount].u_MaterialIndex = drawable.pushConstant_.u_MaterialIndex;
+		VkDrawIndexedIndirectCommand& command = commands[commandCount];
+		command.indexCount = drawable.indexCount_;
+		command.instanceCount = 1;
+		command.firstIndex = drawable.firstIndex_;
+		command.vertexOffset = drawable.vertexOffset_;
+		command.firstInstance = slot;//gl_InstanceIndex of the draw
+		++commandCount;
+	}
+	if (commandCount == 0) return;
+	drawCount_ += commandCount;
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MATERIAL_SET, queue[order[0]].descriptorSets_.size(), queue[order[0]].descriptorSets_.data(), 0, nullptr);
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	for (uint32_t first = 0; first < commandCount; first += maxDrawIndirectCount_) {
+		const uint32_t drawCount = std::min(maxDrawIndirectCount_, commandCount - first);
+		vkCmdDrawIndexedIndirect(commandBuffer, frame.commands.buffer, (firstSlot + first) * stride, drawCount, stride);
+		++stats_.indirectDraws;
+	}
+	stats_.drawables += commandCount;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "AnimatedModel.h"
+
+// Records runs of drawables that share pipeline, index buffer and descriptor sets with one vkCmdDrawIndexedIndirect.
+// Every draw writes its DrawData and VkDrawIndexedIndirectCommand to host visible buffers of the frame in flight,
+// the command's firstInstance is the DrawData slot the shaders read at gl_InstanceIndex
+class IndirectDrawer
+{
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
+	uint32_t maxDrawIndirectCount_ = 1;
+
+	struct FrameResources
+	{
+		vks::Buffer drawData;//DrawData per draw
+		vks::Buffer commands;//VkDrawIndexedIndirectCommand per draw
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+	};
+	std::vector<FrameResources> frames_;
+	uint32_t frameIndex_ = 0;
+	uint32_t drawCount_ = 0;//slots taken in the current frame
+
+	struct Stats
+	{
+		uint32_t drawables = 0;
+		uint32_t indirectDraws = 0;//vkCmdDrawIndexedIndirect calls
+	};
+	Stats stats_;
+public:
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+public:
+	IndirectDrawer(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, uint32_t frameCount = 1);
+	~IndirectDrawer();
+	void destroy();
+
+	// multiDrawIndirect and drawIndirectFirstInstance, getEnabledFeatures has to enable both
+	static bool isSupported(const VkPhysicalDeviceFeatures& features);
+	static bool isSameBatch(const Drawable& a, const Drawable& b);
+
+	// makes room for maxDrawCount draws of the frame, the frame's previous commands must have completed
+	void beginFrame(uint32_t frameIndex, uint32_t maxDrawCount);
+	// the model shaders declare DRAW_SET, it is bound for direct draws as well
+	void bindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const;
+	// queue[order[0, count)] must share one batch, see isSameBatch
+	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<Drawable>& queue, const uint32_t* order, uint32_t count);
+	const Stats& getStats() const { return stats_; }
+private:
+	void createFrameBuffers(FrameResources& frame, uint32_t capacity);
+};
+using IndirectDrawerPtr = std::shared_ptr<IndirectDrawer>;
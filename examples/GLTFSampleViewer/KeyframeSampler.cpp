@@ -0,0 +1,264 @@
+#include "KeyframeSampler.h"
+#include <chrono>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define KEYFRAME_SAMPLER_SSE
+#include <xmmintrin.h>
+#endif
+
+#define Eplison 1e-5f
+
+template<typename T>
+void KeyframeChannels<T>::clear()
+{
+	targetNodes.clear();
+	keyOffsets.clear();
+	keyCounts.clear();
+	cursors.clear();
+	times.clear();
+	values.clear();
+	segments.clear();
+	factors.clear();
+	results.clear();
+}
+template<typename T>
+void KeyframeChannels<T>::addChannel(int targetNode, const std::vector<float>& channelTimes, const std::vector<T>& channelValues)
+{
+	// accessors of times and values may disagree on count
+	uint32_t keyCount = (uint32_t)std::min(channelTimes.size(), channelValues.size());
+	if (keyCount == 0) return;
+
+	targetNodes.push_back(targetNode);
+	keyOffsets.push_back((uint32_t)times.size());
+	keyCounts.push_back(keyCount);
+	cursors.push_back(0);
+	times.insert(times.end(), channelTimes.begin(), channelTimes.begin() + keyCount);
+	values.insert(values.end(), channelValues.begin(), channelValues.begin() + keyCount);
+	// a single key is repeated, so every channel blends the two keys of its segment without a branch
+	if (keyCount == 1) {
+		times.push_back(channelTimes[0]);
+		values.push_back(channelValues[0]);
+	}
+
+	segments.push_back(0);
+	factors.push_back(0);
+	results.push_back(channelValues[0]);
+}
+template<typename T>
+void KeyframeChannels<T>::locateKeys(float time)
+{
+	const size_t channelCount = size();
+	for (size_t c = 0; c < channelCount; ++c)
+	{
+		const float* t = &times[keyOffsets[c]];
+		const uint32_t n = keyCounts[c];
+		uint32_t k = cursors[c];
+		float f = 0;
+
+		// a single key is a constant pose
+		if (n == 1 || time <= t[0]) {
+			k = 0;
+		}
+		else if (time >= t[n - 1]) {
+			k = n - 2;
+			f = 1;
+		}
+		else {
+			if (!(t[k] <= time && time < t[k + 1])) {
+				// forward playback usually lands in the next segment, otherwise seek
+				if (k + 2 < n && t[k + 1] <= time && time < t[k + 2]) ++k;
+				else k = (uint32_t)(std::upper_bound(t, t + n, time) - t) - 1;
+			}
+			f = (time - t[k]) / std::max(t[k + 1] - t[k], Eplison);
+		}
+		cursors[c] = k;
+		segments[c] = keyOffsets[c] + k;
+		factors[c] = f;
+	}
+}
+
+void KeyframeSampler::clear()
+{
+	translations_.clear();
+	rotations_.clear();
+	scales_.clear();
+}
+void KeyframeSampler::build(const Animation& animation)
+{
+	clear();
+	for (const AnimationTrack& track : animation)
+	{
+		const AnimationSampler& translation = track.samplers[kATPath_Translation];
+		if (translation) translations_.addChannel(track.nodeIndex, translation.times, translation.translation);
+
+		const AnimationSampler& rotation = track.samplers[kATPath_Rotation];
+		if (rotation) rotations_.addChannel(track.nodeIndex, rotation.times, rotation.rotation);
+
+		const AnimationSampler& scale = track.samplers[kATPath_Scale];
+		if (scale) scales_.addChannel(track.nodeIndex, scale.times, scale.scale);
+	}
+}
+// Linear keys of vec3 channels, translations and scales alike. With SSE the components of a channel are blended in lanes
+static void blendLinear(KeyframeChannels<glm::vec3>& channels)
+{
+	const glm::vec3* values = channels.values.data();
+	for (size_t c = 0, count = channels.size(); c < count; ++c) {
+		const glm::vec3& a = values[channels.segments[c]];
+		const glm::vec3& b = values[channels.segments[c] + 1];
+#if defined(KEYFRAME_SAMPLER_SSE)
+		const __m128 va = _mm_setr_ps(a.x, a.y, a.z, 0.0f);
+		const __m128 vb = _mm_setr_ps(b.x, b.y, b.z, 0.0f);
+		alignas(16) float result[4];
+		_mm_store_ps(result, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(channels.factors[c]))));
+		channels.results[c] = glm::vec3(result[0], result[1], result[2]);
+#else
+		channels.results[c] = a + (b - a) * channels.factors[c];
+#endif
+	}
+}
+// glm::slerp of the key pairs of rotation channels. With SSE four channels go through the lanes at a time, as columns
+// of a transposed 4x4, and only the acos and sin of the angles are scalar
+static void blendSpherical(KeyframeChannels<glm::quat>& channels)
+{
+	const glm::quat* values = channels.values.data();
+	const size_t count = channels.size();
+	size_t c = 0;
+#if defined(KEYFRAME_SAMPLER_SSE)
+	for (; c + 4 <= count; c += 4) {
+		__m128 x0 = _mm_loadu_ps(&values[channels.segments[c]].x), y0 = _mm_loadu_ps(&values[channels.segments[c + 1]].x);
+		__m128 z0 = _mm_loadu_ps(&values[channels.segments[c + 2]].x), w0 = _mm_loadu_ps(&values[channels.segments[c + 3]].x);
+		__m128 x1 = _mm_loadu_ps(&values[channels.segments[c] + 1].x), y1 = _mm_loadu_ps(&values[channels.segments[c + 1] + 1].x);
+		__m128 z1 = _mm_loadu_ps(&values[channels.segments[c + 2] + 1].x), w1 = _mm_loadu_ps(&values[channels.segments[c + 3] + 1].x);
+		_MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+		_MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+
+		// the short way around, negating the second key
+		__m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_add_ps(_mm_mul_ps(z0, z1), _mm_mul_ps(w0, w1)));
+		const __m128 sign = _mm_and_ps(_mm_cmplt_ps(cosTheta, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+		cosTheta = _mm_xor_ps(cosTheta, sign);
+		x1 = _mm_xor_ps(x1, sign); y1 = _mm_xor_ps(y1, sign); z1 = _mm_xor_ps(z1, sign); w1 = _mm_xor_ps(w1, sign);
+
+		alignas(16) float cosThetas[4], weights0[4], weights1[4];
+		_mm_store_ps(cosThetas, cosTheta);
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			const float a = channels.factors[c + lane];
+			// linear close to the first key, sin(angle) would be 0
+			if (cosThetas[lane] > 1.0f - glm::epsilon<float>()) {
+				weights0[lane] = 1.0f - a;
+				weights1[lane] = a;
+			}
+			else {
+				const float angle = std::acos(cosThetas[lane]), sinAngle = std::sin(angle);
+				weights0[lane] = std::sin((1.0f - a) * angle) / sinAngle;
+				weights1[lane] = std::sin(a * angle) / sinAngle;
+			}
+		}
+		const __m128 weight0 = _mm_load_ps(weights0), weight1 = _mm_load_ps(weights1);
+		x0 = _mm_add_ps(_mm_mul_ps(x0, weight0), _mm_mul_ps(x1, weight1));
+		y0 = _mm_add_ps(_mm_mul_ps(y0, weight0), _mm_mul_ps(y1, weight1));
+		z0 = _mm_add_ps(_mm_mul_ps(z0, weight0), _mm_mul_ps(z1, weight1));
+		w0 = _mm_add_ps(_mm_mul_ps(w0, weight0), _mm_mul_ps(w1, weight1));
+		_MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+		_mm_storeu_ps(&channels.results[c].x, x0);
+		_mm_storeu_ps(&channels.results[c + 1].x, y0);
+		_mm_storeu_ps(&channels.results[c + 2].x, z0);
+		_mm_storeu_ps(&channels.results[c + 3].x, w0);
+	}
+#endif
+	for (; c < count; ++c) {
+		channels.results[c] = glm::slerp(values[channels.segments[c]], values[channels.segments[c] + 1], channels.factors[c]);
+	}
+}
+
+void KeyframeSampler::evaluate(float time)
+{
+	translations_.locateKeys(time);
+	rotations_.locateKeys(time);
+	scales_.locateKeys(time);
+
+	blendLinear(translations_);
+	blendLinear(scales_);
+	blendSpherical(rotations_);
+}
+
+// per-frame linear key scan, the sampling path AnimatedModel used before KeyframeSampler
+static bool selectFrameByTime(const std::vector<float>& times, float curTime, int& frameIndex, float& fParam)
+{
+	if (times.empty()) return false;
+
+	if (curTime <= times[0]) {
+		frameIndex = 0;
+		fParam = 0;
+		return true;
+	}
+	for (int idx = 1; idx < times.size(); ++idx) {
+		if (curTime < times[idx] && times[idx] - times[idx - 1] > Eplison) {
+			frameIndex = idx - 1;
+			fParam = (curTime - times[idx - 1]) / (times[idx] - times[idx - 1]);
+			return true;
+		}
+	}
+	frameIndex = times.size();
+	fParam = 0;
+	return true;
+}
+static size_t sampleByLinearScan(const Animation& animation, float time, glm::vec4& sink)
+{
+	size_t channelCount = 0;
+	for (const AnimationTrack& track : animation)
+	{
+		for (int i = kATPath_Translation; i <= kATPath_Scale; ++i)
+		{
+			const AnimationSampler& sample = track.samplers[i];
+			if (!sample) continue;
+
+			int frameIndex = 0;
+			float fParam = 0;
+			if (!selectFrameByTime(sample.times, time, frameIndex, fParam)) continue;
+
+			if (i == kATPath_Rotation) {
+				glm::quat q = (frameIndex + 1 < sample.rotation.size()) ? glm::slerp(sample.rotation[frameIndex], sample.rotation[frameIndex + 1], fParam) : sample.rotation.back();
+				sink += glm::vec4(q.x, q.y, q.z, q.w);
+			}
+			else {
+				const std::vector<glm::vec3>& values = (i == kATPath_Translation) ? sample.translation : sample.scale;
+				glm::vec3 v = (frameIndex + 1 < values.size()) ? glm::mix(values[frameIndex], values[frameIndex + 1], fParam) : values.back();
+				sink += glm::vec4(v, 0);
+			}
+			channelCount++;
+		}
+	}
+	return channelCount;
+}
+void benchmarkKeyframeSampling(const std::vector<Animation>& animations, uint32_t frameCount)
+{
+	const float frameTime = 1.0f / 60.0f;
+	for (const Animation& animation : animations)
+	{
+		if (animation.getDuration() <= Eplison) continue;
+
+		glm::vec4 sink(0);
+		size_t scanChannels = 0;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			scanChannels += sampleByLinearScan(animation, fmod(frame * frameTime, animation.getDuration()), sink);
+		}
+		double scanSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		KeyframeSampler sampler;
+		sampler.build(animation);
+		size_t samplerChannels = 0;
+		tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			sampler.evaluate(fmod(frame * frameTime, animation.getDuration()));
+			samplerChannels += sampler.getChannelCount();
+			if (!sampler.getTranslations().results.empty()) sink += glm::vec4(sampler.getTranslations().results[0], 0);
+		}
+		double samplerSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		std::cout << "animation \"" << animation.getName() << "\" (" << sampler.getChannelCount() << " channels, " << animation.getDuration() << "s, " << frameCount << " frames)" << std::endl;
+		std::cout << "  linear scan     : " << (scanChannels / std::max(scanSeconds, 1e-9)) << " channels/s" << std::endl;
+		std::cout << "  keyframe sampler: " << (samplerChannels / std::max(samplerSeconds, 1e-9)) << " channels/s" << std::endl;
+		std::cout << "  (checksum " << (sink.x + sink.y + sink.z + sink.w) << ")" << std::endl;
+	}
+}
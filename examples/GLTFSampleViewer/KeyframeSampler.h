@@ -0,0 +1,48 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include "Animation.h"
+
+// Keys of every channel of one target path, packed back to back
+template<typename T>
+struct KeyframeChannels
+{
+	std::vector<int> targetNodes;//glTF node index
+	std::vector<uint32_t> keyOffsets;
+	std::vector<uint32_t> keyCounts;
+	std::vector<uint32_t> cursors;//last used segment, relative to keyOffsets
+	std::vector<float> times;
+	std::vector<T> values;
+
+	// per channel result of the last evaluate()
+	std::vector<uint32_t> segments;//absolute index of the segment's first key
+	std::vector<float> factors;
+	std::vector<T> results;
+
+	size_t size() const { return targetNodes.size(); }
+	void clear();
+	void addChannel(int targetNode, const std::vector<float>& channelTimes, const std::vector<T>& channelValues);
+	// find the key segment of every channel, O(1) when playing forward
+	void locateKeys(float time);
+};
+
+// Sampling engine for one Animation. Channels are batched by interpolation and component count:
+// translations and scales blend linearly in one routine, rotations slerp four channels at a time.
+class KeyframeSampler
+{
+public:
+	void clear();
+	void build(const Animation& animation);
+	void evaluate(float time);
+
+	const KeyframeChannels<glm::vec3>& getTranslations() const { return translations_; }
+	const KeyframeChannels<glm::quat>& getRotations() const { return rotations_; }
+	const KeyframeChannels<glm::vec3>& getScales() const { return scales_; }
+	size_t getChannelCount() const { return translations_.size() + rotations_.size() + scales_.size(); }
+private:
+	KeyframeChannels<glm::vec3> translations_;
+	KeyframeChannels<glm::quat> rotations_;
+	KeyframeChannels<glm::vec3> scales_;
+};
+
+// Compare channels per second of KeyframeSampler against a per-frame linear key scan, prints to stdout
+void benchmarkKeyframeSampling(const std::vector<Animation>& animations, uint32_t frameCount);
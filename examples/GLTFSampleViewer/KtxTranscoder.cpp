@@ -0,0 +1,108 @@
+#include "KtxTranscoder.h"
+#include <ktx.h>
+
+// glTF color data is decoded from sRGB like the RGBA8 textures, files tagged sRGB are sampled through the UNORM format
+static VkFormat toUnormFormat(VkFormat format)
+{
+	const VkFormat unormFormats[] = {
+		VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK,
+		VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_UNORM_BLOCK,
+	};
+	for (VkFormat unormFormat : unormFormats) {
+		if (format == unormFormat || format == vks::tools::formatConvertToSRGB(unormFormat)) return unormFormat;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+KtxTranscoder::KtxTranscoder(vks::VulkanDevice* vulkanDevice)
+{
+	vulkanDevice_ = vulkanDevice;
+	// the block formats transcoding picks from, each family is used only if its feature is enabled
+	bc_ = vulkanDevice_->enabledFeatures.textureCompressionBC && isSampled(VK_FORMAT_BC7_UNORM_BLOCK) && isSampled(VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+	astc_ = vulkanDevice_->enabledFeatures.textureCompressionASTC_LDR && isSampled(VK_FORMAT_ASTC_4x4_UNORM_BLOCK);
+	etc2_ = vulkanDevice_->enabledFeatures.textureCompressionETC2 && isSampled(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK) && isSampled(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK);
+}
+
+bool KtxTranscoder::isSampled(VkFormat format) const
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(vulkanDevice_->physicalDevice, format, &formatProperties);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+bool KtxTranscoder::isFormatSupported(VkFormat format) const
+{
+	switch (toUnormFormat(format)) {
+	case VK_FORMAT_R8G8B8A8_UNORM: return true;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC4_UNORM_BLOCK: case VK_FORMAT_BC7_UNORM_BLOCK: return bc_;
+	case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: return astc_;
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK: case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: return etc2_;
+	default: return false;
+	}
+}
+
+bool KtxTranscoder::isKtx2(const unsigned char* bytes, size_t size)
+{
+	static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	return size >= sizeof(identifier) && memcmp(bytes, identifier, sizeof(identifier)) == 0;
+}
+
+bool KtxTranscoder::transcode(const unsigned char* bytes, size_t size, Image& image) const
+{
+	image = Image();
+	ktxTexture2* texture = nullptr;
+	if (ktxTexture2_CreateFromMemory(bytes, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS) return false;
+
+	bool result = texture->numDimensions == 2 && texture->numLayers == 1 && texture->numFaces == 1 && texture->numLevels > 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	if (result && ktxTexture2_NeedsTranscoding(texture)) {
+		// ETC1S is lower quality than BC1 already, UASTC and alpha need BC7
+		const bool etc1s = ktxTexture2_GetColorModel_e(texture) == KHR_DF_MODEL_ETC1S;
+		const bool alpha = ktxTexture2_GetNumComponents(texture) != 3;
+		ktx_transcode_fmt_e transcodeFormat;
+		if (bc_) {
+			transcodeFormat = (etc1s && !alpha) ? KTX_TTF_BC1_RGB : KTX_TTF_BC7_RGBA;
+			format = (etc1s && !alpha) ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+		else if (astc_) {
+			transcodeFormat = KTX_TTF_ASTC_4x4_RGBA;
+			format = VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+		}
+		else if (etc2_) {
+			transcodeFormat = alpha ? KTX_TTF_ETC2_RGBA : KTX_TTF_ETC1_RGB;
+			format = alpha ? VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK : VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+		}
+		else {
+			transcodeFormat = KTX_TTF_RGBA32;
+			format = VK_FORMAT_R8G8B8A8_UNORM;
+		}
+		result = ktxTexture2_TranscodeBasis(texture, transcodeFormat, 0) == KTX_SUCCESS;
+	}
+	else if (result) {
+		// not supercompressed with Basis, the stored format has to be sampled as is
+		format = toUnormFormat((VkFormat)texture->vkFormat);
+		result = isFormatSupported(format);
+	}
+
+	if (result) {
+		image.format = format;
+		image.width = texture->baseWidth;
+		image.height = texture->baseHeight;
+		const uint32_t mipLevels = std::min<uint32_t>(texture->numLevels, vks::Texture2D::getMipLevelCount(image.width, image.height));
+		image.data.resize(vks::Texture2D::getMipChainLayout(format, image.width, image.height, mipLevels, image.levelOffsets));
+		for (uint32_t level = 0; level < mipLevels && result; ++level) {
+			const VkDeviceSize levelSize = (level + 1 < mipLevels ? image.levelOffsets[level + 1] : image.data.size()) - image.levelOffsets[level];
+			ktx_size_t offset = 0;
+			const ktx_size_t imageSize = ktxTexture_GetImageSize(ktxTexture(texture), level);
+			// levels are 16 byte aligned here, the file packs them tightly
+			result = ktxTexture_GetImageOffset(ktxTexture(texture), level, 0, 0, &offset) == KTX_SUCCESS
+				&& imageSize <= levelSize && levelSize - imageSize < 16
+				&& offset + imageSize <= ktxTexture_GetDataSize(ktxTexture(texture));
+			if (result) memcpy(image.data.data() + image.levelOffsets[level], ktxTexture_GetData(ktxTexture(texture)) + offset, imageSize);
+		}
+	}
+	ktxTexture_Destroy(ktxTexture(texture));
+	if (!result) image = Image();
+	return result;
+}
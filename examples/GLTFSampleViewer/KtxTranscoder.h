@@ -0,0 +1,33 @@
+#pragma once
+#include "gltfShaderStruct.h"
+
+// Loads KTX2 images, the Basis Universal ones of KHR_texture_basisu are transcoded to the best block format the device samples:
+// BC7, or BC1 for opaque ETC1S content that BC7 would not store any better, then ASTC 4x4, ETC2 and RGBA8 as the last resort.
+// Formats are UNORM like the RGBA8 textures, the material sRGB views and shaders decode color the same way.
+// transcode is thread safe once one image has been transcoded, libktx initializes the Basis transcoder on first use
+class KtxTranscoder
+{
+public:
+	struct Image
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0, height = 0;
+		std::vector<VkDeviceSize> levelOffsets;//laid out by Texture2D::getMipChainLayout, one entry per level in the file
+		std::vector<unsigned char> data;
+
+		bool isValid() const { return format != VK_FORMAT_UNDEFINED; }
+		uint32_t getMipLevels() const { return (uint32_t)levelOffsets.size(); }
+	};
+private:
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	bool bc_ = false, astc_ = false, etc2_ = false;
+public:
+	KtxTranscoder(vks::VulkanDevice* vulkanDevice);
+
+	static bool isKtx2(const unsigned char* bytes, size_t size);
+	bool transcode(const unsigned char* bytes, size_t size, Image& image) const;
+	// RGBA8 or a block format transcode may produce on this device, sRGB formats are loaded as their UNORM one
+	bool isFormatSupported(VkFormat format) const;
+private:
+	bool isSampled(VkFormat format) const;
+};
@@ -20,23 +20,24 @@ Light1::Light1(Light* p)
 /**
  * LightManager
  */
-LightManager::LightManager(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool)
+LightManager::LightManager(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, const UniformRingPtr& uniformRing)
 {
 	vulkanDevice_ = vulkanDevice;
 	device_ = vulkanDevice_->logicalDevice;
 	descriptorPool_ = descriptorPool;
+	uniformRing_ = uniformRing;
 
 	params.u_LightCount = 0;
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Light;
-		setLayoutBinding_Light.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, LIGHT_BINDING));
+		setLayoutBinding_Light.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, LIGHT_BINDING));
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI_Params = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBinding_Light.data(), setLayoutBinding_Light.size());
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device_, &descriptorSetLayoutCI_Params, nullptr, &descriptorSetLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet));
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(params)));
+		SAFE_ASSERT(uniformRing_->allocateBlock(uniformBlock_, sizeof(params)));
 	}
 }
 LightManager::~LightManager()
@@ -47,7 +48,8 @@ void LightManager::destroy()
 {
 	//vkSafeFreeDescriptorSets(device_, descriptorPool_, 1, descriptorSet);
 	vkSafeDestroyDescriptorSetLayout(device_, descriptorSetLayout);
-	uniformBuffer.destroy();
+	if (uniformRing_) uniformRing_->freeBlock(uniformBlock_);
+	uniformRing_ = nullptr;
 }
 void LightManager::reset()
 {
@@ -88,8 +90,6 @@ void LightManager::load(tinygltf::Model& gltfMdl)
 	{
 		createDefaultLights();
 	}
-
-	uploadParams2Gpu();
 }
 void LightManager::createDefaultLights()
 {
@@ -124,15 +124,14 @@ LightPtr LightManager::createLight(int lightType /*= LightType_Directional*/)
 	return light;
 }
 
-void LightManager::uploadParams2Gpu()
+void LightManager::uploadParams2Gpu(uint32_t frameIndex)
 {
-	VK_CHECK_RESULT(uniformBuffer.map());
-	memcpy(uniformBuffer.mapped, &params, sizeof(params));
-	uniformBuffer.unmap();
+	uniformRing_->upload(uniformBlock_, frameIndex, &params);
 }
 void LightManager::uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeDescriptorSet)
 {
-	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LIGHT_BINDING, &uniformBuffer.descriptor));
+	uniformDescriptor_ = uniformRing_->getDescriptor(uniformBlock_);
+	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, LIGHT_BINDING, &uniformDescriptor_));
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "GltfShaderStruct.h"
+#include "UniformRing.h"
 
 class Light1
 {
@@ -29,17 +30,20 @@ class LightManager
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDevice device_ = VK_NULL_HANDLE;
 	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
+	UniformRingPtr uniformRing_;
+	UniformRing::Block uniformBlock_;
+	VkDescriptorBufferInfo uniformDescriptor_{};//referenced by the pending descriptor write
 
 	std::vector<LightPtr> lights_;
 public:
 	LightUniforms params{};
 
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
-	vks::Buffer uniformBuffer;
+	// bound with the dynamic offset of the frame in flight, see UniformRing
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 public:
-	LightManager(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool);
+	LightManager(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, const UniformRingPtr& uniformRing);
 	~LightManager();
 	void reset();
 	void destroy();
@@ -49,7 +53,7 @@ public:
 	LightPtr createLight(int lightType = LightType_Directional);
 	void removeAllLights();
 
-	void uploadParams2Gpu();
+	void uploadParams2Gpu(uint32_t frameIndex);
 	void uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams);
 };
 using LightManagerPtr = std::shared_ptr<LightManager>;
\ No newline at end of file
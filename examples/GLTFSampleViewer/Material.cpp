@@ -1,5 +1,13 @@
 #include "Material.h"
 
+// color textures are sampled through their sRGB view
+static bool isSRGBBinding(int binding)
+{
+	return binding == MTL_TEX_BASE_COLOR_BINDING
+		|| binding == MTL_TEX_SHEEN_COLOR_BINDING
+		|| binding == MTL_TEX_CLEARCOAT_BINDING;
+}
+
 void Material::createHardware(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, VkDescriptorSetLayout dsLayout)
 {
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dsLayout, 1);
@@ -206,10 +214,7 @@ void Material::uploadDescriptorSet2Gpu(const std::vector<vks::Texture2D>& imageB
 		auto& image = imageByTexIdx[textureIndex];
 		assert(image);
 		const int binding = MATERIAL_TEXTURE_FIRST_BINDING + i;
-		const bool hasSRGB = image.hasSRGBView() 
-			&& (binding == MTL_TEX_BASE_COLOR_BINDING
-			|| binding == MTL_TEX_SHEEN_COLOR_BINDING
-			|| binding == MTL_TEX_CLEARCOAT_BINDING);
+		const bool hasSRGB = image.hasSRGBView() && isSRGBBinding(binding);
 
 		VkDescriptorImageInfo* imageDescriptor = hasSRGB ? (VkDescriptorImageInfo*)&image.sRGBDescriptor : (VkDescriptorImageInfo*)&image.descriptor;
 		writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, binding, imageDescriptor));
@@ -220,17 +225,139 @@ bool Material::hasTexture(int binding) const
 {
 	return params.getSamplerUVSet(binding - MATERIAL_TEXTURE_FIRST_BINDING) >= 0;
 }
+MaterialVariant Material::getVariant() const
+{
+	MaterialVariant variant;
+	variant.features = mtl_flags & MATERIAL_FEATURE_BITS;
+	variant.alphaMode = params.u_AlphaMode;
+	variant.doubleSided = doubleSided ? 1 : 0;
+	return variant;
+}
+
+/**
+ * MaterialTable
+ */
+void MaterialTable::create(vks::VulkanDevice* vulkanDevice, VkDescriptorSetLayout dsLayout, uint32_t maxTextureCount, const std::vector<Material>& materials, const std::vector<vks::Texture2D>& imageByTexIdx)
+{
+	dispose();
+	vulkanDevice_ = vulkanDevice;
+	VkDevice device = vulkanDevice_->logicalDevice;
+
+	// one array element per image and view, an image sampled as sRGB and linear takes two
+	std::map<std::pair<int, bool>, int> elementByImageView;
+	std::vector<int> textureIndices(std::max<size_t>(1, materials.size()) * MATERIAL_TEXTURE_COUNT, -1);
+	std::vector<PbrMaterialUniforms> params(std::max<size_t>(1, materials.size()));
+	for (size_t m = 0; m < materials.size(); ++m) {
+		const Material& mtl = materials[m];
+		params[m] = mtl.params;
+		for (int i = 0; i < MATERIAL_TEXTURE_COUNT; ++i) {
+			int textureIndex = mtl.textureIndexs[i];
+			if (textureIndex < 0 || textureIndex >= imageByTexIdx.size()) continue;
+
+			auto& image = imageByTexIdx[textureIndex];
+			const bool hasSRGB = image.hasSRGBView() && isSRGBBinding(MATERIAL_TEXTURE_FIRST_BINDING + i);
+			auto key = std::make_pair(textureIndex, hasSRGB);
+			auto iter = elementByImageView.find(key);
+			if (iter == elementByImageView.end()) {
+				if (textureDescriptors_.size() >= maxTextureCount) {
+					std::cerr << "Bindless texture array is full, " << maxTextureCount << " textures at most\n";
+					continue;
+				}
+				iter = elementByImageView.insert(std::make_pair(key, (int)textureDescriptors_.size())).first;
+				textureDescriptors_.push_back(hasSRGB ? image.sRGBDescriptor : image.descriptor);
+			}
+			textureIndices[m * MATERIAL_TEXTURE_COUNT + i] = iter->second;
+		}
+	}
+
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &materialBuffer_, params.size() * sizeof(PbrMaterialUniforms), params.data()));
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &textureIndexBuffer_, textureIndices.size() * sizeof(int), textureIndices.data()));
+	materialBuffer_.setupDescriptor();
+	textureIndexBuffer_.setupDescriptor();
+
+	// a pool of its own, so the number of textures is not bound to the scene's pool
+	const uint32_t textureCount = std::max<uint32_t>(1, textureDescriptors_.size());
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool_));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo = {};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &textureCount;
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool_, &dsLayout, 1);
+	allocInfo.pNext = &variableCountInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+}
+void MaterialTable::dispose()
+{
+	materialBuffer_.destroy();
+	textureIndexBuffer_.destroy();
+	textureDescriptors_.clear();
+	if (descriptorPool_) {
+		vkDestroyDescriptorPool(vulkanDevice_->logicalDevice, descriptorPool_, nullptr);
+		descriptorPool_ = VK_NULL_HANDLE;
+	}
+	descriptorSet = VK_NULL_HANDLE;
+}
+void MaterialTable::uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeDescriptorSet)
+{
+	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MTL_BINDLESS_MATERIALS_BINDING, &materialBuffer_.descriptor));
+	writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MTL_BINDLESS_TEXTURE_INDICES_BINDING, &textureIndexBuffer_.descriptor));
+	if (!textureDescriptors_.empty())
+		writeDescriptorSet.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MTL_BINDLESS_TEXTURES_BINDING, textureDescriptors_.data(), textureDescriptors_.size()));
+}
 
 /**
  * MaterialFactory
  */
-MaterialFactory::MaterialFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool)
+MaterialFactory::MaterialFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, bool bindless)
 {
 	vulkanDevice_ = vulkanDevice;
 	device_ = vulkanDevice_->logicalDevice;
 	descriptorPool_ = descriptorPool;
+	bindless_ = bindless;
+
+	if (bindless_) {
+		VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties = {};
+		descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+		VkPhysicalDeviceProperties2 deviceProperties2 = {};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &descriptorIndexingProperties;
+		vkGetPhysicalDeviceProperties2(vulkanDevice_->physicalDevice, &deviceProperties2);
+		// the same on every factory, pipeline layouts of the viewer and of loaded scenes stay compatible
+		maxTextureCount_ = std::min({ kMaxBindlessTextureCount,
+			descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Material = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, MTL_BINDLESS_MATERIALS_BINDING),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, MTL_BINDLESS_TEXTURE_INDICES_BINDING),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, MTL_BINDLESS_TEXTURES_BINDING, maxTextureCount_),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI_Material = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBinding_Material.data(), setLayoutBinding_Material.size());
+		descriptorSetLayoutCI_Material.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+
+		std::vector<VkDescriptorBindingFlags> bindingFlags = {
+			0,
+			0,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+		};
+		VkDescriptorSetLayoutBindingFlagsCreateInfo dsLayoutBindingFCInfo = {};
+		dsLayoutBindingFCInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		dsLayoutBindingFCInfo.bindingCount = bindingFlags.size();
+		dsLayoutBindingFCInfo.pBindingFlags = bindingFlags.data();
+		descriptorSetLayoutCI_Material.pNext = &dsLayoutBindingFCInfo;
 
-	{
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device_, &descriptorSetLayoutCI_Material, nullptr, &descriptorSetLayout_));
+	}
+	else {
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBinding_Material(1, vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_BINDING));
 		for (int binding = MATERIAL_TEXTURE_FIRST_BINDING; binding <= MATERIAL_TEXTURE_LAST_BINDING; binding++) {
 			setLayoutBinding_Material.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, binding));
@@ -254,6 +381,22 @@ MaterialFactory::MaterialFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPo
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device_, &descriptorSetLayoutCI_Matrices, nullptr, &descriptorSetLayout_));
 	}
 }
+bool MaterialFactory::isBindlessSupported(const VkPhysicalDeviceDescriptorIndexingFeatures& features)
+{
+	return features.runtimeDescriptorArray
+		&& features.shaderSampledImageArrayNonUniformIndexing
+		&& features.descriptorBindingPartiallyBound
+		&& features.descriptorBindingVariableDescriptorCount
+		&& features.descriptorBindingSampledImageUpdateAfterBind;
+}
+void MaterialFactory::enableBindlessFeatures(VkPhysicalDeviceDescriptorIndexingFeatures& features)
+{
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+}
 void MaterialFactory::destroy()
 {
 	vkSafeDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
@@ -263,7 +406,30 @@ Material MaterialFactory::createMaterial(tinygltf::Material& gltfMtl)
 	Material mtl;
 	mtl.load(gltfMtl);
 
-	mtl.createHardware(vulkanDevice_, descriptorPool_, descriptorSetLayout_);
-	mtl.uploadParams2Gpu();
+	// bindless materials live in the model's MaterialTable
+	if (!bindless_) {
+		mtl.createHardware(vulkanDevice_, descriptorPool_, descriptorSetLayout_);
+		mtl.uploadParams2Gpu();
+	}
 	return mtl;
 }
+Material MaterialFactory::createMaterial(const Material& loadedMtl)
+{
+	Material mtl;
+	mtl.mtl_flags = loadedMtl.mtl_flags;
+	mtl.name = loadedMtl.name;
+	mtl.params = loadedMtl.params;
+	mtl.textureIndexs = loadedMtl.textureIndexs;
+	mtl.doubleSided = loadedMtl.doubleSided;
+
+	if (!bindless_) {
+		mtl.createHardware(vulkanDevice_, descriptorPool_, descriptorSetLayout_);
+		mtl.uploadParams2Gpu();
+	}
+	return mtl;
+}
+void MaterialFactory::createMaterialTable(MaterialTable& table, const std::vector<Material>& materials, const std::vector<vks::Texture2D>& imageByTexIdx)
+{
+	assert(bindless_);
+	table.create(vulkanDevice_, descriptorSetLayout_, maxTextureCount_, materials, imageByTexIdx);
+}
@@ -4,6 +4,22 @@
 
 using MaterialFlag = unsigned;
 
+// The pipeline state and specialization a material is drawn with when the viewer specializes pipelines per material
+struct MaterialVariant
+{
+	int features = -1;//MATERIAL_FEATURE_BITS the material uses, -1 evaluates every extension
+	int alphaMode = -1;//ALPHAMODE_*, -1 reads u_AlphaMode
+	int doubleSided = 0;
+
+	bool operator==(const MaterialVariant& other) const {
+		return features == other.features && alphaMode == other.alphaMode && doubleSided == other.doubleSided;
+	}
+	bool operator!=(const MaterialVariant& other) const { return !(*this == other); }
+	bool operator<(const MaterialVariant& other) const {
+		return std::tie(features, alphaMode, doubleSided) < std::tie(other.features, other.alphaMode, other.doubleSided);
+	}
+};
+
 class Material 
 {
 public:
@@ -14,7 +30,7 @@ public:
 	std::array<int, MATERIAL_TEXTURE_COUNT> textureIndexs;
 	bool doubleSided = false;
 
-	VkDescriptorSet descriptorSet;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;//not used by bindless materials
 	vks::Buffer uniformBuffer;
 
 public:
@@ -29,6 +45,7 @@ public:
 	void uploadDescriptorSet2Gpu(const std::vector<vks::Texture2D>& imageByTexId, std::vector<VkWriteDescriptorSet>& writeParams);
 
 	bool hasTexture(int binding) const;
+	MaterialVariant getVariant() const;
 private:
 	void parseTextureTransform(int bindingIdx, const tinygltf::Value& extension);
 	template<class TextureInfo> void parseTextureInfo(int bindingIdx, TextureInfo& texInfo)
@@ -65,19 +82,49 @@ private:
 	}
 };
 
+// Every material of a model in one descriptor set: the uniforms in a storage buffer and the textures in one
+// variable sized array. Draws select their material by PushConsts::u_MaterialIndex, so nothing is rebound between them
+class MaterialTable
+{
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;//sized for this table, update after bind
+	vks::Buffer materialBuffer_;//PbrMaterialUniforms per material
+	vks::Buffer textureIndexBuffer_;//MATERIAL_TEXTURE_COUNT elements of the texture array per material, -1 if unbound
+	std::vector<VkDescriptorImageInfo> textureDescriptors_;
+public:
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+public:
+	void create(vks::VulkanDevice* vulkanDevice, VkDescriptorSetLayout dsLayout, uint32_t maxTextureCount, const std::vector<Material>& materials, const std::vector<vks::Texture2D>& imageByTexIdx);
+	void dispose();
+	bool isValid() const { return descriptorSet != VK_NULL_HANDLE; }
+
+	void uploadDescriptorSet2Gpu(std::vector<VkWriteDescriptorSet>& writeParams);
+};
+
 class MaterialFactory
 {
+	static const uint32_t kMaxBindlessTextureCount = 16384;
 	vks::VulkanDevice* vulkanDevice_ = nullptr;
 	VkDevice device_ = VK_NULL_HANDLE;
 	VkDescriptorPool descriptorPool_ = VK_NULL_HANDLE;
 	VkDescriptorSetLayout descriptorSetLayout_ = VK_NULL_HANDLE;
+	bool bindless_ = false;
+	uint32_t maxTextureCount_ = 0;//size of the bindless texture array
 
 public:
-	MaterialFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool);
+	MaterialFactory(vks::VulkanDevice* vulkanDevice, VkDescriptorPool descriptorPool, bool bindless = false);
 	~MaterialFactory() { destroy(); }
 	void destroy();
 	Material createMaterial(tinygltf::Material& gltfMtl);
+	// from a material that was loaded before, e.g. by the model cache
+	Material createMaterial(const Material& loadedMtl);
+	// bindless only, called once materials and textures of a model are loaded
+	void createMaterialTable(MaterialTable& table, const std::vector<Material>& materials, const std::vector<vks::Texture2D>& imageByTexIdx);
 
+	// runtime sized, non-uniformly indexed and update after bind sampler arrays
+	static bool isBindlessSupported(const VkPhysicalDeviceDescriptorIndexingFeatures& features);
+	static void enableBindlessFeatures(VkPhysicalDeviceDescriptorIndexingFeatures& features);
+	bool isBindless() const { return bindless_; }
 	VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout_; }
 };
 using MaterialFactoryPtr = std::shared_ptr<MaterialFactory>;
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <numeric>
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other)
+{
+	triangles += other.triangles;
+	vertices += other.vertices;
+	misses += other.misses;
+	return *this;
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangles = (uint32_t)(indexCount / 3);
+
+	// a vertex is still cached while fewer than cacheSize misses happened since it was loaded
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (timestamps[v] == 0) stats.vertices++;
+		if (time - timestamps[v] > cacheSize) {
+			timestamps[v] = time++;
+			stats.misses++;
+		}
+	}
+	return stats;
+}
+
+static uint32_t hashAttributes(const uint8_t* vertex, const std::vector<MeshOptimizer::VertexAttribute>& attributes)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const MeshOptimizer::VertexAttribute& attribute : attributes) {
+		for (uint32_t i = 0; i < attribute.size; ++i) {
+			hash ^= vertex[attribute.offset + i];
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+static bool isSameAttributes(const uint8_t* a, const uint8_t* b, const std::vector<MeshOptimizer::VertexAttribute>& attributes)
+{
+	for (const MeshOptimizer::VertexAttribute& attribute : attributes) {
+		if (memcmp(a + attribute.offset, b + attribute.offset, attribute.size) != 0) return false;
+	}
+	return true;
+}
+size_t MeshOptimizer::weldVertices(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<VertexAttribute>& attributes)
+{
+	uint8_t* data = reinterpret_cast<uint8_t*>(vertices);
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2) tableSize *= 2;
+	std::vector<uint32_t> table(tableSize, ~0u);//new vertex index, open addressing
+	std::vector<uint32_t> remap(vertexCount);
+
+	// unique vertices are compacted to the front in place, a vertex only ever moves backwards
+	size_t uniqueCount = 0;
+	for (size_t v = 0; v < vertexCount; ++v) {
+		const uint8_t* vertex = data + v * vertexSize;
+		size_t slot = hashAttributes(vertex, attributes) & (tableSize - 1);
+		while (table[slot] != ~0u && !isSameAttributes(data + table[slot] * vertexSize, vertex, attributes))
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == ~0u) {
+			if (uniqueCount != v) memcpy(data + uniqueCount * vertexSize, vertex, vertexSize);
+			table[slot] = (uint32_t)uniqueCount++;
+		}
+		remap[v] = table[slot];
+	}
+	for (size_t i = 0; i < indexCount; ++i)
+		indices[i] = remap[indices[i]];
+	return uniqueCount;
+}
+
+namespace {
+const int kForsythCacheSize = 32;
+const int kForsythMaxValence = 32;
+
+struct ForsythScores
+{
+	float cache[kForsythCacheSize];
+	float valence[kForsythMaxValence + 1];
+
+	ForsythScores()
+	{
+		// the last triangle's vertices score the same, so the next triangle does not prefer one of its edges
+		for (int i = 0; i < kForsythCacheSize; ++i)
+			cache[i] = (i < 3) ? 0.75f : std::pow(1.0f - (float)(i - 3) / (kForsythCacheSize - 3), 1.5f);
+		// vertices with few triangles left are finished first, so they leave the working set
+		valence[0] = 0.0f;
+		for (int i = 1; i <= kForsythMaxValence; ++i)
+			valence[i] = 2.0f * std::pow((float)i, -0.5f);
+	}
+	float get(int cachePosition, uint32_t liveTriangles) const
+	{
+		if (liveTriangles == 0) return -1.0f;
+		float score = (cachePosition >= 0) ? cache[cachePosition] : 0.0f;
+		return score + valence[std::min(liveTriangles, (uint32_t)kForsythMaxValence)];
+	}
+};
+}
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	static const ForsythScores sScores;
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) return;
+
+	// live triangles of each vertex, the first liveTriangles entries of its adjacency range are not emitted yet
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		liveTriangles[indices[i]]++;
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vertexScores[v] = sScores.get(-1, liveTriangles[v]);
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle]) bestTriangle = (uint32_t)t;
+	}
+
+	std::vector<uint32_t> result(triangleCount * 3);
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(kForsythCacheSize + 3);
+	nextCache.reserve(kForsythCacheSize + 3);
+	size_t scanCursor = 0;//first triangle that may not be emitted yet, for when the cache has no candidate
+	for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		if (bestTriangle == ~0u) {
+			while (emitted[scanCursor]) ++scanCursor;
+			bestTriangle = (uint32_t)scanCursor;
+		}
+		const uint32_t* tri = &indices[bestTriangle * 3];
+		memcpy(&result[emittedCount * 3], tri, sizeof(uint32_t) * 3);
+		emitted[bestTriangle] = true;
+
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = tri[k];
+			uint32_t* live = &adjacency[adjacencyOffsets[v]];
+			uint32_t* last = live + liveTriangles[v] - 1;
+			std::swap(*std::find(live, last + 1, bestTriangle), *last);
+			liveTriangles[v]--;
+		}
+
+		// the emitted triangle moves to the front, everything past kForsythCacheSize falls out
+		nextCache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) nextCache.push_back(v);
+		}
+		for (size_t i = 0; i < nextCache.size(); ++i) {
+			uint32_t v = nextCache[i];
+			cachePositions[v] = (i < kForsythCacheSize) ? (int)i : -1;
+			vertexScores[v] = sScores.get(cachePositions[v], liveTriangles[v]);
+		}
+
+		// rescore the triangles whose vertex scores changed, the next one comes from the cache if possible
+		bestTriangle = ~0u;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < nextCache.size(); ++i) {
+			uint32_t v = nextCache[i];
+			const uint32_t* live = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t j = 0; j < liveTriangles[v]; ++j) {
+				uint32_t t = live[j];
+				float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+				if (i < kForsythCacheSize && score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+		if (nextCache.size() > kForsythCacheSize) nextCache.resize(kForsythCacheSize);
+		cache.swap(nextCache);
+	}
+	memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) return;
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(vertices);
+	auto func_position = [&](uint32_t v) {
+		glm::vec3 position;
+		memcpy(&position, data + v * vertexSize, sizeof(position));
+		return position;
+	};
+
+	// cut wherever the cluster so far is about as cache efficient as the whole order,
+	// the cache starts cold in every cluster since clusters get reordered
+	const float targetACMR = analyzeVertexCache(indices, indexCount, vertexCount, kAnalyzeCacheSize).getACMR() * threshold;
+	std::vector<uint32_t> clusterStarts;
+	{
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		uint32_t time = kAnalyzeCacheSize + 1;
+		uint32_t clusterStart = 0, clusterMisses = 0;
+		for (size_t t = 0; t < triangleCount; ++t) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = indices[t * 3 + k];
+				if (time - timestamps[v] > kAnalyzeCacheSize) {
+					timestamps[v] = time++;
+					clusterMisses++;
+				}
+			}
+			uint32_t clusterSize = (uint32_t)t + 1 - clusterStart;
+			if (clusterMisses <= targetACMR * clusterSize) {
+				clusterStarts.push_back(clusterStart);
+				clusterStart = (uint32_t)t + 1;
+				clusterMisses = 0;
+				time += kAnalyzeCacheSize + 1;
+			}
+		}
+		if (clusterStart < triangleCount) clusterStarts.push_back(clusterStart);
+	}
+	if (clusterStarts.size() < 2) return;
+	clusterStarts.push_back((uint32_t)triangleCount);
+
+	// area weighted centroids and normals
+	const size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f)), clusterNormals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; ++c) {
+		for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+			glm::vec3 p0 = func_position(indices[t * 3]), p1 = func_position(indices[t * 3 + 1]), p2 = func_position(indices[t * 3 + 2]);
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterAreas[c];
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	// clusters facing away from the center are in front from most directions, drawing them first culls more fragments
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		if (clusterAreas[c] <= 0.0f) continue;
+		float normalLength = glm::length(clusterNormals[c]);
+		if (normalLength > 0.0f)
+			sortKeys[c] = glm::dot(clusterCentroids[c] / clusterAreas[c] - meshCentroid, clusterNormals[c] / normalLength);
+	}
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) { return sortKeys[l] > sortKeys[r]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	for (uint32_t c : order)
+		result.insert(result.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+	memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	uint8_t* data = reinterpret_cast<uint8_t*>(vertices);
+	std::vector<uint8_t> source(data, data + vertexCount * vertexSize);
+	std::vector<uint32_t> remap(vertexCount, ~0u);
+
+	uint32_t nextVertex = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t& newIndex = remap[indices[i]];
+		if (newIndex == ~0u) {
+			newIndex = nextVertex++;
+			memcpy(data + newIndex * vertexSize, source.data() + indices[i] * vertexSize, vertexSize);
+		}
+		indices[i] = newIndex;
+	}
+	return nextVertex;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "gltfShaderStruct.h"
+
+// Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats
+{
+	uint32_t triangles = 0;
+	uint32_t vertices = 0;//referenced vertices
+	uint32_t misses = 0;
+
+	float getACMR() const { return triangles ? (float)misses / triangles : 0.0f; }//average cache miss ratio, 0.5 at best
+	float getATVR() const { return vertices ? (float)misses / vertices : 0.0f; }//average transformed vertex ratio, 1.0 at best
+	VertexCacheStats& operator+=(const VertexCacheStats& other);
+};
+
+// Load time triangle list optimization of one primitive. Indices are relative to the primitive's first vertex,
+// vertices are raw structs of vertexSize bytes that are moved bytewise and compared by their attributes
+class MeshOptimizer
+{
+public:
+	static const uint32_t kAnalyzeCacheSize = 16;//a conservative FIFO size of current GPUs
+
+	// bytes of a vertex struct that hold one attribute, padding between them is not compared
+	struct VertexAttribute
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	static VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = kAnalyzeCacheSize);
+
+	// merges vertices whose attributes are bitwise identical, returns the new vertex count
+	static size_t weldVertices(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<VertexAttribute>& attributes);
+	// reorders triangles for post-transform cache hits (Forsyth, linear speed vertex cache optimisation)
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+	// splits the cache optimized order into clusters where that costs at most threshold times the ACMR,
+	// then draws outward facing clusters first (Sander et al., fast triangle reordering for vertex locality and reduced overdraw).
+	// The first three floats of a vertex are its position
+	static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize, float threshold = 1.05f);
+	// orders vertices by first use and drops unreferenced ones, returns the new vertex count
+	static size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize);
+};
@@ -0,0 +1,412 @@
+#include "ModelCache.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The header is written last, a file that was cut short while cooking never validates
+struct ModelCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t options;
+	uint32_t reserved;
+	uint64_t bodySize;
+};
+static_assert(sizeof(ModelCacheFileHeader) == 32, "ModelCacheFileHeader must not contain padding");
+
+static const uint32_t sFileMagic = 0x434D5647;// "GVMC"
+static const uint64_t sBlobAlignment = 16;
+
+static ModelCacheFileHeader makeHeader(const ModelCacheKey& key)
+{
+	ModelCacheFileHeader header = {};
+	header.magic = sFileMagic;
+	header.version = ModelCache::kImporterVersion;
+	header.sourceHash = key.sourceHash;
+	header.options = key.options;
+	return header;
+}
+
+/**
+ * MappedFile
+ */
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	file_ = file;
+	mapping_ = mapping;
+	data_ = (const uint8_t*)view;
+	size_ = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file referenced
+	::close(fd);
+	if (view == MAP_FAILED) return false;
+	data_ = (const uint8_t*)view;
+	size_ = (size_t)st.st_size;
+#endif
+	return true;
+}
+void MappedFile::close()
+{
+	if (!data_) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping_);
+	CloseHandle(file_);
+	mapping_ = file_ = nullptr;
+#else
+	munmap((void*)data_, size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+/**
+ * ModelCacheWriter
+ */
+bool ModelCacheWriter::open(const std::string& filename, const ModelCacheKey& key)
+{
+	abort();
+	filename_ = filename;
+	tmpFilename_ = filename + ".tmp";
+	key_ = key;
+	file_ = fopen(tmpFilename_.c_str(), "wb");
+	if (!file_) return false;
+
+	// placeholder, stays invalid until commit
+	ModelCacheFileHeader header = {};
+	good_ = true;
+	size_ = 0;
+	writeBytes(&header, sizeof(header));
+	return good_;
+}
+bool ModelCacheWriter::commit()
+{
+	if (!file_) return false;
+
+	ModelCacheFileHeader header = makeHeader(key_);
+	header.bodySize = size_ - sizeof(header);
+	bool written = good_ && fseek(file_, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, file_) == 1
+		&& fflush(file_) == 0;
+	// make sure the data reached the disk before the rename makes it visible
+#if defined(_WIN32)
+	written = written && _commit(_fileno(file_)) == 0;
+#else
+	written = written && fsync(fileno(file_)) == 0;
+#endif
+	written = (fclose(file_) == 0) && written;
+	file_ = nullptr;
+	good_ = false;
+	if (!written) {
+		remove(tmpFilename_.c_str());
+		return false;
+	}
+
+	return ModelCache::replaceFile(tmpFilename_, filename_);
+}
+void ModelCacheWriter::abort()
+{
+	if (file_) {
+		fclose(file_);
+		file_ = nullptr;
+		remove(tmpFilename_.c_str());
+	}
+	good_ = false;
+}
+void ModelCacheWriter::writeBytes(const void* data, size_t size)
+{
+	if (!good_ || size == 0) return;
+	good_ = fwrite(data, 1, size, file_) == size;
+	size_ += size;
+}
+void ModelCacheWriter::writeString(const std::string& str)
+{
+	write((uint64_t)str.size());
+	writeBytes(str.data(), str.size());
+}
+void ModelCacheWriter::writeBlob(const void* data, uint64_t size)
+{
+	static const uint8_t zeros[sBlobAlignment] = {};
+	write(size);
+	writeBytes(zeros, (size_t)((sBlobAlignment - size_ % sBlobAlignment) % sBlobAlignment));
+	writeBytes(data, (size_t)size);
+}
+
+/**
+ * ModelCacheReader
+ */
+bool ModelCacheReader::open(const std::string& filename, const ModelCacheKey& key)
+{
+	close();
+	offset_ = 0;
+	if (!file_.open(filename)) return false;
+
+	ModelCacheFileHeader header = {};
+	ModelCacheFileHeader expected = makeHeader(key);
+	good_ = true;
+	bool valid = read(header)
+		&& header.magic == expected.magic
+		&& header.version == expected.version
+		&& header.sourceHash == expected.sourceHash
+		&& header.options == expected.options
+		&& header.bodySize == file_.size() - sizeof(header);
+	if (!valid) {
+		std::cout << "Model cache \"" << filename << "\" is outdated or damaged, cooking the model again\n";
+		close();
+	}
+	return valid;
+}
+bool ModelCacheReader::checkRemaining(uint64_t count, size_t elementSize)
+{
+	if (good_ && (elementSize == 0 || count <= (file_.size() - offset_) / elementSize)) return true;
+	good_ = false;
+	return false;
+}
+bool ModelCacheReader::readBytes(void* data, size_t size)
+{
+	if (!checkRemaining(size, 1)) return false;
+	if (size) memcpy(data, file_.data() + offset_, size);
+	offset_ += size;
+	return true;
+}
+bool ModelCacheReader::readString(std::string& str)
+{
+	str.clear();
+	uint64_t size = 0;
+	if (!read(size) || !checkRemaining(size, 1)) return false;
+	str.assign((const char*)file_.data() + offset_, (size_t)size);
+	offset_ += (size_t)size;
+	return true;
+}
+bool ModelCacheReader::readBlob(ModelCacheBlob& blob)
+{
+	blob = ModelCacheBlob();
+	uint64_t size = 0;
+	if (!read(size)) return false;
+	size_t padding = (size_t)((sBlobAlignment - offset_ % sBlobAlignment) % sBlobAlignment);
+	if (!checkRemaining(padding + size, 1)) return false;
+	offset_ += padding;
+	blob.data = file_.data() + offset_;
+	blob.size = size;
+	offset_ += (size_t)size;
+	return true;
+}
+
+/**
+ * ModelCache
+ */
+uint64_t ModelCache::hashBytes(uint64_t hash, const void* bytes, size_t size)
+{
+	// FNV-1a over 64 bit words, bytewise for the tail
+	const uint8_t* data = (const uint8_t*)bytes;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	for (; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+std::string ModelCache::getCacheFilename(const std::string& cacheDir, const std::string& modelFilename)
+{
+	size_t nameStart = modelFilename.find_last_of("/\\");
+	nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+	size_t nameEnd = modelFilename.find_last_of('.');
+	if (nameEnd == std::string::npos || nameEnd < nameStart) nameEnd = modelFilename.size();
+
+	// models of the same name in different directories get files of their own
+	char pathHash[17];
+	snprintf(pathHash, sizeof(pathHash), "%016llx", (unsigned long long)hashBytes(kHashSeed, (const uint8_t*)modelFilename.data(), modelFilename.size()));
+	return cacheDir + "/" + modelFilename.substr(nameStart, nameEnd - nameStart) + "_" + pathHash + ".modelcache";
+}
+
+static std::string decodeUri(const std::string& uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); ++i) {
+		if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2])) {
+			path.push_back((char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+			i += 2;
+		}
+		else path.push_back(uri[i]);
+	}
+	return path;
+}
+uint64_t ModelCache::hashSourceFiles(const std::string& modelFilename)
+{
+	FILE* file = fopen(modelFilename.c_str(), "rb");
+	if (!file) return 0;
+
+	uint64_t hash = kHashSeed;
+	std::string json;
+	const bool isGltf = vks::tools::getFileNameExtension(modelFilename) == "gltf";
+	std::vector<uint8_t> chunk(1 << 20);
+	size_t readSize;
+	while ((readSize = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+		hash = hashBytes(hash, chunk.data(), readSize);
+		if (isGltf) json.append((const char*)chunk.data(), readSize);
+	}
+	fclose(file);
+	if (!isGltf) return hash;
+
+	// buffers and images of a .gltf live in files of their own, hashing their contents would cost as much as loading them,
+	// so a changed size or modification time stands for a changed file
+	size_t dirEnd = modelFilename.find_last_of("/\\");
+	const std::string baseDir = (dirEnd == std::string::npos) ? "" : modelFilename.substr(0, dirEnd + 1);
+	size_t pos = 0;
+	while ((pos = json.find("\"uri\"", pos)) != std::string::npos) {
+		pos += 5;
+		size_t colon = json.find_first_not_of(" \t\r\n", pos);
+		if (colon == std::string::npos || json[colon] != ':') continue;
+		size_t quote = json.find_first_not_of(" \t\r\n", colon + 1);
+		if (quote == std::string::npos || json[quote] != '"') continue;
+		size_t end = json.find('"', quote + 1);
+		if (end == std::string::npos) break;
+		pos = end + 1;
+
+		const std::string uri = json.substr(quote + 1, end - quote - 1);
+		if (uri.compare(0, 5, "data:") == 0) continue;//embedded, already hashed with the json
+
+		struct stat st;
+		uint64_t fileStamp[2] = { ~0ull, ~0ull };
+		if (stat((baseDir + decodeUri(uri)).c_str(), &st) == 0) {
+			fileStamp[0] = (uint64_t)st.st_size;
+			fileStamp[1] = (uint64_t)st.st_mtime;
+		}
+		hash = hashBytes(hash, (const uint8_t*)fileStamp, sizeof(fileStamp));
+	}
+	return hash;
+}
+
+bool ModelCache::replaceFile(const std::string& tmpFilename, const std::string& filename)
+{
+#if defined(_WIN32)
+	bool renamed = MoveFileExA(tmpFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = rename(tmpFilename.c_str(), filename.c_str()) == 0;
+#endif
+	if (!renamed) remove(tmpFilename.c_str());
+	return renamed;
+}
+bool ModelCache::createDirectory(const std::string& dir)
+{
+#if defined(_WIN32)
+	int result = _mkdir(dir.c_str());
+#else
+	int result = mkdir(dir.c_str(), 0755);
+#endif
+	return result == 0 || errno == EEXIST;
+}
+
+void ModelCache::writeLightsAndCameras(ModelCacheWriter& cache, const tinygltf::Model& gltfMdl)
+{
+	cache.write((uint64_t)gltfMdl.lights.size());
+	for (const auto& light : gltfMdl.lights) {
+		cache.writeString(light.name);
+		cache.writeString(light.type);
+		cache.writeVector(light.color);
+		cache.write(light.intensity);
+		cache.write(light.range);
+		cache.write(light.spot.innerConeAngle);
+		cache.write(light.spot.outerConeAngle);
+	}
+	cache.write((uint64_t)gltfMdl.cameras.size());
+	for (const auto& camera : gltfMdl.cameras) {
+		cache.writeString(camera.name);
+		cache.writeString(camera.type);
+		cache.write(camera.perspective.aspectRatio);
+		cache.write(camera.perspective.yfov);
+		cache.write(camera.perspective.znear);
+		cache.write(camera.perspective.zfar);
+	}
+	// lights and cameras find their node by name
+	const bool needNodes = !gltfMdl.lights.empty() || !gltfMdl.cameras.empty();
+	cache.write((uint64_t)(needNodes ? gltfMdl.nodes.size() : 0));
+	for (size_t i = 0; needNodes && i < gltfMdl.nodes.size(); ++i) {
+		const tinygltf::Node& node = gltfMdl.nodes[i];
+		cache.writeString(node.name);
+		cache.writeVector(node.translation);
+		cache.writeVector(node.rotation);
+		cache.writeVector(node.matrix);
+	}
+}
+bool ModelCache::readLightsAndCameras(ModelCacheReader& cache, tinygltf::Model& gltfMdl)
+{
+	gltfMdl = tinygltf::Model();
+	uint64_t count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		tinygltf::Light light;
+		cache.readString(light.name);
+		cache.readString(light.type);
+		cache.readVector(light.color);
+		cache.read(light.intensity);
+		cache.read(light.range);
+		cache.read(light.spot.innerConeAngle);
+		cache.read(light.spot.outerConeAngle);
+		gltfMdl.lights.push_back(light);
+	}
+	count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		tinygltf::Camera camera;
+		cache.readString(camera.name);
+		cache.readString(camera.type);
+		cache.read(camera.perspective.aspectRatio);
+		cache.read(camera.perspective.yfov);
+		cache.read(camera.perspective.znear);
+		cache.read(camera.perspective.zfar);
+		gltfMdl.cameras.push_back(camera);
+	}
+	count = 0;
+	cache.read(count);
+	for (uint64_t i = 0; i < count && cache.isGood(); ++i) {
+		tinygltf::Node node;
+		cache.readString(node.name);
+		cache.readVector(node.translation);
+		cache.readVector(node.rotation);
+		cache.readVector(node.matrix);
+		gltfMdl.nodes.push_back(node);
+	}
+	return cache.isGood();
+}
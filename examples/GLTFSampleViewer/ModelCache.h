@@ -0,0 +1,133 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include <type_traits>
+
+// Read only view of a whole file, memory mapped
+class MappedFile
+{
+	const uint8_t* data_ = nullptr;
+	size_t size_ = 0;
+#if defined(_WIN32)
+	void* file_ = nullptr;
+	void* mapping_ = nullptr;
+#endif
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string& filename);
+	void close();
+	bool isOpen() const { return data_ != nullptr; }
+	const uint8_t* data() const { return data_; }
+	size_t size() const { return size_; }
+};
+
+// What a cooked model depends on besides the importer: the source files and the load options
+struct ModelCacheKey
+{
+	uint64_t sourceHash = 0;
+	uint32_t options = 0;
+};
+
+// Bytes of a cooked model that go to the GPU as they are
+struct ModelCacheBlob
+{
+	const void* data = nullptr;
+	uint64_t size = 0;
+};
+
+// Streams a cooked model to a temporary file, commit() makes it visible under its final name
+class ModelCacheWriter
+{
+	std::string filename_, tmpFilename_;
+	ModelCacheKey key_;
+	FILE* file_ = nullptr;
+	uint64_t size_ = 0;
+	bool good_ = false;
+public:
+	ModelCacheWriter() {}
+	ModelCacheWriter(const ModelCacheWriter&) = delete;
+	ModelCacheWriter& operator=(const ModelCacheWriter&) = delete;
+	~ModelCacheWriter() { abort(); }
+
+	bool open(const std::string& filename, const ModelCacheKey& key);
+	bool commit();
+	void abort();
+	bool isGood() const { return good_; }
+
+	template<class T> void write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data is written as it is");
+		writeBytes(&value, sizeof(T));
+	}
+	template<class T> void writeVector(const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data is written as it is");
+		write((uint64_t)values.size());
+		writeBytes(values.data(), values.size() * sizeof(T));
+	}
+	void writeString(const std::string& str);
+	// 16 byte aligned in the file, satisfies the copy offset alignment of every staged upload
+	void writeBlob(const void* data, uint64_t size);
+private:
+	void writeBytes(const void* data, size_t size);
+};
+
+// Reads a cooked model back from a mapped file. Reads past the end or of an implausible size
+// leave the value empty and fail the reader, so callers check isGood() once at the end
+class ModelCacheReader
+{
+	MappedFile file_;
+	size_t offset_ = 0;
+	bool good_ = false;
+public:
+	// false if the file is missing, damaged or was cooked from other sources, options or another importer version
+	bool open(const std::string& filename, const ModelCacheKey& key);
+	void close() { file_.close(); good_ = false; }
+	bool isGood() const { return good_; }
+
+	template<class T> bool read(T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data is read as it is");
+		return readBytes(&value, sizeof(T));
+	}
+	template<class T> bool readVector(std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data is read as it is");
+		values.clear();
+		uint64_t count = 0;
+		if (!read(count) || !checkRemaining(count, sizeof(T))) return false;
+		values.resize((size_t)count);
+		return readBytes(values.data(), values.size() * sizeof(T));
+	}
+	bool readString(std::string& str);
+	// points into the mapping, valid until the reader is closed
+	bool readBlob(ModelCacheBlob& blob);
+private:
+	bool checkRemaining(uint64_t count, size_t elementSize);
+	bool readBytes(void* data, size_t size);
+};
+
+class ModelCache
+{
+public:
+	// bump whenever the importer or the cooked layout changes, outdated files are cooked again
+	static const uint32_t kImporterVersion = 4;
+	static const uint64_t kHashSeed = 14695981039346656037ull;
+
+	static uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
+
+	// one file per model and directory, a changed source or option overwrites it
+	static std::string getCacheFilename(const std::string& cacheDir, const std::string& modelFilename);
+	// the model file's bytes, and size and modification time of the files a .gltf refers to
+	static uint64_t hashSourceFiles(const std::string& modelFilename);
+	static bool createDirectory(const std::string& dir);
+	// moves a completely written file into place, replacing an older one; tmpFilename is removed if that fails
+	static bool replaceFile(const std::string& tmpFilename, const std::string& filename);
+
+	// the parts of a glTF model lights and cameras are created from: lights, cameras and the nodes that place them
+	static void writeLightsAndCameras(ModelCacheWriter& cache, const tinygltf::Model& gltfMdl);
+	static bool readLightsAndCameras(ModelCacheReader& cache, tinygltf::Model& gltfMdl);
+};
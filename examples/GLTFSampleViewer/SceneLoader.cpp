@@ -0,0 +1,269 @@
+#include "SceneLoader.h"
+#include "GltfImageDecoder.h"
+#include "TextureCooker.h"
+#include "KtxTranscoder.h"
+
+void Scene::destroy()
+{
+	if (camera) camera->destroy();
+	if (model) model->destroy();
+	if (lightMgr) lightMgr->destroy();
+	if (cameraFac) cameraFac->destroy();
+	if (mtlFac) mtlFac->destroy();
+	camera = nullptr;
+	model = nullptr;
+	lightMgr = nullptr;
+	cameraFac = nullptr;
+	mtlFac = nullptr;
+
+	// frees every descriptor set of the scene
+	if (descriptorPool) {
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		descriptorPool = VK_NULL_HANDLE;
+	}
+}
+
+/**
+ * SceneLoader
+ */
+SceneLoader::SceneLoader(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t frameCount, const UniformRingPtr& uniformRing, const TextureCachePtr& textureCache, const UploadManagerPtr& uploader)
+{
+	vulkanDevice_ = vulkanDevice;
+	queue_ = queue;
+	frameCount_ = std::max(1u, frameCount);
+	uniformRing_ = uniformRing;
+	textureCache_ = textureCache;
+	uploader_ = uploader;
+	commandPool_ = vulkanDevice_->createCommandPool(vulkanDevice_->queueFamilyIndices.graphics);
+
+	worker_ = std::thread(&SceneLoader::run, this);
+}
+SceneLoader::~SceneLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	wakeup_.notify_one();
+	// no more frames begin, a worker waiting for the upload budget goes on
+	if (uploader_) uploader_->setFrameBudget(0);
+	if (worker_.joinable()) worker_.join();
+
+	result_ = nullptr;
+	vkDestroyCommandPool(vulkanDevice_->logicalDevice, commandPool_, nullptr);
+}
+
+static bool parseGltfFile(tinygltf::Model& gltfMdl, const std::string& filename)
+{
+	gltfMdl = tinygltf::Model();
+
+	tinygltf::TinyGLTF gltfContext;
+	// images are only read during parsing and decoded afterwards in parallel
+	gltfContext.SetImageLoader(GltfImageDecoder::deferImageDecode, nullptr);
+	std::string error, warning;
+	bool result;
+	if (vks::tools::getFileNameExtension(filename) == "gltf") {
+		result = gltfContext.LoadASCIIFromFile(&gltfMdl, &error, &warning, filename);
+	}
+	else {
+		result = gltfContext.LoadBinaryFromFile(&gltfMdl, &error, &warning, filename);
+	}
+	if (!result) {
+		MessageBox(NULL, ("load model file " + filename + " failed!").c_str(), "SceneLoader error", MB_OK);
+	}
+	return result;
+}
+bool SceneLoader::loadGltfFile(tinygltf::Model& gltfMdl, const std::string& filename)
+{
+	if (!parseGltfFile(gltfMdl, filename)) return false;
+	GltfImageDecoder::decodeDeferredImages(gltfMdl);
+	return true;
+}
+
+ScenePtr SceneLoader::loadScene(const SceneLoadRequest& request)
+{
+	return buildScene(request, vulkanDevice_->commandPool, nullptr);
+}
+void SceneLoader::requestScene(const SceneLoadRequest& request)
+{
+	ScenePtr outdated;//released outside the lock, it waits for its uploads
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		request_ = request;
+		hasRequest_ = true;
+		// a finished scene that has not been picked up yet is already outdated
+		outdated = std::move(result_);
+		result_ = nullptr;
+		hasResult_ = false;
+		busy_ = true;
+		progress_ = 0.0f;
+	}
+	wakeup_.notify_one();
+}
+bool SceneLoader::pollScene(ScenePtr& scene)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!hasResult_) return false;
+	// the current scene is drawn until the new one is resident
+	if (result_ && uploader_ && !uploader_->isComplete(result_->model->getUploadValue())) return false;
+
+	scene = result_;
+	result_ = nullptr;
+	hasResult_ = false;
+	return true;
+}
+std::string SceneLoader::getStage() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stage_;
+}
+void SceneLoader::setStage(const char* stage, float progress)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	stage_ = stage;
+	progress_ = progress;
+}
+
+ScenePtr SceneLoader::createScene(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader, uint32_t materialCount, uint32_t skinCount) const
+{
+	ScenePtr scene = std::make_shared<Scene>();
+	scene->modelName = request.modelName;
+	scene->glb = request.glb;
+	scene->device = vulkanDevice_->logicalDevice;
+	{
+		// one set per material, one camera and one light set with dynamic offsets, skin sets per frame in flight plus the dummy skin.
+		// Bindless materials allocate from a pool of their own, see MaterialTable
+		materialCount = request.bindless ? 1 : std::max(1u, materialCount);
+		const uint32_t skinSetCount = skinCount * frameCount_ + 1;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, materialCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, materialCount * MATERIAL_TEXTURE_COUNT),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, skinSetCount),
+		};
+		const uint32_t maxSetCount = materialCount + 2 + skinSetCount;
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(scene->device, &descriptorPoolInfo, nullptr, &scene->descriptorPool));
+	}
+	scene->mtlFac = std::make_shared<MaterialFactory>(vulkanDevice_, scene->descriptorPool, request.bindless);
+	scene->cameraFac = std::make_shared<CameraFactory>(vulkanDevice_, scene->descriptorPool, uniformRing_);
+	scene->lightMgr = std::make_shared<LightManager>(vulkanDevice_, scene->descriptorPool, uniformRing_);
+	scene->model = std::make_shared<AnimatedModel>(vulkanDevice_, scene->descriptorPool, queue_, frameCount_);
+	scene->model->setUploadCommandPool(commandPool);
+	scene->model->setUploadManager(uploader);
+	scene->model->setTextureCache(textureCache_);
+	scene->model->setVertexLayout(request.vertexLayout);
+	scene->model->setMeshOptimization(request.optimizeMeshes);
+	return scene;
+}
+void SceneLoader::finishScene(Scene& scene, const SceneLoadRequest& request, tinygltf::Model& gltfMdl)
+{
+	scene.lightMgr->load(gltfMdl);
+	BoundingBox bbox = scene.model->getWorldBBox();
+	scene.camera = scene.cameraFac->creatCamera(request.aspect, bbox.min, bbox.max, gltfMdl);
+
+	setStage("Writing descriptors", 0.95f);
+	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
+	scene.camera->uploadDescriptorSet2Gpu(writeDescriptorSet);
+	scene.lightMgr->uploadDescriptorSet2Gpu(writeDescriptorSet);
+	scene.model->uploadDescriptorSet2Gpu(writeDescriptorSet);
+	vkUpdateDescriptorSets(scene.device, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+}
+
+ScenePtr SceneLoader::buildScene(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader)
+{
+	// a cooked model skips parsing, image decoding, mesh processing and mip generation
+	ModelCacheKey cacheKey;
+	std::string cacheFilename;
+	if (!request.modelCacheDir.empty()) {
+		setStage("Reading model cache", 0.0f);
+		cacheKey.sourceHash = ModelCache::hashSourceFiles(request.filename);
+		cacheKey.options = (uint32_t)request.vertexLayout | (request.optimizeMeshes ? 0x100u : 0u);
+		// a model cooked before its textures were holds them uncompressed
+		if (!request.cookedTextureDir.empty()) {
+			const uint64_t stamp = TextureCooker::getDirectoryStamp(request.cookedTextureDir);
+			cacheKey.sourceHash = ModelCache::hashBytes(cacheKey.sourceHash, &stamp, sizeof(stamp));
+		}
+		cacheFilename = ModelCache::getCacheFilename(request.modelCacheDir, request.filename);
+
+		ModelCacheReader cache;
+		if (cache.open(cacheFilename, cacheKey)) {
+			ScenePtr scene = buildSceneFromCache(request, commandPool, uploader, cache);
+			if (scene) return scene;
+			std::cout << "Model cache \"" << cacheFilename << "\" is damaged, cooking the model again\n";
+		}
+	}
+
+	tinygltf::Model gltfMdl;
+	setStage("Parsing", 0.0f);
+	if (!parseGltfFile(gltfMdl, request.filename)) return nullptr;
+
+	setStage("Decoding images", 0.2f);
+	if (!request.cookedTextureDir.empty()) TextureCooker::useCookedTextures(gltfMdl, request.cookedTextureDir, KtxTranscoder(vulkanDevice_));
+	GltfImageDecoder::decodeDeferredImages(gltfMdl);
+
+	setStage("Uploading", 0.6f);
+	ScenePtr scene = createScene(request, commandPool, uploader, (uint32_t)gltfMdl.materials.size(), (uint32_t)gltfMdl.skins.size());
+
+	// written next to the upload, a failed load leaves no file behind
+	ModelCacheWriter cacheWriter;
+	const bool cooking = !cacheFilename.empty() && ModelCache::createDirectory(request.modelCacheDir)
+		&& cacheWriter.open(cacheFilename, cacheKey);
+	if (cooking) {
+		cacheWriter.write((uint32_t)gltfMdl.materials.size());
+		cacheWriter.write((uint32_t)gltfMdl.skins.size());
+		ModelCache::writeLightsAndCameras(cacheWriter, gltfMdl);
+	}
+	if (!scene->model->load(gltfMdl, *scene->mtlFac, false, cooking ? &cacheWriter : nullptr)) return nullptr;
+	if (cooking && !cacheWriter.commit()) {
+		std::cerr << "Could not write model cache \"" << cacheFilename << "\"\n";
+	}
+
+	finishScene(*scene, request, gltfMdl);
+	setStage("Done", 1.0f);
+	return scene;
+}
+ScenePtr SceneLoader::buildSceneFromCache(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader, ModelCacheReader& cache)
+{
+	uint32_t materialCount = 0, skinCount = 0;
+	tinygltf::Model gltfMdl;//lights, cameras and their nodes only
+	cache.read(materialCount);
+	cache.read(skinCount);
+	if (!ModelCache::readLightsAndCameras(cache, gltfMdl)) return nullptr;
+
+	setStage("Uploading", 0.2f);
+	ScenePtr scene = createScene(request, commandPool, uploader, materialCount, skinCount);
+	if (!scene->model->load(cache, *scene->mtlFac)) return nullptr;
+
+	finishScene(*scene, request, gltfMdl);
+	setStage("Done", 1.0f);
+	return scene;
+}
+
+void SceneLoader::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		wakeup_.wait(lock, [this] { return quit_ || hasRequest_; });
+		if (quit_) break;
+
+		SceneLoadRequest request = request_;
+		hasRequest_ = false;
+		lock.unlock();
+		ScenePtr scene = buildScene(request, commandPool_, uploader_);
+		lock.lock();
+
+		// the user picked another model meanwhile, this scene was never drawn and is dropped right away
+		if (hasRequest_) {
+			lock.unlock();
+			scene = nullptr;//waits for its uploads
+			lock.lock();
+			continue;
+		}
+
+		result_ = scene;
+		hasResult_ = true;
+		busy_ = false;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "Material.h"
+#include "AnimatedModel.h"
+#include "Camera.h"
+#include "Light.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Everything loaded from one glTF file. A scene allocates its descriptor sets from a pool of its own,
+// so it can be built on another thread and destroying the pool releases all of its sets at once
+struct Scene
+{
+	std::string modelName;
+	bool glb = false;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	MaterialFactoryPtr mtlFac;
+	CameraFactoryPtr cameraFac;
+	LightManagerPtr lightMgr;
+	AnimatedModelPtr model;
+	CameraPtr camera;
+
+	~Scene() { destroy(); }
+	void destroy();
+};
+using ScenePtr = std::shared_ptr<Scene>;
+
+struct SceneLoadRequest
+{
+	std::string filename;
+	std::string modelName;
+	bool glb = false;
+	float aspect = 1.0f;
+	VertexLayout vertexLayout = kVertexLayout_Full;
+	bool optimizeMeshes = false;
+	std::string modelCacheDir;//cooked models are read from and written to it, empty disables the model cache
+	std::string cookedTextureDir;//KTX2 files of GLTFTextureCooker replace the images they were cooked from, empty disables them
+	bool bindless = false;//one MaterialTable per model instead of a descriptor set per material
+};
+
+// Builds scenes on a worker thread: parse, image decode, texture and buffer uploads and descriptor writes.
+// The worker records into a command pool of its own and shares the queue with the render thread through VulkanDevice::queueMutex.
+// The render thread keeps drawing its current scene and picks the finished one up with pollScene at a frame boundary.
+// With an UploadManager the worker stages its uploads through it and pollScene holds the scene back until they are complete
+class SceneLoader
+{
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	VkQueue queue_ = VK_NULL_HANDLE;
+	uint32_t frameCount_ = 1;
+	UniformRingPtr uniformRing_;//holds the camera and light constants of every scene
+	TextureCachePtr textureCache_;//shares images and samplers with the scene being replaced and the skybox
+	VkCommandPool commandPool_ = VK_NULL_HANDLE;//used by the worker only
+	UploadManagerPtr uploader_;//used by the worker only, the only thread recording into it
+
+	std::thread worker_;
+	mutable std::mutex mutex_;
+	std::condition_variable wakeup_;
+	bool quit_ = false;
+	bool hasRequest_ = false;
+	SceneLoadRequest request_;
+	bool hasResult_ = false;
+	ScenePtr result_;
+
+	std::atomic<bool> busy_{ false };
+	std::atomic<float> progress_{ 0.0f };
+	const char* stage_ = "";
+public:
+	SceneLoader(vks::VulkanDevice* vulkanDevice, VkQueue queue, uint32_t frameCount, const UniformRingPtr& uniformRing, const TextureCachePtr& textureCache, const UploadManagerPtr& uploader = nullptr);
+	~SceneLoader();
+
+	// Loads on the calling thread with the device command pool, for the first scene when there is nothing to show yet.
+	// The uploads are waited for, the scene can be drawn right away
+	ScenePtr loadScene(const SceneLoadRequest& request);
+	// Queues a background load, a request made while another one is running replaces the one still waiting
+	void requestScene(const SceneLoadRequest& request);
+	// Returns true once per finished request whose uploads are complete, scene is null if loading failed
+	bool pollScene(ScenePtr& scene);
+
+	bool isBusy() const { return busy_; }
+	float getProgress() const { return progress_; }
+	std::string getStage() const;
+
+	static bool loadGltfFile(tinygltf::Model& gltfMdl, const std::string& filename);
+private:
+	ScenePtr buildScene(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader);
+	ScenePtr buildSceneFromCache(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader, ModelCacheReader& cache);
+	ScenePtr createScene(const SceneLoadRequest& request, VkCommandPool commandPool, const UploadManagerPtr& uploader, uint32_t materialCount, uint32_t skinCount) const;
+	void finishScene(Scene& scene, const SceneLoadRequest& request, tinygltf::Model& gltfMdl);
+	void setStage(const char* stage, float progress);
+	void run();
+};
+using SceneLoaderPtr = std::shared_ptr<SceneLoader>;
@@ -0,0 +1,50 @@
+#include "SkinningPalette.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SKINNING_PALETTE_SSE
+#include <xmmintrin.h>
+#endif
+
+void SkinningPalette::multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+#if defined(SKINNING_PALETTE_SSE)
+	const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+	const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+	const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+	const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (int col = 0; col < 4; ++col) {
+		// each output column only reads the same column of b, so writing out in place is safe
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[col][0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[col][1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[col][2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[col][3])));
+		_mm_storeu_ps(&out[col][0], r);
+	}
+#else
+	out = a * b;
+#endif
+}
+void SkinningPalette::build(const glm::mat4& inverseSkinWorld, const TransformHierarchy& transforms,
+	const int* jointNodes, const glm::mat4* inverseBindMatrices, uint32_t jointCount, glm::mat4* palette)
+{
+	glm::mat4 jointMatrix;
+	for (uint32_t i = 0; i < jointCount; ++i) {
+		if (jointNodes[i] < 0) {
+			palette[i] = glm::mat4(1.0);
+			continue;
+		}
+		multiply(transforms.getWorldMatrix(jointNodes[i]), inverseBindMatrices[i], jointMatrix);
+		multiply(inverseSkinWorld, jointMatrix, jointMatrix);
+		// palette points to write-combined memory, store each matrix once
+		memcpy(&palette[i], &jointMatrix, sizeof(glm::mat4));
+	}
+}
+bool SkinningPalette::isChanged(int skinNode, const TransformHierarchy& transforms, const int* jointNodes, uint32_t jointCount)
+{
+	if (transforms.isWorldChanged(skinNode)) return true;
+	for (uint32_t i = 0; i < jointCount; ++i) {
+		if (jointNodes[i] >= 0 && transforms.isWorldChanged(jointNodes[i]))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include "TransformHierarchy.h"
+
+// Joint matrix palette of a skin, written straight into mapped GPU memory
+class SkinningPalette
+{
+public:
+	// out = a * b (column-major, same as glm), out may alias a or b
+	static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+	// palette[i] = inverse(skin node world) * joint world * inverseBindMatrices[i]
+	// jointNodes index into transforms, a negative index writes identity
+	static void build(const glm::mat4& inverseSkinWorld, const TransformHierarchy& transforms,
+		const int* jointNodes, const glm::mat4* inverseBindMatrices, uint32_t jointCount, glm::mat4* palette);
+
+	// true if any joint or the skin node moved during the last TransformHierarchy::update
+	static bool isChanged(int skinNode, const TransformHierarchy& transforms, const int* jointNodes, uint32_t jointCount);
+};
@@ -0,0 +1,119 @@
+#include "TextureCache.h"
+#include "ModelCache.h"
+
+TextureCache::TextureCache(vks::VulkanDevice* vulkanDevice)
+{
+	vulkanDevice_ = vulkanDevice;
+}
+TextureCache::~TextureCache()
+{
+	destroy();
+}
+void TextureCache::destroy()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (SamplerEntry& entry : samplers_) {
+		vkSafeDestroySampler(vulkanDevice_->logicalDevice, entry.sampler);
+	}
+	samplers_.clear();
+	images_.clear();
+	stats_ = Stats();
+}
+
+uint64_t TextureCache::makeImageKey(uint64_t contentHash, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	const uint32_t params[4] = { (uint32_t)format, width, height, mipLevels };
+	return ModelCache::hashBytes(contentHash, params, sizeof(params));
+}
+TextureCache::ImagePtr TextureCache::findImage(uint64_t key, uint64_t& uploadValue)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto iter = images_.find(key);
+	if (iter == images_.end()) return nullptr;
+	ImagePtr image = iter->second.image.lock();
+	if (!image) {
+		images_.erase(iter);
+		return nullptr;
+	}
+	uploadValue = iter->second.uploadValue;
+	++stats_.imageHits;
+	return image;
+}
+TextureCache::ImagePtr TextureCache::addImage(uint64_t key, const vks::Texture2D& image, uint64_t uploadValue)
+{
+	ImagePtr result(new vks::Texture2D(image), [](vks::Texture2D* image) {
+		image->destroy();
+		delete image;
+	});
+	std::lock_guard<std::mutex> lock(mutex_);
+	// a load on another thread may have uploaded the same image meanwhile, both stay valid and the later one is shared
+	ImageEntry& entry = images_[key];
+	entry.image = result;
+	entry.uploadValue = uploadValue;
+	return result;
+}
+// field by field, the padding of SamplerOption is not initialized
+static bool isSameSamplerOption(const vks::Texture2D::SamplerOption& l, const vks::Texture2D::SamplerOption& r)
+{
+	return l.magFilter == r.magFilter && l.minFilter == r.minFilter && l.mipmapMode == r.mipmapMode
+		&& l.addressModeU == r.addressModeU && l.addressModeV == r.addressModeV && l.addressModeW == r.addressModeW
+		&& l.compareEnable == r.compareEnable && l.compareOp == r.compareOp && l.anisotropyEnable == r.anisotropyEnable;
+}
+VkSampler TextureCache::getSampler(const vks::Texture2D::SamplerOption& samplerOpt, bool mipmaps)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const SamplerEntry& entry : samplers_) {
+		if (entry.mipmaps == mipmaps && isSameSamplerOption(entry.samplerOpt, samplerOpt)) {
+			++stats_.samplerHits;
+			return entry.sampler;
+		}
+	}
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = samplerOpt.magFilter;
+	samplerCreateInfo.minFilter = samplerOpt.minFilter;
+	samplerCreateInfo.mipmapMode = samplerOpt.mipmapMode;
+	samplerCreateInfo.addressModeU = samplerOpt.addressModeU;
+	samplerCreateInfo.addressModeV = samplerOpt.addressModeV;
+	samplerCreateInfo.addressModeW = samplerOpt.addressModeW;
+	samplerCreateInfo.compareEnable = samplerOpt.compareEnable;
+	samplerCreateInfo.compareOp = samplerOpt.compareOp;
+	if (samplerOpt.anisotropyEnable) {
+		samplerCreateInfo.maxAnisotropy = vulkanDevice_->enabledFeatures.samplerAnisotropy ? vulkanDevice_->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = vulkanDevice_->enabledFeatures.samplerAnisotropy;
+	}
+	else {
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.anisotropyEnable = false;
+	}
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.minLod = 0.0f;
+	// shared by images of any size, the view clamps to the levels an image has
+	samplerCreateInfo.maxLod = mipmaps ? VK_LOD_CLAMP_NONE : 0.0f;
+	SamplerEntry entry;
+	entry.samplerOpt = samplerOpt;
+	entry.mipmaps = mipmaps;
+	VK_CHECK_RESULT(vkCreateSampler(vulkanDevice_->logicalDevice, &samplerCreateInfo, nullptr, &entry.sampler));
+	samplers_.push_back(entry);
+	return entry.sampler;
+}
+vks::Texture2D TextureCache::makeTexture(const vks::Texture2D& image, VkSampler sampler)
+{
+	vks::Texture2D texture = image;
+	texture.sampler = sampler;
+	texture.updateDescriptor();
+	return texture;
+}
+
+TextureCache::Stats TextureCache::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Stats stats = stats_;
+	stats.images = 0;
+	for (const auto& it : images_) {
+		if (!it.second.image.expired()) ++stats.images;
+	}
+	stats.samplers = (uint32_t)samplers_.size();
+	return stats;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include <mutex>
+#include <unordered_map>
+
+// Shares GPU images and samplers between the textures of all models, the skybox included.
+// An image is found by a hash of its contents and the way it was uploaded, so an image that several glTF textures,
+// materials or models refer to is uploaded once. The models own their images, the cache only remembers them until the
+// last model lets go. Samplers are found by their options and live as long as the cache, there are only a handful.
+// Scenes are built on the loader thread, so all of it is thread safe
+class TextureCache
+{
+public:
+	using ImagePtr = std::shared_ptr<vks::Texture2D>;//without a sampler of its own
+	struct Stats
+	{
+		uint32_t images = 0;//alive
+		uint32_t imageHits = 0;//uploads saved by sharing
+		uint32_t samplers = 0;
+		uint32_t samplerHits = 0;
+	};
+private:
+	struct ImageEntry
+	{
+		std::weak_ptr<vks::Texture2D> image;
+		uint64_t uploadValue = 0;//of the UploadManager batch that uploaded it, 0 if it was waited for
+	};
+	struct SamplerEntry
+	{
+		vks::Texture2D::SamplerOption samplerOpt;
+		bool mipmaps;
+		VkSampler sampler;
+	};
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	std::mutex mutex_;
+	std::unordered_map<uint64_t, ImageEntry> images_;
+	std::vector<SamplerEntry> samplers_;
+	Stats stats_;
+public:
+	TextureCache(vks::VulkanDevice* vulkanDevice);
+	~TextureCache();
+	// the samplers, after every model using them was destroyed
+	void destroy();
+
+	// content is a hash of the staged bytes, the upload parameters tell apart the same pixels uploaded in other ways
+	static uint64_t makeImageKey(uint64_t contentHash, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+	// null if no model holds the image any more, uploadValue has to complete before it is sampled
+	ImagePtr findImage(uint64_t key, uint64_t& uploadValue);
+	// destroys the texture once the last ImagePtr is released
+	ImagePtr addImage(uint64_t key, const vks::Texture2D& image, uint64_t uploadValue);
+	// without mipmaps the sampler stays at the base level of images that have more
+	VkSampler getSampler(const vks::Texture2D::SamplerOption& samplerOpt, bool mipmaps);
+	// a material texture: the shared image sampled with the shared sampler, not to be destroyed
+	static vks::Texture2D makeTexture(const vks::Texture2D& image, VkSampler sampler);
+
+	Stats getStats();
+};
+using TextureCachePtr = std::shared_ptr<TextureCache>;
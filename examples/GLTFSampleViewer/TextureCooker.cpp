@@ -0,0 +1,237 @@
+#include "TextureCooker.h"
+#include "BlockCompressor.h"
+#include "GltfImageDecoder.h"
+#include "KtxTranscoder.h"
+#include "ModelCache.h"
+#include <ktx.h>
+#include <sys/stat.h>
+
+// block rows encoded by one job, small enough to balance a few large images over all threads
+static const uint32_t sBandRows = 16;
+
+TextureCooker::TextureCooker(uint32_t threadCount)
+{
+	threadCount_ = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadPool_.setThreadCount(threadCount_);
+}
+
+static TextureCooker::Usage mergeUsage(TextureCooker::Usage usage, TextureCooker::Usage other)
+{
+	if (usage == TextureCooker::kUsage_None || usage == other) return other;
+	// occlusion packed into the red channel of a metallic roughness map
+	if ((usage == TextureCooker::kUsage_Occlusion && other == TextureCooker::kUsage_MetallicRoughness)
+		|| (usage == TextureCooker::kUsage_MetallicRoughness && other == TextureCooker::kUsage_Occlusion))
+		return TextureCooker::kUsage_MetallicRoughness;
+	// BC7 keeps all channels of an image read in different ways
+	return TextureCooker::kUsage_Color;
+}
+std::vector<TextureCooker::Usage> TextureCooker::getImageUsages(const tinygltf::Model& gltfMdl)
+{
+	std::vector<Usage> usages(gltfMdl.images.size(), kUsage_None);
+	auto func_source = [&](int textureIndex) {
+		if (textureIndex < 0 || textureIndex >= (int)gltfMdl.textures.size()) return -1;
+		const tinygltf::Texture& texture = gltfMdl.textures[textureIndex];
+		// AnimatedModel uploads the KTX2 image of the extension instead
+		if (texture.extensions.find("KHR_texture_basisu") != texture.extensions.end()) return -1;
+		return (texture.source >= 0 && texture.source < (int)usages.size()) ? texture.source : -1;
+	};
+	auto func_use = [&](int textureIndex, Usage usage) {
+		const int imageIndex = func_source(textureIndex);
+		if (imageIndex >= 0) usages[imageIndex] = mergeUsage(usages[imageIndex], usage);
+	};
+	for (const tinygltf::Material& material : gltfMdl.materials) {
+		func_use(material.pbrMetallicRoughness.baseColorTexture.index, kUsage_Color);
+		func_use(material.emissiveTexture.index, kUsage_Color);
+		func_use(material.normalTexture.index, kUsage_Normal);
+		func_use(material.occlusionTexture.index, kUsage_Occlusion);
+		func_use(material.pbrMetallicRoughness.metallicRoughnessTexture.index, kUsage_MetallicRoughness);
+	}
+	// textures of material extensions are read in too many ways to tell, they keep all channels
+	for (int i = 0; i < (int)gltfMdl.textures.size(); ++i) {
+		const int imageIndex = func_source(i);
+		if (imageIndex >= 0 && usages[imageIndex] == kUsage_None) usages[imageIndex] = kUsage_Color;
+	}
+	return usages;
+}
+VkFormat TextureCooker::getCookedFormat(Usage usage)
+{
+	// BC5 would suit normal maps better, but the shaders read them as .rgb and BC5 has no blue channel
+	switch (usage) {
+	case kUsage_Color: return VK_FORMAT_BC7_SRGB_BLOCK;
+	case kUsage_Normal: return VK_FORMAT_BC7_UNORM_BLOCK;
+	case kUsage_Occlusion: return VK_FORMAT_BC4_UNORM_BLOCK;
+	case kUsage_MetallicRoughness: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	default: return VK_FORMAT_UNDEFINED;
+	}
+}
+std::string TextureCooker::getCookedFilename(const std::string& cookedDir, const tinygltf::Image& encodedImage, Usage usage)
+{
+	const uint32_t key[2] = { kCookerVersion, (uint32_t)usage };
+	uint64_t hash = ModelCache::hashBytes(ModelCache::kHashSeed, encodedImage.image.data(), encodedImage.image.size());
+	hash = ModelCache::hashBytes(hash, key, sizeof(key));
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return cookedDir + "/" + name + ".ktx2";
+}
+uint64_t TextureCooker::getDirectoryStamp(const std::string& cookedDir)
+{
+	struct stat st;
+	if (stat(cookedDir.c_str(), &st) != 0) return 0;
+	const uint64_t stamp[2] = { (uint64_t)st.st_size, (uint64_t)st.st_mtime };
+	return ModelCache::hashBytes(ModelCache::kHashSeed, stamp, sizeof(stamp));
+}
+
+static bool isCookable(const tinygltf::Image& image, TextureCooker::Usage usage)
+{
+	return usage != TextureCooker::kUsage_None && image.as_is && !image.image.empty()
+		&& !KtxTranscoder::isKtx2(image.image.data(), image.image.size());
+}
+static bool readFile(const std::string& filename, std::vector<unsigned char>& bytes)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+	bool result = fseek(file, 0, SEEK_END) == 0;
+	const long size = result ? ftell(file) : -1;
+	result = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (result) {
+		bytes.resize((size_t)size);
+		result = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	}
+	fclose(file);
+	return result;
+}
+uint32_t TextureCooker::useCookedTextures(tinygltf::Model& gltfMdl, const std::string& cookedDir, const KtxTranscoder& transcoder)
+{
+	const std::vector<Usage> usages = getImageUsages(gltfMdl);
+	uint32_t count = 0;
+	std::vector<unsigned char> bytes;
+	for (size_t i = 0; i < gltfMdl.images.size(); ++i) {
+		tinygltf::Image& image = gltfMdl.images[i];
+		if (!isCookable(image, usages[i]) || !transcoder.isFormatSupported(getCookedFormat(usages[i]))) continue;
+		if (!readFile(getCookedFilename(cookedDir, image, usages[i]), bytes) || !KtxTranscoder::isKtx2(bytes.data(), bytes.size())) continue;
+		// stays as_is, GltfImageDecoder leaves KTX2 images to AnimatedModel
+		image.image.swap(bytes);
+		++count;
+	}
+	return count;
+}
+
+static bool writeKtx2(const std::string& filename, VkFormat format, uint32_t width, uint32_t height,
+	const std::vector<VkDeviceSize>& levelOffsets, const std::vector<uint8_t>& blocks)
+{
+	ktxTextureCreateInfo createInfo = {};
+	createInfo.vkFormat = format;
+	createInfo.baseWidth = width;
+	createInfo.baseHeight = height;
+	createInfo.baseDepth = 1;
+	createInfo.numDimensions = 2;
+	createInfo.numLevels = (uint32_t)levelOffsets.size();
+	createInfo.numLayers = 1;
+	createInfo.numFaces = 1;
+	createInfo.isArray = KTX_FALSE;
+	createInfo.generateMipmaps = KTX_FALSE;
+	ktxTexture2* texture = nullptr;
+	if (ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) return false;
+
+	// levels are 16 byte aligned in blocks, the file packs them tightly
+	const uint32_t blockSize = vks::tools::formatBlockSize(format);
+	bool result = true;
+	for (uint32_t level = 0; level < createInfo.numLevels && result; ++level) {
+		const uint32_t blocksX = (std::max(1u, width >> level) + 3) / 4, blocksY = (std::max(1u, height >> level) + 3) / 4;
+		result = ktxTexture_SetImageFromMemory(ktxTexture(texture), level, 0, 0,
+			blocks.data() + levelOffsets[level], (ktx_size_t)blocksX * blocksY * blockSize) == KTX_SUCCESS;
+	}
+	const std::string tmpFilename = filename + ".tmp";
+	result = result && ktxTexture_WriteToNamedFile(ktxTexture(texture), tmpFilename.c_str()) == KTX_SUCCESS;
+	ktxTexture_Destroy(ktxTexture(texture));
+	if (!result) {
+		remove(tmpFilename.c_str());
+		return false;
+	}
+	return ModelCache::replaceFile(tmpFilename, filename);
+}
+bool TextureCooker::cookModel(tinygltf::Model& gltfMdl, const std::string& cookedDir, bool force, Stats& stats)
+{
+	struct CookJob
+	{
+		int imageIndex;
+		VkFormat format;
+		std::string filename;
+		uint32_t width = 0, height = 0;
+		std::vector<VkDeviceSize> rgbaOffsets, levelOffsets;
+		std::vector<uint8_t> rgba, blocks;
+	};
+	const std::vector<Usage> usages = getImageUsages(gltfMdl);
+	std::vector<CookJob> jobs;
+	for (size_t i = 0; i < gltfMdl.images.size(); ++i) {
+		tinygltf::Image& image = gltfMdl.images[i];
+		if (isCookable(image, usages[i])) {
+			CookJob job;
+			job.imageIndex = (int)i;
+			job.format = getCookedFormat(usages[i]);
+			job.filename = getCookedFilename(cookedDir, image, usages[i]);
+			struct stat st;
+			if (force || stat(job.filename.c_str(), &st) != 0) {
+				jobs.push_back(std::move(job));
+				continue;
+			}
+			++stats.upToDate;
+		}
+		// only the images to cook are decoded
+		image.image.clear();
+	}
+	if (jobs.empty()) return true;
+	if (!ModelCache::createDirectory(cookedDir)) {
+		std::cerr << "Could not create directory \"" << cookedDir << "\"\n";
+		stats.failed += (uint32_t)jobs.size();
+		return false;
+	}
+	GltfImageDecoder::decodeDeferredImages(gltfMdl, threadCount_);
+
+	// the CPU box filter of the viewer's staged mip chains, one image per job
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		threadPool_.threads[i % threadPool_.threads.size()]->addJob([&gltfMdl, &jobs, i] {
+			CookJob& job = jobs[i];
+			const tinygltf::Image& image = gltfMdl.images[job.imageIndex];
+			if (image.as_is || image.image.empty() || image.component != 4) return;
+
+			job.width = image.width;
+			job.height = image.height;
+			const uint32_t mipLevels = vks::Texture2D::getMipLevelCount(job.width, job.height);
+			job.rgba.resize(vks::Texture2D::getMipChainLayout(job.width, job.height, mipLevels, 4, job.rgbaOffsets));
+			memcpy(job.rgba.data(), image.image.data(), (size_t)job.width * job.height * 4);
+			vks::Texture2D::buildMipChainRGBA8(job.rgba.data(), job.width, job.height, mipLevels, job.rgbaOffsets, job.format == VK_FORMAT_BC7_SRGB_BLOCK);
+			job.blocks.resize(vks::Texture2D::getMipChainLayout(job.format, job.width, job.height, mipLevels, job.levelOffsets));
+		});
+	}
+	threadPool_.wait();
+
+	// bands of block rows of every level of every image, dealt out in turn
+	size_t band = 0;
+	for (CookJob& job : jobs) {
+		for (uint32_t level = 0; level < (uint32_t)job.levelOffsets.size(); ++level) {
+			const uint32_t levelWidth = std::max(1u, job.width >> level), levelHeight = std::max(1u, job.height >> level);
+			const uint32_t blocksY = (levelHeight + 3) / 4;
+			for (uint32_t row = 0; row < blocksY; row += sBandRows, ++band) {
+				threadPool_.threads[band % threadPool_.threads.size()]->addJob([&job, level, levelWidth, levelHeight, row] {
+					BlockCompressor::compressRows(job.format, job.rgba.data() + job.rgbaOffsets[level], levelWidth, levelHeight,
+						row, sBandRows, job.blocks.data() + job.levelOffsets[level]);
+				});
+			}
+		}
+	}
+	threadPool_.wait();
+
+	bool result = true;
+	for (CookJob& job : jobs) {
+		const tinygltf::Image& image = gltfMdl.images[job.imageIndex];
+		if (job.levelOffsets.empty() || !writeKtx2(job.filename, job.format, job.width, job.height, job.levelOffsets, job.blocks)) {
+			std::cerr << "cook image[" << job.imageIndex << "] \"" << image.name << "\" to \"" << job.filename << "\" failed\n";
+			++stats.failed;
+			result = false;
+			continue;
+		}
+		++stats.cooked;
+	}
+	return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include "threadpool.hpp"
+
+class KtxTranscoder;
+
+// Cooks the material textures of a glTF model offline to block compressed KTX2 files with full mip chains:
+// BC7 for color and normal maps, BC4 for occlusion maps and BC1 for metallic roughness (and packed ORM) maps.
+// A cooked file is named by a hash of the encoded source image, its usage and the cooker version, so it is found again
+// for the same image in any model and a changed image is cooked anew. The viewer swaps cooked files in for the encoded
+// images with useCookedTextures before decoding, AnimatedModel uploads them like other KTX2 images
+class TextureCooker
+{
+public:
+	enum Usage
+	{
+		kUsage_None,//not referenced by a texture, or through KHR_texture_basisu only
+		kUsage_Color,
+		kUsage_Normal,
+		kUsage_Occlusion,
+		kUsage_MetallicRoughness,//occlusion may share the image
+	};
+	struct Stats
+	{
+		uint32_t cooked = 0;
+		uint32_t upToDate = 0;
+		uint32_t failed = 0;
+	};
+	// bump whenever an encoder changes, files of older versions are not found any more
+	static const uint32_t kCookerVersion = 2;
+private:
+	vks::ThreadPool threadPool_;
+	uint32_t threadCount_ = 1;
+public:
+	// threadCount 0 uses one thread per hardware core
+	TextureCooker(uint32_t threadCount = 0);
+
+	// Cooks the images of a model parsed with GltfImageDecoder::deferImageDecode, still encoded.
+	// Images are decoded and mipmapped in parallel, then the blocks of all of them are encoded in bands across the threads.
+	// Files that exist already are kept unless force is set
+	bool cookModel(tinygltf::Model& gltfMdl, const std::string& cookedDir, bool force, Stats& stats);
+
+	static std::vector<Usage> getImageUsages(const tinygltf::Model& gltfMdl);
+	static VkFormat getCookedFormat(Usage usage);
+	static std::string getCookedFilename(const std::string& cookedDir, const tinygltf::Image& encodedImage, Usage usage);
+	// size and modification time of the directory, changes whenever a texture is cooked into it
+	static uint64_t getDirectoryStamp(const std::string& cookedDir);
+	// Replaces the bytes of encoded images that have a cooked file by the file, call before GltfImageDecoder::decodeDeferredImages.
+	// Images whose cooked format the device does not sample keep their bytes and are decoded as before
+	static uint32_t useCookedTextures(tinygltf::Model& gltfMdl, const std::string& cookedDir, const KtxTranscoder& transcoder);
+};
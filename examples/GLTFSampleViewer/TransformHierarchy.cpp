@@ -0,0 +1,53 @@
+#include "TransformHierarchy.h"
+#include "Transform.h"
+
+void TransformHierarchy::clear()
+{
+	parents_.clear();
+	subtreeEnds_.clear();
+	translations_.clear();
+	rotations_.clear();
+	scales_.clear();
+	baseMatrices_.clear();
+	localMatrices_.clear();
+	worldMatrices_.clear();
+	dirty_.clear();
+	worldChanged_.clear();
+	anyWorldChanged_ = false;
+}
+int TransformHierarchy::addNode(int parent, const glm::vec3& t, const glm::quat& r, const glm::vec3& s, const glm::mat4& matrix)
+{
+	int index = size();
+	assert(parent < index);
+
+	parents_.push_back(parent);
+	subtreeEnds_.push_back(index + 1);
+	translations_.push_back(t);
+	rotations_.push_back(r);
+	scales_.push_back(s);
+	baseMatrices_.push_back(matrix);
+	localMatrices_.push_back(glm::mat4(1.0));
+	worldMatrices_.push_back(glm::mat4(1.0));
+	dirty_.push_back(true);
+	worldChanged_.push_back(false);
+	return index;
+}
+void TransformHierarchy::update()
+{
+	anyWorldChanged_ = false;
+	const int count = size();
+	for (int i = 0; i < count; ++i)
+	{
+		int parent = parents_[i];
+		bool changed = dirty_[i] || (parent >= 0 && worldChanged_[parent]);
+		if (dirty_[i]) {
+			localMatrices_[i] = Transform::composeMatrix(translations_[i], rotations_[i], scales_[i]) * baseMatrices_[i];
+			dirty_[i] = false;
+		}
+		if (changed) {
+			worldMatrices_[i] = (parent >= 0) ? worldMatrices_[parent] * localMatrices_[i] : localMatrices_[i];
+			anyWorldChanged_ = true;
+		}
+		worldChanged_[i] = changed;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "gltfShaderStruct.h"
+
+// Flattened node transforms stored as structure of arrays.
+// Nodes are kept in depth-first pre-order, so a parent always precedes its children
+// and the subtree of node i is the contiguous range [i, getSubtreeEnd(i)).
+class TransformHierarchy
+{
+public:
+	void clear();
+	int addNode(int parent, const glm::vec3& t, const glm::quat& r, const glm::vec3& s, const glm::mat4& matrix);
+	void endSubtree(int index) { subtreeEnds_[index] = size(); }
+
+	void setTranslation(int index, const glm::vec3& t) { translations_[index] = t; dirty_[index] = true; }
+	void setRotation(int index, const glm::quat& r) { rotations_[index] = r; dirty_[index] = true; }
+	void setScale(int index, const glm::vec3& s) { scales_[index] = s; dirty_[index] = true; }
+
+	// recompute local matrices of dirty nodes and world matrices of their subtrees in one linear pass
+	void update();
+
+	int size() const { return (int)parents_.size(); }
+	int getParent(int index) const { return parents_[index]; }
+	int getSubtreeEnd(int index) const { return subtreeEnds_[index]; }
+	const glm::vec3& getTranslation(int index) const { return translations_[index]; }
+	const glm::quat& getRotation(int index) const { return rotations_[index]; }
+	const glm::vec3& getScale(int index) const { return scales_[index]; }
+	const glm::mat4& getBaseMatrix(int index) const { return baseMatrices_[index]; }
+	const glm::mat4& getLocalMatrix(int index) const { return localMatrices_[index]; }
+	const glm::mat4& getWorldMatrix(int index) const { return worldMatrices_[index]; }
+	// world matrix was rewritten by the last update()
+	bool isWorldChanged(int index) const { return worldChanged_[index] != 0; }
+	bool isAnyWorldChanged() const { return anyWorldChanged_; }
+private:
+	std::vector<int> parents_;
+	std::vector<int> subtreeEnds_;
+	std::vector<glm::vec3> translations_;
+	std::vector<glm::quat> rotations_;
+	std::vector<glm::vec3> scales_;
+	std::vector<glm::mat4> baseMatrices_;//node.matrix of glTF, applied after TRS
+	std::vector<glm::mat4> localMatrices_;
+	std::vector<glm::mat4> worldMatrices_;
+	std::vector<uint8_t> dirty_;
+	std::vector<uint8_t> worldChanged_;
+	bool anyWorldChanged_ = false;
+};
@@ -0,0 +1,116 @@
+#include "UniformRing.h"
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing(vks::VulkanDevice* vulkanDevice, uint32_t frameCount, uint32_t frameSize)
+{
+	vulkanDevice_ = vulkanDevice;
+	frameCount_ = std::max(1u, frameCount);
+
+	// flushed ranges of non-coherent memory have to start and end at atom boundaries as well
+	const VkPhysicalDeviceLimits& limits = vulkanDevice_->properties.limits;
+	alignment_ = (uint32_t)std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+	alignment_ = std::max(1u, alignment_);
+	frameStride_ = alignUp(frameSize, alignment_);
+
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffer_, (VkDeviceSize)frameStride_ * frameCount_));
+	VK_CHECK_RESULT(buffer_.map());
+
+	// createBuffer picked the first host visible type, it may not be coherent
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(vulkanDevice_->logicalDevice, buffer_.buffer, &memReqs);
+	const uint32_t memoryType = vulkanDevice_->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	coherent_ = (vulkanDevice_->memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	freeRanges_.push_back({ 0, frameStride_ });
+}
+UniformRing::~UniformRing()
+{
+	destroy();
+}
+void UniformRing::destroy()
+{
+	buffer_.destroy();
+	freeRanges_.clear();
+}
+
+bool UniformRing::allocateBlock(Block& block, uint32_t size)
+{
+	const uint32_t allocSize = alignUp(std::max(1u, size), alignment_);
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto it = freeRanges_.begin(); it != freeRanges_.end(); ++it) {
+		if (it->size < allocSize) continue;
+
+		block.offset = it->offset;
+		block.size = size;
+		block.version = 1;//no slice holds it yet
+		block.data.assign(size, 0);
+		block.frameVersions.assign(frameCount_, 0);
+
+		it->offset += allocSize;
+		it->size -= allocSize;
+		if (it->size == 0) freeRanges_.erase(it);
+		return true;
+	}
+	std::cerr << "UniformRing: no room for a block of " << size << " bytes, " << frameStride_ << " bytes per frame\n";
+	return false;
+}
+void UniformRing::freeBlock(Block& block)
+{
+	if (!block.isValid()) return;
+
+	Range range = { block.offset, alignUp(block.size, alignment_) };
+	block = Block();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = std::lower_bound(freeRanges_.begin(), freeRanges_.end(), range.offset, [](const Range& r, uint32_t offset) {
+		return r.offset < offset;
+	});
+	it = freeRanges_.insert(it, range);
+	// merge with the following range first, the iterator stays valid
+	auto next = it + 1;
+	if (next != freeRanges_.end() && it->offset + it->size == next->offset) {
+		it->size += next->size;
+		freeRanges_.erase(next);
+	}
+	if (it != freeRanges_.begin()) {
+		auto prev = it - 1;
+		if (prev->offset + prev->size == it->offset) {
+			prev->size += it->size;
+			freeRanges_.erase(it);
+		}
+	}
+}
+
+void UniformRing::upload(Block& block, uint32_t frameIndex, const void* data)
+{
+	if (!block.isValid()) return;
+
+	if (memcmp(block.data.data(), data, block.size)) {
+		memcpy(block.data.data(), data, block.size);
+		++block.version;
+	}
+	uint32_t& frameVersion = block.frameVersions[frameIndex % frameCount_];
+	if (frameVersion == block.version) {
+		++stats_.skipped;
+		return;
+	}
+
+	const uint32_t offset = getDynamicOffset(frameIndex) + block.offset;
+	memcpy((uint8_t*)buffer_.mapped + offset, block.data.data(), block.size);
+	if (!coherent_) buffer_.flush(alignUp(block.size, alignment_), offset);
+	frameVersion = block.version;
+	++stats_.writes;
+}
+
+VkDescriptorBufferInfo UniformRing::getDescriptor(const Block& block) const
+{
+	VkDescriptorBufferInfo descriptor;
+	descriptor.buffer = buffer_.buffer;
+	descriptor.offset = block.offset;
+	descriptor.range = std::max(1u, block.size);
+	return descriptor;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include <mutex>
+
+// One persistently mapped uniform buffer for the per-frame constants of environment, cameras and lights.
+// The buffer holds a slice per frame in flight and a block has the same offset in every slice,
+// so its descriptor set is written once and the frame's slice is selected by the dynamic offset at bind time.
+// A block remembers which version of its contents every slice holds, unchanged blocks are neither copied nor flushed
+class UniformRing
+{
+public:
+	struct Block
+	{
+		uint32_t offset = 0;//within a frame slice
+		uint32_t size = 0;
+		uint32_t version = 0;//bumped whenever the uploaded contents change
+		std::vector<uint8_t> data;//contents of the latest version
+		std::vector<uint32_t> frameVersions;//version held by each frame slice
+
+		bool isValid() const { return size != 0; }
+	};
+	struct Stats
+	{
+		uint32_t writes = 0;//blocks copied into a frame slice
+		uint32_t skipped = 0;//uploads whose frame slice was current already
+	};
+private:
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	vks::Buffer buffer_;
+	bool coherent_ = true;
+	uint32_t frameCount_ = 1;
+	uint32_t frameStride_ = 0;
+	uint32_t alignment_ = 1;//of block offsets and flushed ranges
+
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+	std::mutex mutex_;//scenes allocate and free their blocks on the loader thread
+	std::vector<Range> freeRanges_;//sorted by offset, neighbours are merged
+	Stats stats_;
+public:
+	UniformRing(vks::VulkanDevice* vulkanDevice, uint32_t frameCount, uint32_t frameSize = 64 * 1024);
+	~UniformRing();
+	void destroy();
+
+	bool allocateBlock(Block& block, uint32_t size);
+	void freeBlock(Block& block);
+	// the frame's slice must not be read by the GPU anymore, i.e. its fence has been waited on
+	void upload(Block& block, uint32_t frameIndex, const void* data);
+
+	// for a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding, bound with getDynamicOffset of the frame
+	VkDescriptorBufferInfo getDescriptor(const Block& block) const;
+	uint32_t getDynamicOffset(uint32_t frameIndex) const { return (frameIndex % frameCount_) * frameStride_; }
+
+	void resetStats() { stats_ = Stats(); }
+	const Stats& getStats() const { return stats_; }
+};
+using UniformRingPtr = std::shared_ptr<UniformRing>;
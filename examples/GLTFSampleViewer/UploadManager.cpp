@@ -0,0 +1,356 @@
+#include "UploadManager.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkSemaphore createTimeline(VkDevice device)
+{
+	VkSemaphoreTypeCreateInfo typeCI{};
+	typeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeCI.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+	semaphoreCI.pNext = &typeCI;
+	VkSemaphore semaphore;
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
+	return semaphore;
+}
+
+static void submitTimeline(VkQueue queue, VkCommandBuffer cmd, VkSemaphore waitSemaphore, uint64_t waitValue, VkSemaphore signalSemaphore, uint64_t signalValue)
+{
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitSemaphore ? 1 : 0;
+	timelineInfo.pWaitSemaphoreValues = &waitValue;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitSemaphore ? 1 : 0;
+	submitInfo.pWaitSemaphores = &waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &signalSemaphore;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+UploadManager::UploadManager(vks::VulkanDevice* vulkanDevice, VkQueue graphicsQueue, VkDeviceSize ringSize)
+{
+	vulkanDevice_ = vulkanDevice;
+	graphicsQueue_ = graphicsQueue;
+
+	// copy offsets and the flushed ranges of non-coherent memory share one alignment
+	const VkPhysicalDeviceLimits& limits = vulkanDevice_->properties.limits;
+	alignment_ = std::max<VkDeviceSize>(16, std::max(limits.optimalBufferCopyOffsetAlignment, limits.nonCoherentAtomSize));
+	ringSize_ = alignUp(ringSize, alignment_);
+	// buffer copies read staging memory on the transfer family, image copies on the graphics family, without ownership transfers
+	stagingQueueFamilies_ = { vulkanDevice_->queueFamilyIndices.graphics, vulkanDevice_->queueFamilyIndices.transfer };
+	VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ring_, ringSize_, nullptr, stagingQueueFamilies_));
+	VK_CHECK_RESULT(ring_.map());
+
+	graphicsPool_ = vulkanDevice_->createCommandPool(vulkanDevice_->queueFamilyIndices.graphics, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	graphicsTimeline_ = createTimeline(vulkanDevice_->logicalDevice);
+	if (vulkanDevice_->queueFamilyIndices.transfer != vulkanDevice_->queueFamilyIndices.graphics) {
+		vkGetDeviceQueue(vulkanDevice_->logicalDevice, vulkanDevice_->queueFamilyIndices.transfer, 0, &transferQueue_);
+		transferPool_ = vulkanDevice_->createCommandPool(vulkanDevice_->queueFamilyIndices.transfer, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		transferTimeline_ = createTimeline(vulkanDevice_->logicalDevice);
+	}
+}
+UploadManager::~UploadManager()
+{
+	destroy();
+}
+void UploadManager::destroy()
+{
+	if (!graphicsPool_) return;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		frameBudget_ = 0;
+		waitLocked(lock, submitLocked(lock));
+	}
+	VkDevice device = vulkanDevice_->logicalDevice;
+	if (!finishedGraphicsCmds_.empty()) vkFreeCommandBuffers(device, graphicsPool_, (uint32_t)finishedGraphicsCmds_.size(), finishedGraphicsCmds_.data());
+	if (!finishedTransferCmds_.empty()) vkFreeCommandBuffers(device, transferPool_, (uint32_t)finishedTransferCmds_.size(), finishedTransferCmds_.data());
+	finishedGraphicsCmds_.clear();
+	finishedTransferCmds_.clear();
+
+	vkDestroySemaphore(device, graphicsTimeline_, nullptr);
+	vkDestroyCommandPool(device, graphicsPool_, nullptr);
+	if (transferPool_) {
+		vkDestroySemaphore(device, transferTimeline_, nullptr);
+		vkDestroyCommandPool(device, transferPool_, nullptr);
+	}
+	graphicsTimeline_ = transferTimeline_ = VK_NULL_HANDLE;
+	graphicsPool_ = transferPool_ = VK_NULL_HANDLE;
+	ring_.destroy();
+}
+
+bool UploadManager::isSupported(VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool UploadManager::isThrottled() const
+{
+	return frameBudget_ != 0 && frameThread_ != std::thread::id() && frameThread_ != std::this_thread::get_id();
+}
+
+uint64_t UploadManager::getCounterValue(VkSemaphore timeline) const
+{
+	uint64_t value = 0;
+	VK_CHECK_RESULT(vkGetSemaphoreCounterValue(vulkanDevice_->logicalDevice, timeline, &value));
+	return value;
+}
+
+void UploadManager::beginRecording()
+{
+	if (recording_.isRecording()) return;
+
+	// command buffers of completed batches are freed here, by the only thread that uses the pools
+	VkDevice device = vulkanDevice_->logicalDevice;
+	if (!finishedGraphicsCmds_.empty()) vkFreeCommandBuffers(device, graphicsPool_, (uint32_t)finishedGraphicsCmds_.size(), finishedGraphicsCmds_.data());
+	if (!finishedTransferCmds_.empty()) vkFreeCommandBuffers(device, transferPool_, (uint32_t)finishedTransferCmds_.size(), finishedTransferCmds_.data());
+	finishedGraphicsCmds_.clear();
+	finishedTransferCmds_.clear();
+
+	recording_.graphicsCmd = vulkanDevice_->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, graphicsPool_, true);
+	recording_.transferCmd = hasTransferQueue() ? vulkanDevice_->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferPool_, true) : recording_.graphicsCmd;
+}
+
+UploadManager::Span UploadManager::stage(VkDeviceSize size)
+{
+	const VkDeviceSize allocSize = alignUp(std::max<VkDeviceSize>(1, size), alignment_);
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (isThrottled() && recording_.bytes && recording_.bytes + allocSize > frameBudget_) submitLocked(lock);
+
+	Span span;
+	if (allocSize > ringSize_ / 2) {
+		// would stall the ring for too long, gets a staging buffer of its own
+		vks::Buffer staging;
+		VK_CHECK_RESULT(vulkanDevice_->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, size, nullptr, stagingQueueFamilies_));
+		VK_CHECK_RESULT(staging.map());
+		span.buffer = staging.buffer;
+		span.mapped = staging.mapped;
+		recording_.oversized.push_back(staging);
+	}
+	else {
+		for (;;) {
+			// an allocation never wraps, the rest of the ring is skipped instead
+			uint64_t start = ringHead_;
+			const VkDeviceSize offset = start % ringSize_;
+			if (offset + allocSize > ringSize_) start += ringSize_ - offset;
+			if (start + allocSize - ringTail_ <= ringSize_) {
+				ringHead_ = start + allocSize;
+				span.buffer = ring_.buffer;
+				span.offset = start % ringSize_;
+				span.mapped = (uint8_t*)ring_.mapped + span.offset;
+				break;
+			}
+			// the ring is full, only the recorded batch holds it if nothing is in flight
+			if (inFlight_.empty()) submitLocked(lock);
+			waitLocked(lock, inFlight_.front().value);
+		}
+	}
+	beginRecording();
+	recording_.bytes += allocSize;
+	return span;
+}
+
+void UploadManager::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+{
+	// large buffers go in pieces, so they can be spread over frames and never need an oversized staging buffer
+	VkDeviceSize chunkSize = ringSize_ / 4;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (frameBudget_) chunkSize = std::min(chunkSize, frameBudget_);
+	}
+	chunkSize = std::max(alignment_, chunkSize);
+
+	for (VkDeviceSize done = 0; done < size; done += chunkSize) {
+		const VkDeviceSize copySize = std::min(chunkSize, size - done);
+		const Span span = stage(copySize);
+		memcpy(span.mapped, (const uint8_t*)data + done, copySize);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		VkBufferCopy copyRegion = { span.offset, dstOffset + done, copySize };
+		vkCmdCopyBuffer(recording_.transferCmd, span.buffer, dstBuffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset + done;
+		barrier.size = copySize;
+		if (hasTransferQueue()) {
+			// release to the graphics family, the acquire in the graphics part makes the data visible
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = vulkanDevice_->queueFamilyIndices.transfer;
+			barrier.dstQueueFamilyIndex = vulkanDevice_->queueFamilyIndices.graphics;
+			vkCmdPipelineBarrier(recording_.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(recording_.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+		else {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(recording_.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+	}
+}
+
+VkCommandBuffer UploadManager::getGraphicsCommandBuffer()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	beginRecording();
+	return recording_.graphicsCmd;
+}
+
+uint64_t UploadManager::submit()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return submitLocked(lock);
+}
+
+uint64_t UploadManager::submitLocked(std::unique_lock<std::mutex>& lock)
+{
+	if (!recording_.isRecording()) return graphicsValue_;
+
+	if (isThrottled()) {
+		frameBegun_.wait(lock, [this]() {
+			return !isThrottled() || frameBytes_ == 0 || frameBytes_ + recording_.bytes <= frameBudget_;
+		});
+	}
+	frameBytes_ += recording_.bytes;
+	++frameStats_.batches;
+	frameStats_.bytes += recording_.bytes;
+
+	Batch batch = std::move(recording_);
+	recording_ = Batch();
+	batch.ringEnd = ringHead_;
+	if (hasTransferQueue()) {
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.transferCmd));
+		batch.transferValue = ++transferValue_;
+		submitTimeline(transferQueue_, batch.transferCmd, VK_NULL_HANDLE, 0, transferTimeline_, batch.transferValue);
+	}
+	VK_CHECK_RESULT(vkEndCommandBuffer(batch.graphicsCmd));
+	batch.value = ++graphicsValue_;
+	inFlight_.push_back(std::move(batch));
+	pumpLocked();
+	return graphicsValue_;
+}
+
+void UploadManager::pumpLocked()
+{
+	// graphics parts go in submission order, each once its transfer has finished
+	const uint64_t transferDone = hasTransferQueue() ? getCounterValue(transferTimeline_) : 0;
+	for (Batch& batch : inFlight_) {
+		if (batch.graphicsSubmitted) continue;
+		if (batch.transferValue > transferDone) break;
+
+		std::lock_guard<std::mutex> queueLock(vulkanDevice_->queueMutex);
+		submitTimeline(graphicsQueue_, batch.graphicsCmd, transferTimeline_, batch.transferValue, graphicsTimeline_, batch.value);
+		batch.graphicsSubmitted = true;
+	}
+}
+
+void UploadManager::reclaimLocked()
+{
+	const uint64_t done = getCounterValue(graphicsTimeline_);
+	while (!inFlight_.empty() && inFlight_.front().graphicsSubmitted && inFlight_.front().value <= done) {
+		Batch& batch = inFlight_.front();
+		finishedGraphicsCmds_.push_back(batch.graphicsCmd);
+		if (hasTransferQueue()) finishedTransferCmds_.push_back(batch.transferCmd);
+		for (auto& staging : batch.oversized) staging.destroy();
+		ringTail_ = batch.ringEnd;
+		inFlight_.pop_front();
+	}
+}
+
+void UploadManager::waitLocked(std::unique_lock<std::mutex>& lock, uint64_t value)
+{
+	value = std::min(value, graphicsValue_);
+	for (;;) {
+		pumpLocked();
+		reclaimLocked();
+		if (getCounterValue(graphicsTimeline_) >= value) return;
+
+		// a graphics part that is not submitted yet waits for its transfer first
+		VkSemaphore semaphore = graphicsTimeline_;
+		uint64_t waitValue = value;
+		for (const Batch& batch : inFlight_) {
+			if (batch.graphicsSubmitted) continue;
+			if (batch.value <= value) {
+				semaphore = transferTimeline_;
+				waitValue = batch.transferValue;
+			}
+			break;
+		}
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &waitValue;
+		lock.unlock();
+		VkResult result = vkWaitSemaphores(vulkanDevice_->logicalDevice, &waitInfo, UINT64_MAX);
+		lock.lock();
+		VK_CHECK_RESULT(result);
+	}
+}
+
+bool UploadManager::isComplete(uint64_t value)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	pumpLocked();
+	reclaimLocked();
+	return getCounterValue(graphicsTimeline_) >= std::min(value, graphicsValue_);
+}
+
+void UploadManager::wait(uint64_t value)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	waitLocked(lock, value);
+}
+
+void UploadManager::setFrameBudget(VkDeviceSize bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	frameBudget_ = bytes;
+	frameBegun_.notify_all();
+}
+
+void UploadManager::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	frameThread_ = std::this_thread::get_id();
+	frameBytes_ = 0;
+	stats_ = frameStats_;
+	stats_.inFlight = (uint32_t)inFlight_.size();
+	frameStats_ = Stats();
+	pumpLocked();
+	reclaimLocked();
+	frameBegun_.notify_all();
+}
+
+UploadManager::Stats UploadManager::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+// Streams buffer and texture data to device local memory through one persistently mapped staging ring.
+// Uploads are recorded into a batch that is submitted as a whole. With a transfer queue family of its own, buffer copies run on it
+// and the buffers are released to the graphics family, whose part of the batch acquires them and holds the commands that need a
+// graphics queue (image copies with mip blits). That part is submitted once the transfer has finished, so the render frames queued
+// behind it never wait for a copy. Each batch signals the next value of a timeline semaphore, callers poll or wait for it.
+// Batches of any thread but the one calling beginFrame are limited to the frame budget and wait for the next frame beyond it
+class UploadManager
+{
+public:
+	struct Span
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		void* mapped = nullptr;
+	};
+	struct Stats
+	{
+		uint32_t batches = 0;//submitted during the last frame
+		VkDeviceSize bytes = 0;//staged by those batches
+		uint32_t inFlight = 0;
+	};
+private:
+	struct Batch
+	{
+		VkCommandBuffer transferCmd = VK_NULL_HANDLE;//the graphics one without a transfer queue
+		VkCommandBuffer graphicsCmd = VK_NULL_HANDLE;
+		uint64_t transferValue = 0;
+		uint64_t value = 0;//of the graphics timeline, reached once the batch is complete
+		bool graphicsSubmitted = false;
+		uint64_t ringEnd = 0;
+		VkDeviceSize bytes = 0;
+		std::vector<vks::Buffer> oversized;//staging of uploads too large for the ring
+
+		bool isRecording() const { return graphicsCmd != VK_NULL_HANDLE; }
+	};
+	vks::VulkanDevice* vulkanDevice_ = nullptr;
+	VkQueue graphicsQueue_ = VK_NULL_HANDLE;
+	VkQueue transferQueue_ = VK_NULL_HANDLE;//null without a transfer family of its own
+	VkCommandPool graphicsPool_ = VK_NULL_HANDLE, transferPool_ = VK_NULL_HANDLE;
+	VkSemaphore graphicsTimeline_ = VK_NULL_HANDLE, transferTimeline_ = VK_NULL_HANDLE;
+	uint64_t graphicsValue_ = 0, transferValue_ = 0;//of the latest submitted batch
+
+	vks::Buffer ring_;
+	std::vector<uint32_t> stagingQueueFamilies_;//share the ring and oversized staging buffers
+	VkDeviceSize ringSize_ = 0;
+	VkDeviceSize alignment_ = 16;
+	uint64_t ringHead_ = 0, ringTail_ = 0;//running byte counts, modulo the ring size they are offsets
+
+	Batch recording_;//one thread records at a time, the command pools are only touched by it
+	std::deque<Batch> inFlight_;
+	std::vector<VkCommandBuffer> finishedGraphicsCmds_, finishedTransferCmds_;//freed by the recording thread
+
+	VkDeviceSize frameBudget_ = 0;//0 is unlimited
+	VkDeviceSize frameBytes_ = 0;
+	std::thread::id frameThread_;
+	Stats stats_, frameStats_;
+
+	std::mutex mutex_;
+	std::condition_variable frameBegun_;
+public:
+	UploadManager(vks::VulkanDevice* vulkanDevice, VkQueue graphicsQueue, VkDeviceSize ringSize = 64 * 1024 * 1024);
+	~UploadManager();
+	void destroy();
+
+	// timeline semaphores are core since Vulkan 1.2, the feature has to be enabled at device creation
+	static bool isSupported(VkPhysicalDevice physicalDevice);
+	bool hasTransferQueue() const { return transferQueue_ != VK_NULL_HANDLE; }
+
+	// Reserves staging memory in the recorded batch, which is submitted first when the ring or the frame budget is exhausted.
+	// Write the data to mapped and record the copies from buffer at offset right away, before staging anything else
+	Span stage(VkDeviceSize size);
+	// dstBuffer may be read with dstAccess in dstStage by graphics queue commands once the batch is complete
+	void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+	// for commands that need the graphics queue, executed after the buffer copies of the batch
+	VkCommandBuffer getGraphicsCommandBuffer();
+	// returns the value that completes everything recorded so far, 0 if nothing was
+	uint64_t submit();
+	bool isComplete(uint64_t value);
+	void wait(uint64_t value);
+
+	void setFrameBudget(VkDeviceSize bytes);
+	// on the render thread once per frame: refills the budget and submits the graphics parts of finished transfers
+	void beginFrame();
+	Stats getStats();
+private:
+	bool isThrottled() const;
+	void beginRecording();
+	uint64_t submitLocked(std::unique_lock<std::mutex>& lock);
+	void pumpLocked();
+	void reclaimLocked();
+	void waitLocked(std::unique_lock<std::mutex>& lock, uint64_t value);
+	uint64_t getCounterValue(VkSemaphore timeline) const;
+};
+using UploadManagerPtr = std::shared_ptr<UploadManager>;
@@ -0,0 +1,160 @@
+#include "ViewerBenchmark.h"
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <cmath>
+
+static const char* sPhaseNames[kBenchPhase_Count] =
+{
+	"frame_wait",
+	"animation",
+	"extraction",
+	"recording",
+	"submit_present",
+	"frame"
+};
+
+ViewerBenchmark::ScopedPhase::ScopedPhase(ViewerBenchmark* bench, ViewerBenchPhase phase)
+	: bench_(bench), phase_(phase)
+{
+	if (bench_) tStart_ = std::chrono::high_resolution_clock::now();
+}
+ViewerBenchmark::ScopedPhase::~ScopedPhase()
+{
+	if (bench_) bench_->addSample(phase_, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart_).count());
+}
+
+std::vector<std::string> ViewerBenchmark::splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) end = list.size();
+		if (end > start) items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+ViewerBenchmark::Stats ViewerBenchmark::computeStats(std::vector<double> samples)
+{
+	Stats stats;
+	if (samples.empty()) return stats;
+
+	std::sort(samples.begin(), samples.end());
+	// nearest rank
+	auto func_percentile = [&](double p) {
+		size_t rank = (size_t)std::ceil(p * samples.size());
+		return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+	};
+	stats.min = samples.front();
+	stats.max = samples.back();
+	stats.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	stats.p95 = func_percentile(0.95);
+	stats.p99 = func_percentile(0.99);
+	return stats;
+}
+
+bool ViewerBenchmark::beginNextRun(std::string& modelName, std::string& enviromentName)
+{
+	const size_t runCount = models.size() * enviroments.size();
+	if (finished_ || runs_.size() >= runCount) {
+		finished_ = true;
+		return false;
+	}
+	// every enviroment of a model runs back to back, so each model is loaded once
+	const size_t runIndex = runs_.size();
+	runs_.emplace_back();
+	Run& run = runs_.back();
+	run.modelName = modelName = models[runIndex / enviroments.size()];
+	run.enviromentName = enviromentName = enviroments[runIndex % enviroments.size()];
+	for (auto& samples : run.samples)
+		samples.reserve(frameCount);
+	frameIndex_ = 0;
+	return true;
+}
+
+void ViewerBenchmark::failRun()
+{
+	if (runs_.empty()) return;
+	runs_.back().loaded = false;
+	frameIndex_ = warmupFrames + frameCount;
+}
+
+void ViewerBenchmark::beginFrame()
+{
+	std::fill(std::begin(frameSamples_), std::end(frameSamples_), 0.0);
+	frameStart_ = std::chrono::high_resolution_clock::now();
+}
+void ViewerBenchmark::endFrame()
+{
+	frameSamples_[kBenchPhase_Frame] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart_).count();
+	// the first frames after a load still fill caches and the pipeline cache, they are not measured
+	if (!runs_.empty() && frameIndex_ >= warmupFrames) {
+		for (int phase = 0; phase < kBenchPhase_Count; ++phase)
+			runs_.back().samples[phase].push_back(frameSamples_[phase]);
+	}
+	frameIndex_++;
+}
+
+static std::string escapeJson(const std::string& str)
+{
+	std::string result;
+	for (char c : str) {
+		if (c == '"' || c == '\\') result.push_back('\\');
+		if ((unsigned char)c < 0x20) continue;
+		result.push_back(c);
+	}
+	return result;
+}
+bool ViewerBenchmark::writeReport(const VkPhysicalDeviceProperties& deviceProps) const
+{
+	std::ofstream result(filename, std::ios::out);
+	if (!result.is_open()) {
+		std::cerr << "Could not write viewer benchmark report \"" << filename << "\"\n";
+		return false;
+	}
+	auto func_writeMs = [&](double ms) {
+		if (ms < 0.0) result << "null";
+		else result << ms;
+	};
+
+	result << std::fixed << std::setprecision(4);
+	result << "{\n";
+	result << "  \"device\": \"" << escapeJson(deviceProps.deviceName) << "\",\n";
+	result << "  \"driverVersion\": " << deviceProps.driverVersion << ",\n";
+	result << "  \"timestep\": " << timestep << ",\n";
+	result << "  \"frames\": " << frameCount << ",\n";
+	result << "  \"warmupFrames\": " << warmupFrames << ",\n";
+	result << "  \"glb\": " << (glb ? "true" : "false") << ",\n";
+	result << "  \"runs\": [";
+	for (size_t i = 0; i < runs_.size(); ++i)
+	{
+		const Run& run = runs_[i];
+		result << (i ? ",\n" : "\n") << "    {\n";
+		result << "      \"model\": \"" << escapeJson(run.modelName) << "\",\n";
+		result << "      \"environment\": \"" << escapeJson(run.enviromentName) << "\",\n";
+		result << "      \"loaded\": " << (run.loaded ? "true" : "false") << ",\n";
+		result << "      \"modelLoadMs\": "; func_writeMs(run.modelLoadMs); result << ",\n";
+		result << "      \"environmentLoadMs\": "; func_writeMs(run.enviromentLoadMs); result << ",\n";
+		result << "      \"phases\": ";
+		if (!run.loaded) {
+			result << "null\n    }";
+			continue;
+		}
+		result << "{";
+		for (int phase = 0; phase < kBenchPhase_Count; ++phase)
+		{
+			Stats stats = computeStats(run.samples[phase]);
+			result << (phase ? ",\n" : "\n") << "        \"" << sPhaseNames[phase] << "\": { "
+				<< "\"min\": " << stats.min << ", \"avg\": " << stats.avg << ", \"p95\": " << stats.p95
+				<< ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+		}
+		result << "\n      }\n    }";
+	}
+	result << "\n  ]\n}\n";
+	result.flush();
+
+	std::cout << "Viewer benchmark finished, " << runs_.size() << " runs written to \"" << filename << "\"\n";
+	return result.good();
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "gltfShaderStruct.h"
+#include <chrono>
+
+// CPU phases of one viewer frame, timed separately so a regression shows up in the hot path that caused it
+enum ViewerBenchPhase
+{
+	kBenchPhase_FrameWait,//fence wait and swapchain acquire
+	kBenchPhase_Animation,//animation, joint palettes and uniform uploads
+	kBenchPhase_Extraction,//drawable extraction, culling and sorting
+	kBenchPhase_Recording,//command buffer recording
+	kBenchPhase_SubmitPresent,//queue submit and present
+	kBenchPhase_Frame,//the whole frame
+	kBenchPhase_Count
+};
+
+// Runs every model/enviroment combination for a fixed number of frames with a fixed animation timestep
+// and writes min/avg/p95/p99/max of each phase to one JSON report
+class ViewerBenchmark
+{
+public:
+	struct Stats
+	{
+		double min = 0.0;
+		double avg = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+	struct Run
+	{
+		std::string modelName, enviromentName;
+		double modelLoadMs = -1.0;//negative if the model was already loaded by the previous run
+		double enviromentLoadMs = -1.0;
+		bool loaded = true;//false if the model failed to load, the run has no frames then
+		std::vector<double> samples[kBenchPhase_Count];
+	};
+
+	// Times the enclosing scope, does nothing without a benchmark
+	class ScopedPhase
+	{
+		ViewerBenchmark* bench_;
+		ViewerBenchPhase phase_;
+		std::chrono::high_resolution_clock::time_point tStart_;
+	public:
+		ScopedPhase(ViewerBenchmark* bench, ViewerBenchPhase phase);
+		~ScopedPhase();
+	};
+
+	std::vector<std::string> models, enviroments;
+	bool glb = false;
+	float timestep = 1.0f / 60.0f;
+	uint32_t frameCount = 600;
+	uint32_t warmupFrames = 60;
+	std::string filename = "viewerbench.json";
+private:
+	std::vector<Run> runs_;
+	bool finished_ = false;
+	uint32_t frameIndex_ = 0;
+	double frameSamples_[kBenchPhase_Count] = {};
+	std::chrono::high_resolution_clock::time_point frameStart_;
+public:
+	static std::vector<std::string> splitList(const std::string& list);
+	static Stats computeStats(std::vector<double> samples);
+
+	// Moves on to the next model/enviroment combination, false once all of them ran
+	bool beginNextRun(std::string& modelName, std::string& enviromentName);
+	Run& getCurrentRun() { return runs_.back(); }
+	// completes the current run without frames, reported as not loaded
+	void failRun();
+	bool isRunComplete() const { return runs_.empty() || frameIndex_ >= warmupFrames + frameCount; }
+	bool isFinished() const { return finished_; }
+
+	void beginFrame();
+	void addSample(ViewerBenchPhase phase, double ms) { frameSamples_[phase] += ms; }
+	void endFrame();
+
+	bool writeReport(const VkPhysicalDeviceProperties& deviceProps) const;
+};
+using ViewerBenchmarkPtr = std::shared_ptr<ViewerBenchmark>;
@@ -1,5 +1,38 @@
 #include "VulkanGLTFSampleViewer.h"
 
+// Reads the SpecId decorations of a SPIR-V file, false if it cannot be read. Options needing a shader or constant the
+// compiled shaders lack are refused with it, rather than drawing with stale SPIR-V
+static bool readShaderSpecIds(const std::string& filename, std::vector<uint32_t>& specIds)
+{
+	std::ifstream is(filename, std::ios::binary | std::ios::ate);
+	if (!is.is_open()) return false;
+	size_t size = (size_t)is.tellg();
+	if (size < 5 * sizeof(uint32_t) || size % sizeof(uint32_t)) return false;
+	std::vector<uint32_t> words(size / sizeof(uint32_t));
+	is.seekg(0, std::ios::beg);
+	is.read((char*)words.data(), size);
+	if (words[0] != 0x07230203) return false;//SPIR-V magic
+
+	specIds.clear();
+	for (size_t i = 5; i < words.size();) {
+		uint32_t opcode = words[i] & 0xffff, wordCount = words[i] >> 16;
+		if (wordCount == 0 || i + wordCount > words.size()) return false;
+		// OpDecorate %target SpecId id
+		if (opcode == 71 && wordCount == 4 && words[i + 2] == 1) specIds.push_back(words[i + 3]);
+		i += wordCount;
+	}
+	return true;
+}
+static bool hasShaderSpecIds(const std::string& filename, const std::vector<uint32_t>& needed)
+{
+	std::vector<uint32_t> specIds;
+	if (!readShaderSpecIds(filename, specIds)) return false;
+	for (uint32_t id : needed) {
+		if (std::find(specIds.begin(), specIds.end(), id) == specIds.end()) return false;
+	}
+	return true;
+}
+
 VulkanGLTFSampleViewer::VulkanGLTFSampleViewer() 
 {
 	title = "homework1";
@@ -25,6 +58,97 @@ VulkanGLTFSampleViewer::VulkanGLTFSampleViewer()
 
 	modelName_ = "ToyCar";
 	enviromentName_ = "neutral";
+
+	// viewer specific options, base class has already parsed the common ones
+	commandLineParser.add("compactvertices", { "-cv", "--compactvertices" }, 0, "Load models with the quantized, split-stream vertex layout");
+	commandLineParser.add("optimizemeshes", { "-om", "--optimizemeshes" }, 0, "Weld and reorder the primitives of loaded models for vertex cache, overdraw and fetch locality");
+	commandLineParser.add("modelcache", { "-mc", "--modelcache" }, 1, "Set directory cooked models are loaded from and saved to (default modelcache)");
+	commandLineParser.add("nomodelcache", { "-nmc", "--nomodelcache" }, 0, "Do not load or save cooked models");
+	commandLineParser.add("cookedtextures", { "-ct", "--cookedtextures" }, 1, "Set directory the block compressed textures of GLTFTextureCooker are loaded from (default cookedtextures)");
+	commandLineParser.add("nocookedtextures", { "-nct", "--nocookedtextures" }, 0, "Do not load cooked textures, decode the images of the models");
+	commandLineParser.add("environment", { "-env", "--environment" }, 1, "Set environment, one of the environment assets or an equirectangular .hdr panorama (default neutral)");
+	commandLineParser.add("iblcache", { "-ibl", "--iblcache" }, 1, "Set directory environments baked from panoramas are loaded from and saved to (default iblcache)");
+	commandLineParser.add("envbudget", { "-eb", "--envbudget" }, 1, "Megabytes of environment cubemaps kept resident for switching back, 0 keeps only the current one (default 256)");
+	commandLineParser.add("bindless", { "-bl", "--bindless" }, 0, "Bind all materials and textures of a model at once and select them per draw, needs descriptor indexing");
+	commandLineParser.add("indirectdraw", { "-id", "--indirectdraw" }, 0, "Draw model primitives with indirect multi-draw, needs multiDrawIndirect and drawIndirectFirstInstance");
+	commandLineParser.add("specializematerials", { "-sm", "--specializematerials" }, 0, "Build a pipeline per material variant, the shaders compile out the glTF extensions a material does not use");
+	commandLineParser.add("syncuploads", { "-su", "--syncuploads" }, 0, "Submit and wait for the uploads of every scene load instead of streaming them through the upload ring");
+	commandLineParser.add("uploadbudget", { "-ub", "--uploadbudget" }, 1, "Megabytes a background scene load may upload per frame, 0 is unlimited (default 16)");
+	commandLineParser.add("animbench", { "-ab", "--animbench" }, 1, "Benchmark animation sampling of the loaded model for the given number of frames");
+	commandLineParser.add("viewerbench", { "-vb", "--viewerbench" }, 1, "Benchmark the CPU phases of each frame and write a JSON report to the given file");
+	commandLineParser.add("viewerbenchmodels", { "-vbm", "--viewerbenchmodels" }, 1, "Comma separated models for the viewer benchmark");
+	commandLineParser.add("viewerbenchenvs", { "-vbe", "--viewerbenchenvs" }, 1, "Comma separated environments for the viewer benchmark");
+	commandLineParser.add("viewerbenchglb", { "-vbg", "--viewerbenchglb" }, 0, "Benchmark the glTF-Binary variants of the models");
+	commandLineParser.add("viewerbenchtimestep", { "-vbt", "--viewerbenchtimestep" }, 1, "Fixed animation timestep of the viewer benchmark in milliseconds (default 16.667)");
+	commandLineParser.add("viewerbenchframes", { "-vbf", "--viewerbenchframes" }, 1, "Measured frames per model and environment (default 600)");
+	commandLineParser.add("viewerbenchwarmup", { "-vbw", "--viewerbenchwarmup" }, 1, "Frames rendered but not measured after each load (default 60)");
+	commandLineParser.parse(args);
+
+	if (commandLineParser.isSet("compactvertices")) {
+		if (hasShaderSpecIds(getSampleShadersPath() + "gltf_compact.vert.spv", {})) {
+			vertexLayout_ = kVertexLayout_Compact;
+			modelShaderName_.vertex = "gltf_compact.vert";
+		}
+		else {
+			std::cout << "gltf_compact.vert.spv is missing, compile the shaders to use compact vertices\n";
+		}
+	}
+	optimizeMeshes_ = commandLineParser.isSet("optimizemeshes");
+	modelCacheDir_ = commandLineParser.getValueAsString("modelcache", modelCacheDir_);
+	if (commandLineParser.isSet("nomodelcache")) modelCacheDir_.clear();
+	cookedTextureDir_ = commandLineParser.getValueAsString("cookedtextures", cookedTextureDir_);
+	if (commandLineParser.isSet("nocookedtextures")) cookedTextureDir_.clear();
+	enviromentName_ = commandLineParser.getValueAsString("environment", enviromentName_);
+	iblCacheDir_ = commandLineParser.getValueAsString("iblcache", iblCacheDir_);
+	enviromentBudgetMB_ = (uint32_t)std::max(0, commandLineParser.getValueAsInt("envbudget", (int)enviromentBudgetMB_));
+	bindless_ = commandLineParser.isSet("bindless");
+	if (bindless_ && !hasShaderSpecIds(getSampleShadersPath() + "gltf2_bindless.frag.spv", {})) {
+		std::cout << "gltf2_bindless.frag.spv is missing, compile the shaders to use bindless materials\n";
+		bindless_ = false;
+	}
+	// the fragment shaders the model pipelines may use, gltf2.frag is also the fallback when the device lacks bindless
+	auto func_hasPixelSpecIds = [&](const std::vector<uint32_t>& ids) {
+		return hasShaderSpecIds(getSampleShadersPath() + modelShaderName_.pixel + ".spv", ids)
+			&& (!bindless_ || hasShaderSpecIds(getSampleShadersPath() + "gltf2_bindless.frag.spv", ids));
+	};
+	constantValue_.INDIRECT_DRAW = commandLineParser.isSet("indirectdraw") ? 1 : 0;//dropped in getEnabledFeatures if unsupported
+	// both stages read the model matrix from DrawData once the constant is set
+	if (constantValue_.INDIRECT_DRAW && !(hasShaderSpecIds(getSampleShadersPath() + modelShaderName_.vertex + ".spv", { 5 }) && func_hasPixelSpecIds({ 5 }))) {
+		std::cout << "The compiled model shaders lack the INDIRECT_DRAW constant, compile the shaders to draw indirectly\n";
+		constantValue_.INDIRECT_DRAW = 0;
+	}
+	specializeMaterials_ = commandLineParser.isSet("specializematerials");
+	// MATERIAL_FEATURES and ALPHA_MODE, without them every variant would run the full shader
+	if (specializeMaterials_ && !func_hasPixelSpecIds({ 6, 7 })) {
+		std::cout << "The compiled fragment shader lacks the material constants, compile the shaders to specialize materials\n";
+		specializeMaterials_ = false;
+	}
+	asyncUploads_ = !commandLineParser.isSet("syncuploads");//dropped in getEnabledFeatures without timeline semaphores
+	uploadBudgetMB_ = (uint32_t)std::max(0, commandLineParser.getValueAsInt("uploadbudget", (int)uploadBudgetMB_));
+	// buffer copies go to a transfer queue family of its own if the device has one
+	if (asyncUploads_) requestedQueueTypes |= VK_QUEUE_TRANSFER_BIT;
+
+	if (commandLineParser.isSet("viewerbench")) {
+		viewerBench_ = std::make_shared<ViewerBenchmark>();
+		viewerBench_->filename = commandLineParser.getValueAsString("viewerbench", viewerBench_->filename);
+		viewerBench_->models = ViewerBenchmark::splitList(commandLineParser.getValueAsString("viewerbenchmodels", modelName_));
+		viewerBench_->enviroments = ViewerBenchmark::splitList(commandLineParser.getValueAsString("viewerbenchenvs", enviromentName_));
+		viewerBench_->glb = commandLineParser.isSet("viewerbenchglb");
+		float timestepMs = (float)atof(commandLineParser.getValueAsString("viewerbenchtimestep", "16.667").c_str());
+		if (timestepMs > 0.0f) viewerBench_->timestep = timestepMs / 1000.0f;
+		viewerBench_->frameCount = commandLineParser.getValueAsInt("viewerbenchframes", viewerBench_->frameCount);
+		viewerBench_->warmupFrames = commandLineParser.getValueAsInt("viewerbenchwarmup", viewerBench_->warmupFrames);
+		if (viewerBench_->models.empty()) viewerBench_->models.push_back(modelName_);
+		if (viewerBench_->enviroments.empty()) viewerBench_->enviroments.push_back(enviromentName_);
+
+		// start with the first run's assets, so the first run does not load twice
+		modelName_ = viewerBench_->models.front();
+		enviromentName_ = viewerBench_->enviroments.front();
+		modelGlb_ = viewerBench_->glb;
+		// validation layers and the overlay would dominate the timings
+		settings.validation = false;
+		settings.overlay = false;
+	}
 }
 void MultiSampleTarget::destroy(VkDevice device)
 {
@@ -38,6 +162,11 @@ void MultiSampleTarget::destroy(VkDevice device)
 }
 VulkanGLTFSampleViewer::~VulkanGLTFSampleViewer()
 {
+	// joins the workers, loads in progress finish first
+	sceneLoader_ = nullptr;
+	if (enviromentCache_) enviromentCache_->destroy();
+	if (iblBaker_) iblBaker_->destroy();
+
 	vkSafeDestroyPipelineLayout(this->device, skyboxPipelineLayout_, nullptr);
 	vkSafeDestroyPipeline(this->device, skyboxPipeline_.solid, nullptr);
 	vkSafeDestroyPipeline(this->device, skyboxPipeline_.wireframe, nullptr);
@@ -54,19 +183,56 @@ VulkanGLTFSampleViewer::~VulkanGLTFSampleViewer()
 	multisampleTarget_.destroy(this->device);
 	if (opaqueFramebuffer_) opaqueFramebuffer_->destroy();
 
-	if (model_) model_->destroy();
+	retiredScenes_.clear();
+	if (scene_) scene_->destroy();
 	if (skyBox_) skyBox_->destroy();
+	if (textureCache_) textureCache_->destroy();
 
 	if (enviroment_) enviroment_->destroy();
-	if (lightMgr_) lightMgr_->destroy();
-	if (cameraFac_) cameraFac_->destroy();
 	if (mtlFac_) mtlFac_->destroy();
-	if (userCamera_) userCamera_->destroy();
+	if (indirectDrawer_) indirectDrawer_->destroy();
+	if (uniformRing_) uniformRing_->destroy();
+	if (uploadManager_) uploadManager_->destroy();
 }
 void VulkanGLTFSampleViewer::getEnabledFeatures()
 {
 	// Fill mode non solid is required for wireframe display
 	if (deviceFeatures.fillModeNonSolid) enabledFeatures.fillModeNonSolid = VK_TRUE;
+	// KHR_texture_basisu textures are transcoded to whichever block compression family is enabled
+	if (deviceFeatures.textureCompressionBC) enabledFeatures.textureCompressionBC = VK_TRUE;
+	if (deviceFeatures.textureCompressionASTC_LDR) enabledFeatures.textureCompressionASTC_LDR = VK_TRUE;
+	if (deviceFeatures.textureCompressionETC2) enabledFeatures.textureCompressionETC2 = VK_TRUE;
+	if (bindless_) {
+		if (MaterialFactory::isBindlessSupported(descriptorIndexingFeatures)) {
+			MaterialFactory::enableBindlessFeatures(enabledDescriptorIndexingFeatures);
+		}
+		else {
+			std::cout << "Bindless materials need runtime sized, non-uniformly indexed and update after bind sampler arrays, binding per material\n";
+			bindless_ = false;
+		}
+	}
+	if (constantValue_.INDIRECT_DRAW) {
+		if (IndirectDrawer::isSupported(deviceFeatures)) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		else {
+			std::cout << "Indirect draw needs multiDrawIndirect and drawIndirectFirstInstance, drawing directly\n";
+			constantValue_.INDIRECT_DRAW = 0;
+		}
+	}
+	if (asyncUploads_) {
+		if (UploadManager::isSupported(physicalDevice)) {
+			timelineSemaphoreFeatures_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+			timelineSemaphoreFeatures_.timelineSemaphore = VK_TRUE;
+			timelineSemaphoreFeatures_.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures_;
+		}
+		else {
+			std::cout << "Asynchronous uploads need Vulkan 1.2 timeline semaphores, uploading synchronously\n";
+			asyncUploads_ = false;
+		}
+	}
 }
 std::string VulkanGLTFSampleViewer::getSampleShadersPath() const
 {
@@ -365,24 +531,6 @@ void VulkanGLTFSampleViewer::setupFrameBuffer()
 	}
 }
 
-static bool LoadGltfModelFromFile(tinygltf::Model& gltfMdl, const std::string& filename)
-{
-	gltfMdl = tinygltf::Model();
-
-	tinygltf::TinyGLTF gltfContext;
-	std::string error, warning;
-	bool result;
-	if (vks::tools::getFileNameExtension(filename) == "gltf") {
-		result = gltfContext.LoadASCIIFromFile(&gltfMdl, &error, &warning, filename);
-	}
-	else {
-		result = gltfContext.LoadBinaryFromFile(&gltfMdl, &error, &warning, filename);
-	}
-	if (!result) {
-		MessageBox(NULL, ("load model file " + filename + " failed!").c_str(), "LoadGltfModelFromFile error", MB_OK);
-	}
-	return result;
-}
 static EnviromentImagesPath MakeEnvImgsPath(std::string envDir, std::string envName) 
 {
 	if (!envDir.empty() && envDir.back() != '/') envDir.push_back('/');
@@ -400,85 +548,68 @@ static EnviromentImagesPath MakeEnvImgsPath(std::string envDir, std::string envN
 };
 bool VulkanGLTFSampleViewer::initScene()
 {
-	const int uniformAllocCount = 128;
-	const int samplerAllocCount = 128;
+	// skybox only, environments and scenes allocate from pools of their own
+	const uint32_t frameCount = settings.framesInFlight;
+	const int uniformAllocCount = 128 * frameCount;
+	const int samplerAllocCount = 128 * frameCount;
+	const int storageAllocCount = 64 * frameCount;
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformAllocCount),
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, samplerAllocCount),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storageAllocCount),
 	};
-	const int maxSetCount = uniformAllocCount + samplerAllocCount;
+	const int maxSetCount = uniformAllocCount + samplerAllocCount + storageAllocCount;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
-	enviroment_ = std::make_shared<Enviroment>(vulkanDevice, descriptorPool, queue);
-	lightMgr_ = std::make_shared<LightManager>(vulkanDevice, descriptorPool);
-	cameraFac_ = std::make_shared<CameraFactory>(vulkanDevice, descriptorPool);
-	mtlFac_ = std::make_shared<MaterialFactory>(vulkanDevice, descriptorPool);
-
-	skyBox_ = std::make_shared<AnimatedModel>(vulkanDevice, descriptorPool, queue);
-	model_ = std::make_shared<AnimatedModel>(vulkanDevice, descriptorPool, queue);
-
-	tinygltf::Model gltfMdl, gltfCamera, gltfSkybox;
-	tinygltf::TinyGLTF gltfContext;
-	if (!LoadGltfModelFromFile(gltfSkybox, getAssetPath() + "models/cube.gltf")) return false;
-#if 1
-	if (modelGlb_) {
-		if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/" + modelName_ + "/glTF-Binary/" + modelName_ + ".glb")) 
-			return false;
+	uniformRing_ = std::make_shared<UniformRing>(vulkanDevice, frameCount);
+	enviroment_ = std::make_shared<Enviroment>(vulkanDevice, uniformRing_);
+	auto func_resolveEnviroment = [this](const std::string& name, EnviromentImagesPath& paths) {
+		return getEnviromentImagesPath(name, paths);
+	};
+	enviromentCache_ = std::make_shared<EnviromentCache>(vulkanDevice, queue, frameCount, enviroment_, func_resolveEnviroment, (VkDeviceSize)enviromentBudgetMB_ * 1024 * 1024);
+	// the device may lack the descriptor indexing extension after all
+	if (bindless_ && !MaterialFactory::isBindlessSupported(vulkanDevice->enabledDescriptorIndexingFeatures)) {
+		std::cout << "Descriptor indexing is not enabled, binding per material\n";
+		bindless_ = false;
 	}
-	else {
-		if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/" + modelName_ + "/glTF/" + modelName_ + ".gltf"))
-			return false;
+	if (bindless_) modelShaderName_.pixel = "gltf2_bindless.frag";
+	mtlFac_ = std::make_shared<MaterialFactory>(vulkanDevice, descriptorPool, bindless_);
+	indirectDrawer_ = std::make_shared<IndirectDrawer>(vulkanDevice, descriptorPool, frameCount);
+	if (asyncUploads_) {
+		uploadManager_ = std::make_shared<UploadManager>(vulkanDevice, queue);
+		uploadManager_->setFrameBudget((VkDeviceSize)uploadBudgetMB_ * 1024 * 1024);
 	}
-	gltfCamera = gltfMdl;
-#elif 0
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/BusterDrone/glTF-Binary/BusterDrone.glb")) return false;
-	if (!LoadGltfModelFromFile(gltfCamera, getModelAssetPath() + "Models/BusterDrone/glTF/camera.gltf")) return false;
-	gltfCamera = gltfMdl;
-#elif 0
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/BoxAnimated/glTF/BoxAnimated.gltf")) return false;
-	if (!LoadGltfModelFromFile(gltfCamera, getModelAssetPath() + "Models/BoxAnimated/glTF/camera.gltf")) return false;
-	gltfCamera = gltfMdl;
-#elif 0
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/CesiumMilkTruck/glTF/CesiumMilkTruck.gltf")) return false;
-	gltfCamera = gltfMdl;
-#elif 0
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/CesiumMan/glTF/CesiumMan.gltf")) return false;
-	gltfCamera = gltfMdl;
-#elif 0
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/BrainStem/glTF/BrainStem.gltf")) return false;
-	gltfCamera = gltfMdl;
-#elif 1
-	if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/ToyCar/glTF/ToyCar.gltf")) return false;
-	if (!LoadGltfModelFromFile(gltfCamera, getModelAssetPath() + "Models/ToyCar/glTF/camera.gltf")) return false;
-	gltfCamera = gltfMdl;
-#endif
+	textureCache_ = std::make_shared<TextureCache>(vulkanDevice);
+	sceneLoader_ = std::make_shared<SceneLoader>(vulkanDevice, queue, frameCount, uniformRing_, textureCache_, uploadManager_);
 
-	skyBox_->load(gltfSkybox, *mtlFac_, true);
-	lightMgr_->load(gltfMdl);
+	skyBox_ = std::make_shared<AnimatedModel>(vulkanDevice, descriptorPool, queue, frameCount);
+	skyBox_->setTextureCache(textureCache_);
+	skyBox_->frustumCulling_ = false;//skybox always surrounds the camera
 
-	model_->load(gltfMdl, *mtlFac_);
-	constantValue_.USE_SKELETON = model_->hasSkin();
+	tinygltf::Model gltfSkybox;
+	if (!SceneLoader::loadGltfFile(gltfSkybox, getAssetPath() + "models/cube.gltf")) return false;
+	skyBox_->load(gltfSkybox, *mtlFac_, true);
 
-	BoundingBox bbox = model_->getWorldBBox();
-	userCamera_ = cameraFac_->creatCamera((float)width / (float)height, bbox.min, bbox.max, gltfCamera);
+	// nothing is shown yet, so the first scene is loaded on this thread
+	ScenePtr scene = sceneLoader_->loadScene(makeSceneLoadRequest());
+	if (!scene) return false;
+	setScene(scene);
+	if (commandLineParser.isSet("animbench")) {
+		benchmarkKeyframeSampling(model_->animations_, commandLineParser.getValueAsInt("animbench", 10000));
+	}
 
-	DrawableQueueGroup dqg;
-	model_->getDrawableQueueGroup(dqg, *userCamera_);
-	hasTransmission_ = !dqg.transmissionQueue_.empty();
+	hasTransmission_ = model_->hasTransmission();
 	if (hasTransmission_ && !opaqueFramebuffer_) createOpaqueFramebuffer();
 
 	// however, the environment resource "https://raw.githubusercontent.com/KhronosGroup/glTF-Sample-Environments/low_resolution_hdrs/neutral.hdr" glTF-Sample-Viewer used 
 	// is more lighter than https://github.com/KhronosGroup/glTF-Sample-Environments our used
-	enviroment_->load(MakeEnvImgsPath(getEnviromentAssetPath(), enviromentName_), hasTransmission_ ? &opaqueFramebuffer_->attachments[isMSAAEnabled() ? 1 : 0] : nullptr);
-
-	// write-to descriptor-sets
-	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
-	userCamera_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	lightMgr_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	enviroment_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	model_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	vkUpdateDescriptorSets(device, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+	// the transmission framebuffer goes into the set of every environment adopted from now on
+	enviroment_->setTransmissionFramebuffer(getTransmissionAttachment());
+	if (!enviromentCache_->load(enviromentName_)) {
+		enviromentName_ = "neutral";
+		if (!enviromentCache_->load(enviromentName_)) return false;
+	}
 	return true;
 }
 void VulkanGLTFSampleViewer::createOpaqueFramebuffer()
@@ -536,7 +667,7 @@ void VulkanGLTFSampleViewer::createOpaqueFramebuffer()
 		auto& dependencies_1 = dependencies[1];
 		dependencies_1.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies_1.dstSubpass = 0;
-		dependencies_1.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies_1.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;//previous frame may still sample it
 		dependencies_1.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies_1.srcAccessMask = 0;
 		dependencies_1.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
@@ -544,63 +675,156 @@ void VulkanGLTFSampleViewer::createOpaqueFramebuffer()
 	}
 	opaqueFramebuffer_->createRenderPass(dependencies);
 }
+const vks::FramebufferAttachment* VulkanGLTFSampleViewer::getTransmissionAttachment() const
+{
+	// stays bound once created, models without transmission simply do not sample it
+	return opaqueFramebuffer_ ? &opaqueFramebuffer_->attachments[isMSAAEnabled() ? 1 : 0] : nullptr;
+}
+void VulkanGLTFSampleViewer::updateEnviromentDescriptorSets()
+{
+	enviromentCache_->updateDescriptorSets();
+}
+bool VulkanGLTFSampleViewer::getEnviromentImagesPath(const std::string& enviromentName, EnviromentImagesPath& paths)
+{
+	if (!IblBaker::isPanorama(enviromentName)) {
+		paths = MakeEnvImgsPath(getEnviromentAssetPath(), enviromentName);
+		return true;
+	}
+	// baked once, then found in the cache by the panorama's hash
+	if (!iblBaker_) {
+		iblBaker_ = std::make_shared<IblBaker>(IblBaker::Settings());
+		iblBaker_->enableCompute(vulkanDevice, queue, getSampleShadersPath() + "ibl_filter.comp.spv");
+	}
+	auto tStart = std::chrono::high_resolution_clock::now();
+	if (!iblBaker_->bake(enviromentName, iblCacheDir_, false, paths)) return false;
+	auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	std::cout << "environment \"" << enviromentName << "\" from " << paths.ggxEnvPath << " (" << (uint32_t)tDiff << " ms)\n";
+	return true;
+}
 bool VulkanGLTFSampleViewer::reloadEnviroment()
 {
-	enviroment_->load(MakeEnvImgsPath(getEnviromentAssetPath(), enviromentName_), hasTransmission_ ? &opaqueFramebuffer_->attachments[isMSAAEnabled() ? 1 : 0] : nullptr);
-
-	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
-	enviroment_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	vkUpdateDescriptorSets(device, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+	// a resident environment is bound from the next frame on, applyLoadedEnviroment binds any other once it is loaded
+	enviromentCache_->select(enviromentName_);
 	return true;
 }
+void VulkanGLTFSampleViewer::applyLoadedEnviroment()
+{
+	EnviromentImagesPtr images;
+	if (!enviromentCache_->pollRequest(images)) return;
+	// loading failed, the environment selection goes back to what is still shown
+	if (!images) enviromentName_ = enviroment_->getImages()->name;
+}
+SceneLoadRequest VulkanGLTFSampleViewer::makeSceneLoadRequest() const
+{
+	SceneLoadRequest request;
+	request.modelName = modelName_;
+	request.glb = modelGlb_;
+	if (modelGlb_) request.filename = getModelAssetPath() + "Models/" + modelName_ + "/glTF-Binary/" + modelName_ + ".glb";
+	else request.filename = getModelAssetPath() + "Models/" + modelName_ + "/glTF/" + modelName_ + ".gltf";
+	request.aspect = (float)width / (float)height;
+	request.vertexLayout = vertexLayout_;
+	request.optimizeMeshes = optimizeMeshes_;
+	request.modelCacheDir = modelCacheDir_;
+	request.cookedTextureDir = cookedTextureDir_;
+	request.bindless = bindless_;
+	return request;
+}
+void VulkanGLTFSampleViewer::setScene(const ScenePtr& scene)
+{
+	scene_ = scene;
+	model_ = scene->model;
+	userCamera_ = scene->camera;
+	lightMgr_ = scene->lightMgr;
+}
 bool VulkanGLTFSampleViewer::reloadModel()
 {
-	tinygltf::Model gltfMdl, gltfCamera;
-	{
-		tinygltf::TinyGLTF gltfContext;
-		if (modelGlb_) {
-			if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/" + modelName_ + "/glTF-Binary/" + modelName_ + ".glb"))
-				return false;
-		}
-		else {
-			if (!LoadGltfModelFromFile(gltfMdl, getModelAssetPath() + "Models/" + modelName_ + "/glTF/" + modelName_ + ".gltf"))
-				return false;
+	// the current scene keeps being drawn, applyLoadedScene swaps the new one in once it is resident
+	sceneLoader_->requestScene(makeSceneLoadRequest());
+	return true;
+}
+void VulkanGLTFSampleViewer::applyLoadedScene()
+{
+	ScenePtr scene;
+	if (!sceneLoader_->pollScene(scene)) return;
+	if (!scene) {
+		// loading failed, the model selection goes back to what is still shown
+		if (!sceneLoader_->isBusy()) {
+			modelName_ = scene_->modelName;
+			modelGlb_ = scene_->glb;
 		}
-		gltfCamera = gltfMdl;
+		return;
 	}
-
-	lightMgr_->load(gltfMdl);
-
-	model_->load(gltfMdl, *mtlFac_);
-
-	constantValue_.USE_SKELETON = model_->hasSkin();
-	if (!modelPipelineByConstant_.count(constantValue_)) {
-		createModelPipeline(constantValue_, modelPipelineByConstant_[constantValue_]);
+	swapScene(scene);
+}
+void VulkanGLTFSampleViewer::swapScene(const ScenePtr& scene)
+{
+	// the frames in flight may still draw the old scene
+	retiredScenes_.push_back({ scene_, (uint32_t)frameResources.size() });
+	setScene(scene);
+	if (specializeMaterials_) requireMaterialPipelines(*model_);
+
+	hasTransmission_ = model_->hasTransmission();
+	if (hasTransmission_ && !opaqueFramebuffer_) {
+		// only the first model with transmission pays for this, the environment sets of all frames get the framebuffer bound
+		waitFramesInFlight();
+		createOpaqueFramebuffer();
+		enviroment_->setTransmissionFramebuffer(getTransmissionAttachment());
+		updateEnviromentDescriptorSets();
+	}
+}
+bool VulkanGLTFSampleViewer::stepViewerBenchmark()
+{
+	if (viewerBench_->isFinished()) return false;
+	if (!viewerBench_->isRunComplete()) return true;
+
+	std::string modelName, enviromentName;
+	if (!viewerBench_->beginNextRun(modelName, enviromentName)) {
+		viewerBench_->writeReport(vulkanDevice->properties);
+#if defined(_WIN32)
+		PostQuitMessage(0);
+#elif !defined(VK_USE_PLATFORM_ANDROID_KHR)
+		quit = true;
+#endif
+		return false;
 	}
 
-	BoundingBox bbox = model_->getWorldBBox();
-	userCamera_ = cameraFac_->creatCamera((float)width / (float)height, bbox.min, bbox.max, gltfCamera);
-
-	DrawableQueueGroup dqg;
-	model_->getDrawableQueueGroup(dqg, *userCamera_);
-	bool hasTransmission = !dqg.transmissionQueue_.empty();
-	if (hasTransmission && !opaqueFramebuffer_) {
-		createOpaqueFramebuffer();
+	// loads are synchronous here, their time is reported separately from the frame phases
+	ViewerBenchmark::Run& run = viewerBench_->getCurrentRun();
+	if (modelName != scene_->modelName || modelGlb_ != scene_->glb) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		modelName_ = modelName;
+		ScenePtr scene = sceneLoader_->loadScene(makeSceneLoadRequest());
+		run.modelLoadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		if (!scene) {
+			// the previous model is still drawn, its frames must not be reported under this name
+			std::cerr << "Viewer benchmark could not load \"" << modelName << "\", skipping the run\n";
+			viewerBench_->failRun();
+			return stepViewerBenchmark();
+		}
+		swapScene(scene);
 	}
-	if (hasTransmission != hasTransmission_) {
-		enviroment_->load(MakeEnvImgsPath(getEnviromentAssetPath(), enviromentName_), hasTransmission_ ? &opaqueFramebuffer_->attachments[isMSAAEnabled() ? 1 : 0] : nullptr);
+	if (enviromentName != enviromentName_) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		enviromentName_ = enviromentName;
+		if (!enviromentCache_->load(enviromentName_)) enviromentName_ = enviroment_->getImages()->name;
+		run.enviromentLoadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
-	hasTransmission_ = hasTransmission;
-
-	// write-to descriptor-sets
-	std::vector<VkWriteDescriptorSet> writeDescriptorSet;
-	userCamera_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	lightMgr_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	enviroment_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	model_->uploadDescriptorSet2Gpu(writeDescriptorSet);
-	vkUpdateDescriptorSets(device, writeDescriptorSet.size(), writeDescriptorSet.data(), 0, nullptr);
+	animationTime_ = 0.0f;
 	return true;
 }
+void VulkanGLTFSampleViewer::releaseRetiredScenes()
+{
+	bool released = false;
+	for (auto it = retiredScenes_.begin(); it != retiredScenes_.end();) {
+		if (--it->framesLeft == 0) {
+			it = retiredScenes_.erase(it);
+			released = true;
+		}
+		else ++it;
+	}
+	// blocks the old scene emptied go back to the driver, the next scene starts from compact blocks
+	if (released) vulkanDevice->memoryAllocator->releaseEmptyBlocks();
+}
 
 bool VulkanGLTFSampleViewer::createSkyboxPipeline(int TONEMAP, ModelPipeline& mdlpipe)
 {
@@ -608,12 +832,11 @@ bool VulkanGLTFSampleViewer::createSkyboxPipeline(int TONEMAP, ModelPipeline& md
 
 	// Vertex input bindings and attributes
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
-	const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
-		vks::initializers::vertexInputBindingDescription(0, sizeof(AnimatedModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
-	};
+	// sky.vert reads the interleaved layout, the skybox model is always loaded with it
+	const std::vector<VkVertexInputBindingDescription> vertexInputBindings = AnimatedModel::getVertexBindingsDesc(skyBox_->getVertexLayout(), false);
 	vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size());
 	vertexInputStateCI.pVertexBindingDescriptions = vertexInputBindings.data();
-	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = model_->getVertexAttributesDesc();
+	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = AnimatedModel::getVertexAttributesDesc(skyBox_->getVertexLayout());
 	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 	vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
@@ -670,20 +893,29 @@ bool VulkanGLTFSampleViewer::createModelPipeline(const ConstantValue& cv, ModelP
 
 	// Vertex input bindings and attributes
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
-	const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
-		vks::initializers::vertexInputBindingDescription(0, sizeof(AnimatedModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
-	};
+	const std::vector<VkVertexInputBindingDescription> vertexInputBindings = AnimatedModel::getVertexBindingsDesc(vertexLayout_, cv.USE_SKELETON != 0);
 	vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size());
 	vertexInputStateCI.pVertexBindingDescriptions = vertexInputBindings.data();
-	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = model_->getVertexAttributesDesc();
+	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = AnimatedModel::getVertexAttributesDesc(vertexLayout_);
 	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 	vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
-	VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+	const VkCullModeFlags cullMode = cv.DOUBLE_SIDED ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, cullMode, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+	// only a specialized ALPHAMODE_BLEND pipeline blends, the one for all materials keeps drawing them opaque
+	const bool blend = cv.ALPHA_MODE == ALPHAMODE_BLEND;
+	VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, blend ? VK_TRUE : VK_FALSE);
+	if (blend) {
+		blendAttachmentStateCI.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentStateCI.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStateCI.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStateCI.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStateCI.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStateCI.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
 	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentStateCI);
-	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, blend ? VK_FALSE : VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
 	VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 	VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(sampleCount_, 0);
 	const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
@@ -726,16 +958,36 @@ bool VulkanGLTFSampleViewer::createModelPipeline(const ConstantValue& cv, ModelP
 	}
 	return true;
 }
+void VulkanGLTFSampleViewer::requireModelPipelines(const ConstantValue& cv)
+{
+	// the transmission pass draws with the linear tonemap variant
+	auto constantValueLinear = cv; constantValueLinear.TONEMAP = TONEMAP_LINEAR;
+	for (const ConstantValue& constantValue : { cv, constantValueLinear }) {
+		if (!modelPipelineByConstant_.count(constantValue))
+			createModelPipeline(constantValue, modelPipelineByConstant_[constantValue]);
+	}
+}
+void VulkanGLTFSampleViewer::requireMaterialPipelines(const AnimatedModel& model)
+{
+	// built when the model is swapped in, drawing only picks them
+	for (auto& variant : model.getMaterialVariants()) {
+		auto constantValue = constantValue_;
+		constantValue.USE_SKELETON = variant.second ? 1 : 0;
+		constantValue.setMaterialVariant(variant.first);
+		requireModelPipelines(constantValue);
+	}
+}
 void VulkanGLTFSampleViewer::preparePipelines()
 {
 	if (!modelPipelineLayout_)
 	{
 		std::array<VkDescriptorSetLayout, SET_COUNT> dsLayouts = {
 			enviroment_->descriptorSetLayout,
-			cameraFac_->descriptorSetLayout,
+			scene_->cameraFac->descriptorSetLayout,
 			lightMgr_->descriptorSetLayout,
 			mtlFac_->getDescriptorSetLayout(),
-			model_->skeletonDSLayout
+			model_->skeletonDSLayout,
+			indirectDrawer_->descriptorSetLayout
 		};
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(dsLayouts.data(), dsLayouts.size());
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -745,18 +997,23 @@ void VulkanGLTFSampleViewer::preparePipelines()
 		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &modelPipelineLayout_));
 	}
-	createModelPipeline(constantValue_, modelPipelineByConstant_[constantValue_]);
-	auto constantValueLinear = constantValue_; constantValueLinear.TONEMAP = TONEMAP_LINEAR;
-	createModelPipeline(constantValueLinear, modelPipelineByConstant_[constantValueLinear]);
+	// static and skinned primitives draw with their own skeleton variant, both are built up front,
+	// so swapping in a background loaded model never compiles a pipeline
+	for (int USE_SKELETON = 0; USE_SKELETON <= 1; ++USE_SKELETON) {
+		auto constantValue = constantValue_; constantValue.USE_SKELETON = USE_SKELETON;
+		requireModelPipelines(constantValue);
+	}
+	if (specializeMaterials_) requireMaterialPipelines(*model_);
 
 	if (!skyboxPipelineLayout_)
 	{
 		std::array<VkDescriptorSetLayout, SET_COUNT> dsLayouts = {
 			enviroment_->descriptorSetLayout,
-			cameraFac_->descriptorSetLayout,
+			scene_->cameraFac->descriptorSetLayout,
 			lightMgr_->descriptorSetLayout,
 			mtlFac_->getDescriptorSetLayout(),
-			model_->skeletonDSLayout
+			model_->skeletonDSLayout,
+			indirectDrawer_->descriptorSetLayout
 		};
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(dsLayouts.data(), dsLayouts.size());
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -770,7 +1027,7 @@ void VulkanGLTFSampleViewer::preparePipelines()
 	if (!skyboxLinearPipeline_.layout) createSkyboxPipeline(TONEMAP_LINEAR, skyboxLinearPipeline_);
 }
 
-void VulkanGLTFSampleViewer::drawScene(int currentBuffer)
+void VulkanGLTFSampleViewer::drawScene(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -791,44 +1048,48 @@ void VulkanGLTFSampleViewer::drawScene(int currentBuffer)
 	}
 
 	DrawableQueueGroup modelDQG, skyDQG;
-	model_->getDrawableQueueGroup(modelDQG, *userCamera_); 
-	modelDQG.sortTransparentQueueByDepth(); 
-	modelDQG.sortTransmissionQueueByDepth();
-	skyBox_->getDrawableQueueGroup(skyDQG, *userCamera_);
+	{
+		ViewerBenchmark::ScopedPhase phase(viewerBench_.get(), kBenchPhase_Extraction);
+		model_->getDrawableQueueGroup(modelDQG, *userCamera_); 
+		modelDQG.sortOpaqueQueueByState();
+		modelDQG.sortTransparentQueueByDepth(); 
+		modelDQG.sortTransmissionQueueByDepth();
+		skyBox_->getDrawableQueueGroup(skyDQG, *userCamera_);
+	}
+	// the transmission pass draws opaque and transparent drawables a second time
+	const size_t modelDrawableCount = modelDQG.opaqueQueue_.size() + modelDQG.transmissionQueue_.size() + modelDQG.transparentQueue_.size();
+	indirectDrawer_->beginFrame(currentFrame, (uint32_t)(2 * modelDrawableCount));
 
-	VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[currentBuffer], &cmdBufInfo));
+	ViewerBenchmark::ScopedPhase recordPhase(viewerBench_.get(), kBenchPhase_Recording);
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 	{
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(drawCmdBuffers[currentBuffer], 0, 1, &viewport);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(drawCmdBuffers[currentBuffer], 0, 1, &scissor);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
 		// descriptor set
 		std::array<VkDescriptorSet, 3> descriptorSets = {
-			enviroment_->descriptorSet,
+			enviroment_->getDescriptorSet(),
 			userCamera_->descriptorSet,
 			lightMgr_->descriptorSet
 		};
+		// the three uniform blocks live in the frame's slice of uniformRing_
+		const uint32_t frameOffset = uniformRing_->getDynamicOffset(currentFrame);
+		const std::array<uint32_t, 3> dynamicOffsets = { frameOffset, frameOffset, frameOffset };
 		
-		auto func_bindVboIbo = [&](AnimatedModel& mdl) {
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[currentBuffer], 0, 1, &mdl.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[currentBuffer], mdl.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-		};
-
-		auto& mdl_pipe = modelPipelineByConstant_[constantValue_];
 		auto constantValueLinear = constantValue_; constantValueLinear.TONEMAP = TONEMAP_LINEAR;
-		auto& mdl_linear_pipe = modelPipelineByConstant_[constantValueLinear];
 		
 		auto& sky_pipe = skyboxPipeline_;
 		auto& sky_linear_pipe = skyboxLinearPipeline_;
 
 		auto func_bindPipeline = [&](ModelPipeline& mpipe) {
 			// bind pipeline
-			vkCmdBindPipeline(drawCmdBuffers[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe_ ? mpipe.wireframe : mpipe.solid);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe_ ? mpipe.wireframe : mpipe.solid);
 			// bind descriptor set
-			vkCmdBindDescriptorSets(drawCmdBuffers[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, mpipe.layout, ENVIROMENT_SET, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mpipe.layout, ENVIROMENT_SET, descriptorSets.size(), descriptorSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+			indirectDrawer_->bindDescriptorSet(commandBuffer, mpipe.layout);
 		};
 		auto func_beginPass = [&](VkRenderPass pass, int width, int height, VkFramebuffer framebuffer){
 			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
@@ -840,14 +1101,72 @@ void VulkanGLTFSampleViewer::drawScene(int currentBuffer)
 			renderPassBeginInfo.clearValueCount = clearValues.size();
 			renderPassBeginInfo.pClearValues = clearValues.data();
 			renderPassBeginInfo.framebuffer = framebuffer;
-			vkCmdBeginRenderPass(drawCmdBuffers[currentBuffer], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		};
 		auto func_endPass = [&](){
-			vkCmdEndRenderPass(drawCmdBuffers[currentBuffer]);
+			vkCmdEndRenderPass(commandBuffer);
 		};
 
 		auto func_draw = [&](Drawable& drawable, ModelPipeline& mpipe) {
-			drawable.draw(drawCmdBuffers[currentBuffer], mpipe.layout);
+			drawable.draw(commandBuffer, mpipe.layout);
+		};
+		// static and skinned primitives use different pipelines and vertex streams, rebind only when the kind changes
+		ModelPipeline* boundPipeline = nullptr;
+		int boundSkinned = -1;
+		int boundIndexType = -1;
+		// bindless drawables share their material set, only the skin set changes
+		std::array<VkDescriptorSet, 2> boundDescriptorSets = {};
+		auto func_drawModel = [&](std::vector<Drawable>& queue, const std::vector<uint32_t>& order, const ConstantValue& cv) {
+			auto constantValueStatic = cv; constantValueStatic.USE_SKELETON = 0;
+			auto constantValueSkinned = cv; constantValueSkinned.USE_SKELETON = 1;
+			ModelPipeline* mdl_pipes[2] = { &modelPipelineByConstant_[constantValueStatic], &modelPipelineByConstant_[constantValueSkinned] };
+			// specialized pipelines are looked up once per run of drawables with the same variant
+			MaterialVariant lookupVariant;
+			int lookupSkinned = -1;
+			ModelPipeline* variantPipe = nullptr;
+			for (size_t i = 0; i < order.size(); ) {
+				auto& drawable = queue[order[i]];
+				ModelPipeline* pipe = mdl_pipes[drawable.skinned_ ? 1 : 0];
+				if (specializeMaterials_) {
+					if (!variantPipe || lookupSkinned != (int)drawable.skinned_ || lookupVariant != drawable.variant_) {
+						lookupSkinned = drawable.skinned_;
+						lookupVariant = drawable.variant_;
+						auto constantValue = cv;
+						constantValue.USE_SKELETON = drawable.skinned_ ? 1 : 0;
+						constantValue.setMaterialVariant(drawable.variant_);
+						requireModelPipelines(constantValue);//no-op unless the variant was missed by requireMaterialPipelines
+						variantPipe = &modelPipelineByConstant_[constantValue];
+					}
+					pipe = variantPipe;
+				}
+				auto& mdl_pipe = *pipe;
+				if (boundPipeline != pipe) {
+					boundPipeline = pipe;
+					func_bindPipeline(mdl_pipe);
+				}
+				if (boundSkinned != (int)drawable.skinned_) {
+					boundSkinned = drawable.skinned_;
+					model_->bindVertexBuffers(commandBuffer, drawable.skinned_);
+				}
+				if (boundIndexType != (int)drawable.indexType_) {
+					boundIndexType = drawable.indexType_;
+					model_->bindIndexBuffer(commandBuffer, drawable.indexType_);
+				}
+				if (cv.INDIRECT_DRAW) {
+					// depth sorted queues only merge neighbours, a multi-draw keeps their order
+					size_t end = i + 1;
+					while (end < order.size() && IndirectDrawer::isSameBatch(drawable, queue[order[end]])
+						&& (!specializeMaterials_ || drawable.variant_ == queue[order[end]].variant_)) ++end;
+					indirectDrawer_->draw(commandBuffer, mdl_pipe.layout, queue, &order[i], (uint32_t)(end - i));
+					boundDescriptorSets = drawable.descriptorSets_;
+					i = end;
+				}
+				else {
+					drawable.draw(commandBuffer, mdl_pipe.layout, drawable.descriptorSets_ != boundDescriptorSets);
+					boundDescriptorSets = drawable.descriptorSets_;
+					++i;
+				}
+			}
 		};
 		if (hasTransmission_) 
 		{
@@ -855,22 +1174,22 @@ void VulkanGLTFSampleViewer::drawScene(int currentBuffer)
 			{
 				if (showEnviromentMap_) {
 					func_bindPipeline(sky_linear_pipe);
-					func_bindVboIbo(*skyBox_);
+					skyBox_->bindVertexBuffers(commandBuffer, false);
+					skyBox_->bindIndexBuffer(commandBuffer, VK_INDEX_TYPE_UINT32);
 					for (auto& drawable : skyDQG.opaqueQueue_)
 						func_draw(drawable, sky_linear_pipe);
 				}
 
-				func_bindPipeline(mdl_linear_pipe);
-				func_bindVboIbo(*model_);
-				for (auto& drawable : modelDQG.opaqueQueue_)
-					func_draw(drawable, mdl_linear_pipe);
-				for (auto& drawable : modelDQG.transparentQueue_)
-					func_draw(drawable, mdl_linear_pipe);
+				boundPipeline = nullptr;
+				boundSkinned = boundIndexType = -1;
+				boundDescriptorSets = {};
+				func_drawModel(modelDQG.opaqueQueue_, modelDQG.opaqueOrder_, constantValueLinear);
+				func_drawModel(modelDQG.transparentQueue_, modelDQG.transparentOrder_, constantValueLinear);
 			}
 			func_endPass();
 
 			vks::tools::insertImageMemoryBarrier(
-				drawCmdBuffers[currentBuffer],
+				commandBuffer,
 				opaqueFramebuffer_->attachments[isMSAAEnabled() ? 1 : 0].image,
 				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, 
 				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
@@ -878,68 +1197,58 @@ void VulkanGLTFSampleViewer::drawScene(int currentBuffer)
 				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
 			);
 
-			func_beginPass(renderPass, width, height, frameBuffers[currentBuffer]);
+			func_beginPass(renderPass, width, height, frameBuffers[imageIndex]);
 			{
 				if (showEnviromentMap_) {
 					func_bindPipeline(sky_pipe);
-					func_bindVboIbo(*skyBox_);
+					skyBox_->bindVertexBuffers(commandBuffer, false);
+					skyBox_->bindIndexBuffer(commandBuffer, VK_INDEX_TYPE_UINT32);
 					for (auto& drawable : skyDQG.opaqueQueue_)
 						func_draw(drawable, sky_pipe);
 				}
 
-				func_bindPipeline(mdl_pipe);
-				func_bindVboIbo(*model_);
-				for (auto& drawable : modelDQG.opaqueQueue_)
-					func_draw(drawable, mdl_pipe);
-				for (auto& drawable : modelDQG.transmissionQueue_)
-					func_draw(drawable, mdl_pipe);
-				for (auto& drawable : modelDQG.transparentQueue_)
-					func_draw(drawable, mdl_pipe);
+				boundPipeline = nullptr;
+				boundSkinned = boundIndexType = -1;
+				boundDescriptorSets = {};
+				func_drawModel(modelDQG.opaqueQueue_, modelDQG.opaqueOrder_, constantValue_);
+				func_drawModel(modelDQG.transmissionQueue_, modelDQG.transmissionOrder_, constantValue_);
+				func_drawModel(modelDQG.transparentQueue_, modelDQG.transparentOrder_, constantValue_);
 
-				drawUI(drawCmdBuffers[currentBuffer]);
+				drawUI(commandBuffer);
 			}
 			func_endPass();
 		}
 		else
 		{
-			func_beginPass(renderPass, width, height, frameBuffers[currentBuffer]);
+			func_beginPass(renderPass, width, height, frameBuffers[imageIndex]);
 			{
 				if (showEnviromentMap_) {
 					func_bindPipeline(sky_pipe);
-					func_bindVboIbo(*skyBox_);
+					skyBox_->bindVertexBuffers(commandBuffer, false);
+					skyBox_->bindIndexBuffer(commandBuffer, VK_INDEX_TYPE_UINT32);
 					for (auto& drawable : skyDQG.opaqueQueue_)
 						func_draw(drawable, sky_pipe);
 				}
 
-				func_bindPipeline(mdl_pipe);
-				func_bindVboIbo(*model_);
-				for (auto& drawable : modelDQG.opaqueQueue_)
-					func_draw(drawable, mdl_pipe);
-				for (auto& drawable : modelDQG.transmissionQueue_)
-					func_draw(drawable, mdl_pipe);
-				for (auto& drawable : modelDQG.transparentQueue_)
-					func_draw(drawable, mdl_pipe);
-				drawUI(drawCmdBuffers[currentBuffer]);
+				boundPipeline = nullptr;
+				boundSkinned = boundIndexType = -1;
+				boundDescriptorSets = {};
+				func_drawModel(modelDQG.opaqueQueue_, modelDQG.opaqueOrder_, constantValue_);
+				func_drawModel(modelDQG.transmissionQueue_, modelDQG.transmissionOrder_, constantValue_);
+				func_drawModel(modelDQG.transparentQueue_, modelDQG.transparentOrder_, constantValue_);
+				drawUI(commandBuffer);
 			}
 			func_endPass();
 		}
 	}
-	VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[currentBuffer]));
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 }
-void VulkanGLTFSampleViewer::buildCommandBuffers()
-{
-	for (int i = 0; i < drawCmdBuffers.size(); ++i) {
-		drawScene(i);
-	}
-}
-
 void VulkanGLTFSampleViewer::prepare()
 {
 	initSettings();
 	VulkanExampleBase::prepare();
 	if (!initScene()) return;
 	preparePipelines();
-	buildCommandBuffers();
 	prepared = true;
 }
 #pragma endregion
@@ -947,37 +1256,68 @@ void VulkanGLTFSampleViewer::prepare()
 #pragma region render
 void VulkanGLTFSampleViewer::updateScene()
 {
-	if (!paused) animationTime_ += timerSpeed * frameTimer;
+	// the benchmark steps by a fixed timestep, so every run animates through the same poses
+	if (!paused) animationTime_ += viewerBench_ ? viewerBench_->timestep : timerSpeed * frameTimer;
+	model_->setFrameIndex(currentFrame);
+	skyBox_->setFrameIndex(currentFrame);
 	model_->setAnimationTime(animationTime_);
 
-	userCamera_->uploadParams2Gpu();
-	lightMgr_->uploadParams2Gpu();
-	enviroment_->uploadParams2Gpu();
+	uniformRing_->resetStats();
+	userCamera_->uploadParams2Gpu(currentFrame);
+	lightMgr_->uploadParams2Gpu(currentFrame);
+	enviroment_->uploadParams2Gpu(currentFrame);
 }
 void VulkanGLTFSampleViewer::myRrenderFrame()
 {
-	VulkanExampleBase::prepareFrame();
+	ViewerBenchmark* bench = viewerBench_.get();
+	if (bench) bench->beginFrame();
 
-	updateScene();
-	drawScene(currentBuffer);
+	// refills the upload budget of a background load and submits its finished transfers to the graphics queue
+	if (uploadManager_) uploadManager_->beginFrame();
+	// swapped before this frame resets its fence, so a swap can still wait for the frames in flight
+	applyLoadedScene();
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	VulkanExampleBase::submitFrame();
+	{
+		// waits only for the frame that last used this slot, not for the whole queue
+		ViewerBenchmark::ScopedPhase phase(bench, kBenchPhase_FrameWait);
+		if (!prepareFrameInFlight()) return;
+	}
+	releaseRetiredScenes();
+	// a finished environment load gets its set written here, while the frames in flight keep the current one
+	enviromentCache_->beginFrame();
+	applyLoadedEnviroment();
+
+	{
+		ViewerBenchmark::ScopedPhase phase(bench, kBenchPhase_Animation);
+		updateScene();
+	}
+	drawScene(frameResources[currentFrame].commandBuffer, currentBuffer);
+
+	{
+		ViewerBenchmark::ScopedPhase phase(bench, kBenchPhase_SubmitPresent);
+		submitFrameInFlight();
+	}
+	if (bench) bench->endFrame();
 }
 
 void VulkanGLTFSampleViewer::render()
 {
 	if (!prepared)
 		return;
+	if (viewerBench_ && !stepViewerBenchmark())
+		return;
 	myRrenderFrame();
 }
 #pragma endregion
 
 void VulkanGLTFSampleViewer::windowResized()
 {
-	if (hasTransmission_) createOpaqueFramebuffer();
+	if (opaqueFramebuffer_) {
+		createOpaqueFramebuffer();
+		// the device is idle after the resize, the environment sets can be rewritten right away
+		enviroment_->setTransmissionFramebuffer(getTransmissionAttachment());
+		updateEnviromentDescriptorSets();
+	}
 }
 
 void VulkanGLTFSampleViewer::mouseWheeled(short wheelDelta, bool& handled)
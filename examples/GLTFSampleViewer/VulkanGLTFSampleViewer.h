@@ -5,6 +5,11 @@
 #include "Camera.h"
 #include "Light.h"
 #include "Enviroment.h"
+#include "EnviromentCache.h"
+#include "SceneLoader.h"
+#include "IndirectDrawer.h"
+#include "IblBaker.h"
+#include "ViewerBenchmark.h"
 #include "VulkanFrameBuffer.hpp"
 
 struct MultiSampleTarget 
@@ -30,6 +35,11 @@ struct ConstantValue
 	int USE_PUNCTUAL = 1;
 	int DEBUG1 = 0;
 	int USE_SKELETON = 0;
+	int INDIRECT_DRAW = 0;//model matrix from DRAW_SET instead of the push constants
+	// MaterialVariant of the drawn materials, the defaults build one pipeline for every material
+	int MATERIAL_FEATURES = -1;
+	int ALPHA_MODE = -1;
+	int DOUBLE_SIDED = 0;//rasterizer state only, gltf2.frag declares no constant for it
 
 	// Hash function
 	struct Hash {
@@ -40,6 +50,10 @@ struct ConstantValue
 			hashValue ^= std::hash<int>{}(cv.USE_PUNCTUAL) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
 			hashValue ^= std::hash<int>{}(cv.DEBUG1) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
 			hashValue ^= std::hash<int>{}(cv.USE_SKELETON) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
+			hashValue ^= std::hash<int>{}(cv.INDIRECT_DRAW) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
+			hashValue ^= std::hash<int>{}(cv.MATERIAL_FEATURES) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
+			hashValue ^= std::hash<int>{}(cv.ALPHA_MODE) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
+			hashValue ^= std::hash<int>{}(cv.DOUBLE_SIDED) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
 			return hashValue;
 		}
 	};
@@ -50,13 +64,23 @@ struct ConstantValue
 			USE_IBL == other.USE_IBL &&
 			USE_PUNCTUAL == other.USE_PUNCTUAL &&
 			DEBUG1 == other.DEBUG1 &&
-			USE_SKELETON == other.USE_SKELETON;
+			USE_SKELETON == other.USE_SKELETON &&
+			INDIRECT_DRAW == other.INDIRECT_DRAW &&
+			MATERIAL_FEATURES == other.MATERIAL_FEATURES &&
+			ALPHA_MODE == other.ALPHA_MODE &&
+			DOUBLE_SIDED == other.DOUBLE_SIDED;
 	}
 
 	// Less-than operator (used for ordering in std::map and std::set)
 	bool operator<(const ConstantValue& other) const {
-		return std::tie(TONEMAP, USE_IBL, USE_PUNCTUAL, DEBUG1, USE_SKELETON)
-			< std::tie(other.TONEMAP, other.USE_IBL, other.USE_PUNCTUAL, other.DEBUG1, USE_SKELETON);
+		return std::tie(TONEMAP, USE_IBL, USE_PUNCTUAL, DEBUG1, USE_SKELETON, INDIRECT_DRAW, MATERIAL_FEATURES, ALPHA_MODE, DOUBLE_SIDED)
+			< std::tie(other.TONEMAP, other.USE_IBL, other.USE_PUNCTUAL, other.DEBUG1, other.USE_SKELETON, other.INDIRECT_DRAW, other.MATERIAL_FEATURES, other.ALPHA_MODE, other.DOUBLE_SIDED);
+	}
+
+	void setMaterialVariant(const MaterialVariant& variant) {
+		MATERIAL_FEATURES = variant.features;
+		ALPHA_MODE = variant.alphaMode;
+		DOUBLE_SIDED = variant.doubleSided;
 	}
 };
 
@@ -79,16 +103,43 @@ public:
 	ModelPipeline skyboxPipeline_, skyboxLinearPipeline_;
 
 	MaterialFactoryPtr mtlFac_;
-	CameraFactoryPtr cameraFac_;
 	CameraPtr userCamera_;
 	LightManagerPtr lightMgr_;
 	EnviromentPtr enviroment_;
+	EnviromentCachePtr enviromentCache_;//the environment bound is one of its resident ones
 	AnimatedModelPtr model_, skyBox_;
+	UniformRingPtr uniformRing_;//environment, camera and light constants of every frame in flight
+	TextureCachePtr textureCache_;//images and samplers of the models and the skybox
+	IndirectDrawerPtr indirectDrawer_;//its set is bound for direct draws too, the model shaders declare DRAW_SET
+
+	// model_, userCamera_ and lightMgr_ belong to scene_, a replaced scene lives on until no frame in flight draws it
+	ScenePtr scene_;
+	struct RetiredScene {
+		ScenePtr scene;
+		uint32_t framesLeft = 0;
+	};
+	std::vector<RetiredScene> retiredScenes_;
+	SceneLoaderPtr sceneLoader_;
+	UploadManagerPtr uploadManager_;//background scene loads stream through it, null with synchronous uploads
+	bool asyncUploads_ = true;
+	uint32_t uploadBudgetMB_ = 16;//per frame, 0 is unlimited
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures_{};
+	ViewerBenchmarkPtr viewerBench_;//only set in benchmark mode
 
 	float animationTime_ = 0.0f;
 	bool cameraFixed_ = false;
 	std::string modelName_, enviromentName_;
 	bool modelGlb_ = false;
+	VertexLayout vertexLayout_ = kVertexLayout_Full;//of every scene model, the pipelines are built for it
+	bool optimizeMeshes_ = false;
+	std::string modelCacheDir_ = "modelcache";//empty if the model cache is disabled
+	std::string cookedTextureDir_ = "cookedtextures";//empty if cooked textures are not loaded
+	std::string iblCacheDir_ = "iblcache";//environments baked from HDR panoramas
+	IblBakerPtr iblBaker_;//created with the first panorama, used by the enviroment cache worker only
+	uint32_t enviromentBudgetMB_ = 256;//of resident environment cubemaps
+	std::string prefetchedEnviroment_;//the UI prefetched the environments next to it
+	bool bindless_ = false;//materials through MaterialTable, drawn with gltf2_bindless.frag
+	bool specializeMaterials_ = false;//a pipeline per MaterialVariant instead of one for all materials
 
 	struct ShaderName {
 		std::string vertex;
@@ -112,7 +163,6 @@ public:
 	bool isMSAAEnabled() const { return sampleCount_ != VK_SAMPLE_COUNT_1_BIT; }
 
 #pragma region prepare
-	void buildCommandBuffers() override;
 	void setupRenderPass() override;
 	void setupMultisampleTarget();
 	void setupFrameBuffer() override;
@@ -122,6 +172,8 @@ public:
 	void createOpaqueFramebuffer();
 	bool initScene();
 	bool createModelPipeline(const ConstantValue& cv, ModelPipeline& mpipe);
+	void requireModelPipelines(const ConstantValue& cv);
+	void requireMaterialPipelines(const AnimatedModel& model);
 	bool createSkyboxPipeline(int TONEMAP, ModelPipeline& mpipe);
 	void preparePipelines();
 
@@ -130,11 +182,22 @@ public:
 
 #pragma region render
 	void updateScene();
-	void drawScene(int currentBuffer);
+	void drawScene(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void swapScene(const ScenePtr& scene);
+	void applyLoadedScene();
+	void applyLoadedEnviroment();
+	bool stepViewerBenchmark();
+	void releaseRetiredScenes();
 	void myRrenderFrame();
 	void render() override;
 #pragma endregion
 
+	SceneLoadRequest makeSceneLoadRequest() const;
+	void setScene(const ScenePtr& scene);
+	const vks::FramebufferAttachment* getTransmissionAttachment() const;
+	void updateEnviromentDescriptorSets();
+	// an environment of the asset directory, or an HDR panorama baked into iblCacheDir_. Called on the enviroment cache worker
+	bool getEnviromentImagesPath(const std::string& enviromentName, EnviromentImagesPath& paths);
 	bool reloadEnviroment();
 	bool reloadModel();
 	void windowResized() override;
@@ -156,16 +156,42 @@ void VulkanGLTFSampleViewer::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 	if (overlay->header("Settings")) 
 	{
 		overlay->checkBox("Wireframe", &wireframe_);
+		overlay->checkBox("Frustum Culling", &model_->frustumCulling_);
+		overlay->text("Primitives: %u visible, %u culled", model_->getCullingStats().visible, model_->getCullingStats().culled);
+		overlay->text("Uniform blocks: %u written, %u unchanged", uniformRing_->getStats().writes, uniformRing_->getStats().skipped);
+		{
+			const vks::DeviceMemoryAllocator::Stats memoryStats = vulkanDevice->memoryAllocator->getStats();
+			const float MB = 1024.0f * 1024.0f;
+			overlay->text("Device memory: %.1f of %.1f MB used, %u blocks, %u dedicated", memoryStats.usedBytes / MB, (memoryStats.blockBytes + memoryStats.dedicatedBytes) / MB, memoryStats.blockCount, memoryStats.dedicatedCount);
+			overlay->text("Allocations: %u, free block memory %.0f%% fragmented", memoryStats.allocationCount, memoryStats.fragmentation * 100.0f);
+			if (uploadManager_) {
+				const UploadManager::Stats uploadStats = uploadManager_->getStats();
+				overlay->text("Uploads: %u batches, %.1f MB last frame, %u in flight%s", uploadStats.batches, uploadStats.bytes / MB, uploadStats.inFlight,
+					uploadManager_->hasTransferQueue() ? ", transfer queue" : "");
+			}
+			const TextureCache::Stats textureStats = textureCache_->getStats();
+			overlay->text("Textures: %u images (%u shared), %u samplers (%u shared)", textureStats.images, textureStats.imageHits, textureStats.samplers, textureStats.samplerHits);
+			const EnviromentCache::Stats enviromentStats = enviromentCache_->getStats();
+			overlay->text("Environments: %u resident, %.1f of %.0f MB, %u hits (%u prefetched), %u evicted", enviromentCache_->getResidentCount(),
+				enviromentCache_->getResidentBytes() / MB, enviromentCache_->getBudget() / MB, enviromentStats.hits, enviromentStats.prefetchHits, enviromentStats.evictions);
+		}
+		if (constantValue_.INDIRECT_DRAW) overlay->text("Indirect draws: %u for %u primitives", indirectDrawer_->getStats().indirectDraws, indirectDrawer_->getStats().drawables);
 		
+		// a panorama given on the command line
+		if (std::find(sEnviromentAssets.begin(), sEnviromentAssets.end(), enviromentName_) == sEnviromentAssets.end()) sEnviromentAssets.push_back(enviromentName_);
 		int enviromentIndex, enviromentIndexOld;
 		enviromentIndex = enviromentIndexOld = getIndex(sEnviromentAssets, enviromentName_);
 		ImGui_Combo("Environment", vector2map(sEnviromentAssets), enviromentIndex);
+		if (enviromentCache_->isLoading()) overlay->text("Loading environment...");
 
 		bool isGlb = modelGlb_;
 		int modelIndex, modelIndexOld;
 		modelIndex = modelIndexOld = getIndex(sModelAssets, modelName_);
 		ImGui_Combo("Model", vector2map(sModelAssets), modelIndex);
 		overlay->checkBox("glTF-Binary", &isGlb);
+		if (sceneLoader_->isBusy()) {
+			ImGui::ProgressBar(sceneLoader_->getProgress(), ImVec2(-1, 0), sceneLoader_->getStage().c_str());
+		}
 
 		overlay->checkBox("Show EnviromentMap", &showEnviromentMap_);
 		overlay->checkBox("Blur Enviroment", &enviroment_->environmentBlur);
@@ -203,6 +229,13 @@ void VulkanGLTFSampleViewer::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 			enviromentName_ = sEnviromentAssets[enviromentIndex];
 			reloadEnviroment();
 		}
+		// the environments next to the selected one in the list are the likely next picks
+		if (prefetchedEnviroment_ != enviromentName_) {
+			prefetchedEnviroment_ = enviromentName_;
+			const int count = (int)sEnviromentAssets.size();
+			const int index = getIndex(sEnviromentAssets, enviromentName_);
+			enviromentCache_->prefetch({ sEnviromentAssets[(index + 1) % count], sEnviromentAssets[(index + count - 1) % count] });
+		}
 		if (modelIndex != modelIndexOld || isGlb != modelGlb_)
 		{
 			modelName_ = sModelAssets[modelIndex];
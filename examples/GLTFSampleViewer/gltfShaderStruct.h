@@ -22,8 +22,17 @@ static_assert(sizeof(uchar4) == 4, "");
 #pragma pack(push, 16)
 struct PushConsts {
 	mat4 u_ModelMatrix;
+	int u_MaterialIndex = 0;//into the bindless material table
+	int u_padding[3] = {};
 };
-static_assert(sizeof(PushConsts) == 16 * 4, "");
+static_assert(sizeof(PushConsts) == 16 * 5, "");
+// one per indirect draw, the shaders read it at gl_InstanceIndex instead of the push constants
+struct DrawData {
+	mat4 u_ModelMatrix;
+	int u_MaterialIndex = 0;
+	int u_padding[3] = {};
+};
+static_assert(sizeof(DrawData) == 16 * 5, "");
 #pragma pack(pop)
 
 // fragment shader
@@ -93,7 +102,8 @@ static_assert(sizeof(PushConsts) == 16 * 4, "");
 #define LIGHT_SET 2
 #define MATERIAL_SET 3
 #define MODEL_SET 4
-#define LAST_SET 4
+#define DRAW_SET 5
+#define LAST_SET 5
 #define SET_COUNT (LAST_SET - FIRST_SET + 1)
 
 #define MATERIAL_BINDING 0
@@ -117,8 +127,13 @@ static_assert(sizeof(PushConsts) == 16 * 4, "");
 #define MTL_TEX_ANISOTROPY_BINDING 24
 #define MATERIAL_TEXTURE_LAST_BINDING 24
 #define MATERIAL_TEXTURE_COUNT (MATERIAL_TEXTURE_LAST_BINDING - MATERIAL_TEXTURE_FIRST_BINDING + 1)
+// MATERIAL_SET of the bindless mode, one set per model
+#define MTL_BINDLESS_MATERIALS_BINDING 0
+#define MTL_BINDLESS_TEXTURE_INDICES_BINDING 1
+#define MTL_BINDLESS_TEXTURES_BINDING 2
 
 #define SKELETON_BINDING 0
+#define DRAW_DATA_BINDING 0
 #define CAMERA_BINDING 0
 #define LIGHT_BINDING 0
 
@@ -162,6 +177,8 @@ static_assert(sizeof(PushConsts) == 16 * 4, "");
 #define MATERIAL_DISPERSION_BIT                	(1<<24)
 #define MATERIAL_EMISSIVE_STRENGTH_BIT         	(1<<25)
 #define MATERIAL_IOR_BIT						(1<<26)
+// the extensions gltf2.frag compiles out of a MATERIAL_FEATURES specialization
+#define MATERIAL_FEATURE_BITS					((MATERIAL_IOR_BIT - 1) & ~(MATERIAL_SHEEN_BIT - 1))
 
 #define ALPHAMODE_OPAQUE 0
 #define ALPHAMODE_MASK 1
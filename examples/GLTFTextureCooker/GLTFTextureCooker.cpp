@@ -0,0 +1,86 @@
+/*
+ * Offline texture cooker of the glTF sample viewer
+ *
+ * Encodes the material textures of glTF models to block compressed KTX2 files with full mip chains.
+ * GLTFSampleViewer loads them from its cooked texture directory in place of the images they were cooked from,
+ * so cook into the directory the viewer is started with (cookedtextures in its working directory by default).
+ *
+ * usage: GLTFTextureCooker [-o dir] [-j threads] [-f] model.gltf|model.glb...
+ */
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#include "TextureCooker.h"
+#include "GltfImageDecoder.h"
+
+static bool parseModel(tinygltf::Model& gltfMdl, const std::string& filename)
+{
+	tinygltf::TinyGLTF gltfContext;
+	// the cooker hashes the encoded images, they are only decoded if they need cooking
+	gltfContext.SetImageLoader(GltfImageDecoder::deferImageDecode, nullptr);
+	std::string error, warning;
+	bool result;
+	if (vks::tools::getFileNameExtension(filename) == "gltf") {
+		result = gltfContext.LoadASCIIFromFile(&gltfMdl, &error, &warning, filename);
+	}
+	else {
+		result = gltfContext.LoadBinaryFromFile(&gltfMdl, &error, &warning, filename);
+	}
+	if (!result) std::cerr << "load model file \"" << filename << "\" failed: " << error << "\n";
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	CommandLineParser commandLineParser;
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("output", { "-o", "--output" }, 1, "Set directory the cooked textures are written to (default cookedtextures)");
+	commandLineParser.add("threads", { "-j", "--threads" }, 1, "Number of encoding threads (default one per hardware core)");
+	commandLineParser.add("force", { "-f", "--force" }, 0, "Cook textures again that were cooked already");
+	commandLineParser.parse(argc, argv);
+
+	// every argument that is neither an option nor an option value is a model
+	std::vector<std::string> modelFilenames;
+	for (int i = 1; i < argc; ++i) {
+		if (argv[i][0] == '-') {
+			for (auto& option : commandLineParser.options) {
+				const auto& commands = option.second.commands;
+				if (option.second.hasValue && std::find(commands.begin(), commands.end(), argv[i]) != commands.end()) ++i;
+			}
+			continue;
+		}
+		modelFilenames.push_back(argv[i]);
+	}
+	if (commandLineParser.isSet("help") || modelFilenames.empty()) {
+		std::cout << "usage: GLTFTextureCooker [options] model.gltf|model.glb...\n";
+		commandLineParser.printHelp();
+		std::cout << "\n";
+		return modelFilenames.empty() ? 1 : 0;
+	}
+	const std::string cookedDir = commandLineParser.getValueAsString("output", "cookedtextures");
+	TextureCooker cooker((uint32_t)commandLineParser.getValueAsInt("threads", 0));
+	const bool force = commandLineParser.isSet("force");
+
+	bool result = true;
+	TextureCooker::Stats total;
+	for (const std::string& filename : modelFilenames) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		tinygltf::Model gltfMdl;
+		TextureCooker::Stats stats;
+		if (!parseModel(gltfMdl, filename)) {
+			result = false;
+			continue;
+		}
+		result = cooker.cookModel(gltfMdl, cookedDir, force, stats) && result;
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << filename << ": " << stats.cooked << " cooked, " << stats.upToDate << " up to date, " << stats.failed << " failed ("
+			<< (uint32_t)tDiff << " ms)\n";
+		total.cooked += stats.cooked;
+		total.upToDate += stats.upToDate;
+		total.failed += stats.failed;
+	}
+	if (modelFilenames.size() > 1) {
+		std::cout << "total: " << total.cooked << " cooked, " << total.upToDate << " up to date, " << total.failed << " failed\n";
+	}
+	return result ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Shared by gltf.vert and gltf_compact.vert, COMPACT_VERTEX selects the vertex layout
+#define HAS_COLOR_0_VEC4
+#define HAS_NORMAL_VEC3
+#define HAS_TANGENT_VEC4
+
+layout(constant_id = 4) const int USE_SKELETON = 0;
+layout(constant_id = 5) const int INDIRECT_DRAW = 0;
+
+layout (location = 0) in vec4 inPos;
+#ifdef COMPACT_VERTEX
+// AnimatedModel's compact layout: position, attribute and skin streams, normal and tangent are octahedral
+#ifdef HAS_NORMAL_VEC3
+layout (location = 1) in vec2 inNormalOct;
+#endif
+#ifdef HAS_TANGENT_VEC4
+layout (location = 5) in vec2 inTangentOct;
+#endif
+#else
+#ifdef HAS_NORMAL_VEC3
+layout (location = 1) in vec3 inNormal;
+#endif
+#ifdef HAS_TANGENT_VEC4
+layout (location = 5) in vec4 inTangent;
+#endif
+#endif
+#ifdef HAS_COLOR_0_VEC4
+layout (location = 2) in vec4 inColor;
+#endif
+layout (location = 3) in vec2 inUV0;
+layout (location = 4) in vec2 inUV1;
+layout (location = 6) in uvec4 inJointIndices;
+layout (location = 7) in vec4 inJointWeights;
+
+layout(push_constant) uniform PushConsts {
+	mat4 u_ModelMatrix;
+	int u_MaterialIndex;
+} pushConstants;
+
+#define CAMERA_SET 1
+#define CAMERA_BINDING 0
+layout(std140, set = CAMERA_SET, binding = CAMERA_BINDING) uniform CameraUniforms 
+{
+    mat4 u_ViewMatrix;
+    mat4 u_ProjectionMatrix;
+    vec3 u_Camera;
+    float u_Exposure;
+};
+
+#define MODEL_SET 4
+#define SKELETON_BINDING 0
+layout(std140, set = MODEL_SET, binding = SKELETON_BINDING) readonly buffer JointMatrices 
+{
+	mat4 jointMatrices[];
+};
+
+// indirect draws take the model matrix from their DrawData slot, firstInstance is the slot
+#define DRAW_SET 5
+#define DRAW_DATA_BINDING 0
+struct DrawData
+{
+	mat4 u_ModelMatrix;
+	int u_MaterialIndex;
+};
+layout(std430, set = DRAW_SET, binding = DRAW_DATA_BINDING) readonly buffer DrawDatas
+{
+	DrawData u_DrawData[];
+};
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec2 outUV0;
+layout (location = 2) out vec2 outUV1;
+#ifdef HAS_COLOR_0_VEC4
+layout (location = 3) out vec4 outColor;
+#endif
+#ifdef HAS_NORMAL_VEC3
+#ifdef HAS_TANGENT_VEC4
+layout (location = 4) out mat3 outTBN;
+#else
+layout (location = 4) out vec3 outNormal;
+#endif
+#endif
+layout (location = 7) flat out int outDrawIndex;
+layout (location = 8) flat out int outMaterialIndex;//of the bindless material table
+
+#ifdef COMPACT_VERTEX
+vec2 signNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+	return normalize(v);
+}
+#endif
+
+void main() 
+{
+#ifdef COMPACT_VERTEX
+#ifdef HAS_NORMAL_VEC3
+	vec3 inNormal = octDecode(inNormalOct);
+#endif
+#ifdef HAS_TANGENT_VEC4
+	// y is stored remapped to [0,1], its sign is the bitangent sign
+	vec4 inTangent = vec4(octDecode(vec2(inTangentOct.x, abs(inTangentOct.y) * 2.0 - 1.0)), inTangentOct.y < 0.0 ? -1.0 : 1.0);
+#endif
+#endif
+#ifdef HAS_COLOR_0_VEC4
+	outColor = inColor;
+#endif
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	
+	outDrawIndex = gl_InstanceIndex;
+	outMaterialIndex = INDIRECT_DRAW != 0 ? u_DrawData[gl_InstanceIndex].u_MaterialIndex : pushConstants.u_MaterialIndex;
+	mat4 baseMatrix = INDIRECT_DRAW != 0 ? u_DrawData[gl_InstanceIndex].u_ModelMatrix : pushConstants.u_ModelMatrix;
+	mat4 modelMatrix;
+	if (USE_SKELETON != 0)
+	{
+		mat4 skinMat = 
+			inJointWeights.x * jointMatrices[int(inJointIndices.x)] +
+			inJointWeights.y * jointMatrices[int(inJointIndices.y)] +
+			inJointWeights.z * jointMatrices[int(inJointIndices.z)] +
+			inJointWeights.w * jointMatrices[int(inJointIndices.w)];		
+		modelMatrix = baseMatrix * skinMat;
+	}
+	else 
+	{
+		modelMatrix = baseMatrix;
+	}
+
+#ifdef HAS_NORMAL_VEC3
+#ifdef HAS_TANGENT_VEC4
+	mat3 m3 = mat3(modelMatrix);
+	vec3 normal = m3 * inNormal;
+	vec3 tangent = m3 * inTangent.xyz;
+	vec3 bitangent = cross(normal, tangent) * inTangent.w;
+	outTBN = mat3(tangent, bitangent, normal);
+#else
+	outNormal = mat3(modelMatrix) * inNormal;
+#endif
+#endif
+
+	vec4 worldPos = modelMatrix * inPos;
+	outWorldPos = worldPos.xyz;
+	gl_Position = u_ProjectionMatrix * u_ViewMatrix * worldPos;
+}
\ No newline at end of file